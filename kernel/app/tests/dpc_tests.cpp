@@ -0,0 +1,268 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include "tests.h"
+
+#include <err.h>
+#include <inttypes.h>
+#include <platform.h>
+#include <stdio.h>
+
+#include <arch/ops.h>
+#include <kernel/atomic.h>
+#include <kernel/event.h>
+#include <kernel/mp.h>
+#include <kernel/thread.h>
+#include <lib/dpc.h>
+
+#include <zircon/types.h>
+
+#define LATENCY_RUNS 1000
+#define STRESS_RUNS 10000
+
+struct dpc_test_context {
+    dpc_t dpc;
+    event_t done;
+    uint ran_on;
+    lk_time_t queued_at;
+    lk_time_t latency;
+};
+
+static void dpc_test_cb(dpc_t* dpc) {
+    dpc_test_context* ctx = (dpc_test_context*)dpc->arg;
+    ctx->latency = current_time() - ctx->queued_at;
+    ctx->ran_on = arch_curr_cpu_num();
+    event_signal(&ctx->done, true);
+}
+
+static void dpc_test_context_init(dpc_test_context* ctx) {
+    ctx->dpc = {LIST_INITIAL_CLEARED_VALUE, &dpc_test_cb, ctx, 0};
+    event_init(&ctx->done, false, EVENT_FLAG_AUTOUNSIGNAL);
+}
+
+static int dpc_local_thread(void* arg) {
+    dpc_test_context* ctx = (dpc_test_context*)arg;
+    dpc_queue(&ctx->dpc, false);
+    event_wait(&ctx->done);
+    return 0;
+}
+
+static bool dpc_test_targeting(void) {
+    printf("testing dpc cpu targeting\n");
+
+    dpc_test_context ctx;
+    dpc_test_context_init(&ctx);
+
+    bool ok = true;
+    uint max = arch_max_num_cpus();
+    for (uint cpu = 0; cpu < max; cpu++) {
+        if (!mp_is_cpu_online(cpu))
+            continue;
+
+        zx_status_t status = dpc_queue_on_cpu(&ctx.dpc, cpu, false);
+        if (status != ZX_OK) {
+            printf("!! failed to queue dpc on cpu %u: %d\n", cpu, status);
+            ok = false;
+            continue;
+        }
+        event_wait(&ctx.done);
+        if (ctx.ran_on != cpu) {
+            printf("!! dpc queued on cpu %u ran on cpu %u\n", cpu, ctx.ran_on);
+            ok = false;
+        }
+    }
+
+    // a dpc queued by a thread runs on that thread's cpu
+    for (uint cpu = 0; cpu < max; cpu++) {
+        if (!mp_is_cpu_online(cpu))
+            continue;
+
+        thread_t* t = thread_create("dpc local", dpc_local_thread, &ctx,
+                                    DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+        if (t == NULL) {
+            printf("failed to create thread for cpu %u\n", cpu);
+            ok = false;
+            break;
+        }
+        thread_set_pinned_cpu(t, (int)cpu);
+        thread_resume(t);
+        thread_join(t, NULL, INFINITE_TIME);
+        if (ctx.ran_on != cpu) {
+            printf("!! dpc queued from cpu %u ran on cpu %u\n", cpu, ctx.ran_on);
+            ok = false;
+        }
+    }
+
+    if (dpc_queue_on_cpu(&ctx.dpc, SMP_MAX_CPUS, false) != ZX_ERR_INVALID_ARGS) {
+        printf("!! queueing on a bad cpu number did not fail\n");
+        ok = false;
+    }
+
+    event_destroy(&ctx.done);
+    return ok;
+}
+
+static volatile int hog_stop;
+
+static int hog_thread(void* arg) {
+    while (atomic_load(&hog_stop) == 0)
+        ;
+    return 0;
+}
+
+// Measure how long a dpc waits between being queued and running, on every
+// cpu, optionally with a busy thread competing for each cpu.
+static void dpc_test_latency(bool loaded) {
+    printf("testing dpc latency (%s)\n", loaded ? "loaded" : "idle");
+
+    thread_t* hogs[SMP_MAX_CPUS] = {};
+    uint max = arch_max_num_cpus();
+
+    atomic_store(&hog_stop, 0);
+    if (loaded) {
+        for (uint cpu = 0; cpu < max; cpu++) {
+            if (!mp_is_cpu_online(cpu))
+                continue;
+            hogs[cpu] = thread_create("dpc hog", hog_thread, NULL,
+                                      DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+            if (hogs[cpu] == NULL) {
+                printf("failed to create hog thread for cpu %u\n", cpu);
+                break;
+            }
+            thread_set_pinned_cpu(hogs[cpu], (int)cpu);
+            thread_resume(hogs[cpu]);
+        }
+    }
+
+    dpc_test_context ctx;
+    dpc_test_context_init(&ctx);
+
+    printf("  cpu      min ns      avg ns      max ns\n");
+    for (uint cpu = 0; cpu < max; cpu++) {
+        if (!mp_is_cpu_online(cpu))
+            continue;
+
+        lk_time_t min = UINT64_MAX, max_latency = 0, total = 0;
+        for (uint i = 0; i < LATENCY_RUNS; i++) {
+            ctx.queued_at = current_time();
+            if (dpc_queue_on_cpu(&ctx.dpc, cpu, false) != ZX_OK)
+                break;
+            event_wait(&ctx.done);
+
+            total += ctx.latency;
+            if (ctx.latency < min)
+                min = ctx.latency;
+            if (ctx.latency > max_latency)
+                max_latency = ctx.latency;
+        }
+        printf("  %3u %11" PRIu64 " %11" PRIu64 " %11" PRIu64 "\n",
+               cpu, min, total / LATENCY_RUNS, max_latency);
+    }
+
+    atomic_store(&hog_stop, 1);
+    for (uint cpu = 0; cpu < max; cpu++) {
+        if (hogs[cpu])
+            thread_join(hogs[cpu], NULL, INFINITE_TIME);
+    }
+
+    event_destroy(&ctx.done);
+}
+
+// Each stress thread owns a small ring of dpcs and only reuses one once it
+// has been pulled off its queue, so every queue call adds work. They are
+// static so a callback still running after its thread exits is harmless.
+static dpc_t stress_dpcs[SMP_MAX_CPUS][16];
+static int stress_count;
+
+static void dpc_stress_cb(dpc_t* dpc) {
+    atomic_add((volatile int*)dpc->arg, 1);
+}
+
+static int dpc_stress_thread(void* arg) {
+    dpc_t* dpcs = stress_dpcs[arch_curr_cpu_num()];
+    const uint ndpcs = countof(stress_dpcs[0]);
+
+    uint max = arch_max_num_cpus();
+    for (uint i = 0; i < STRESS_RUNS; i++) {
+        dpc_t* dpc = &dpcs[i % ndpcs];
+        while (list_in_list(&dpc->node))
+            thread_yield();
+
+        if (i & 1) {
+            dpc_queue(dpc, false);
+        } else {
+            uint cpu = i % max;
+            if (dpc_queue_on_cpu(dpc, cpu, false) != ZX_OK)
+                dpc_queue(dpc, false);
+        }
+    }
+
+    return 0;
+}
+
+// Queue dpcs from every cpu at once, both locally and across cpus, and make
+// sure every one of them runs.
+static bool dpc_test_stress(void) {
+    printf("testing concurrent dpc queueing\n");
+
+    thread_t* threads[SMP_MAX_CPUS] = {};
+    uint max = arch_max_num_cpus();
+    uint started = 0;
+
+    stress_count = 0;
+
+    for (uint cpu = 0; cpu < max; cpu++) {
+        for (uint i = 0; i < countof(stress_dpcs[cpu]); i++) {
+            stress_dpcs[cpu][i] = {LIST_INITIAL_CLEARED_VALUE, &dpc_stress_cb, &stress_count, 0};
+        }
+    }
+
+    lk_time_t start = current_time();
+    for (uint cpu = 0; cpu < max; cpu++) {
+        if (!mp_is_cpu_online(cpu))
+            continue;
+        threads[cpu] = thread_create("dpc stress", dpc_stress_thread, NULL,
+                                     DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+        if (threads[cpu] == NULL) {
+            printf("failed to create stress thread for cpu %u\n", cpu);
+            break;
+        }
+        thread_set_pinned_cpu(threads[cpu], (int)cpu);
+        thread_resume(threads[cpu]);
+        started++;
+    }
+
+    for (uint cpu = 0; cpu < max; cpu++) {
+        if (threads[cpu])
+            thread_join(threads[cpu], NULL, INFINITE_TIME);
+    }
+
+    // the last few callbacks may still be running
+    int expected = (int)(started * STRESS_RUNS);
+    lk_time_t deadline = current_time() + LK_SEC(5);
+    while (atomic_load(&stress_count) != expected && current_time() < deadline)
+        thread_sleep_relative(LK_MSEC(1));
+    lk_time_t elapsed = current_time() - start;
+
+    int ran = atomic_load(&stress_count);
+    printf("  %d dpcs from %u threads in %" PRIu64 " us\n",
+           ran, started, elapsed / 1000);
+    if (ran != expected) {
+        printf("!! expected %d dpcs to run, %d did\n", expected, ran);
+        return false;
+    }
+    return true;
+}
+
+int dpc_tests(int argc, const cmd_args* argv) {
+    bool ok = dpc_test_targeting();
+    dpc_test_latency(false);
+    dpc_test_latency(true);
+    ok = dpc_test_stress() && ok;
+
+    printf("%s\n", ok ? "Success" : "Failed");
+    return ok ? ZX_OK : ZX_ERR_INTERNAL;
+}
@@ -12,6 +12,7 @@
 #include <err.h>
 #include <inttypes.h>
 #include <kernel/event.h>
+#include <kernel/mp.h>
 #include <kernel/mutex.h>
 #include <kernel/thread.h>
 #include <platform.h>
@@ -97,6 +98,65 @@ static int mutex_test(void) {
     return 0;
 }
 
+static mutex_t contention_mutex = MUTEX_INITIAL_VALUE(contention_mutex);
+static volatile uint64_t contention_shared;
+
+static int mutex_contention_thread(void* arg) {
+    const int iterations = 100000;
+
+    for (int i = 0; i < iterations; i++) {
+        mutex_acquire(&contention_mutex);
+        // a short critical section, like most of the kernel's
+        for (int j = 0; j < 100; j++)
+            contention_shared++;
+        mutex_release(&contention_mutex);
+    }
+
+    return 0;
+}
+
+// Hammer a single mutex from every cpu with short critical sections, which
+// is where spinning on a running holder should avoid most of the blocking.
+static int mutex_contention_test(void) {
+    thread_t* threads[SMP_MAX_CPUS] = {};
+    uint max = arch_max_num_cpus();
+
+    mutex_reset_stats();
+    contention_shared = 0;
+
+    lk_time_t start = current_time();
+    for (uint cpu = 0; cpu < max; cpu++) {
+        if (!mp_is_cpu_online(cpu))
+            continue;
+        threads[cpu] = thread_create("mutex contention", &mutex_contention_thread, NULL,
+                                     DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+        if (threads[cpu] == NULL)
+            break;
+        thread_set_pinned_cpu(threads[cpu], (int)cpu);
+        thread_resume(threads[cpu]);
+    }
+
+    uint started = 0;
+    for (uint cpu = 0; cpu < max; cpu++) {
+        if (threads[cpu]) {
+            thread_join(threads[cpu], NULL, INFINITE_TIME);
+            started++;
+        }
+    }
+    lk_time_t elapsed = current_time() - start;
+
+    struct mutex_stats stats;
+    mutex_get_stats(&stats);
+    printf("mutex contention: %u threads in %" PRIu64 " us, %" PRIu64 " contended,"
+           " %" PRIu64 " acquired by spinning, %" PRIu64 " blocked\n",
+           started, elapsed / 1000, stats.contended, stats.spin_acquires, stats.blocks);
+
+    if (contention_shared != (uint64_t)started * 100000 * 100)
+        panic("mutex contention: lost updates to the shared counter\n");
+
+    return 0;
+}
+
 static event_t e;
 
 static int event_signaler(void* arg) {
@@ -569,6 +629,7 @@ int thread_tests(void) {
     kill_tests();
 
     mutex_test();
+    mutex_contention_test();
     event_test();
 
     spinlock_test();
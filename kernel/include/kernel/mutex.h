@@ -24,11 +24,14 @@ __BEGIN_CDECLS
  * The val field holds either 0 or a pointer to the thread_t holding the mutex.
  * If one or more threads are blocking and queued up, MUTEX_FLAG_QUEUED is ORed in as well.
  * NOTE: MUTEX_FLAG_QUEUED is only manipulated under the THREAD_LOCK.
+ * The acquire_time field is set by the holder when it had to contend for the
+ * mutex, and is 0 otherwise. It is only used for statistics.
  */
 typedef struct TA_CAP("mutex") mutex {
     uint32_t magic;
     uintptr_t val;
     wait_queue_t wait;
+    lk_time_t acquire_time;
 } mutex_t;
 
 #define MUTEX_FLAG_QUEUED ((uintptr_t)1)
@@ -49,6 +52,7 @@ static inline thread_t* mutex_holder(const mutex_t* m) {
         .magic = MUTEX_MAGIC,                       \
         .val = 0,                                   \
         .wait = WAIT_QUEUE_INITIAL_VALUE((m).wait), \
+        .acquire_time = 0,                          \
     }
 
 /* Rules for Mutexes:
@@ -63,6 +67,26 @@ void mutex_release(mutex_t* m) TA_REL(m);
 /* special version of the above with the thread lock held */
 void mutex_release_thread_locked(mutex_t* m, bool resched) TA_REL(m);
 
+/* Contention statistics, summed over all mutexes.
+ * A contended acquire first spins for as long as the holder is running on
+ * another cpu, and only blocks if the holder stops running, the spin budget
+ * runs out, or other threads are already queued. Times are bucketed by
+ * powers of two, starting with everything under 1us.
+ */
+#define MUTEX_STATS_BUCKETS 16
+
+struct mutex_stats {
+    uint64_t contended;      /* acquires that did not get the mutex right away */
+    uint64_t spin_acquires;  /* contended acquires that got the mutex by spinning */
+    uint64_t blocks;         /* contended acquires that blocked */
+    uint64_t spin_time[MUTEX_STATS_BUCKETS];  /* time spent spinning, per acquire */
+    uint64_t block_time[MUTEX_STATS_BUCKETS]; /* time spent blocked, per acquire */
+    uint64_t hold_time[MUTEX_STATS_BUCKETS];  /* time held after a contended acquire */
+};
+
+void mutex_get_stats(struct mutex_stats* stats);
+void mutex_reset_stats(void);
+
 /* does the current thread hold the mutex? */
 static inline bool is_mutex_held(const mutex_t* m) {
     return (mutex_holder(m) == get_current_thread());
@@ -19,6 +19,9 @@ struct percpu {
     /* per cpu timer queue */
     struct list_node timer_queue;
 
+    /* search tree over timer_queue; the root is timer_tree.child[0] */
+    struct timer_tree_node timer_tree;
+
     /* per cpu preemption timer */
     timer_t preempt_timer;
 
@@ -13,6 +13,12 @@
 
 __BEGIN_CDECLS
 
+#if WITH_LIB_LOCKPROF
+/* the lock profiler provides out of line versions, see lib/lockprof.h */
+void spin_lock(spin_lock_t* lock);
+int spin_trylock(spin_lock_t* lock);
+void spin_unlock(spin_lock_t* lock);
+#else
 /* interrupts should already be disabled */
 static inline void spin_lock(spin_lock_t* lock) {
     arch_spin_lock(lock);
@@ -27,6 +33,7 @@ static inline int spin_trylock(spin_lock_t* lock) {
 static inline void spin_unlock(spin_lock_t* lock) {
     arch_spin_unlock(lock);
 }
+#endif
 
 static inline void spin_lock_init(spin_lock_t* lock) {
     arch_spin_lock_init(lock);
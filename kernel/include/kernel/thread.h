@@ -17,6 +17,10 @@
 #include <zircon/compiler.h>
 #include <sys/types.h>
 
+#if WITH_LIB_LOCKPROF
+#include <lib/lockprof.h>
+#endif
+
 __BEGIN_CDECLS
 
 /* debug-enable runtime checks */
@@ -150,6 +154,10 @@ typedef struct thread {
     int linebuffer_pos;
     char linebuffer[THREAD_LINEBUFFER_LENGTH];
 #endif
+#if WITH_LIB_LOCKPROF
+    /* mutexes held by the thread, for the lock profiler */
+    struct lockprof_held_stack lockprof;
+#endif
 } thread_t;
 
 static inline uint thread_last_cpu(const thread_t* t) {
@@ -27,9 +27,18 @@ enum slack_mode {
     TIMER_SLACK_EARLY,  // slack interval is (deadline - slack, dealine]
 };
 
+// Links of a timer in its cpu's search tree (a treap ordered by
+// scheduled_time, which mirrors the order of the timer_queue list).
+struct timer_tree_node {
+    struct timer_tree_node* parent;
+    struct timer_tree_node* child[2];
+    uint32_t priority;
+};
+
 typedef struct timer {
     int magic;
     struct list_node node;
+    struct timer_tree_node tree;
 
     lk_time_t scheduled_time;
     int64_t slack; // Stores the applied slack adjustment from
@@ -45,6 +54,7 @@ typedef struct timer {
     {                                       \
         .magic = TIMER_MAGIC,               \
         .node = LIST_INITIAL_CLEARED_VALUE, \
+        .tree = {NULL, {NULL, NULL}, 0},    \
         .scheduled_time = 0,                \
         .slack = 0,                         \
         .callback = NULL,                   \
@@ -18,6 +18,7 @@
 #include <kernel/spinlock.h>
 #include <kernel/stats.h>
 #include <kernel/timer.h>
+#include <lib/dpc.h>
 #include <stdlib.h>
 #include <trace.h>
 
@@ -308,8 +309,10 @@ status_t mp_unplug_cpu(uint cpu_id) {
         status = event_wait(&unplug_done);
     } while (status < 0);
 
-    /* Now that the CPU is no longer processing tasks, move all of its timers */
+    /* Now that the CPU is no longer processing tasks, move all of its timers
+     * and any dpcs still waiting for its dpc thread */
     timer_transition_off_cpu(cpu_id);
+    dpc_transition_off_cpu(cpu_id);
 
     status = platform_mp_cpu_unplug(cpu_id);
     if (status != ZX_OK) {
@@ -20,12 +20,58 @@
 #include <debug.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/mp.h>
 #include <kernel/sched.h>
 #include <kernel/thread.h>
+#include <platform.h>
+#include <stdio.h>
+#include <string.h>
 #include <trace.h>
 
+#if WITH_LIB_LOCKPROF
+#include <lib/lockprof.h>
+
+// charge the acquisition to the caller of mutex_acquire()
+#define LOCKPROF_ACQUIRE_BEGIN()                                      \
+    uintptr_t lockprof_site = (uintptr_t)__builtin_return_address(0); \
+    lk_time_t lockprof_time = lockprof_start()
+#define LOCKPROF_ACQUIRED(m, contended) \
+    lockprof_mutex_acquired(m, lockprof_site, lockprof_time, contended)
+#define LOCKPROF_RELEASED(m) lockprof_mutex_released(m)
+#else
+#define LOCKPROF_ACQUIRE_BEGIN() do {} while (0)
+#define LOCKPROF_ACQUIRED(m, contended) do {} while (0)
+#define LOCKPROF_RELEASED(m) do {} while (0)
+#endif
+
 #define LOCAL_TRACE 0
 
+// longest a contended acquire spins on a running holder before blocking
+#define MUTEX_SPIN_MAX LK_USEC(20)
+
+// statistics are kept per cpu so that contended mutexes don't also contend
+// on the counters
+static struct mutex_stats mutex_stats[SMP_MAX_CPUS];
+
+static uint mutex_stats_bucket(lk_time_t t) {
+    // bucket 0 holds everything under 1us, then each bucket doubles
+    t >>= 10;
+    uint bucket = 0;
+    while (t != 0 && bucket < MUTEX_STATS_BUCKETS - 1) {
+        t >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static inline void mutex_stats_add(uint64_t* counter) {
+    __atomic_fetch_add(counter, 1u, __ATOMIC_RELAXED);
+}
+
+static inline struct mutex_stats* local_mutex_stats(void) {
+    return &mutex_stats[arch_curr_cpu_num()];
+}
+
 /**
  * @brief  Initialize a mutex_t
  */
@@ -57,6 +103,45 @@ void mutex_destroy(mutex_t* m) {
     wait_queue_destroy(&m->wait);
 }
 
+// Spin while the holder is running on another cpu, on the assumption that
+// it will release the mutex before blocking would have paid off. Returns
+// true if the mutex was acquired.
+//
+// The holder can release the mutex and exit while we look at it, so its
+// thread_t may be stale by the time we read its state. That's harmless: at
+// worst we stop spinning early, or spin until the mutex changes hands.
+static bool mutex_spin(mutex_t* m, thread_t* ct) {
+    lk_time_t start = current_time();
+    lk_time_t now = start;
+    bool acquired = false;
+
+    do {
+        uintptr_t val = mutex_val(m);
+        if (val == 0) {
+            if (atomic_cmpxchg_u64(&m->val, &val, (uintptr_t)ct)) {
+                acquired = true;
+                break;
+            }
+            continue;
+        }
+
+        // with threads queued the mutex is handed directly to the first of
+        // them on release, so there's nothing to wait for
+        if (val & MUTEX_FLAG_QUEUED)
+            break;
+
+        thread_t* holder = (thread_t*)val;
+        if (holder->state != THREAD_RUNNING || thread_last_cpu(holder) == arch_curr_cpu_num())
+            break;
+
+        arch_spinloop_pause();
+        now = current_time();
+    } while (now - start < MUTEX_SPIN_MAX);
+
+    mutex_stats_add(&local_mutex_stats()->spin_time[mutex_stats_bucket(now - start)]);
+    return acquired;
+}
+
 /**
  * @brief  Acquire the mutex
  */
@@ -66,12 +151,17 @@ void mutex_acquire(mutex_t* m) TA_NO_THREAD_SAFETY_ANALYSIS {
 
     thread_t* ct = get_current_thread();
     uintptr_t oldval;
+    bool spun = false;
+    LOCKPROF_ACQUIRE_BEGIN();
 
 retry:
     // fast path: assume its unheld, try to grab it
     oldval = 0;
     if (likely(atomic_cmpxchg_u64(&m->val, &oldval, (uintptr_t)ct))) {
-        // acquired it cleanly
+        // acquired it cleanly, unless we came back here after contending
+        if (unlikely(spun))
+            m->acquire_time = current_time();
+        LOCKPROF_ACQUIRED(m, spun);
         return;
     }
 
@@ -81,7 +171,20 @@ retry:
               ct, ct->name, m);
 #endif
 
-    // we contended with someone else, will probably need to block
+    // we contended with someone else, try spinning before blocking, but
+    // only once per acquire
+    if (!spun) {
+        spun = true;
+        mutex_stats_add(&local_mutex_stats()->contended);
+        if (mutex_spin(m, ct)) {
+            mutex_stats_add(&local_mutex_stats()->spin_acquires);
+            m->acquire_time = current_time();
+            LOCKPROF_ACQUIRED(m, true);
+            return;
+        }
+    }
+
+    // will probably need to block
     THREAD_LOCK(state);
 
     // save the current state and check to see if it wasn't released in the interim
@@ -99,6 +202,8 @@ retry:
     }
 
     // we have signalled that we're blocking, so drop into the wait queue
+    mutex_stats_add(&local_mutex_stats()->blocks);
+    lk_time_t block_start = current_time();
     status_t ret = wait_queue_block(&m->wait, INFINITE_TIME);
     if (unlikely(ret < ZX_OK)) {
         // mutexes are not interruptable and cannot time out, so it
@@ -110,7 +215,12 @@ retry:
     // someone must have woken us up, we should own the mutex now
     DEBUG_ASSERT(ct == mutex_holder(m));
 
+    m->acquire_time = current_time();
+    mutex_stats_add(&local_mutex_stats()->block_time[mutex_stats_bucket(m->acquire_time - block_start)]);
+
     THREAD_UNLOCK(state);
+
+    LOCKPROF_ACQUIRED(m, true);
 }
 
 // shared implementation of release
@@ -119,6 +229,15 @@ static inline void mutex_release_internal(mutex_t* m, bool reschedule, bool thre
     thread_t* ct = get_current_thread();
     uintptr_t oldval;
 
+    LOCKPROF_RELEASED(m);
+
+    // if we had to contend for the mutex, account for how long we held it
+    if (unlikely(m->acquire_time != 0)) {
+        lk_time_t held = current_time() - m->acquire_time;
+        m->acquire_time = 0;
+        mutex_stats_add(&local_mutex_stats()->hold_time[mutex_stats_bucket(held)]);
+    }
+
     // in case there's no contention, try the fast path
     oldval = (uintptr_t)ct;
     if (likely(atomic_cmpxchg_u64(&m->val, &oldval, 0))) {
@@ -183,3 +302,74 @@ void mutex_release_thread_locked(mutex_t* m, bool reschedule) TA_NO_THREAD_SAFET
     // the thread_lock
     mutex_release_internal(m, reschedule, true);
 }
+
+void mutex_get_stats(struct mutex_stats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+        const struct mutex_stats* s = &mutex_stats[i];
+        stats->contended += __atomic_load_n(&s->contended, __ATOMIC_RELAXED);
+        stats->spin_acquires += __atomic_load_n(&s->spin_acquires, __ATOMIC_RELAXED);
+        stats->blocks += __atomic_load_n(&s->blocks, __ATOMIC_RELAXED);
+        for (uint j = 0; j < MUTEX_STATS_BUCKETS; j++) {
+            stats->spin_time[j] += __atomic_load_n(&s->spin_time[j], __ATOMIC_RELAXED);
+            stats->block_time[j] += __atomic_load_n(&s->block_time[j], __ATOMIC_RELAXED);
+            stats->hold_time[j] += __atomic_load_n(&s->hold_time[j], __ATOMIC_RELAXED);
+        }
+    }
+}
+
+void mutex_reset_stats(void) {
+    // racy with respect to concurrent updates, which is fine for statistics
+    memset(mutex_stats, 0, sizeof(mutex_stats));
+}
+
+#if WITH_LIB_CONSOLE
+#include <lib/console.h>
+
+static void dump_histogram(const char* name, const uint64_t* buckets) {
+    printf("%s:\n", name);
+    for (uint i = 0; i < MUTEX_STATS_BUCKETS; i++) {
+        if (buckets[i] == 0)
+            continue;
+        lk_time_t limit = LK_USEC(1) << i;
+        if (i == MUTEX_STATS_BUCKETS - 1) {
+            printf("\t   >= %8" PRIu64 " us: %" PRIu64 "\n", limit / 2 / LK_USEC(1), buckets[i]);
+        } else {
+            printf("\t    < %8" PRIu64 " us: %" PRIu64 "\n", limit / LK_USEC(1), buckets[i]);
+        }
+    }
+}
+
+static int cmd_mutex(int argc, const cmd_args* argv, uint32_t flags) {
+    if (argc < 2) {
+    usage:
+        printf("usage:\n");
+        printf("%s stats   : dump mutex contention statistics\n", argv[0].str);
+        printf("%s reset   : reset mutex contention statistics\n", argv[0].str);
+        return ZX_ERR_INTERNAL;
+    }
+
+    if (!strcmp(argv[1].str, "stats")) {
+        struct mutex_stats stats;
+        mutex_get_stats(&stats);
+        printf("contended acquires: %" PRIu64 "\n", stats.contended);
+        printf("acquired by spinning: %" PRIu64 "\n", stats.spin_acquires);
+        printf("blocked: %" PRIu64 "\n", stats.blocks);
+        dump_histogram("spin time", stats.spin_time);
+        dump_histogram("block time", stats.block_time);
+        dump_histogram("hold time after contention", stats.hold_time);
+    } else if (!strcmp(argv[1].str, "reset")) {
+        mutex_reset_stats();
+    } else {
+        printf("unknown command\n");
+        goto usage;
+    }
+
+    return ZX_OK;
+}
+
+STATIC_COMMAND_START
+STATIC_COMMAND("mutex", "kernel mutex contention statistics", &cmd_mutex)
+STATIC_COMMAND_END(mutex);
+
+#endif // WITH_LIB_CONSOLE
@@ -138,6 +138,10 @@ static mp_cpu_mask_t rand_cpu(const mp_cpu_mask_t mask) {
 
 /* find a cpu to wake up */
 static mp_cpu_mask_t find_cpu(thread_t* t) {
+    /* a pinned thread can only run on one cpu, so kick that one */
+    if (unlikely(t->pinned_cpu >= 0))
+        return (1u << t->pinned_cpu);
+
     /* get the last cpu the thread ran on */
     mp_cpu_mask_t last_ran_cpu_mask = (1u << thread_last_cpu(t));
 
@@ -42,6 +42,98 @@ void timer_init(timer_t* timer) {
     *timer = (timer_t)TIMER_INITIAL_VALUE(*timer);
 }
 
+// Each cpu's timer_queue is a list sorted by scheduled_time, so the next
+// timer to fire is always at its head. To avoid walking the list when
+// inserting, the same timers are also kept in a treap (a binary search tree
+// that is heap-ordered on random priorities) rooted at the cpu's timer_tree
+// sentinel, which finds a new timer's neighbors in O(log n). Timers with
+// equal scheduled_time are ordered first-in, first-out in both.
+
+// Source of treap priorities; protected by timer_lock.
+static uint32_t timer_tree_seed = 1;
+
+static inline timer_t* tree_to_timer(struct timer_tree_node* n) {
+    return containerof(n, timer_t, tree);
+}
+
+// Rotates |n| above its parent, keeping the in-order sequence intact.
+static void tree_rotate_up(struct timer_tree_node* n) {
+    struct timer_tree_node* p = n->parent;
+    struct timer_tree_node* g = p->parent;
+    int dir = (p->child[1] == n);
+
+    p->child[dir] = n->child[!dir];
+    if (p->child[dir])
+        p->child[dir]->parent = p;
+    n->child[!dir] = p;
+    p->parent = n;
+
+    // The sentinel only ever uses child[0].
+    g->child[g->child[1] == p] = n;
+    n->parent = g;
+}
+
+// Inserts |timer| into the tree of |cpu| and links it into the timer_queue
+// list after all timers scheduled at or before it.
+static void tree_insert(uint cpu, timer_t* timer) {
+    struct timer_tree_node* sentinel = &percpu[cpu].timer_tree;
+    struct timer_tree_node* parent = sentinel;
+    struct timer_tree_node** link = &sentinel->child[0];
+    timer_t* prev = NULL;
+
+    while (*link) {
+        parent = *link;
+        timer_t* entry = tree_to_timer(parent);
+        if (timer->scheduled_time < entry->scheduled_time) {
+            link = &parent->child[0];
+        } else {
+            prev = entry;
+            link = &parent->child[1];
+        }
+    }
+
+    // xorshift32
+    timer_tree_seed ^= timer_tree_seed << 13;
+    timer_tree_seed ^= timer_tree_seed >> 17;
+    timer_tree_seed ^= timer_tree_seed << 5;
+
+    struct timer_tree_node* n = &timer->tree;
+    n->parent = parent;
+    n->child[0] = n->child[1] = NULL;
+    n->priority = timer_tree_seed;
+    *link = n;
+
+    // The sentinel has the highest possible priority, so it stays on top.
+    while (n->priority > n->parent->priority)
+        tree_rotate_up(n);
+
+    if (prev)
+        list_add_after(&prev->node, &timer->node);
+    else
+        list_add_head(&percpu[cpu].timer_queue, &timer->node);
+}
+
+// Removes a queued |timer| from its cpu's tree and timer_queue.
+static void timer_queue_remove(timer_t* timer) {
+    struct timer_tree_node* n = &timer->tree;
+
+    // Rotate |n| down until it is a leaf, then cut it off.
+    while (n->child[0] || n->child[1]) {
+        struct timer_tree_node* c;
+        if (!n->child[0])
+            c = n->child[1];
+        else if (!n->child[1])
+            c = n->child[0];
+        else
+            c = (n->child[0]->priority > n->child[1]->priority) ? n->child[0] : n->child[1];
+        tree_rotate_up(c);
+    }
+    n->parent->child[n->parent->child[1] == n] = NULL;
+    n->parent = NULL;
+
+    list_delete(&timer->node);
+}
+
 static void insert_timer_in_queue(uint cpu, timer_t* timer,
                                   uint64_t early_slack, uint64_t late_slack) {
 
@@ -52,108 +144,83 @@ static void insert_timer_in_queue(uint cpu, timer_t* timer,
     lk_time_t latest_deadline = timer->scheduled_time + late_slack;
 
     // For inserting the timer we consider several cases. In general we
-    // want to coalesce with the current timer unless we can prove that
+    // want to coalesce with an existing timer unless we can prove that
     // either that:
-    //  1- there is no slack overlap with current timer OR
-    //  2- the next timer is a better fit.
+    //  1- there is no slack overlap with it OR
+    //  2- the timer on the other side of the new one is a better fit.
     //
     // In diagrams that follow
-    // - Let |e| be the current (existing) timer deadline
+    // - Let |e| be the deadline of the latest existing timer before the
+    //   one we are inserting, if any
     // - Let |t| be the deadline of the timer we are inserting
-    // - Let |n| be the next timer deadline if any
-    // - Let |x| be the end of the list (not a timer)
+    // - Let |n| be the deadline of the earliest existing timer at or
+    //   after |t|, if any
     // - Let |(| and |)| the earliest_deadline and latest_deadline.
     //
-    timer_t* entry;
-
-    list_for_every_entry (&percpu[cpu].timer_queue, entry, timer_t, node) {
-        if (entry->scheduled_time > latest_deadline) {
-            // New timer latest is earlier than the current timer.
-            // Just add upfront as is, without slack.
-            //
-            //   ---------t---)--e-------------------------------> time
-            //
-            timer->slack = 0ull;
-            list_add_before(&entry->node, &timer->node);
-            return;
+    timer_t* entry = NULL;
+    timer_t* next = NULL;
+    struct timer_tree_node* x = percpu[cpu].timer_tree.child[0];
+    while (x) {
+        timer_t* t = tree_to_timer(x);
+        if (t->scheduled_time < timer->scheduled_time) {
+            entry = t;
+            x = x->child[1];
+        } else {
+            next = t;
+            x = x->child[0];
         }
+    }
 
-        if (entry->scheduled_time >= timer->scheduled_time) {
-            //  New timer slack overlaps and is to the left (or equal). We
-            //  coalesce with current by scheduling late.
+    timer_t* target = NULL;
+    if (entry != NULL && entry->scheduled_time >= earliest_deadline) {
+        // New timer is to the right of |e| and there is overlap with it,
+        // but could the next timer (if any) be a better fit?
+        //
+        //  -------------(--e---t-----?-------------------> time
+        //
+        target = entry;
+        if (next != NULL && next->scheduled_time == timer->scheduled_time) {
+            // The next timer is due exactly when the new one is, which
+            // is always the best fit.
             //
-            //  --------(----t---e-)----------------------------> time
+            //  --------------(-e---t=n-)-------------------------> time
             //
-            timer->slack = entry->scheduled_time - timer->scheduled_time;
-            timer->scheduled_time = entry->scheduled_time;
-            list_add_after(&entry->node, &timer->node);
-            return;
-        }
-
-        if (entry->scheduled_time < earliest_deadline) {
-            // new timer earliest is later than the current timer. This case
-            // is handled in a future iteration.
+            target = next;
+        } else if (next != NULL && next->scheduled_time < latest_deadline) {
+            // There is slack overlap with the next timer, and also with the
+            // current timer. Which coalescing is a better match?
             //
-            //   ----------------e--(---t-----------------------> time
+            //  --------------(-e---t---n-)-----------------------> time
             //
-            continue;
+            lk_time_t delta_entry = timer->scheduled_time - entry->scheduled_time;
+            lk_time_t delta_next = next->scheduled_time - timer->scheduled_time;
+            if (delta_next < delta_entry)
+                target = next;
         }
-
-        // New timer is to the right of current timer and there is overlap
-        // with the current timer, but could the next timer (if any) be
-        // a better fit?
+    } else if (next != NULL && next->scheduled_time <= latest_deadline) {
+        //  New timer slack overlaps the next timer, which is to the right
+        //  (or equal). We coalesce with it by scheduling late.
         //
-        //  -------------(--e---t-----?-------------------> time
+        //  --------(----t---n-)----------------------------> time
         //
+        target = next;
+    }
 
-        const timer_t* next =
-            list_next_type(&percpu[cpu].timer_queue, &entry->node, timer_t, node);
-
-        if (next != NULL) {
-            if (next->scheduled_time <= timer->scheduled_time) {
-                // The new timer is to the right of the next timer. There is no
-                // chance the current timer is a better fit.
-                //
-                //  -------------(--e---n---t----------------------> time
-                //
-                continue;
-            }
-
-            if (next->scheduled_time < latest_deadline) {
-                // There is slack overlap with the next timer, and also with the
-                // current timer. Which coalescing is a better match?
-                //
-                //  --------------(-e---t---n-)-----------------------> time
-                //
-                lk_time_t delta_entry = timer->scheduled_time - entry->scheduled_time;
-                lk_time_t delta_next = next->scheduled_time - timer->scheduled_time;
-                if (delta_next < delta_entry) {
-                    // New timer is closer to the next timer, handle it in the
-                    // next iteration.
-                    continue;
-                }
-            }
-        }
-
-        // Handles the remaining cases, note that there is overlap with
-        // the current timer.
-        //
-        //  1- this is the last timer (next == NULL) or
-        //  2- there is no overlap with the next timer, or
-        //  3- there is overlap with both current and next but
-        //     current is closer.
+    if (target != NULL) {
+        // Coalesce by moving the new timer to the |target| deadline,
+        // early or late.
+        timer->slack = target->scheduled_time - timer->scheduled_time;
+        timer->scheduled_time = target->scheduled_time;
+    } else {
+        // There is no slack overlap with any timer. Just add as is,
+        // without slack.
         //
-        //  So we coalesce by scheduling early.
+        //   ------e----(---t---)--n-------------------------> time
         //
-        timer->slack = entry->scheduled_time - timer->scheduled_time;
-        timer->scheduled_time = entry->scheduled_time;
-        list_add_after(&entry->node, &timer->node);
-        return;
+        timer->slack = 0ull;
     }
 
-    // Walked off the end of the list and there was no overlap.
-    timer->slack = 0ull;
-    list_add_tail(&percpu[cpu].timer_queue, &timer->node);
+    tree_insert(cpu, timer);
 }
 
 void timer_set(timer_t* timer, lk_time_t deadline,
@@ -252,7 +319,7 @@ void timer_reset_oneshot_local(timer_t* timer, lk_time_t deadline, timer_callbac
 
     /* remove it from the queue if it was present */
     if (list_in_list(&timer->node))
-        list_delete(&timer->node);
+        timer_queue_remove(timer);
 
     /* set up the structure */
     timer->scheduled_time = deadline;
@@ -311,7 +378,7 @@ bool timer_cancel(timer_t* timer) {
         timer_t* oldhead = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
 
         /* remove our timer from the queue */
-        list_delete(&timer->node);
+        timer_queue_remove(timer);
 
         /* TODO(cpu): if  after removing |timer| there is one other single timer with
            the same scheduled_time and slack non-zero then it is possible to return
@@ -377,7 +444,7 @@ enum handler_return timer_tick(lk_time_t now) {
         DEBUG_ASSERT_MSG(timer && timer->magic == TIMER_MAGIC,
                          "ASSERT: timer failed magic check: timer %p, magic 0x%x\n",
                          timer, (uint)timer->magic);
-        list_delete(&timer->node);
+        timer_queue_remove(timer);
 
         /* mark the timer busy */
         timer->active_cpu = cpu;
@@ -449,6 +516,7 @@ void timer_transition_off_cpu(uint old_cpu) {
 
     timer_t *entry = NULL, *tmp_entry = NULL;
     /* Move all timers from old_cpu to this cpu */
+    percpu[old_cpu].timer_tree.child[0] = NULL;
     list_for_every_entry_safe (&percpu[old_cpu].timer_queue, entry, tmp_entry, timer_t, node) {
         list_delete(&entry->node);
         // We lost the original asymmetric slack information so when we combine them
@@ -486,6 +554,11 @@ void timer_queue_init(void) {
     timer_lock = SPIN_LOCK_INITIAL_VALUE;
     for (uint i = 0; i < SMP_MAX_CPUS; i++) {
         list_initialize(&percpu[i].timer_queue);
+        percpu[i].timer_tree = (struct timer_tree_node){
+            .parent = NULL,
+            .child = {NULL, NULL},
+            .priority = UINT32_MAX,
+        };
     }
 }
 
@@ -6,30 +6,55 @@
 
 #include <lib/debuglog.h>
 
+#include <arch/ops.h>
 #include <err.h>
 #include <dev/udisplay.h>
+#include <inttypes.h>
+#include <kernel/atomic.h>
+#include <kernel/cmdline.h>
+#include <kernel/mp.h>
 #include <kernel/spinlock.h>
 #include <kernel/thread.h>
 #include <lib/io.h>
 #include <lib/version.h>
 #include <lk/init.h>
 #include <platform.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-#define DLOG_SIZE (128u * 1024u)
-#define DLOG_MASK (DLOG_SIZE - 1u)
+#define DLOG_DEFAULT_SIZE (128u * 1024u)
+#define DLOG_MIN_SIZE (16u * 1024u)
+#define DLOG_MAX_SIZE (64u * 1024u * 1024u)
 
-static_assert((DLOG_SIZE & DLOG_MASK) == 0u, "must be power of two");
-static_assert(DLOG_MAX_RECORD <= DLOG_SIZE, "wat");
+// per-cpu staging ring, see below
+//
+// This only has to hold what a cpu writes between two runs of the
+// notifier, and a writer that fills it merges it itself, so it is kept
+// small: it is paid for SMP_MAX_CPUS times over in bss.  Room for seven
+// maximum size records.
+#define DLOG_CPU_SIZE (2u * 1024u)
+#define DLOG_CPU_MASK (DLOG_CPU_SIZE - 1u)
+
+// how many records the notifier merges per acquisition of the log lock
+#define DLOG_MERGE_BATCH 32u
+
+static_assert((DLOG_DEFAULT_SIZE & (DLOG_DEFAULT_SIZE - 1)) == 0u, "must be power of two");
+static_assert((DLOG_CPU_SIZE & DLOG_CPU_MASK) == 0u, "must be power of two");
+static_assert(DLOG_MAX_RECORD <= DLOG_MIN_SIZE, "wat");
+static_assert(sizeof(uint64_t) + DLOG_MAX_RECORD <= DLOG_CPU_SIZE, "wat");
 static_assert((DLOG_MAX_RECORD & 3) == 0, "E_DONT_DO_THAT");
 
-static uint8_t DLOG_DATA[DLOG_SIZE];
+static uint8_t DLOG_DATA[DLOG_DEFAULT_SIZE];
 
 static dlog_t DLOG = {
     .lock = SPIN_LOCK_INITIAL_VALUE,
     .head = 0,
     .tail = 0,
     .data = DLOG_DATA,
+    .size = DLOG_DEFAULT_SIZE,
+    .seq = 0,
+    .pending = 0,
     .event = EVENT_INITIAL_VALUE(DLOG.event, 0, EVENT_FLAG_AUTOUNSIGNAL),
 
     .readers_lock = MUTEX_INITIAL_VALUE(DLOG.readers_lock),
@@ -56,15 +81,137 @@ static dlog_t DLOG = {
 // Tail indicates the oldest message in the debug log to read
 // from, Head indicates the next space in the debug log to write
 // a new message to.  They are clipped to the actual buffer by
-// DLOG_MASK.
+// the size of the buffer, which is a power of two and can be
+// set on the kernel command line.
 //
 //       T                     T
 //  [....XXXX....]  [XX........XX]
 //           H         H
-
+//
+// Writers do not touch the global fifo or its lock.  Each cpu has a
+// small staging fifo of its own which only that cpu writes, with
+// interrupts disabled, and each staged record is prefixed with a
+// global sequence number.  The notifier thread (and readers, and
+// a writer that finds its staging fifo full) merge the staged
+// records into the global fifo in sequence order while holding the
+// global lock, which is the only thing that ever consumes from the
+// staging fifos.  If a writer's staging fifo is full and someone
+// else is already merging, the record is dropped and counted
+// rather than spinning with interrupts off.
+
+typedef struct dlog_cpu {
+    // written only by the owning cpu, with interrupts disabled
+    size_t head;
+    uint64_t written;
+    uint64_t dropped;
+
+    // written only with DLOG.lock held
+    size_t tail;
+
+    uint8_t data[DLOG_CPU_SIZE];
+} __CPU_ALIGN dlog_cpu_t;
+
+static dlog_cpu_t DLOG_CPU[SMP_MAX_CPUS];
 
 #define ALIGN4(n) (((n) + 3) & (~3))
 
+// Copy into / out of a power of two sized ring at an unmasked position,
+// wrapping around the end of the buffer if needed.
+static void ring_write(uint8_t* data, size_t mask, size_t pos,
+                       const void* ptr, size_t len) {
+    size_t offset = pos & mask;
+    size_t fifospace = mask + 1 - offset;
+
+    if (fifospace >= len) {
+        memcpy(data + offset, ptr, len);
+    } else {
+        memcpy(data + offset, ptr, fifospace);
+        memcpy(data, ptr + fifospace, len - fifospace);
+    }
+}
+
+static void ring_read(const uint8_t* data, size_t mask, size_t pos,
+                      void* ptr, size_t len) {
+    size_t offset = pos & mask;
+    size_t fifospace = mask + 1 - offset;
+
+    if (fifospace >= len) {
+        memcpy(ptr, data + offset, len);
+    } else {
+        memcpy(ptr, data + offset, fifospace);
+        memcpy(ptr + fifospace, data, len - fifospace);
+    }
+}
+
+// Append a record to the global fifo, discarding the oldest
+// records to make room for it.
+static void dlog_put_locked(dlog_t* log, const void* rec, size_t wiresize) {
+    size_t mask = log->size - 1;
+
+    // Discard records at tail until there is enough
+    // space for the new record.
+    while ((log->head - log->tail) > (log->size - wiresize)) {
+        uint32_t header = *((uint32_t*) (log->data + (log->tail & mask)));
+        log->tail += DLOG_HDR_GET_FIFOLEN(header);
+    }
+
+    ring_write(log->data, mask, log->head, rec, wiresize);
+    log->head += wiresize;
+}
+
+// Move up to |max| staged records into the global fifo, oldest first.
+// Returns the number of records moved.
+static size_t dlog_merge_locked(dlog_t* log, size_t max) {
+    size_t count = 0;
+
+    while (count < max) {
+        dlog_cpu_t* next = NULL;
+        uint64_t next_seq = 0;
+
+        for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+            dlog_cpu_t* c = &DLOG_CPU[i];
+            size_t head = __atomic_load_n(&c->head, __ATOMIC_ACQUIRE);
+            if (c->tail == head) {
+                continue;
+            }
+            uint64_t seq;
+            ring_read(c->data, DLOG_CPU_MASK, c->tail, &seq, sizeof(seq));
+            if ((next == NULL) || (seq < next_seq)) {
+                next = c;
+                next_seq = seq;
+            }
+        }
+        if (next == NULL) {
+            break;
+        }
+
+        size_t pos = next->tail + sizeof(uint64_t);
+        uint32_t header;
+        ring_read(next->data, DLOG_CPU_MASK, pos, &header, sizeof(header));
+        size_t wiresize = DLOG_HDR_GET_FIFOLEN(header);
+
+        uint32_t rec[DLOG_MAX_RECORD / sizeof(uint32_t)];
+        ring_read(next->data, DLOG_CPU_MASK, pos, rec, wiresize);
+        dlog_put_locked(log, rec, wiresize);
+
+        // hand the space back to the writer only once we are done with it
+        __atomic_store_n(&next->tail, pos + wiresize, __ATOMIC_RELEASE);
+        count++;
+    }
+
+    return count;
+}
+
+static void dlog_merge(dlog_t* log) {
+    size_t count;
+    do {
+        spin_lock_saved_state_t state;
+        spin_lock_irqsave(&log->lock, state);
+        count = dlog_merge_locked(log, DLOG_MERGE_BATCH);
+        spin_unlock_irqrestore(&log->lock, state);
+    } while (count == DLOG_MERGE_BATCH);
+}
+
 zx_status_t dlog_write(uint32_t flags, const void* ptr, size_t len) {
     dlog_t* log = &DLOG;
 
@@ -80,13 +227,13 @@ zx_status_t dlog_write(uint32_t flags, const void* ptr, size_t len) {
     // that worst case there will be room for a header skipping
     // the last n bytes when the fifo wraps
     size_t wiresize = DLOG_MIN_RECORD + ALIGN4(len);
+    size_t stagesize = sizeof(uint64_t) + wiresize;
 
-    // Prepare the record header before taking the lock
+    // Prepare the record header before disabling interrupts
     dlog_header_t hdr;
     hdr.header = DLOG_HDR_SET(wiresize, DLOG_MIN_RECORD + len);
     hdr.datalen = len;
     hdr.flags = flags;
-    hdr.timestamp = current_time();
     thread_t *t = get_current_thread();
     if (t) {
         hdr.pid = t->user_pid;
@@ -97,47 +244,53 @@ zx_status_t dlog_write(uint32_t flags, const void* ptr, size_t len) {
     }
 
     spin_lock_saved_state_t state;
-    spin_lock_irqsave(&log->lock, state);
-
-    // Discard records at tail until there is enough
-    // space for the new record.
-    while ((log->head - log->tail) > (DLOG_SIZE - wiresize)) {
-        uint32_t header = *((uint32_t*) (log->data + (log->tail & DLOG_MASK)));
-        log->tail += DLOG_HDR_GET_FIFOLEN(header);
-    }
-
-    size_t offset = (log->head & DLOG_MASK);
-
-    size_t fifospace = DLOG_SIZE - offset;
-
-    if (fifospace >= wiresize) {
-        // everything fits in one write, simple case!
-        memcpy(log->data + offset, &hdr, sizeof(hdr));
-        memcpy(log->data + offset + sizeof(hdr), ptr, len);
-    } else if (fifospace < sizeof(hdr)) {
-        // the wrap happens in the header
-        memcpy(log->data + offset, &hdr, fifospace);
-        memcpy(log->data, ((void*) &hdr) + fifospace, sizeof(hdr) - fifospace);
-        memcpy(log->data + (sizeof(hdr) - fifospace), ptr, len);
-    } else {
-        // the wrap happens in the data
-        memcpy(log->data + offset, &hdr, sizeof(hdr));
-        offset += sizeof(hdr);
-        fifospace -= sizeof(hdr);
-        memcpy(log->data + offset, ptr, fifospace);
-        memcpy(log->data, ptr + fifospace, len - fifospace);
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    dlog_cpu_t* c = &DLOG_CPU[arch_curr_cpu_num()];
+    size_t head = c->head;
+
+    if ((head - __atomic_load_n(&c->tail, __ATOMIC_ACQUIRE)) > (DLOG_CPU_SIZE - stagesize)) {
+        // Our staging fifo is full.  Drain everything into the global
+        // fifo ourselves, unless someone else is already at it, in which
+        // case we are better off dropping this record than spinning.
+        if (spin_trylock(&log->lock) == 0) {
+            dlog_merge_locked(log, SIZE_MAX);
+            spin_unlock(&log->lock);
+        }
+        if ((head - __atomic_load_n(&c->tail, __ATOMIC_ACQUIRE)) > (DLOG_CPU_SIZE - stagesize)) {
+            c->dropped++;
+            arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+            return ZX_OK;
+        }
     }
-    log->head += wiresize;
 
-    // if we happen to be called from within the global thread lock, use a
-    // special version of event signal
-    if (spin_lock_holder_cpu(&thread_lock) == arch_curr_cpu_num()) {
-        event_signal_thread_locked(&log->event);
-    } else {
-        event_signal(&log->event, false);
+    // Take the timestamp with interrupts off, together with the sequence
+    // number, so that records merged in sequence order are also in
+    // timestamp order.
+    hdr.timestamp = current_time();
+    uint64_t seq = __atomic_fetch_add(&log->seq, 1, __ATOMIC_RELAXED);
+    ring_write(c->data, DLOG_CPU_MASK, head, &seq, sizeof(seq));
+    head += sizeof(seq);
+    ring_write(c->data, DLOG_CPU_MASK, head, &hdr, sizeof(hdr));
+    head += sizeof(hdr);
+    ring_write(c->data, DLOG_CPU_MASK, head, ptr, len);
+    head += ALIGN4(len);
+    __atomic_store_n(&c->head, head, __ATOMIC_RELEASE);
+    c->written++;
+
+    // Only the first record staged since the notifier last looked
+    // needs to wake it up.
+    if (atomic_swap(&log->pending, 1) == 0) {
+        // if we happen to be called from within the global thread lock, use a
+        // special version of event signal
+        if (spin_lock_holder_cpu(&thread_lock) == arch_curr_cpu_num()) {
+            event_signal_thread_locked(&log->event);
+        } else {
+            event_signal(&log->event, false);
+        }
     }
 
-    spin_unlock_irqrestore(&log->lock, state);
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
 
     return ZX_OK;
 }
@@ -156,6 +309,9 @@ zx_status_t dlog_read(dlog_reader_t* rdr, uint32_t flags, void* ptr, size_t len,
     spin_lock_saved_state_t state;
     spin_lock_irqsave(&log->lock, state);
 
+    // pick up anything staged since the notifier last ran
+    dlog_merge_locked(log, DLOG_MERGE_BATCH);
+
     size_t rtail = rdr->tail;
 
     // If the read-tail is not within the range of log-tail..log-head
@@ -167,18 +323,11 @@ zx_status_t dlog_read(dlog_reader_t* rdr, uint32_t flags, void* ptr, size_t len,
     }
 
     if (rtail != log->head) {
-        size_t offset = (rtail & DLOG_MASK);
-        uint32_t header = *((uint32_t*) (log->data + offset));
+        size_t mask = log->size - 1;
+        uint32_t header = *((uint32_t*) (log->data + (rtail & mask)));
 
         size_t actual = DLOG_HDR_GET_READLEN(header);
-        size_t fifospace = DLOG_SIZE - offset;
-
-        if (fifospace >= actual) {
-            memcpy(ptr, log->data + offset, actual);
-        } else {
-            memcpy(ptr, log->data + offset, fifospace);
-            memcpy(ptr + fifospace, log->data, actual - fifospace);
-        }
+        ring_read(log->data, mask, rtail, ptr, actual);
 
         *_actual = actual;
         status = ZX_OK;
@@ -238,6 +387,11 @@ static int debuglog_notifier(void* arg) {
     for (;;) {
         event_wait(&log->event);
 
+        // clear pending before merging, so that a record staged after
+        // the merge looked at its cpu wakes us up again
+        atomic_store(&log->pending, 0);
+        dlog_merge(log);
+
         // notify readers that new log items were posted
         mutex_acquire(&log->readers_lock);
         dlog_reader_t* rdr;
@@ -302,11 +456,33 @@ static int debuglog_dumper(void *arg) {
 }
 
 
+// Move everything still staged on any cpu into the global fifo, where
+// it can be found after the panic.
+static void dlog_drain_for_panic(dlog_t* log) {
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    if (spin_trylock(&log->lock) == 0) {
+        dlog_merge_locked(log, SIZE_MAX);
+        spin_unlock(&log->lock);
+    } else if (spin_lock_holder_cpu(&log->lock) == arch_curr_cpu_num()) {
+        // We panicked in the middle of a merge, which is never going to
+        // finish.  At worst the record it was moving shows up twice.
+        dlog_merge_locked(log, SIZE_MAX);
+    }
+    // Otherwise another cpu is merging, and drains the staging fifos
+    // itself.
+
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+}
+
 void dlog_bluescreen_init(void) {
     // if we're panicing, stop processing log writes
     // they'll fail over to kernel console and serial
     DLOG.panic = true;
 
+    dlog_drain_for_panic(&DLOG);
+
     udisplay_bind_gfxconsole();
 
     // replay debug log?
@@ -323,9 +499,61 @@ void dlog_bluescreen_init(void) {
     }
 }
 
+// Switch the global fifo over to a buffer of a different size, keeping
+// as many of the newest records as fit.
+static void dlog_resize(dlog_t* log, size_t size) {
+    uint8_t* data = malloc(size);
+    if (data == NULL) {
+        printf("debuglog: cannot allocate %zu byte buffer\n", size);
+        return;
+    }
+
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&log->lock, state);
+
+    size_t mask = log->size - 1;
+    while ((log->head - log->tail) > size) {
+        uint32_t header = *((uint32_t*) (log->data + (log->tail & mask)));
+        log->tail += DLOG_HDR_GET_FIFOLEN(header);
+    }
+
+    // records keep their absolute positions, so reader tails stay valid
+    for (size_t pos = log->tail; pos != log->head;) {
+        uint32_t header = *((uint32_t*) (log->data + (pos & mask)));
+        uint32_t rec[DLOG_MAX_RECORD / sizeof(uint32_t)];
+        size_t wiresize = DLOG_HDR_GET_FIFOLEN(header);
+        ring_read(log->data, mask, pos, rec, wiresize);
+        ring_write(data, size - 1, pos, rec, wiresize);
+        pos += wiresize;
+    }
+
+    void* old = log->data;
+    log->data = data;
+    log->size = size;
+
+    spin_unlock_irqrestore(&log->lock, state);
+
+    if (old != DLOG_DATA) {
+        free(old);
+    }
+}
+
 static void dlog_init_hook(uint level) {
     thread_t* rthread;
 
+    size_t size = (size_t)cmdline_get_uint32("kernel.debuglog.size-kb",
+                                             DLOG_DEFAULT_SIZE / 1024u) * 1024u;
+    if (size < DLOG_MIN_SIZE) {
+        size = DLOG_MIN_SIZE;
+    } else if (size > DLOG_MAX_SIZE) {
+        size = DLOG_MAX_SIZE;
+    }
+    // round up to a power of two
+    size = 1ul << (sizeof(long) * 8 - __builtin_clzl(size - 1));
+    if (size != DLOG.size) {
+        dlog_resize(&DLOG, size);
+    }
+
     if ((rthread = thread_create("debuglog-notifier", debuglog_notifier, NULL,
                                  HIGH_PRIORITY - 1, DEFAULT_STACK_SIZE)) != NULL) {
         thread_resume(rthread);
@@ -337,3 +565,99 @@ static void dlog_init_hook(uint level) {
 }
 
 LK_INIT_HOOK(debuglog, dlog_init_hook, LK_INIT_LEVEL_THREADING - 1);
+
+#if WITH_LIB_CONSOLE
+
+#include <lib/console.h>
+
+static int dlog_bench_thread(void* arg) {
+    uint count = *(uint*)arg;
+    char msg[80];
+    int len = snprintf(msg, sizeof(msg), "dlog bench: cpu %u flooding the debuglog\n",
+                       arch_curr_cpu_num());
+
+    lk_time_t max = 0;
+    lk_time_t start = current_time();
+    for (uint i = 0; i < count; i++) {
+        lk_time_t t0 = current_time();
+        dlog_write(0, msg, len);
+        lk_time_t t = current_time() - t0;
+        if (t > max) {
+            max = t;
+        }
+    }
+    lk_time_t elapsed = current_time() - start;
+
+    printf("  cpu %u: %u writes in %" PRIu64 " us, %" PRIu64 " ns avg, %" PRIu64 " ns max\n",
+           arch_curr_cpu_num(), count, elapsed / 1000, elapsed / count, max);
+    return 0;
+}
+
+// Have one thread per cpu write |count| records to the debuglog as fast
+// as it can, and report how long each write took.
+static void dlog_bench(uint count) {
+    thread_t* threads[SMP_MAX_CPUS] = {};
+    uint max = arch_max_num_cpus();
+
+    for (uint cpu = 0; cpu < max; cpu++) {
+        if (!mp_is_cpu_online(cpu)) {
+            continue;
+        }
+        threads[cpu] = thread_create("dlog bench", dlog_bench_thread, &count,
+                                     DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+        if (threads[cpu] == NULL) {
+            printf("failed to create thread for cpu %u\n", cpu);
+            break;
+        }
+        thread_set_pinned_cpu(threads[cpu], cpu);
+    }
+    for (uint cpu = 0; cpu < max; cpu++) {
+        if (threads[cpu]) {
+            thread_resume(threads[cpu]);
+        }
+    }
+    for (uint cpu = 0; cpu < max; cpu++) {
+        if (threads[cpu]) {
+            thread_join(threads[cpu], NULL, INFINITE_TIME);
+        }
+    }
+}
+
+static void dlog_stats(void) {
+    dlog_t* log = &DLOG;
+
+    printf("fifo size %zu, head %zu, tail %zu\n", log->size, log->head, log->tail);
+    printf("cpu      written      dropped\n");
+    for (uint i = 0; i < arch_max_num_cpus(); i++) {
+        dlog_cpu_t* c = &DLOG_CPU[i];
+        printf("%3u %12" PRIu64 " %12" PRIu64 "\n", i, c->written, c->dropped);
+    }
+}
+
+static int cmd_dlog(int argc, const cmd_args* argv, uint32_t flags) {
+    if (argc < 2) {
+        printf("not enough arguments\n");
+    usage:
+        printf("%s stats         : show per-cpu write and drop counts\n", argv[0].str);
+        printf("%s bench [count] : flood the log from every cpu\n", argv[0].str);
+        return -1;
+    }
+
+    if (!strcmp(argv[1].str, "stats")) {
+        dlog_stats();
+    } else if (!strcmp(argv[1].str, "bench")) {
+        dlog_bench(argc > 2 ? (uint)argv[2].u : 1000u);
+        dlog_stats();
+    } else {
+        printf("unknown command\n");
+        goto usage;
+    }
+
+    return 0;
+}
+
+STATIC_COMMAND_START
+STATIC_COMMAND("dlog", "debuglog statistics and benchmark", &cmd_dlog)
+STATIC_COMMAND_END(dlog);
+
+#endif // WITH_LIB_CONSOLE
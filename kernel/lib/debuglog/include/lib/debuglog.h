@@ -27,9 +27,19 @@ struct dlog {
     size_t tail;
 
     void* data;
+    size_t size;
+
+    // sequence number handed to each record as it is staged, so records
+    // from different cpus can be merged back into the order they were
+    // written in
+    uint64_t seq;
 
     bool panic;
 
+    // set by writers when they stage a record, cleared by the notifier
+    // thread before it merges, so only the first write after a merge
+    // has to signal the event
+    int pending;
     event_t event;
 
     mutex_t readers_lock;
@@ -9,15 +9,65 @@
 #include <assert.h>
 #include <err.h>
 #include <list.h>
+#include <stdio.h>
 #include <trace.h>
 
+#include <arch/ops.h>
+#include <kernel/atomic.h>
 #include <kernel/event.h>
 #include <kernel/spinlock.h>
+#include <kernel/thread.h>
 #include <lk/init.h>
 
-static spin_lock_t dpc_lock = SPIN_LOCK_INITIAL_VALUE;
-static struct list_node dpc_list = LIST_INITIAL_VALUE(dpc_list);
-static event_t dpc_event = EVENT_INITIAL_VALUE(dpc_event, false, 0);
+// Each cpu has its own queue of pending dpcs and its own worker thread,
+// pinned to that cpu, to drain it. A dpc queued from interrupt context
+// runs on the cpu that took the interrupt, and queueing never touches
+// another cpu's lock unless it is explicitly targeted.
+struct dpc_cpu_queue {
+    spin_lock_t lock;
+    struct list_node list;
+    event_t event;
+    thread_t *thread;
+    // cleared while the cpu is unplugged; guarded by lock
+    bool online;
+};
+
+static struct dpc_cpu_queue dpc_queues[SMP_MAX_CPUS];
+
+// Put the dpc on the given cpu's queue. Must be called with interrupts
+// disabled.
+static zx_status_t dpc_enqueue(dpc_t *dpc, uint cpu, bool thread_locked,
+                               bool check_online)
+{
+    struct dpc_cpu_queue *q = &dpc_queues[cpu];
+
+    spin_lock(&q->lock);
+
+    // the current cpu is always able to run its own queue; a remote one may
+    // be on its way down, in which case its queue has already been drained
+    if (check_online && !q->online) {
+        spin_unlock(&q->lock);
+        return ZX_ERR_BAD_STATE;
+    }
+
+    if (list_in_list(&dpc->node)) {
+        spin_unlock(&q->lock);
+        return ZX_OK;
+    }
+
+    // put the dpc at the tail of the list and signal the worker
+    atomic_store(&dpc->cpu, (int)cpu);
+    list_add_tail(&q->list, &dpc->node);
+    if (thread_locked) {
+        event_signal_thread_locked(&q->event);
+    } else {
+        event_signal(&q->event, false);
+    }
+
+    spin_unlock(&q->lock);
+
+    return ZX_OK;
+}
 
 zx_status_t dpc_queue(dpc_t *dpc, bool reschedule)
 {
@@ -27,14 +77,13 @@ zx_status_t dpc_queue(dpc_t *dpc, bool reschedule)
     if (list_in_list(&dpc->node))
         return ZX_OK;
 
+    // keep the current cpu stable while we queue onto it
     spin_lock_saved_state_t state;
-    spin_lock_irqsave(&dpc_lock, state);
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
 
-    // put the dpc at the tail of the list and signal the worker
-    list_add_tail(&dpc_list, &dpc->node);
-    event_signal(&dpc_event, false);
+    dpc_enqueue(dpc, arch_curr_cpu_num(), false, false);
 
-    spin_unlock_irqrestore(&dpc_lock, state);
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
 
     // reschedule here if asked to
     if (reschedule)
@@ -43,24 +92,40 @@ zx_status_t dpc_queue(dpc_t *dpc, bool reschedule)
     return ZX_OK;
 }
 
-zx_status_t dpc_queue_thread_locked(dpc_t *dpc)
+zx_status_t dpc_queue_on_cpu(dpc_t *dpc, uint cpu, bool reschedule)
 {
     DEBUG_ASSERT(dpc);
     DEBUG_ASSERT(dpc->func);
 
+    if (cpu >= SMP_MAX_CPUS)
+        return ZX_ERR_INVALID_ARGS;
+
     if (list_in_list(&dpc->node))
         return ZX_OK;
 
     spin_lock_saved_state_t state;
-    spin_lock_irqsave(&dpc_lock, state);
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
 
-    // put the dpc at the tail of the list and signal the worker
-    list_add_tail(&dpc_list, &dpc->node);
-    event_signal_thread_locked(&dpc_event);
+    zx_status_t status = dpc_enqueue(dpc, cpu, false, true);
 
-    spin_unlock_irqrestore(&dpc_lock, state);
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
 
-    return ZX_OK;
+    if (status == ZX_OK && reschedule)
+        thread_reschedule();
+
+    return status;
+}
+
+zx_status_t dpc_queue_thread_locked(dpc_t *dpc)
+{
+    DEBUG_ASSERT(dpc);
+    DEBUG_ASSERT(dpc->func);
+    DEBUG_ASSERT(arch_ints_disabled());
+
+    if (list_in_list(&dpc->node))
+        return ZX_OK;
+
+    return dpc_enqueue(dpc, arch_curr_cpu_num(), true, false);
 }
 
 bool dpc_cancel(dpc_t *dpc)
@@ -68,51 +133,152 @@ bool dpc_cancel(dpc_t *dpc)
     DEBUG_ASSERT(dpc);
 
     spin_lock_saved_state_t state;
-    spin_lock_irqsave(&dpc_lock, state);
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
 
     bool callback_not_running = false;
 
-    if (list_in_list(&dpc->node)) {
-        list_delete(&dpc->node);
-        callback_not_running = true;
+    // the dpc can be moved to another cpu's queue while we are acquiring the
+    // lock, so make sure the queue we locked is still the one it is on
+    for (;;) {
+        uint cpu = (uint)atomic_load(&dpc->cpu);
+        struct dpc_cpu_queue *q = &dpc_queues[cpu];
+
+        spin_lock(&q->lock);
+        if ((uint)atomic_load(&dpc->cpu) != cpu) {
+            spin_unlock(&q->lock);
+            continue;
+        }
+
+        if (list_in_list(&dpc->node)) {
+            list_delete(&dpc->node);
+            callback_not_running = true;
+        }
+
+        spin_unlock(&q->lock);
+        break;
     }
 
-    spin_unlock_irqrestore(&dpc_lock, state);
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
     return callback_not_running;
 }
 
+void dpc_transition_off_cpu(uint cpu)
+{
+    DEBUG_ASSERT(cpu < SMP_MAX_CPUS);
+
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    uint cur_cpu = arch_curr_cpu_num();
+    DEBUG_ASSERT(cpu != cur_cpu);
+
+    struct dpc_cpu_queue *src = &dpc_queues[cpu];
+    struct dpc_cpu_queue *dst = &dpc_queues[cur_cpu];
+
+    // only the hotplug path ever holds two queue locks at once, and it is
+    // serialized, so there is no ordering to worry about here
+    spin_lock(&src->lock);
+    spin_lock(&dst->lock);
+
+    dpc_t *dpc;
+    bool moved = false;
+    while ((dpc = list_remove_head_type(&src->list, dpc_t, node))) {
+        atomic_store(&dpc->cpu, (int)cur_cpu);
+        list_add_tail(&dst->list, &dpc->node);
+        moved = true;
+    }
+    event_unsignal(&src->event);
+    src->online = false;
+    if (moved)
+        event_signal(&dst->event, false);
+
+    spin_unlock(&dst->lock);
+    spin_unlock(&src->lock);
+
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+}
+
 static int dpc_thread(void *arg)
 {
+    struct dpc_cpu_queue *q = (struct dpc_cpu_queue *)arg;
+
     for (;;) {
         // wait for a dpc to fire
-        __UNUSED zx_status_t err = event_wait(&dpc_event);
+        __UNUSED zx_status_t err = event_wait(&q->event);
         DEBUG_ASSERT(err == ZX_OK);
 
         spin_lock_saved_state_t state;
-        spin_lock_irqsave(&dpc_lock, state);
+        spin_lock_irqsave(&q->lock, state);
 
         // pop a dpc off the list
-        dpc_t *dpc = list_remove_head_type(&dpc_list, dpc_t, node);
+        dpc_t *dpc = list_remove_head_type(&q->list, dpc_t, node);
 
         // if the list is now empty, unsignal the event so we block until it is
         if (!dpc)
-            event_unsignal(&dpc_event);
+            event_unsignal(&q->event);
 
-        spin_unlock_irqrestore(&dpc_lock, state);
+        spin_unlock_irqrestore(&q->lock, state);
 
         // call the dpc
         if (dpc && dpc->func)
             dpc->func(dpc);
     }
 
-
     return 0;
 }
 
-static void dpc_init(unsigned int level)
+static void dpc_init_queues(unsigned int level)
+{
+    for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+        struct dpc_cpu_queue *q = &dpc_queues[i];
+
+        spin_lock_init(&q->lock);
+        list_initialize(&q->list);
+        event_init(&q->event, false, 0);
+        q->thread = NULL;
+        q->online = false;
+    }
+}
+
+void dpc_init_for_cpu(uint cpu)
 {
-    thread_t *t = thread_create("dpc", &dpc_thread, NULL, DPC_THREAD_PRIORITY, DEFAULT_STACK_SIZE);
+    DEBUG_ASSERT(cpu < SMP_MAX_CPUS);
+    struct dpc_cpu_queue *q = &dpc_queues[cpu];
+
+    // a cpu coming back from being unplugged already has its worker
+    if (q->thread)
+        return;
+
+    char name[THREAD_NAME_LENGTH];
+    snprintf(name, sizeof(name), "dpc-%u", cpu);
+
+    // until the cpu enters the scheduler, the thread just waits on the run
+    // queue, since no other cpu will pick it up
+    thread_t *t = thread_create(name, &dpc_thread, q, DPC_THREAD_PRIORITY, DEFAULT_STACK_SIZE);
+    DEBUG_ASSERT(t);
+    thread_set_pinned_cpu(t, (int)cpu);
+    q->thread = t;
     thread_detach_and_resume(t);
 }
 
+static void dpc_init(unsigned int level)
+{
+    // The secondary cpus' workers are created on this cpu as well, by
+    // lk_init_secondary_cpus(), since the scheduler is not yet running on
+    // a secondary cpu when its init hooks are.
+    dpc_init_for_cpu(arch_curr_cpu_num());
+}
+
+static void dpc_init_online(unsigned int level)
+{
+    struct dpc_cpu_queue *q = &dpc_queues[arch_curr_cpu_num()];
+
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&q->lock, state);
+    q->online = true;
+    spin_unlock_irqrestore(&q->lock, state);
+}
+
+LK_INIT_HOOK(dpc_queues, dpc_init_queues, LK_INIT_LEVEL_THREADING - 1);
 LK_INIT_HOOK(dpc, dpc_init, LK_INIT_LEVEL_THREADING);
+LK_INIT_HOOK_FLAGS(dpc_online, dpc_init_online, LK_INIT_LEVEL_THREADING, LK_INIT_FLAG_ALL_CPUS);
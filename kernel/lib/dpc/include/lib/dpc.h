@@ -22,6 +22,9 @@ typedef struct dpc {
 
     dpc_func_t func;
     void *arg;
+
+    /* cpu whose queue the dpc was last put on; owned by lib/dpc */
+    int cpu;
 } dpc_t;
 
 #define DPC_INITIAL_VALUE \
@@ -29,12 +32,17 @@ typedef struct dpc {
     .node = LIST_INITIAL_CLEARED_VALUE, \
     .func = 0, \
     .arg = 0, \
+    .cpu = 0, \
 }
 
 /* queue an already filled out dpc, optionally reschedule immediately to run the dpc thread */
-/* the deferred procedure runs in a dedicated thread that runs at DPC_THREAD_PRIORITY */
+/* the deferred procedure runs in the current cpu's dpc thread, which runs at DPC_THREAD_PRIORITY */
 zx_status_t dpc_queue(dpc_t *dpc, bool reschedule);
 
+/* queue a dpc to run in the dpc thread of a specific cpu */
+/* returns ZX_ERR_INVALID_ARGS for a bad cpu number and ZX_ERR_BAD_STATE if the cpu is offline */
+zx_status_t dpc_queue_on_cpu(dpc_t *dpc, uint cpu, bool reschedule);
+
 /* queue a dpc, but must be holding the thread lock */
 /* does not force a reschedule */
 zx_status_t dpc_queue_thread_locked(dpc_t *dpc);
@@ -43,4 +51,12 @@ zx_status_t dpc_queue_thread_locked(dpc_t *dpc);
 /* before it was scheduled to run. */
 bool dpc_cancel(dpc_t *dpc);
 
+/* Creates the dpc thread of a cpu, pinned to it. Called on the boot cpu */
+/* for each secondary cpu before it is started. */
+void dpc_init_for_cpu(uint cpu);
+
+/* Moves the pending dpcs of an unplugged cpu onto the current cpu's queue. */
+/* Called by the hotplug code once the cpu has stopped running threads. */
+void dpc_transition_off_cpu(uint cpu);
+
 __END_CDECLS
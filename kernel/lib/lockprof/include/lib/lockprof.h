@@ -0,0 +1,74 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS
+
+/* The lock profiler is built into the kernel with ENABLE_LOCK_PROFILING=true.
+ *
+ * Locks are grouped into classes by the code that acquires them: every
+ * mutex_t (and so fbl::Mutex) and spin_lock_t acquisition is charged to the
+ * return address of the acquire call, so all the instances of a lock that
+ * are taken in the same place share a class. For each class the profiler
+ * counts acquisitions and contended acquisitions, and accumulates the time
+ * spent waiting for the lock and holding it. Recording is off until started
+ * with the "lockprof" console command.
+ */
+
+#define LOCKPROF_MAX_CLASSES 2048
+/* most locks of each kind that can be held at once and still be timed */
+#define LOCKPROF_MAX_HELD 16
+
+enum lockprof_kind {
+    LOCKPROF_MUTEX = 1,
+    LOCKPROF_SPINLOCK = 2,
+};
+
+typedef struct lock_class {
+    uintptr_t site; /* return address of the acquire call, 0 if unused */
+    uint32_t kind;
+    uint64_t acquisitions;
+    uint64_t contended;
+    lk_time_t wait_time;
+    lk_time_t max_wait;
+    lk_time_t hold_time;
+    lk_time_t max_hold;
+} lock_class_t;
+
+struct lockprof_held {
+    const void* lock;
+    lock_class_t* cls;
+    lk_time_t acquired;
+};
+
+/* Locks held by a thread, or by a cpu for spinlocks, which can be released
+ * by a different thread than the one that acquired them. */
+struct lockprof_held_stack {
+    uint count;
+    struct lockprof_held locks[LOCKPROF_MAX_HELD];
+};
+
+/* Returns the time at which to start timing an acquisition, or 0 if the
+ * profiler is off. */
+lk_time_t lockprof_start(void);
+
+/* Hooks for the lock implementations. */
+void lockprof_mutex_acquired(const void* lock, uintptr_t site, lk_time_t start, bool contended);
+void lockprof_mutex_released(const void* lock);
+
+/* Copies out up to |max| classes, with the most total wait time first, and
+ * returns the number copied. */
+size_t lockprof_get_classes(lock_class_t* classes, size_t max);
+void lockprof_reset(void);
+
+/* Writes a snapshot of every class into the ktrace buffer. */
+void lockprof_ktrace_export(void);
+
+__END_CDECLS
@@ -0,0 +1,323 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <lib/lockprof.h>
+
+#include <arch/ops.h>
+#include <debug.h>
+#include <err.h>
+#include <inttypes.h>
+#include <kernel/atomic.h>
+#include <kernel/spinlock.h>
+#include <kernel/thread.h>
+#include <lib/ktrace.h>
+#include <platform.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fbl/algorithm.h>
+
+// Everything here runs inside lock acquire and release paths, including
+// those of the spinlocks the rest of the kernel uses to implement locking,
+// so it must not take any locks or allocate: the class table is a fixed
+// size open addressed hash table, claimed and updated with atomics.
+static lock_class_t classes[LOCKPROF_MAX_CLASSES];
+
+// Acquisitions that could not be charged to a class because the table was
+// full.
+static uint64_t dropped;
+
+static int enabled;
+
+// Set once recording has been started, after which locks released while it
+// is stopped still need to come off the held stacks.
+static int started;
+
+// Spinlocks are held with interrupts disabled, so never migrate, but can be
+// released by another thread than the one that acquired them (the thread
+// lock is handed across context switches), so they are tracked per cpu.
+static struct lockprof_held_stack held_spinlocks[SMP_MAX_CPUS];
+
+static inline uint64_t load(const uint64_t* p) {
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+static inline void add(uint64_t* p, uint64_t value) {
+    __atomic_fetch_add(p, value, __ATOMIC_RELAXED);
+}
+
+static void update_max(uint64_t* p, uint64_t value) {
+    uint64_t old = load(p);
+    while (value > old &&
+           !__atomic_compare_exchange_n(p, &old, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static lock_class_t* find_class(uintptr_t site, uint32_t kind) {
+    // Fibonacci hashing spreads out the call sites, which are clustered.
+    size_t index = static_cast<size_t>((site * 0x9E3779B97F4A7C15ull) >> 53) % LOCKPROF_MAX_CLASSES;
+    for (size_t i = 0; i < LOCKPROF_MAX_CLASSES; i++) {
+        lock_class_t* cls = &classes[(index + i) % LOCKPROF_MAX_CLASSES];
+        uintptr_t cur = __atomic_load_n(&cls->site, __ATOMIC_ACQUIRE);
+        if (cur == 0) {
+            // claim the slot, unless someone else just did
+            if (!__atomic_compare_exchange_n(&cls->site, &cur, site, false,
+                                             __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                if (cur != site)
+                    continue;
+            }
+            cls->kind = kind;
+            return cls;
+        }
+        if (cur == site)
+            return cls;
+    }
+    add(&dropped, 1);
+    return nullptr;
+}
+
+static void acquired(struct lockprof_held_stack* held, const void* lock, uintptr_t site,
+                     uint32_t kind, lk_time_t start, bool contended) {
+    lock_class_t* cls = find_class(site, kind);
+    if (cls == nullptr)
+        return;
+
+    lk_time_t now = current_time();
+    add(&cls->acquisitions, 1);
+    if (contended) {
+        add(&cls->contended, 1);
+        add(&cls->wait_time, now - start);
+        update_max(&cls->max_wait, now - start);
+    }
+
+    if (held->count < LOCKPROF_MAX_HELD)
+        held->locks[held->count] = {lock, cls, now};
+    // keep counting past the end, so the stack unwinds correctly
+    held->count++;
+}
+
+static void released(struct lockprof_held_stack* held, const void* lock) {
+    if (held->count == 0)
+        return;
+
+    // locks are almost always released in the reverse order, so search
+    // from the top
+    uint top = fbl::min(held->count, static_cast<uint>(LOCKPROF_MAX_HELD));
+    for (uint i = top; i > 0; i--) {
+        struct lockprof_held* entry = &held->locks[i - 1];
+        if (entry->lock != lock)
+            continue;
+
+        lk_time_t hold = current_time() - entry->acquired;
+        add(&entry->cls->hold_time, hold);
+        update_max(&entry->cls->max_hold, hold);
+
+        memmove(entry, entry + 1, (top - i) * sizeof(*entry));
+        held->count--;
+        return;
+    }
+
+    // not timed, because it was acquired while the stack was full or before
+    // recording started
+    if (held->count > LOCKPROF_MAX_HELD)
+        held->count--;
+}
+
+lk_time_t lockprof_start(void) {
+    return atomic_load(&enabled) ? current_time() : 0;
+}
+
+void lockprof_mutex_acquired(const void* lock, uintptr_t site, lk_time_t start, bool contended) {
+    if (start == 0)
+        return;
+    acquired(&get_current_thread()->lockprof, lock, site, LOCKPROF_MUTEX, start, contended);
+}
+
+void lockprof_mutex_released(const void* lock) {
+    if (atomic_load(&started))
+        released(&get_current_thread()->lockprof, lock);
+}
+
+// With the profiler built in, the spinlock operations are out of line, so
+// that the return address identifies the code taking the lock.
+
+void spin_lock(spin_lock_t* lock) {
+    lk_time_t start = lockprof_start();
+    if (start == 0) {
+        arch_spin_lock(lock);
+        return;
+    }
+
+    bool contended = arch_spin_trylock(lock) != 0;
+    if (contended)
+        arch_spin_lock(lock);
+    acquired(&held_spinlocks[arch_curr_cpu_num()], lock,
+             reinterpret_cast<uintptr_t>(__builtin_return_address(0)), LOCKPROF_SPINLOCK,
+             start, contended);
+}
+
+int spin_trylock(spin_lock_t* lock) {
+    int ret = arch_spin_trylock(lock);
+    lk_time_t start;
+    if (ret == 0 && (start = lockprof_start()) != 0) {
+        acquired(&held_spinlocks[arch_curr_cpu_num()], lock,
+                 reinterpret_cast<uintptr_t>(__builtin_return_address(0)), LOCKPROF_SPINLOCK,
+                 start, false);
+    }
+    return ret;
+}
+
+void spin_unlock(spin_lock_t* lock) {
+    // the cpu number isn't usable early in boot, and there's nothing to
+    // release until recording has started anyway
+    if (atomic_load(&started))
+        released(&held_spinlocks[arch_curr_cpu_num()], lock);
+    arch_spin_unlock(lock);
+}
+
+static int compare_wait_time(const void* a, const void* b) {
+    const lock_class_t* ca = static_cast<const lock_class_t*>(a);
+    const lock_class_t* cb = static_cast<const lock_class_t*>(b);
+    if (ca->wait_time != cb->wait_time)
+        return ca->wait_time > cb->wait_time ? -1 : 1;
+    if (ca->acquisitions != cb->acquisitions)
+        return ca->acquisitions > cb->acquisitions ? -1 : 1;
+    return 0;
+}
+
+size_t lockprof_get_classes(lock_class_t* out, size_t max) {
+    lock_class_t* snapshot = static_cast<lock_class_t*>(
+        malloc(sizeof(lock_class_t) * LOCKPROF_MAX_CLASSES));
+    if (snapshot == nullptr)
+        return 0;
+
+    size_t count = 0;
+    for (size_t i = 0; i < LOCKPROF_MAX_CLASSES; i++) {
+        lock_class_t* cls = &classes[i];
+        uintptr_t site = __atomic_load_n(&cls->site, __ATOMIC_ACQUIRE);
+        if (site == 0 || load(&cls->acquisitions) == 0)
+            continue;
+        snapshot[count++] = {
+            site,
+            cls->kind,
+            load(&cls->acquisitions),
+            load(&cls->contended),
+            load(&cls->wait_time),
+            load(&cls->max_wait),
+            load(&cls->hold_time),
+            load(&cls->max_hold),
+        };
+    }
+
+    qsort(snapshot, count, sizeof(lock_class_t), compare_wait_time);
+    count = fbl::min(count, max);
+    memcpy(out, snapshot, count * sizeof(lock_class_t));
+    free(snapshot);
+    return count;
+}
+
+void lockprof_reset(void) {
+    // The classes stay claimed, since the slots can't be safely freed while
+    // other cpus may be looking them up. Only the statistics are cleared,
+    // which races with concurrent updates; that's fine for statistics.
+    for (size_t i = 0; i < LOCKPROF_MAX_CLASSES; i++) {
+        lock_class_t* cls = &classes[i];
+        __atomic_store_n(&cls->acquisitions, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&cls->contended, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&cls->wait_time, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&cls->max_wait, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&cls->hold_time, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&cls->max_hold, 0, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&dropped, 0, __ATOMIC_RELAXED);
+}
+
+static uint32_t clamp32(uint64_t value) {
+    return value > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(value);
+}
+
+void lockprof_ktrace_export(void) {
+    for (uint32_t i = 0; i < LOCKPROF_MAX_CLASSES; i++) {
+        lock_class_t* cls = &classes[i];
+        uint64_t site = __atomic_load_n(&cls->site, __ATOMIC_ACQUIRE);
+        if (site == 0 || load(&cls->acquisitions) == 0)
+            continue;
+
+        // times are in microseconds, so they fit the 32 bit fields
+        ktrace(TAG_LOCK_CLASS, i, static_cast<uint32_t>(site),
+               static_cast<uint32_t>(site >> 32), cls->kind);
+        ktrace(TAG_LOCK_COUNTS, i, clamp32(load(&cls->acquisitions)),
+               clamp32(load(&cls->contended)), 0);
+        ktrace(TAG_LOCK_TIMES, i, clamp32(load(&cls->wait_time) / 1000),
+               clamp32(load(&cls->hold_time) / 1000), clamp32(load(&cls->max_wait) / 1000));
+    }
+}
+
+#if WITH_LIB_CONSOLE
+#include <lib/console.h>
+
+static const char* kind_name(uint32_t kind) {
+    return kind == LOCKPROF_SPINLOCK ? "spin" : "mutex";
+}
+
+static int cmd_lockprof(int argc, const cmd_args* argv, uint32_t flags) {
+    if (argc < 2) {
+    usage:
+        printf("usage:\n");
+        printf("%s start        : start recording lock statistics\n", argv[0].str);
+        printf("%s stop         : stop recording lock statistics\n", argv[0].str);
+        printf("%s reset        : clear lock statistics\n", argv[0].str);
+        printf("%s dump [count] : show the lock classes with the most wait time\n", argv[0].str);
+        printf("%s ktrace       : write lock statistics to the ktrace buffer\n", argv[0].str);
+        return ZX_ERR_INTERNAL;
+    }
+
+    if (!strcmp(argv[1].str, "start")) {
+        atomic_store(&started, 1);
+        atomic_store(&enabled, 1);
+    } else if (!strcmp(argv[1].str, "stop")) {
+        atomic_store(&enabled, 0);
+    } else if (!strcmp(argv[1].str, "reset")) {
+        lockprof_reset();
+    } else if (!strcmp(argv[1].str, "dump")) {
+        size_t max = (argc >= 3) ? static_cast<size_t>(argv[2].u) : 20;
+        if (max == 0 || max > LOCKPROF_MAX_CLASSES)
+            max = LOCKPROF_MAX_CLASSES;
+        lock_class_t* list = static_cast<lock_class_t*>(malloc(sizeof(lock_class_t) * max));
+        if (list == nullptr)
+            return ZX_ERR_NO_MEMORY;
+        size_t count = lockprof_get_classes(list, max);
+
+        printf("%-18s %-5s %12s %12s %12s %12s %12s %12s\n", "site", "kind", "acquired",
+               "contended", "wait us", "max wait us", "hold us", "max hold us");
+        for (size_t i = 0; i < count; i++) {
+            const lock_class_t* cls = &list[i];
+            printf("%#18" PRIxPTR " %-5s %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64
+                   " %12" PRIu64 " %12" PRIu64 "\n",
+                   cls->site, kind_name(cls->kind), cls->acquisitions, cls->contended,
+                   cls->wait_time / 1000, cls->max_wait / 1000, cls->hold_time / 1000,
+                   cls->max_hold / 1000);
+        }
+        uint64_t lost = load(&dropped);
+        if (lost != 0)
+            printf("%" PRIu64 " acquisitions not recorded, the class table is full\n", lost);
+        free(list);
+    } else if (!strcmp(argv[1].str, "ktrace")) {
+        lockprof_ktrace_export();
+    } else {
+        printf("unknown command\n");
+        goto usage;
+    }
+
+    return ZX_OK;
+}
+
+STATIC_COMMAND_START
+STATIC_COMMAND("lockprof", "lock contention profiler", &cmd_lockprof)
+STATIC_COMMAND_END(lockprof);
+
+#endif // WITH_LIB_CONSOLE
@@ -0,0 +1,52 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <iovec.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <lib/user_copy/user_ptr.h>
+#include <zircon/types.h>
+
+constexpr uint32_t kMaxUserIovecs = ZX_IOVEC_MAX;
+
+// The kernel's iovec_t and the public zx_iovec_t are interchangeable, so a
+// user iovec array can be copied straight into an iovec_t array.
+static_assert(sizeof(iovec_t) == sizeof(zx_iovec_t), "");
+static_assert(offsetof(iovec_t, iov_base) == offsetof(zx_iovec_t, buffer), "");
+static_assert(offsetof(iovec_t, iov_len) == offsetof(zx_iovec_t, length), "");
+
+// Copies |count| zx_iovec_ts from |vec| into |iov|, which must have room for
+// kMaxUserIovecs entries, and returns the total number of bytes they
+// describe in |total|. The buffers they point to are user memory: use a
+// UserIovecCursor to get at them.
+zx_status_t copy_iovecs_from_user(user_ptr<const zx_iovec_t> vec, uint32_t count,
+                                  iovec_t* iov, size_t* total);
+
+// Walks the user buffers described by an iovec_t array, copying data to or
+// from them as if they were one contiguous buffer.
+class UserIovecCursor {
+public:
+    UserIovecCursor(const iovec_t* iov, uint32_t count)
+        : iov_(iov), count_(count), offset_(0u) {}
+
+    // Copies the next |len| bytes out of the user buffers into |dst|.
+    zx_status_t CopyFromUser(void* dst, size_t len);
+
+    // Copies |len| bytes from |src| into the next part of the user buffers.
+    zx_status_t CopyToUser(const void* src, size_t len);
+
+private:
+    // Returns the current position, and how many bytes up to |len| can be
+    // copied there, or 0 if the buffers are used up.
+    size_t Next(size_t len, uint8_t** ptr);
+
+    const iovec_t* iov_;
+    uint32_t count_;
+    size_t offset_;
+};
@@ -0,0 +1,76 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <lib/user_copy/user_iovec.h>
+
+#include <err.h>
+
+zx_status_t copy_iovecs_from_user(user_ptr<const zx_iovec_t> vec, uint32_t count,
+                                  iovec_t* iov, size_t* total) {
+    if (count > kMaxUserIovecs)
+        return ZX_ERR_OUT_OF_RANGE;
+    if (vec.reinterpret<const iovec_t>().copy_array_from_user(iov, count) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+
+    // iovec_size() would silently wrap, so check each step here.
+    size_t sum = 0u;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (iov[i].iov_len > SIZE_MAX - sum)
+            return ZX_ERR_OUT_OF_RANGE;
+        sum += iov[i].iov_len;
+    }
+    *total = sum;
+    return ZX_OK;
+}
+
+size_t UserIovecCursor::Next(size_t len, uint8_t** ptr) {
+    // Skip buffers that are used up, including empty ones.
+    while (count_ > 0 && offset_ == iov_->iov_len) {
+        ++iov_;
+        --count_;
+        offset_ = 0u;
+    }
+    if (count_ == 0)
+        return 0u;
+
+    size_t avail = iov_->iov_len - offset_;
+    *ptr = static_cast<uint8_t*>(iov_->iov_base) + offset_;
+    return (len < avail) ? len : avail;
+}
+
+zx_status_t UserIovecCursor::CopyFromUser(void* dst, size_t len) {
+    uint8_t* out = static_cast<uint8_t*>(dst);
+    while (len > 0) {
+        uint8_t* ptr;
+        size_t chunk = Next(len, &ptr);
+        if (chunk == 0)
+            return ZX_ERR_OUT_OF_RANGE;
+        zx_status_t status = make_user_ptr<const uint8_t>(ptr).copy_array_from_user(out, chunk);
+        if (status != ZX_OK)
+            return status;
+        offset_ += chunk;
+        out += chunk;
+        len -= chunk;
+    }
+    return ZX_OK;
+}
+
+zx_status_t UserIovecCursor::CopyToUser(const void* src, size_t len) {
+    const uint8_t* in = static_cast<const uint8_t*>(src);
+    while (len > 0) {
+        uint8_t* ptr;
+        size_t chunk = Next(len, &ptr);
+        if (chunk == 0)
+            return ZX_ERR_OUT_OF_RANGE;
+        zx_status_t status = make_user_ptr(ptr).copy_array_to_user(in, chunk);
+        if (status != ZX_OK)
+            return status;
+        offset_ += chunk;
+        in += chunk;
+        len -= chunk;
+    }
+    return ZX_OK;
+}
@@ -121,6 +121,12 @@ void FifoDispatcher::OnPeerZeroHandles() {
 }
 
 zx_status_t FifoDispatcher::WriteFromUser(user_ptr<const uint8_t> ptr, size_t len, uint32_t* actual) {
+    iovec_t iov = {const_cast<uint8_t*>(ptr.get()), len};
+    return WriteFromUser(&iov, 1u, len, actual);
+}
+
+zx_status_t FifoDispatcher::WriteFromUser(const iovec_t* iov, uint32_t iov_count, size_t len,
+                                          uint32_t* actual) {
     canary_.Assert();
 
     fbl::RefPtr<FifoDispatcher> other;
@@ -131,10 +137,11 @@ zx_status_t FifoDispatcher::WriteFromUser(user_ptr<const uint8_t> ptr, size_t le
         other = other_;
     }
 
-    return other->WriteSelf(ptr, len, actual);
+    UserIovecCursor src(iov, iov_count);
+    return other->WriteSelf(&src, len, actual);
 }
 
-zx_status_t FifoDispatcher::WriteSelf(user_ptr<const uint8_t> ptr, size_t bytelen, uint32_t* actual) {
+zx_status_t FifoDispatcher::WriteSelf(UserIovecCursor* src, size_t bytelen, uint32_t* actual) {
     canary_.Assert();
 
     size_t count = bytelen / elem_size_;
@@ -165,8 +172,8 @@ zx_status_t FifoDispatcher::WriteSelf(user_ptr<const uint8_t> ptr, size_t bytele
         // number of slots we can actually copy
         size_t to_copy = (count > n) ? n : count;
 
-        zx_status_t status = ptr.copy_array_from_user(&data_[offset * elem_size_],
-                                                      to_copy * elem_size_);
+        zx_status_t status = src->CopyFromUser(&data_[offset * elem_size_],
+                                               to_copy * elem_size_);
         if (status != ZX_OK) {
             // roll back, in case this is the second copy
             head_ = old_head;
@@ -177,7 +184,6 @@ zx_status_t FifoDispatcher::WriteSelf(user_ptr<const uint8_t> ptr, size_t bytele
         // due to size limitations on fifo, to_copy will always fit in a u32
         head_ += static_cast<uint32_t>(to_copy);
         count -= to_copy;
-        ptr = ptr.byte_offset(to_copy * elem_size_);
     }
 
     // if was empty, we've become readable
@@ -192,9 +198,17 @@ zx_status_t FifoDispatcher::WriteSelf(user_ptr<const uint8_t> ptr, size_t bytele
     return ZX_OK;
 }
 
-zx_status_t FifoDispatcher::ReadToUser(user_ptr<uint8_t> ptr, size_t bytelen, uint32_t* actual) {
+zx_status_t FifoDispatcher::ReadToUser(user_ptr<uint8_t> ptr, size_t len, uint32_t* actual) {
+    iovec_t iov = {ptr.get(), len};
+    return ReadToUser(&iov, 1u, len, actual);
+}
+
+zx_status_t FifoDispatcher::ReadToUser(const iovec_t* iov, uint32_t iov_count, size_t bytelen,
+                                       uint32_t* actual) {
     canary_.Assert();
 
+    UserIovecCursor dst(iov, iov_count);
+
     size_t count = bytelen / elem_size_;
     if (count == 0)
         return ZX_ERR_OUT_OF_RANGE;
@@ -223,8 +237,8 @@ zx_status_t FifoDispatcher::ReadToUser(user_ptr<uint8_t> ptr, size_t bytelen, ui
         // number of slots we can actually copy
         size_t to_copy = (count > n) ? n : count;
 
-        zx_status_t status = ptr.copy_array_to_user(&data_[offset * elem_size_],
-                                                    to_copy * elem_size_);
+        zx_status_t status = dst.CopyToUser(&data_[offset * elem_size_],
+                                            to_copy * elem_size_);
         if (status != ZX_OK) {
             // roll back, in case this is the second copy
             tail_ = old_tail;
@@ -235,7 +249,6 @@ zx_status_t FifoDispatcher::ReadToUser(user_ptr<uint8_t> ptr, size_t bytelen, ui
         // due to size limitations on fifo, to_copy will always fit in a u32
         tail_ += static_cast<uint32_t>(to_copy);
         count -= to_copy;
-        ptr = ptr.byte_offset(to_copy * elem_size_);
     }
 
     // if we were full, we have become writable
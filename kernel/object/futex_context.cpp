@@ -23,9 +23,42 @@ FutexContext::FutexContext() {
 FutexContext::~FutexContext() {
     LTRACE_ENTRY;
 
+#if LK_DEBUGLEVEL > 1
     // All of the threads should have removed themselves from wait queues
     // by the time the process has exited.
-    DEBUG_ASSERT(futex_table_.is_empty());
+    for (Bucket& bucket : buckets_) {
+        AutoLock lock(&bucket.lock);
+        DEBUG_ASSERT(bucket.futex_table.is_empty());
+    }
+#endif
+}
+
+FutexContext::Bucket* FutexContext::GetBucket(uintptr_t futex_key) {
+    static_assert((kNumBuckets & (kNumBuckets - 1)) == 0,
+                  "kNumBuckets must be a power of two");
+
+    // Futex addresses are at least int aligned and often much more, so mix
+    // all of the bits with a multiplicative hash and take the top ones.
+    uint64_t hash = static_cast<uint64_t>(futex_key >> 2) * 0x9e3779b97f4a7c15ull;
+    return &buckets_[hash >> (64 - __builtin_ctzll(kNumBuckets))];
+}
+
+void FutexContext::LockBuckets(Bucket* bucket1, Bucket* bucket2) TA_NO_THREAD_SAFETY_ANALYSIS {
+    if (bucket1 == bucket2) {
+        bucket1->lock.Acquire();
+    } else if (bucket1 < bucket2) {
+        bucket1->lock.Acquire();
+        bucket2->lock.Acquire();
+    } else {
+        bucket2->lock.Acquire();
+        bucket1->lock.Acquire();
+    }
+}
+
+void FutexContext::UnlockBuckets(Bucket* bucket1, Bucket* bucket2) TA_NO_THREAD_SAFETY_ANALYSIS {
+    bucket1->lock.Release();
+    if (bucket1 != bucket2)
+        bucket2->lock.Release();
 }
 
 zx_status_t FutexContext::FutexWait(user_ptr<int> value_ptr, int current_value, zx_time_t deadline) {
@@ -36,6 +69,7 @@ zx_status_t FutexContext::FutexWait(user_ptr<int> value_ptr, int current_value,
         return ZX_ERR_INVALID_ARGS;
 
     FutexNode* node;
+    Bucket* bucket = GetBucket(futex_key);
 
     // FutexWait() checks that the address value_ptr still contains
     // current_value, and if so it sleeps awaiting a FutexWake() on value_ptr.
@@ -43,16 +77,16 @@ zx_status_t FutexContext::FutexWait(user_ptr<int> value_ptr, int current_value,
     // If a FutexWake() operation could occur between them, a userland mutex
     // operation built on top of futexes would have a race condition that
     // could miss wakeups.
-    lock_.Acquire();
+    bucket->lock.Acquire();
 
     int value;
     zx_status_t result = value_ptr.copy_from_user(&value);
     if (result != ZX_OK) {
-        lock_.Release();
+        bucket->lock.Release();
         return result;
     }
     if (value != current_value) {
-        lock_.Release();
+        bucket->lock.Release();
         return ZX_ERR_BAD_STATE;
     }
 
@@ -61,10 +95,11 @@ zx_status_t FutexContext::FutexWait(user_ptr<int> value_ptr, int current_value,
     node->set_hash_key(futex_key);
     node->SetAsSingletonList();
 
-    QueueNodesLocked(node);
+    QueueNodesLocked(bucket, node);
 
-    // Block current thread.  This releases lock_ and does not reacquire it.
-    result = node->BlockThread(&lock_, deadline);
+    // Block current thread.  This releases the bucket lock and does not
+    // reacquire it.
+    result = node->BlockThread(&bucket->lock, deadline);
     if (result == ZX_OK) {
         DEBUG_ASSERT(!node->IsInQueue());
         // All the work necessary for removing us from the hash table was done by FutexWake()
@@ -77,8 +112,7 @@ zx_status_t FutexContext::FutexWait(user_ptr<int> value_ptr, int current_value,
     //
     // We need to ensure that the thread's node is removed from the wait
     // queue, because FutexWake() probably didn't do that.
-    AutoLock lock(&lock_);
-    if (UnqueueNodeLocked(node)) {
+    if (UnqueueNode(node)) {
         return result;
     }
     // The current thread was not found on the wait queue.  This means
@@ -113,9 +147,10 @@ zx_status_t FutexContext::FutexWake(user_ptr<const int> value_ptr,
     if (futex_key % sizeof(int))
         return ZX_ERR_INVALID_ARGS;
 
-    AutoLock lock(&lock_);
+    Bucket* bucket = GetBucket(futex_key);
+    AutoLock lock(&bucket->lock);
 
-    FutexNode* node = futex_table_.erase(futex_key);
+    FutexNode* node = bucket->futex_table.erase(futex_key);
     if (!node) {
         // nothing blocked on this futex if we can't find it
         return ZX_OK;
@@ -128,7 +163,7 @@ zx_status_t FutexContext::FutexWake(user_ptr<const int> value_ptr,
 
     if (remaining_waiters) {
         DEBUG_ASSERT(remaining_waiters->GetKey() == futex_key);
-        futex_table_.insert(remaining_waiters);
+        bucket->futex_table.insert(remaining_waiters);
     }
 
     if (any_woken) {
@@ -146,31 +181,51 @@ zx_status_t FutexContext::FutexRequeue(user_ptr<int> wake_ptr, uint32_t wake_cou
     if ((requeue_ptr.get() == nullptr) && requeue_count)
         return ZX_ERR_INVALID_ARGS;
 
-    AutoLock lock(&lock_);
+    uintptr_t wake_key = reinterpret_cast<uintptr_t>(wake_ptr.get());
+    uintptr_t requeue_key = reinterpret_cast<uintptr_t>(requeue_ptr.get());
+    Bucket* wake_bucket = GetBucket(wake_key);
+    Bucket* requeue_bucket = GetBucket(requeue_key);
+
+    LockBuckets(wake_bucket, requeue_bucket);
 
     int value;
     zx_status_t result = wake_ptr.copy_from_user(&value);
-    if (result != ZX_OK) return result;
-    if (value != current_value) return ZX_ERR_BAD_STATE;
+    if (result == ZX_OK && value != current_value)
+        result = ZX_ERR_BAD_STATE;
+    if (result == ZX_OK && wake_key == requeue_key)
+        result = ZX_ERR_INVALID_ARGS;
+    if (result == ZX_OK && (wake_key % sizeof(int) || requeue_key % sizeof(int)))
+        result = ZX_ERR_INVALID_ARGS;
 
-    uintptr_t wake_key = reinterpret_cast<uintptr_t>(wake_ptr.get());
-    uintptr_t requeue_key = reinterpret_cast<uintptr_t>(requeue_ptr.get());
-    if (wake_key == requeue_key) return ZX_ERR_INVALID_ARGS;
-    if (wake_key % sizeof(int) || requeue_key % sizeof(int))
-        return ZX_ERR_INVALID_ARGS;
+    bool any_woken = false;
+    if (result == ZX_OK) {
+        RequeueLocked(wake_bucket, requeue_bucket, wake_key, wake_count,
+                      requeue_key, requeue_count, &any_woken);
+    }
 
+    UnlockBuckets(wake_bucket, requeue_bucket);
+
+    if (any_woken)
+        thread_reschedule();
+
+    return result;
+}
+
+void FutexContext::RequeueLocked(Bucket* wake_bucket, Bucket* requeue_bucket,
+                                 uintptr_t wake_key, uint32_t wake_count,
+                                 uintptr_t requeue_key, uint32_t requeue_count,
+                                 bool* any_woken) {
     // This must happen before RemoveFromHead() calls set_hash_key() on
-    // nodes below, because operations on futex_table_ look at the GetKey
+    // nodes below, because operations on futex_table look at the GetKey
     // field of the list head nodes for wake_key and requeue_key.
-    FutexNode* node = futex_table_.erase(wake_key);
+    FutexNode* node = wake_bucket->futex_table.erase(wake_key);
     if (!node) {
         // nothing blocked on this futex if we can't find it
-        return ZX_OK;
+        return;
     }
 
-    bool any_woken = false;
     if (wake_count > 0) {
-        node = FutexNode::WakeThreads(node, wake_count, wake_key, &any_woken);
+        node = FutexNode::WakeThreads(node, wake_count, wake_key, any_woken);
     }
 
     // node is now the head of wake_ptr futex after possibly removing some threads to wake
@@ -183,26 +238,19 @@ zx_status_t FutexContext::FutexRequeue(user_ptr<int> wake_ptr, uint32_t wake_cou
 
             // now requeue our nodes to requeue_ptr mutex
             DEBUG_ASSERT(requeue_head->GetKey() == requeue_key);
-            QueueNodesLocked(requeue_head);
+            QueueNodesLocked(requeue_bucket, requeue_head);
         }
     }
 
     // add any remaining nodes back to wake_key futex
     if (node != nullptr) {
         DEBUG_ASSERT(node->GetKey() == wake_key);
-        futex_table_.insert(node);
+        wake_bucket->futex_table.insert(node);
     }
-
-    if (any_woken) {
-        lock.release();
-        thread_reschedule();
-    }
-
-    return ZX_OK;
 }
 
-void FutexContext::QueueNodesLocked(FutexNode* head) {
-    DEBUG_ASSERT(lock_.IsHeld());
+void FutexContext::QueueNodesLocked(Bucket* bucket, FutexNode* head) {
+    DEBUG_ASSERT(bucket->lock.IsHeld());
 
     FutexNode::HashTable::iterator iter;
 
@@ -210,29 +258,43 @@ void FutexContext::QueueNodesLocked(FutexNode* head) {
     // succeeds, then the current thread is first to block on this futex and we
     // are finished.  If the insert fails, then there is already a thread
     // waiting on this futex.  Add ourselves to that thread's list.
-    if (!futex_table_.insert_or_find(head, &iter))
+    if (!bucket->futex_table.insert_or_find(head, &iter))
         iter->AppendList(head);
 }
 
 // This attempts to unqueue a thread (which may or may not be waiting on a
 // futex), given its FutexNode.  This returns whether the FutexNode was
 // found and removed from a futex wait queue.
-bool FutexContext::UnqueueNodeLocked(FutexNode* node) {
-    DEBUG_ASSERT(lock_.IsHeld());
+bool FutexContext::UnqueueNode(FutexNode* node) {
+    for (;;) {
+        // Note: When UnqueueNode() is called from FutexWait(), it might be
+        // tempting to reuse the futex key that was passed to FutexWait().
+        // However, that could be out of date if the thread was requeued by
+        // FutexRequeue(), so we need to re-get the hash table key here.
+        // FutexRequeue() changes the key while holding the locks of both
+        // the old and the new futex's buckets, so once we hold the lock
+        // for the bucket of the key we read, the key can only still match
+        // if it is stable.
+        uintptr_t futex_key = node->GetKey();
+        Bucket* bucket = GetBucket(futex_key);
+        AutoLock lock(&bucket->lock);
+        if (node->GetKey() == futex_key)
+            return UnqueueNodeLocked(bucket, node);
+    }
+}
+
+bool FutexContext::UnqueueNodeLocked(Bucket* bucket, FutexNode* node) {
+    DEBUG_ASSERT(bucket->lock.IsHeld());
 
     if (!node->IsInQueue())
         return false;
 
-    // Note: When UnqueueNode() is called from FutexWait(), it might be
-    // tempting to reuse the futex key that was passed to FutexWait().
-    // However, that could be out of date if the thread was requeued by
-    // FutexRequeue(), so we need to re-get the hash table key here.
     uintptr_t futex_key = node->GetKey();
 
-    FutexNode* old_head = futex_table_.erase(futex_key);
+    FutexNode* old_head = bucket->futex_table.erase(futex_key);
     DEBUG_ASSERT(old_head);
     FutexNode* new_head = FutexNode::RemoveNodeFromList(old_head, node);
     if (new_head)
-        futex_table_.insert(new_head);
+        bucket->futex_table.insert(new_head);
     return true;
 }
@@ -174,10 +174,11 @@ bool FutexNode::WakeThread() {
     // cases to consider:
     //  1) The thread's wait times out, or the thread is killed or
     //     suspended.  In those cases, FutexWait() will reacquire the
-    //     FutexContext lock.  We are currently holding that lock, so
-    //     FutexWait() will not race with us.
+    //     lock of the FutexContext bucket holding this futex.  We are
+    //     currently holding that lock, so FutexWait() will not race
+    //     with us.
     //  2) The thread is woken by our wait_queue_wake_one() call.  In
-    //     this case, FutexWait() will *not* reacquire the FutexContext
+    //     this case, FutexWait() will *not* reacquire the bucket
     //     lock.  To handle this correctly, we must not access |this|
     //     after wait_queue_wake_one().
 
@@ -185,9 +186,9 @@ bool FutexNode::WakeThread() {
     MarkAsNotInQueue();
 
     // Place the waiting thread in the runnable state, but do not
-    // reschedule yet.  Our caller is currently holding the main
-    // futex_lock, and any threads which get woken by this action are going
-    // to immediately attempt to obtain the main futex_lock.  If we
+    // reschedule yet.  Our caller is currently holding the futex's
+    // bucket lock, and any threads which get woken by this action are going
+    // to immediately attempt to obtain that lock.  If we
     // indicate that the thread was woken during this process, our caller
     // will release the lock and then arrange for a reschedule operation
     // (which leads to a smoother transition).
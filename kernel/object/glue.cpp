@@ -14,7 +14,12 @@
 #include <pow2.h>
 #include <trace.h>
 
+#include <arch/ops.h>
+
+#include <kernel/auto_lock.h>
 #include <kernel/cmdline.h>
+#include <kernel/mp.h>
+#include <kernel/spinlock.h>
 
 #include <lk/init.h>
 
@@ -34,6 +39,7 @@
 #include <object/state_tracker.h>
 
 #include <fbl/arena.h>
+#include <fbl/atomic.h>
 #include <fbl/auto_lock.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/mutex.h>
@@ -52,13 +58,41 @@ constexpr size_t kMaxHandleCount = 256 * 1024u;
 // there are this many outstanding handles.
 constexpr size_t kHighHandleCount = (kMaxHandleCount * 7) / 8;
 
-// The handle arena and its mutex. It also guards Dispatcher::handle_count_.
+// The number of free handle slots each CPU can cache, and the number moved
+// between a cache and the arena at once when the cache runs empty or full.
+constexpr size_t kHandleCacheSize = 64u;
+constexpr size_t kHandleCacheBatch = kHandleCacheSize / 2;
+
+// The handle arena and its mutex.
 static fbl::Mutex handle_mutex;
 static fbl::Arena TA_GUARDED(handle_mutex) handle_arena;
 
+// Handles currently in use. Slots sitting in a HandleCache are allocated
+// from the arena's point of view but are not counted here.
+static fbl::atomic<size_t> outstanding_handles(0u);
+
+// A per-CPU stash of free handle slots, so that most handle creation and
+// destruction doesn't touch |handle_mutex|. A thread may migrate after
+// picking its CPU's cache, so each cache still has a (nearly always
+// uncontended) lock.
+struct HandleCache {
+    SpinLock lock;
+    // The following are guarded by |lock|.
+    size_t count;
+    void* slots[kHandleCacheSize];
+    uint64_t alloc_hits;
+    uint64_t alloc_misses;
+    uint64_t free_hits;
+    uint64_t free_misses;
+};
+static HandleCache handle_cache[SMP_MAX_CPUS];
+
+static HandleCache* GetHandleCache() {
+    return &handle_cache[arch_curr_cpu_num()];
+}
+
 size_t internal::OutstandingHandles() {
-    AutoLock lock(&handle_mutex);
-    return handle_arena.DiagnosticCount();
+    return outstanding_handles.load();
 }
 
 // All jobs and processes are rooted at the |root_job|.
@@ -93,11 +127,13 @@ static_assert(((3 << 30) ^ kHandleGenerationMask ^ kHandleIndexMask) ==
                   0xffffffffu,
               "Masks do not agree");
 
-// Returns a new |base_value| based on the value stored in the free
-// |handle_arena| slot pointed to by |addr|. The new value will be different
-// from the last |base_value| used by this slot.
-static uint32_t GetNewHandleBaseValue(void* addr) TA_REQ(handle_mutex) {
-    // Get the index of this slot within handle_arena.
+// Returns the |base_value| for a newly allocated handle, based on the value
+// stashed by TearDownHandle() in the free |handle_arena| slot pointed to by
+// |addr|. The new value will be different from the last |base_value| used by
+// this slot.
+static uint32_t GetNewHandleBaseValue(void* addr) TA_NO_THREAD_SAFETY_ANALYSIS {
+    // Get the index of this slot within handle_arena. The arena's start
+    // never changes after initialization, so this doesn't need the lock.
     auto va = reinterpret_cast<Handle*>(addr) -
               reinterpret_cast<Handle*>(handle_arena.start());
     uint32_t handle_index = static_cast<uint32_t>(va);
@@ -105,21 +141,19 @@ static uint32_t GetNewHandleBaseValue(void* addr) TA_REQ(handle_mutex) {
 
     // Check the free memory for a stashed base_value.
     uint32_t v = *reinterpret_cast<uint32_t*>(addr);
-    uint32_t old_gen;
     if (v == 0) {
         // First time this slot has been allocated.
-        old_gen = 0;
-    } else {
-        // This slot has been used before.
-        DEBUG_ASSERT((v & kHandleIndexMask) == handle_index);
-        old_gen = (v & kHandleGenerationMask) >> kHandleGenerationShift;
+        return (1u << kHandleGenerationShift) | handle_index;
     }
-    return (((old_gen + 1) << kHandleGenerationShift) & kHandleGenerationMask) | handle_index;
+    // This slot has been used before; TearDownHandle() already bumped the
+    // generation.
+    DEBUG_ASSERT((v & kHandleIndexMask) == handle_index);
+    return v;
 }
 
 // Destroys, but does not free, the Handle, and fixes up its memory to protect
-// against stale pointers to it. Also stashes the Handle's base_value for reuse
-// the next time this slot is allocated.
+// against stale pointers to it. Also stashes the next base_value for this slot
+// to be used the next time it is allocated.
 void internal::TearDownHandle(Handle* handle) TA_EXCL(handle_mutex) {
     uint32_t base_value = handle->base_value();
 
@@ -132,9 +166,12 @@ void internal::TearDownHandle(Handle* handle) TA_EXCL(handle_mutex) {
     // or point to any Dispatcher.
     memset(handle, 0, sizeof(Handle));
 
-    // Hold onto the base_value for the next user of this slot, stashing
-    // it at the beginning of the free slot.
-    *reinterpret_cast<uint32_t*>(handle) = base_value;
+    // Bump the generation for the next user of this slot, stashing the
+    // result at the beginning of the free slot.
+    uint32_t old_gen = (base_value & kHandleGenerationMask) >> kHandleGenerationShift;
+    *reinterpret_cast<uint32_t*>(handle) =
+        (((old_gen + 1) << kHandleGenerationShift) & kHandleGenerationMask) |
+        (base_value & kHandleIndexMask);
 
     // Double-check that the process_id field is zero, ensuring that
     // no process can refer to this slot while it's free. This isn't
@@ -143,37 +180,116 @@ void internal::TearDownHandle(Handle* handle) TA_EXCL(handle_mutex) {
     DEBUG_ASSERT(handle->process_id() == 0);
 }
 
-static void high_handle_count(size_t count) {
-    // TODO: Avoid calling this for every handle after kHighHandleCount;
-    // printfs are slow and |handle_mutex| is held by our caller.
-    printf("WARNING: High handle count: %zu handles\n", count);
-}
+// Takes a free slot from the current CPU's cache, refilling the cache from
+// |handle_arena| if it's empty. Returns nullptr if there are no free slots.
+static void* AllocHandleSlot() {
+    HandleCache* cache = GetHandleCache();
+    {
+        AutoSpinLockIrqSave lock(&cache->lock);
+        if (cache->count > 0) {
+            cache->alloc_hits++;
+            return cache->slots[--cache->count];
+        }
+        cache->alloc_misses++;
+    }
 
-Handle* MakeHandle(fbl::RefPtr<Dispatcher> dispatcher, zx_rights_t rights) {
-    uint32_t* handle_count = nullptr;
-    void* addr;
-    uint32_t base_value;
+    void* batch[kHandleCacheBatch];
+    size_t n = 0;
+    {
+        AutoLock lock(&handle_mutex);
+        while (n < kHandleCacheBatch) {
+            void* addr = handle_arena.Alloc();
+            if (addr == nullptr)
+                break;
+            batch[n++] = addr;
+        }
+    }
+
+    if (n == 0) {
+        // The arena is exhausted; the only free slots left are in
+        // other CPUs' caches.
+        for (auto& other : handle_cache) {
+            AutoSpinLockIrqSave lock(&other.lock);
+            if (other.count > 0)
+                return other.slots[--other.count];
+        }
+        return nullptr;
+    }
 
+    // Keep one slot for the caller and stash the rest. If the cache was
+    // refilled while we were away, give the excess back to the arena.
+    void* addr = batch[--n];
     {
+        AutoSpinLockIrqSave lock(&cache->lock);
+        while (n > 0 && cache->count < kHandleCacheSize)
+            cache->slots[cache->count++] = batch[--n];
+    }
+    if (n > 0) {
         AutoLock lock(&handle_mutex);
-        addr = handle_arena.Alloc();
-        const size_t outstanding_handles = handle_arena.DiagnosticCount();
-        if (addr == nullptr) {
-            lock.release();
-            printf("WARNING: Could not allocate new handle (%zu outstanding)\n",
-                   outstanding_handles);
-            return nullptr;
+        while (n > 0)
+            handle_arena.Free(batch[--n]);
+    }
+    return addr;
+}
+
+// Returns a slot to the current CPU's cache, moving a batch of slots back
+// to |handle_arena| if the cache is full.
+static void FreeHandleSlot(void* addr) {
+    HandleCache* cache = GetHandleCache();
+    void* batch[kHandleCacheBatch];
+    {
+        AutoSpinLockIrqSave lock(&cache->lock);
+        if (cache->count < kHandleCacheSize) {
+            cache->free_hits++;
+            cache->slots[cache->count++] = addr;
+            return;
         }
-        if (outstanding_handles > kHighHandleCount)
-            high_handle_count(outstanding_handles);
+        cache->free_misses++;
+        for (size_t i = 0; i < kHandleCacheBatch; ++i)
+            batch[i] = cache->slots[--cache->count];
+        cache->slots[cache->count++] = addr;
+    }
 
-        handle_count = dispatcher->get_handle_count_ptr();
-        (*handle_count)++;
-        if (*handle_count != 2u)
-            handle_count = nullptr;
+    AutoLock lock(&handle_mutex);
+    for (size_t i = 0; i < kHandleCacheBatch; ++i)
+        handle_arena.Free(batch[i]);
+}
 
-        base_value = GetNewHandleBaseValue(addr);
+static void high_handle_count(size_t count) {
+    // TODO: Avoid calling this for every handle after kHighHandleCount;
+    // printfs are slow.
+    printf("WARNING: High handle count: %zu handles\n", count);
+}
+
+// Allocates a slot for a new handle to |dispatcher| and bumps the
+// dispatcher's handle count. Returns nullptr if there are no slots left.
+// If the dispatcher now has exactly two handles, |*handle_count| points
+// to its count; otherwise it is set to nullptr.
+static void* AllocHandle(Dispatcher* dispatcher, const char* what,
+                         fbl::atomic<uint32_t>** handle_count) {
+    void* addr = AllocHandleSlot();
+    if (addr == nullptr) {
+        printf("WARNING: Could not allocate %s handle (%zu outstanding)\n",
+               what, outstanding_handles.load());
+        return nullptr;
     }
+    const size_t outstanding = outstanding_handles.fetch_add(1u) + 1u;
+    if (outstanding > kHighHandleCount)
+        high_handle_count(outstanding);
+
+    *handle_count = dispatcher->get_handle_count_ptr();
+    if ((*handle_count)->fetch_add(1u) + 1u != 2u)
+        *handle_count = nullptr;
+
+    return addr;
+}
+
+Handle* MakeHandle(fbl::RefPtr<Dispatcher> dispatcher, zx_rights_t rights) {
+    fbl::atomic<uint32_t>* handle_count;
+    void* addr = AllocHandle(dispatcher.get(), "new", &handle_count);
+    if (addr == nullptr)
+        return nullptr;
+    uint32_t base_value = GetNewHandleBaseValue(addr);
 
     auto state_tracker = dispatcher->get_state_tracker();
     if (state_tracker != nullptr)
@@ -184,30 +300,11 @@ Handle* MakeHandle(fbl::RefPtr<Dispatcher> dispatcher, zx_rights_t rights) {
 
 Handle* DupHandle(Handle* source, zx_rights_t rights, bool is_replace) {
     fbl::RefPtr<Dispatcher> dispatcher(source->dispatcher());
-    uint32_t* handle_count;
-    void* addr;
-    uint32_t base_value;
-
-    {
-        AutoLock lock(&handle_mutex);
-        addr = handle_arena.Alloc();
-        const size_t outstanding_handles = handle_arena.DiagnosticCount();
-        if (addr == nullptr) {
-            lock.release();
-            printf("WARNING: Could not allocate duplicate handle (%zu outstanding)\n",
-                   outstanding_handles);
-            return nullptr;
-        }
-        if (outstanding_handles > kHighHandleCount)
-            high_handle_count(outstanding_handles);
-
-        handle_count = dispatcher->get_handle_count_ptr();
-        (*handle_count)++;
-        if (*handle_count != 2u)
-            handle_count = nullptr;
-
-        base_value = GetNewHandleBaseValue(addr);
-    }
+    fbl::atomic<uint32_t>* handle_count;
+    void* addr = AllocHandle(dispatcher.get(), "duplicate", &handle_count);
+    if (addr == nullptr)
+        return nullptr;
+    uint32_t base_value = GetNewHandleBaseValue(addr);
 
     auto state_tracker = dispatcher->get_state_tracker();
     if (!is_replace && (state_tracker != nullptr))
@@ -230,19 +327,15 @@ void DeleteHandle(Handle* handle) {
     internal::TearDownHandle(handle);
 
     bool zero_handles = false;
-    uint32_t* handle_count;
-    {
-        AutoLock lock(&handle_mutex);
+    fbl::atomic<uint32_t>* handle_count = dispatcher->get_handle_count_ptr();
+    uint32_t count = handle_count->fetch_sub(1u) - 1u;
+    if (count == 0u)
+        zero_handles = true;
+    else if (count != 1u)
+        handle_count = nullptr;
 
-        handle_count = dispatcher->get_handle_count_ptr();
-        (*handle_count)--;
-        if (*handle_count == 0u)
-            zero_handles = true;
-        else if (*handle_count != 1u)
-            handle_count = nullptr;
-
-        handle_arena.Free(handle);
-    }
+    outstanding_handles.fetch_sub(1u);
+    FreeHandleSlot(handle);
 
     if (zero_handles) {
         dispatcher->on_zero_handles();
@@ -271,8 +364,23 @@ Handle* MapU32ToHandle(uint32_t value) TA_NO_THREAD_SAFETY_ANALYSIS {
 }
 
 void internal::DumpHandleTableInfo() {
-    AutoLock lock(&handle_mutex);
-    handle_arena.Dump();
+    {
+        AutoLock lock(&handle_mutex);
+        handle_arena.Dump();
+    }
+
+    printf("per-cpu handle caches:\n");
+    printf("  cpu cached   alloc hits  alloc misses    free hits   free misses\n");
+    for (uint cpu = 0; cpu < SMP_MAX_CPUS; ++cpu) {
+        HandleCache* cache = &handle_cache[cpu];
+        AutoSpinLockIrqSave lock(&cache->lock);
+        if (cache->alloc_hits + cache->alloc_misses + cache->free_hits +
+                cache->free_misses == 0)
+            continue;
+        printf("  %3u %6zu %12" PRIu64 " %13" PRIu64 " %12" PRIu64 " %13" PRIu64 "\n",
+               cpu, cache->count, cache->alloc_hits, cache->alloc_misses,
+               cache->free_hits, cache->free_misses);
+    }
 }
 
 zx_status_t SetSystemExceptionPort(fbl::RefPtr<ExceptionPort> eport) {
@@ -11,6 +11,7 @@
 
 #include <zircon/syscalls/object.h>
 #include <zircon/types.h>
+#include <fbl/atomic.h>
 #include <fbl/ref_counted.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_ptr.h>
@@ -42,6 +43,7 @@ DECLARE_DISPTAG(FifoDispatcher, ZX_OBJ_TYPE_FIFO)
 DECLARE_DISPTAG(GuestDispatcher, ZX_OBJ_TYPE_GUEST)
 DECLARE_DISPTAG(VcpuDispatcher, ZX_OBJ_TYPE_VCPU)
 DECLARE_DISPTAG(TimerDispatcher, ZX_OBJ_TYPE_TIMER)
+DECLARE_DISPTAG(WaitSetDispatcher, ZX_OBJ_TYPE_WAIT_SET)
 
 #undef DECLARE_DISPTAG
 
@@ -57,7 +59,7 @@ public:
     zx_koid_t get_koid() const { return koid_; }
 
     // Updating |handle_count_| is done at the Handle management layer.
-    uint32_t* get_handle_count_ptr() { return &handle_count_; }
+    fbl::atomic<uint32_t>* get_handle_count_ptr() { return &handle_count_; }
 
     // Interface for derived classes.
 
@@ -87,7 +89,7 @@ public:
 
 private:
     const zx_koid_t koid_;
-    uint32_t handle_count_;
+    fbl::atomic<uint32_t> handle_count_;
 };
 
 // DownCastDispatcher checks if a RefPtr<Dispatcher> points to a
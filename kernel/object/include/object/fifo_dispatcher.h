@@ -15,6 +15,7 @@
 #include <fbl/canary.h>
 #include <fbl/mutex.h>
 #include <fbl/ref_counted.h>
+#include <lib/user_copy/user_iovec.h>
 #include <lib/user_copy/user_ptr.h>
 
 class FifoDispatcher final : public Dispatcher {
@@ -35,11 +36,18 @@ public:
     zx_status_t WriteFromUser(user_ptr<const uint8_t> src, size_t len, uint32_t* actual);
     zx_status_t ReadToUser(user_ptr<uint8_t> dst, size_t len, uint32_t* actual);
 
+    // Scatter-gather forms of the above: |iov| describes |iov_count| user
+    // buffers holding |len| bytes in total.
+    zx_status_t WriteFromUser(const iovec_t* iov, uint32_t iov_count, size_t len,
+                              uint32_t* actual);
+    zx_status_t ReadToUser(const iovec_t* iov, uint32_t iov_count, size_t len,
+                           uint32_t* actual);
+
 private:
     FifoDispatcher(uint32_t options, uint32_t elem_count, uint32_t elem_size,
                    fbl::unique_ptr<uint8_t[]> data);
     void Init(fbl::RefPtr<FifoDispatcher> other);
-    zx_status_t WriteSelf(user_ptr<const uint8_t> ptr, size_t len, uint32_t* actual);
+    zx_status_t WriteSelf(UserIovecCursor* src, size_t len, uint32_t* actual);
     zx_status_t UserSignalSelf(uint32_t clear_mask, uint32_t set_mask);
 
     void OnPeerZeroHandles();
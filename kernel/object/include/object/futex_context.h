@@ -23,6 +23,12 @@
 // When the thread at the head of the futex's blocked thread list is resumed,
 // The FutexNode for the new head of the blocked thread list is set as the hash table value
 // for the futex.
+//
+// The hash table is split into kNumBuckets buckets, each with its own lock,
+// so that operations on unrelated futexes in a heavily threaded process
+// don't contend with each other.  A futex is always found in the bucket
+// chosen by hashing its address.  FutexRequeue() needs the buckets of both
+// futexes and takes their locks in bucket order.
 class FutexContext {
 public:
     FutexContext();
@@ -48,17 +54,45 @@ public:
                              user_ptr<int> requeue_ptr, uint32_t requeue_count);
 
 private:
+    // Must be a power of two.  Every process pays for all of the buckets, so
+    // keep this small: each bucket is a mutex and a single-chain table, 72
+    // bytes on 64-bit builds, so the whole array is a little over 1KB.
+    static constexpr size_t kNumBuckets = 16;
+
+    struct Bucket {
+        // protects futex_table
+        fbl::Mutex lock;
+
+        // Hash table for the futexes in this bucket.
+        // Key is futex address, value is the FutexNode for the head of futex's blocked
+        // thread list.
+        FutexNode::HashTable futex_table TA_GUARDED(lock);
+    };
+    static_assert(sizeof(Bucket) <= 2 * 64,
+                  "Bucket has grown; revisit kNumBuckets and the cost per process");
+
     FutexContext(const FutexContext&) = delete;
     FutexContext& operator=(const FutexContext&) = delete;
 
-    void QueueNodesLocked(FutexNode* head) TA_REQ(lock_);
+    Bucket* GetBucket(uintptr_t futex_key);
+
+    // Acquire (or release) the locks of two buckets, which may be the same one,
+    // in a consistent order.
+    static void LockBuckets(Bucket* bucket1, Bucket* bucket2)
+        TA_ACQ(bucket1->lock, bucket2->lock);
+    static void UnlockBuckets(Bucket* bucket1, Bucket* bucket2)
+        TA_REL(bucket1->lock, bucket2->lock);
+
+    static void RequeueLocked(Bucket* wake_bucket, Bucket* requeue_bucket,
+                              uintptr_t wake_key, uint32_t wake_count,
+                              uintptr_t requeue_key, uint32_t requeue_count,
+                              bool* any_woken)
+        TA_REQ(wake_bucket->lock, requeue_bucket->lock);
 
-    bool UnqueueNodeLocked(FutexNode* node) TA_REQ(lock_);
+    static void QueueNodesLocked(Bucket* bucket, FutexNode* head) TA_REQ(bucket->lock);
 
-    // protects futex_table_
-    fbl::Mutex lock_;
+    bool UnqueueNode(FutexNode* node);
+    static bool UnqueueNodeLocked(Bucket* bucket, FutexNode* node) TA_REQ(bucket->lock);
 
-    // Hash table for futexes in this context.
-    // Key is futex address, value is the FutexNode for the head of futex's blocked thread list.
-    FutexNode::HashTable futex_table_ TA_GUARDED(lock_);
+    Bucket buckets_[kNumBuckets];
 };
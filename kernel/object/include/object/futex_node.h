@@ -17,7 +17,13 @@
 // Intended to be embedded within a ThreadDispatcher Instance
 class FutexNode : public fbl::SinglyLinkedListable<FutexNode*> {
 public:
-    using HashTable = fbl::HashTable<uintptr_t, FutexNode*>;
+    // Each FutexContext has one of these tables per bucket, and the bucket
+    // has already been chosen by hashing the futex address, so a single
+    // chain is enough.
+    static constexpr size_t kHashTableBuckets = 1;
+    using HashTable = fbl::HashTable<uintptr_t, FutexNode*,
+                                     fbl::SinglyLinkedList<FutexNode*>,
+                                     size_t, kHashTableBuckets>;
 
     FutexNode();
     ~FutexNode();
@@ -23,6 +23,7 @@ public:
     bool is_full() const;
     bool is_empty() const;
     size_t size() const { return size_; }
+    size_t capacity() const { return kSizeMax; }
 
 private:
     // An MBuf is a small fixed-size chainable memory buffer.
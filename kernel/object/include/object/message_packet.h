@@ -8,6 +8,7 @@
 
 #include <stdint.h>
 
+#include <lib/user_copy/user_iovec.h>
 #include <lib/user_copy/user_ptr.h>
 #include <zircon/types.h>
 #include <fbl/intrusive_double_list.h>
@@ -33,6 +34,11 @@ public:
     static zx_status_t Create(const void* data, uint32_t data_size,
                               uint32_t num_handles,
                               fbl::unique_ptr<MessagePacket>* msg);
+    // Gathers the data from the |iov_count| user buffers described by
+    // |iov|, which hold |data_size| bytes in total.
+    static zx_status_t Create(const iovec_t* iov, uint32_t iov_count, uint32_t data_size,
+                              uint32_t num_handles,
+                              fbl::unique_ptr<MessagePacket>* msg);
 
     uint32_t data_size() const { return data_size_; }
 
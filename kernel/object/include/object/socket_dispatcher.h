@@ -11,6 +11,7 @@
 #include <lib/user_copy/user_ptr.h>
 #include <object/dispatcher.h>
 #include <object/mbuf.h>
+#include <object/socket_ring.h>
 #include <object/state_tracker.h>
 
 #include <zircon/types.h>
@@ -36,7 +37,10 @@ public:
     zx_status_t user_signal(uint32_t clear_mask, uint32_t set_mask, bool peer) final;
 
     // Socket methods.
-    zx_status_t Write(user_ptr<const void> src, size_t len, size_t* written);
+    // With |in_place|, which only ZX_SOCKET_BULK sockets support, Write()
+    // and Read() don't copy anything: |src| and |dst| are unused, and |len|
+    // bytes are made readable from, or dropped from, the shared ring.
+    zx_status_t Write(user_ptr<const void> src, size_t len, bool in_place, size_t* written);
 
     zx_status_t WriteControl(user_ptr<const void> src, size_t len);
 
@@ -45,22 +49,34 @@ public:
 
     zx_status_t HalfClose();
 
-    zx_status_t Read(user_ptr<void> dst, size_t len, size_t* nread);
+    zx_status_t Read(user_ptr<void> dst, size_t len, bool in_place, size_t* nread);
 
     zx_status_t ReadControl(user_ptr<void> dst, size_t len, size_t* nread);
 
+    // The number of bytes this endpoint can hold for reading. Only
+    // ZX_SOCKET_BULK sockets can change it, and only while empty.
+    size_t GetBufferSize();
+    zx_status_t SetBufferSize(size_t size);
+
+    // Shares the ring this endpoint reads from, or with |write| the one it
+    // writes to, with user space; see SocketRing::Share().
+    zx_status_t GetRing(bool write, fbl::RefPtr<VmObject>* vmo);
+
     void OnPeerZeroHandles();
 
 private:
     explicit SocketDispatcher(uint32_t flags);
     void Init(fbl::RefPtr<SocketDispatcher> other);
-    zx_status_t WriteSelf(user_ptr<const void> src, size_t len, size_t* nwritten);
+    zx_status_t WriteSelf(user_ptr<const void> src, size_t len, bool in_place,
+                          size_t* nwritten);
+    zx_status_t ShareRing(fbl::RefPtr<VmObject>* vmo);
     zx_status_t WriteControlSelf(user_ptr<const void> src, size_t len);
     zx_status_t UserSignalSelf(uint32_t clear_mask, uint32_t set_mask);
     zx_status_t ShutdownOther(uint32_t how);
 
-    bool is_full() const TA_REQ(lock_) { return data_.is_full(); }
-    bool is_empty() const TA_REQ(lock_) { return data_.is_empty(); }
+    bool is_bulk() const { return flags_ & ZX_SOCKET_BULK; }
+    bool is_full() const TA_REQ(lock_) { return is_bulk() ? ring_.is_full() : data_.is_full(); }
+    bool is_empty() const TA_REQ(lock_) { return is_bulk() ? ring_.is_empty() : data_.is_empty(); }
 
     fbl::Canary<fbl::magic("SOCK")> canary_;
 
@@ -71,6 +87,8 @@ private:
     // The |lock_| protects all members below.
     fbl::Mutex lock_;
     MBufChain data_ TA_GUARDED(lock_);
+    // Used instead of |data_| by ZX_SOCKET_BULK sockets.
+    SocketRing ring_ TA_GUARDED(lock_);
     fbl::unique_ptr<char[]> control_msg_ TA_GUARDED(lock_);
     size_t control_msg_len_ TA_GUARDED(lock_);
     fbl::RefPtr<SocketDispatcher> other_ TA_GUARDED(lock_);
@@ -0,0 +1,100 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stdint.h>
+
+#include <fbl/atomic.h>
+#include <fbl/ref_ptr.h>
+#include <lib/user_copy/user_ptr.h>
+#include <vm/vm_address_region.h>
+#include <vm/vm_object.h>
+#include <zircon/types.h>
+
+// A byte ring in a VMO mapped into the kernel, which buffers the data of a
+// ZX_SOCKET_BULK socket. Unlike an MBufChain it is sized once, by the
+// reader, and large reads and writes copy straight between the user buffer
+// and the ring in at most two pieces.
+//
+// The VMO starts with a header page (a zx_socket_ring_header_t) followed
+// by the data. Once shared with user space by Share(), both ends can map
+// it and move data through it without the kernel copying anything: the
+// writer fills the space after the data and makes it readable with
+// Commit(), and the reader consumes it in place with Consume().
+//
+// Only the header page is committed up front. Data pages are committed,
+// and mapped, as data first reaches them. Each ring may commit its first
+// kGuaranteedBytes of data unconditionally; the pages beyond that, which
+// only rings enlarged past the default have, come out of a budget of
+// kMaxTotalCommitted shared by all rings. So an enlarged ring that stops
+// being drained can exhaust that budget, but cannot stop other rings from
+// moving data. A write that would need more than the budget has fails
+// with ZX_ERR_NO_MEMORY, or is cut short to the pages already committed.
+class SocketRing {
+public:
+    static constexpr size_t kDefaultCapacity = 256 * 1024;
+    static constexpr size_t kMaxCapacity = 16 * 1024 * 1024;
+    static constexpr size_t kGuaranteedBytes = kDefaultCapacity;
+    static constexpr size_t kMaxTotalCommitted = 64 * 1024 * 1024;
+
+    SocketRing() = default;
+    ~SocketRing();
+
+    // Reserves a ring of |capacity| bytes, rounded up to whole pages,
+    // replacing the current one. The ring must be empty and not shared.
+    zx_status_t Init(size_t capacity);
+
+    zx_status_t Write(user_ptr<const void> src, size_t len, size_t* written);
+    size_t Read(user_ptr<void> dst, size_t len);
+
+    // Commits the whole ring and returns its VMO, to be mapped by user
+    // space. From then on the ring stays committed and its size is fixed.
+    zx_status_t Share(fbl::RefPtr<VmObject>* vmo);
+
+    // The in place versions of Write() and Read(), for shared rings:
+    // Commit() makes up to |len| bytes the writer has put after the data
+    // readable, and Consume() drops up to |len| bytes the reader is done
+    // with.
+    zx_status_t Commit(size_t len, size_t* written);
+    size_t Consume(size_t len);
+
+    bool is_full() const { return size_ == capacity_; }
+    bool is_empty() const { return size_ == 0; }
+    bool is_shared() const { return shared_; }
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+
+private:
+    void Free();
+
+    // The committed data pages are a prefix of the ring, since an unshared
+    // ring starts over at the beginning whenever it drains, and a shared
+    // ring is committed in full. These grow and shrink that prefix to end
+    // at |end|.
+    zx_status_t CommitTo(size_t end);
+    void DecommitTo(size_t end);
+
+    // Moves the head and tail of the data, and tells user space if shared.
+    void Advance(size_t read, size_t written);
+
+    fbl::RefPtr<VmObject> vmo_;
+    fbl::RefPtr<VmMapping> mapping_;
+    zx_socket_ring_header_t* header_ = nullptr;
+    char* data_ = nullptr;
+    size_t capacity_ = 0u;
+    size_t committed_ = 0u;
+    // Offset of the first unread byte.
+    size_t head_ = 0u;
+    size_t size_ = 0u;
+    bool shared_ = false;
+    // Totals published in the header of a shared ring.
+    uint64_t read_count_ = 0u;
+    uint64_t write_count_ = 0u;
+
+    // Bytes committed by all rings beyond their kGuaranteedBytes.
+    static fbl::atomic<size_t> total_committed_;
+};
@@ -10,6 +10,7 @@
 
 #include <kernel/spinlock.h>
 #include <zircon/types.h>
+#include <fbl/atomic.h>
 #include <fbl/canary.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/mutex.h>
@@ -51,7 +52,7 @@ public:
 
     // Nofity others with ZX_SIGNAL_LAST_HANDLE if the value pointed by |count| is 1. This
     // value is allowed to mutate by other threads while this call is executing.
-    void UpdateLastHandleSignal(uint32_t* count);
+    void UpdateLastHandleSignal(fbl::atomic<uint32_t>* count);
 
     zx_signals_t GetSignalsState() { return signals_; }
 
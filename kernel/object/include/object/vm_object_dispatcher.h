@@ -8,6 +8,9 @@
 
 #include <zircon/types.h>
 #include <fbl/canary.h>
+#include <fbl/intrusive_double_list.h>
+#include <fbl/mutex.h>
+#include <fbl/unique_ptr.h>
 #include <object/dispatcher.h>
 #include <object/state_tracker.h>
 
@@ -45,6 +48,19 @@ public:
 private:
     explicit VmObjectDispatcher(fbl::RefPtr<VmObject> vmo);
 
+    // ZX_VMO_OP_LOCK and ZX_VMO_OP_UNLOCK.
+    zx_status_t Lock(uint64_t offset, uint64_t size);
+    zx_status_t Unlock(uint64_t offset, uint64_t size);
+
+    // A range locked into memory by ZX_VMO_OP_LOCK, which only the process
+    // that locked it can unlock. Whatever is still locked when the last
+    // handle goes away is unlocked then.
+    struct LockedRange : public fbl::DoublyLinkedListable<fbl::unique_ptr<LockedRange>> {
+        zx_koid_t owner;
+        uint64_t offset;
+        uint64_t size;
+    };
+
     fbl::Canary<fbl::magic("VMOD")> canary_;
     fbl::RefPtr<VmObject> vmo_;
 
@@ -53,4 +69,7 @@ private:
     // shares the same lock.
     StateTracker state_tracker_;
     CookieJar cookie_jar_;
+
+    fbl::Mutex lock_;
+    fbl::DoublyLinkedList<fbl::unique_ptr<LockedRange>> locked_ TA_GUARDED(lock_);
 };
@@ -0,0 +1,122 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stdint.h>
+
+#include <kernel/event.h>
+#include <object/dispatcher.h>
+#include <object/state_observer.h>
+
+#include <zircon/types.h>
+#include <fbl/canary.h>
+#include <fbl/intrusive_double_list.h>
+#include <fbl/intrusive_wavl_tree.h>
+#include <fbl/mutex.h>
+#include <fbl/ref_ptr.h>
+#include <fbl/unique_ptr.h>
+
+// A wait set is a persistent collection of (handle, signals) entries, each
+// named by a caller-chosen cookie. An entry observes its object's
+// StateTracker from the time it is added until it is removed, and moves
+// itself on and off the set's triggered list as the object's signals
+// change. Waiting on the set therefore only looks at the entries that are
+// ready, instead of attaching and detaching an observer per handle per
+// wait the way object_wait_many() does.
+//
+// Locking: |registration_lock_| serializes adding and removing entries and
+// guards |entries_|. |lock_| guards the triggered list and the mutable
+// state of each entry, and is taken by the entries' StateObserver
+// callbacks while the observed object's StateTracker lock is held. The
+// order is therefore registration_lock_ -> StateTracker lock -> lock_.
+class WaitSetDispatcher final : public Dispatcher {
+public:
+    // The most entries a single wait set can hold.
+    static constexpr uint32_t kMaxEntries = 4096u;
+
+    static zx_status_t Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
+                              zx_rights_t* rights);
+
+    ~WaitSetDispatcher() final;
+    zx_obj_type_t get_type() const final { return ZX_OBJ_TYPE_WAIT_SET; }
+    void on_zero_handles() final;
+
+    // Called under the handle table lock.
+    zx_status_t AddEntry(uint64_t cookie, Handle* handle, zx_signals_t signals);
+
+    zx_status_t RemoveEntry(uint64_t cookie);
+
+    // Blocks until at least one entry is triggered or |deadline| passes, then
+    // fills in up to |max_results| of the triggered entries.
+    zx_status_t Wait(zx_time_t deadline, zx_waitset_result_t* results,
+                     uint32_t max_results, uint32_t* num_results);
+
+private:
+    class Entry final : public StateObserver,
+                        public fbl::DoublyLinkedListable<Entry*>,
+                        public fbl::WAVLTreeContainable<fbl::unique_ptr<Entry>> {
+    public:
+        Entry(WaitSetDispatcher* wait_set, uint64_t cookie, zx_signals_t signals,
+              Handle* handle);
+        ~Entry() = default;
+
+        uint64_t GetKey() const { return cookie_; }
+
+        // Whether the entry is on the wait set's triggered list.
+        bool IsTriggered() const {
+            return fbl::DoublyLinkedListable<Entry*>::InContainer();
+        }
+
+        // Detaches the entry from its object's StateTracker unless the
+        // object already did that when the handle went away. Must not be
+        // called with |lock_| held.
+        void Detach();
+
+    private:
+        friend class WaitSetDispatcher;
+
+        Entry(const Entry&) = delete;
+        Entry& operator=(const Entry&) = delete;
+
+        // StateObserver implementation:
+        Flags OnInitialize(zx_signals_t initial_state, const StateObserver::CountInfo* cinfo) final;
+        Flags OnStateChange(zx_signals_t new_state) final;
+        Flags OnCancel(const Handle* handle) final;
+
+        fbl::Canary<fbl::magic("WSEN")> canary_;
+
+        WaitSetDispatcher* const wait_set_;
+        const uint64_t cookie_;
+        const zx_signals_t watched_signals_;
+        const Handle* const handle_;
+        fbl::RefPtr<Dispatcher> dispatcher_;
+
+        // Guarded by the wait set's |lock_|.
+        zx_signals_t observed_ = 0u;
+        zx_status_t status_ = ZX_OK;
+        bool attached_ = false;
+        bool removing_ = false;
+    };
+
+    WaitSetDispatcher();
+
+    // Puts |entry| on the triggered list or takes it off, according to its
+    // current state. Returns true if threads were woken.
+    bool UpdateTriggeredLocked(Entry* entry) TA_REQ(lock_);
+    void RemoveTriggeredLocked(Entry* entry) TA_REQ(lock_);
+
+    fbl::Canary<fbl::magic("WSET")> canary_;
+
+    fbl::Mutex registration_lock_;
+    fbl::WAVLTree<uint64_t, fbl::unique_ptr<Entry>> entries_ TA_GUARDED(registration_lock_);
+    bool zero_handles_ TA_GUARDED(registration_lock_) = false;
+
+    fbl::Mutex lock_;
+    fbl::DoublyLinkedList<Entry*> triggered_ TA_GUARDED(lock_);
+    bool canceled_ TA_GUARDED(lock_) = false;
+    Event event_;
+};
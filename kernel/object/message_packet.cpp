@@ -76,6 +76,24 @@ zx_status_t MessagePacket::Create(const void* data, uint32_t data_size,
     return ZX_OK;
 }
 
+// static
+zx_status_t MessagePacket::Create(const iovec_t* iov, uint32_t iov_count, uint32_t data_size,
+                                  uint32_t num_handles,
+                                  fbl::unique_ptr<MessagePacket>* msg) {
+    zx_status_t status = NewPacket(data_size, num_handles, msg);
+    if (status != ZX_OK) {
+        return status;
+    }
+    if (data_size > 0u) {
+        UserIovecCursor src(iov, iov_count);
+        if (src.CopyFromUser((*msg)->data(), data_size) != ZX_OK) {
+            msg->reset();
+            return ZX_ERR_INVALID_ARGS;
+        }
+    }
+    return ZX_OK;
+}
+
 MessagePacket::~MessagePacket() {
     if (owns_handles_) {
         // Delete handles out-of-band to avoid the worst case recursive
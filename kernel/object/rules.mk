@@ -37,12 +37,14 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/resource_dispatcher.cpp \
     $(LOCAL_DIR)/semaphore.cpp \
     $(LOCAL_DIR)/socket_dispatcher.cpp \
+    $(LOCAL_DIR)/socket_ring.cpp \
     $(LOCAL_DIR)/state_tracker.cpp \
     $(LOCAL_DIR)/thread_dispatcher.cpp \
     $(LOCAL_DIR)/timer_dispatcher.cpp \
     $(LOCAL_DIR)/vcpu_dispatcher.cpp \
     $(LOCAL_DIR)/vm_address_region_dispatcher.cpp \
     $(LOCAL_DIR)/vm_object_dispatcher.cpp \
+    $(LOCAL_DIR)/wait_set_dispatcher.cpp \
     $(LOCAL_DIR)/wait_state_observer.cpp \
 
 # Tests
@@ -54,6 +56,7 @@ MODULE_DEPS := \
     kernel/lib/hypervisor \
     kernel/lib/fbl \
     kernel/lib/oom \
+    kernel/lib/user_copy \
     kernel/dev/interrupt \
     kernel/dev/udisplay \
 
@@ -37,6 +37,9 @@ zx_status_t SocketDispatcher::Create(uint32_t flags,
 
     if (flags & ~ZX_SOCKET_CREATE_MASK)
         return ZX_ERR_INVALID_ARGS;
+    // Bulk sockets carry a byte stream.
+    if ((flags & ZX_SOCKET_BULK) && (flags & ZX_SOCKET_DATAGRAM))
+        return ZX_ERR_INVALID_ARGS;
 
     fbl::AllocChecker ac;
     auto socket0 = fbl::AdoptRef(new (&ac) SocketDispatcher(flags));
@@ -50,6 +53,18 @@ zx_status_t SocketDispatcher::Create(uint32_t flags,
     socket0->Init(socket1);
     socket1->Init(socket0);
 
+    if (flags & ZX_SOCKET_BULK) {
+        AutoLock lock0(&socket0->lock_);
+        zx_status_t status = socket0->ring_.Init(SocketRing::kDefaultCapacity);
+        if (status != ZX_OK)
+            return status;
+
+        AutoLock lock1(&socket1->lock_);
+        status = socket1->ring_.Init(SocketRing::kDefaultCapacity);
+        if (status != ZX_OK)
+            return status;
+    }
+
     // TODO: use mbufs to avoid pinning control buffer memory.
     if (flags & ZX_SOCKET_HAS_CONTROL) {
         // TODO: after moving to an mbuf pool, do this in Init
@@ -68,7 +83,11 @@ zx_status_t SocketDispatcher::Create(uint32_t flags,
         socket1->state_tracker_.UpdateState(0u, ZX_SOCKET_CONTROL_WRITABLE);
     }
 
+    // Only bulk sockets can be resized, and resizing reserves kernel memory,
+    // so the right to do it is handed out with them alone.
     *rights = ZX_DEFAULT_SOCKET_RIGHTS;
+    if (flags & ZX_SOCKET_BULK)
+        *rights |= ZX_RIGHT_SET_PROPERTY;
     *dispatcher0 = fbl::move(socket0);
     *dispatcher1 = fbl::move(socket1);
     return ZX_OK;
@@ -212,7 +231,7 @@ zx_status_t SocketDispatcher::ShutdownOther(uint32_t how) {
     return ZX_OK;
 }
 
-zx_status_t SocketDispatcher::Write(user_ptr<const void> src, size_t len,
+zx_status_t SocketDispatcher::Write(user_ptr<const void> src, size_t len, bool in_place,
                                     size_t* nwritten) {
     canary_.Assert();
 
@@ -236,7 +255,7 @@ zx_status_t SocketDispatcher::Write(user_ptr<const void> src, size_t len,
     if (len != static_cast<size_t>(static_cast<uint32_t>(len)))
         return ZX_ERR_INVALID_ARGS;
 
-    return other->WriteSelf(src, len, nwritten);
+    return other->WriteSelf(src, len, in_place, nwritten);
 }
 
 zx_status_t SocketDispatcher::WriteControl(user_ptr<const void> src, size_t len) {
@@ -283,12 +302,18 @@ zx_status_t SocketDispatcher::WriteControlSelf(user_ptr<const void> src,
     return ZX_OK;
 }
 
-zx_status_t SocketDispatcher::WriteSelf(user_ptr<const void> src, size_t len,
+zx_status_t SocketDispatcher::WriteSelf(user_ptr<const void> src, size_t len, bool in_place,
                                         size_t* written) {
     canary_.Assert();
 
+    if (in_place && !is_bulk())
+        return ZX_ERR_NOT_SUPPORTED;
+
     AutoLock lock(&lock_);
 
+    if (in_place && !ring_.is_shared())
+        return ZX_ERR_BAD_STATE;
+
     if (is_full())
         return ZX_ERR_SHOULD_WAIT;
 
@@ -296,7 +321,11 @@ zx_status_t SocketDispatcher::WriteSelf(user_ptr<const void> src, size_t len,
 
     size_t st = 0u;
     zx_status_t status;
-    if (flags_ & ZX_SOCKET_DATAGRAM) {
+    if (in_place) {
+        status = ring_.Commit(len, &st);
+    } else if (is_bulk()) {
+        status = ring_.Write(src, len, &st);
+    } else if (flags_ & ZX_SOCKET_DATAGRAM) {
         status = data_.WriteDatagram(src, len, &st);
     } else {
         status = data_.WriteStream(src, len, &st);
@@ -316,17 +345,23 @@ zx_status_t SocketDispatcher::WriteSelf(user_ptr<const void> src, size_t len,
     return status;
 }
 
-zx_status_t SocketDispatcher::Read(user_ptr<void> dst, size_t len,
+zx_status_t SocketDispatcher::Read(user_ptr<void> dst, size_t len, bool in_place,
                                    size_t* nread) {
     canary_.Assert();
 
     LTRACE_ENTRY;
 
+    if (in_place && !is_bulk())
+        return ZX_ERR_NOT_SUPPORTED;
+
     AutoLock lock(&lock_);
 
+    if (in_place && !ring_.is_shared())
+        return ZX_ERR_BAD_STATE;
+
     // Just query for bytes outstanding.
     if (!dst && len == 0) {
-        *nread = data_.size();
+        *nread = is_bulk() ? ring_.size() : data_.size();
         return ZX_OK;
     }
 
@@ -345,7 +380,14 @@ zx_status_t SocketDispatcher::Read(user_ptr<void> dst, size_t len,
 
     bool was_full = is_full();
 
-    auto st = data_.Read(dst, len, flags_ & ZX_SOCKET_DATAGRAM);
+    size_t st;
+    if (in_place) {
+        st = ring_.Consume(len);
+    } else if (is_bulk()) {
+        st = ring_.Read(dst, len);
+    } else {
+        st = data_.Read(dst, len, flags_ & ZX_SOCKET_DATAGRAM);
+    }
 
     if (is_empty()) {
         uint32_t set_mask = 0u;
@@ -386,3 +428,47 @@ zx_status_t SocketDispatcher::ReadControl(user_ptr<void> dst, size_t len,
     *nread = copy_len;
     return ZX_OK;
 }
+
+size_t SocketDispatcher::GetBufferSize() {
+    canary_.Assert();
+
+    AutoLock lock(&lock_);
+    return is_bulk() ? ring_.capacity() : data_.capacity();
+}
+
+zx_status_t SocketDispatcher::SetBufferSize(size_t size) {
+    canary_.Assert();
+
+    if (!is_bulk())
+        return ZX_ERR_NOT_SUPPORTED;
+
+    AutoLock lock(&lock_);
+    if (!is_empty())
+        return ZX_ERR_BAD_STATE;
+    return ring_.Init(size);
+}
+
+zx_status_t SocketDispatcher::GetRing(bool write, fbl::RefPtr<VmObject>* vmo) {
+    canary_.Assert();
+
+    if (!is_bulk())
+        return ZX_ERR_NOT_SUPPORTED;
+    if (!write)
+        return ShareRing(vmo);
+
+    fbl::RefPtr<SocketDispatcher> other;
+    {
+        AutoLock lock(&lock_);
+        if (!other_)
+            return ZX_ERR_PEER_CLOSED;
+        other = other_;
+    }
+    return other->ShareRing(vmo);
+}
+
+zx_status_t SocketDispatcher::ShareRing(fbl::RefPtr<VmObject>* vmo) {
+    canary_.Assert();
+
+    AutoLock lock(&lock_);
+    return ring_.Share(vmo);
+}
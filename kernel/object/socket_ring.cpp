@@ -0,0 +1,239 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <object/socket_ring.h>
+
+#include <assert.h>
+#include <err.h>
+#include <stdlib.h>
+
+#include <lib/user_copy/user_ptr.h>
+#include <vm/vm_aspace.h>
+#include <vm/vm_object_paged.h>
+
+#include <fbl/algorithm.h>
+
+#define LOCAL_TRACE 0
+
+constexpr size_t SocketRing::kDefaultCapacity;
+constexpr size_t SocketRing::kMaxCapacity;
+constexpr size_t SocketRing::kGuaranteedBytes;
+constexpr size_t SocketRing::kMaxTotalCommitted;
+
+static_assert(ZX_SOCKET_RING_DATA_OFFSET == PAGE_SIZE, "the ring header is one page");
+static_assert(sizeof(zx_socket_ring_header_t) <= ZX_SOCKET_RING_DATA_OFFSET, "");
+
+fbl::atomic<size_t> SocketRing::total_committed_(0u);
+
+namespace {
+
+constexpr size_t kHeaderSize = ZX_SOCKET_RING_DATA_OFFSET;
+
+// The part of the first |committed| bytes of a ring charged to the budget.
+size_t Charged(size_t committed) {
+    return committed > SocketRing::kGuaranteedBytes ? committed - SocketRing::kGuaranteedBytes : 0u;
+}
+
+} // namespace
+
+SocketRing::~SocketRing() {
+    Free();
+}
+
+void SocketRing::Free() {
+    if (vmo_ == nullptr)
+        return;
+
+    // User space may still hold the VMO of a shared ring, in which case
+    // its pages outlive the ring, but they are no longer ours to count.
+    total_committed_.fetch_sub(Charged(committed_));
+    if (shared_)
+        vmo_->Unpin(0u, kHeaderSize + capacity_);
+    mapping_->Destroy();
+    mapping_.reset();
+    vmo_.reset();
+    header_ = nullptr;
+    data_ = nullptr;
+    capacity_ = 0u;
+    committed_ = 0u;
+    shared_ = false;
+}
+
+zx_status_t SocketRing::CommitTo(size_t end) {
+    if (end <= committed_)
+        return ZX_OK;
+
+    // Charge the pages before committing them, so that racing rings can't
+    // both squeeze in under the limit.
+    size_t charge = Charged(end) - Charged(committed_);
+    if (total_committed_.fetch_add(charge) + charge > kMaxTotalCommitted) {
+        total_committed_.fetch_sub(charge);
+        return ZX_ERR_NO_MEMORY;
+    }
+    // Map the pages as well as committing them, so that copying into them
+    // under the socket's lock never takes a page fault.
+    size_t len = end - committed_;
+    zx_status_t status = mapping_->MapRange(kHeaderSize + committed_, len, true);
+    if (status != ZX_OK) {
+        uint64_t decommitted;
+        vmo_->DecommitRange(kHeaderSize + committed_, len, &decommitted);
+        total_committed_.fetch_sub(charge);
+        return status;
+    }
+    committed_ = end;
+    return ZX_OK;
+}
+
+void SocketRing::DecommitTo(size_t end) {
+    if (end >= committed_)
+        return;
+
+    uint64_t decommitted;
+    vmo_->DecommitRange(kHeaderSize + end, committed_ - end, &decommitted);
+    total_committed_.fetch_sub(Charged(committed_) - Charged(end));
+    committed_ = end;
+}
+
+void SocketRing::Advance(size_t read, size_t written) {
+    size_ = size_ + written - read;
+    head_ = (head_ + read) % capacity_;
+    if (!shared_)
+        return;
+
+    read_count_ += read;
+    write_count_ += written;
+    __atomic_store_n(&header_->read_count, read_count_, __ATOMIC_RELEASE);
+    __atomic_store_n(&header_->write_count, write_count_, __ATOMIC_RELEASE);
+}
+
+zx_status_t SocketRing::Init(size_t capacity) {
+    DEBUG_ASSERT(is_empty());
+
+    if (shared_)
+        return ZX_ERR_BAD_STATE;
+    if (capacity == 0u || capacity > kMaxCapacity)
+        return ZX_ERR_OUT_OF_RANGE;
+    capacity = ROUNDUP(capacity, PAGE_SIZE);
+
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, kHeaderSize + capacity, &vmo);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<VmMapping> mapping;
+    status = VmAspace::kernel_aspace()->RootVmar()->CreateVmMapping(
+        0 /* ignored */, kHeaderSize + capacity, 0 /* align pow2 */, 0 /* vmar flags */,
+        vmo, 0, ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE, "socket ring", &mapping);
+    if (status != ZX_OK)
+        return status;
+
+    // Only the header is committed now; see CommitTo() for the data.
+    status = mapping->MapRange(0u, kHeaderSize, true);
+    if (status != ZX_OK) {
+        mapping->Destroy();
+        return status;
+    }
+
+    Free();
+    vmo_ = fbl::move(vmo);
+    mapping_ = fbl::move(mapping);
+    header_ = reinterpret_cast<zx_socket_ring_header_t*>(mapping_->base());
+    header_->capacity = capacity;
+    data_ = reinterpret_cast<char*>(mapping_->base()) + kHeaderSize;
+    capacity_ = capacity;
+    head_ = 0u;
+    return ZX_OK;
+}
+
+zx_status_t SocketRing::Share(fbl::RefPtr<VmObject>* vmo) {
+    if (!shared_) {
+        zx_status_t status = CommitTo(capacity_);
+        if (status != ZX_OK)
+            return status;
+        // Pinning keeps user space, which can decommit or resize the VMO,
+        // from pulling pages out from under the kernel mapping.
+        status = vmo_->Pin(0u, kHeaderSize + capacity_);
+        if (status != ZX_OK)
+            return status;
+        shared_ = true;
+        read_count_ = head_;
+        write_count_ = head_ + size_;
+        Advance(0u, 0u);
+    }
+    *vmo = vmo_;
+    return ZX_OK;
+}
+
+zx_status_t SocketRing::Write(user_ptr<const void> src, size_t len, size_t* written) {
+    size_t count = fbl::min(len, capacity_ - size_);
+    if (count == 0u)
+        return ZX_ERR_SHOULD_WAIT;
+
+    // Fill from the end of the data to the end of the ring, then wrap.
+    size_t tail = (head_ + size_) % capacity_;
+    size_t end = (tail + count > capacity_) ? capacity_ : ROUNDUP(tail + count, PAGE_SIZE);
+    zx_status_t status = CommitTo(end);
+    if (status != ZX_OK) {
+        // Make do with the pages already committed, if any are free.
+        if (tail >= committed_)
+            return status;
+        count = fbl::min(count, committed_ - tail);
+    }
+
+    size_t first = fbl::min(count, capacity_ - tail);
+    if (src.copy_array_from_user(data_ + tail, first) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS; // Bad user buffer.
+    if (first < count &&
+        src.byte_offset(first).copy_array_from_user(data_, count - first) != ZX_OK)
+        count = first;
+
+    Advance(0u, count);
+    *written = count;
+    return ZX_OK;
+}
+
+size_t SocketRing::Read(user_ptr<void> dst, size_t len) {
+    size_t count = fbl::min(len, size_);
+
+    size_t first = fbl::min(count, capacity_ - head_);
+    if (dst.copy_array_to_user(data_ + head_, first) != ZX_OK)
+        return 0u;
+    if (first < count &&
+        dst.byte_offset(first).copy_array_to_user(data_, count - first) != ZX_OK)
+        count = first;
+
+    Advance(count, 0u);
+    // Start over at the beginning once drained, so the next copies are less
+    // likely to wrap. Pages are only given back when other rings are short
+    // of them, and then only down to the guaranteed share, so a ring that
+    // is busy keeps its pages from one burst to the next.
+    if (size_ == 0u && !shared_) {
+        head_ = 0u;
+        if (committed_ > kGuaranteedBytes &&
+            total_committed_.load() > kMaxTotalCommitted / 2)
+            DecommitTo(kGuaranteedBytes);
+    }
+    return count;
+}
+
+zx_status_t SocketRing::Commit(size_t len, size_t* written) {
+    if (!shared_)
+        return ZX_ERR_BAD_STATE;
+    size_t count = fbl::min(len, capacity_ - size_);
+    if (count == 0u)
+        return ZX_ERR_SHOULD_WAIT;
+
+    Advance(0u, count);
+    *written = count;
+    return ZX_OK;
+}
+
+size_t SocketRing::Consume(size_t len) {
+    DEBUG_ASSERT(shared_);
+    size_t count = fbl::min(len, size_);
+    Advance(count, 0u);
+    return count;
+}
@@ -124,7 +124,7 @@ void StateTracker::UpdateState(zx_signals_t clear_mask,
         thread_reschedule();
 }
 
-void StateTracker::UpdateLastHandleSignal(uint32_t* count) {
+void StateTracker::UpdateLastHandleSignal(fbl::atomic<uint32_t>* count) {
     canary_.Assert();
 
     if (count == nullptr)
@@ -140,7 +140,7 @@ void StateTracker::UpdateLastHandleSignal(uint32_t* count) {
 
         // We assume here that the value pointed by |count| can mutate by
         // other threads.
-        signals_ = (*count == 1u) ?
+        signals_ = (count->load() == 1u) ?
             signals_ | ZX_SIGNAL_LAST_HANDLE : signals_ & ~ZX_SIGNAL_LAST_HANDLE;
 
         if (previous_signals == signals_)
@@ -39,9 +39,9 @@ private:
 // all of |st|'s observers.
 void call_all_on_hooks(StateTracker* st) {
     st->UpdateState(0, 7);
-    uint32_t count = 5;
+    fbl::atomic<uint32_t> count(5u);
     st->UpdateLastHandleSignal(&count);
-    count = 1;
+    count.store(1u);
     st->UpdateLastHandleSignal(&count);
     st->Cancel(/* handle= */ nullptr);
     st->CancelByKey(/* handle= */ nullptr, /* port= */ nullptr, /* key= */ 2u);
@@ -117,9 +117,9 @@ bool on_state_change_via_last_handle(void* context) {
 
     // Cause OnStateChange() to be called. Need to transition out of and
     // back into ZX_SIGNAL_LAST_HANDLE, because it's asserted by default.
-    uint32_t count = 2;
+    fbl::atomic<uint32_t> count(2u);
     st.UpdateLastHandleSignal(&count);
-    count = 1;
+    count.store(1u);
     st.UpdateLastHandleSignal(&count);
 
     // Should have been removed.
@@ -6,12 +6,14 @@
 
 #include <object/vm_object_dispatcher.h>
 
+#include <object/process_dispatcher.h>
 #include <vm/vm_aspace.h>
 #include <vm/vm_object.h>
 
 #include <zircon/rights.h>
 
 #include <fbl/alloc_checker.h>
+#include <fbl/auto_lock.h>
 
 #include <assert.h>
 #include <err.h>
@@ -38,6 +40,10 @@ VmObjectDispatcher::VmObjectDispatcher(fbl::RefPtr<VmObject> vmo)
     : vmo_(vmo), state_tracker_(0u) {}
 
 VmObjectDispatcher::~VmObjectDispatcher() {
+    while (!locked_.is_empty()) {
+        auto range = locked_.pop_front();
+        vmo_->Unpin(range->offset, range->size);
+    }
     // Intentionally leave vmo_->user_id() set to our koid even though we're
     // dying and the koid will no longer map to a Dispatcher. koids are never
     // recycled, and it could be a useful breadcrumb.
@@ -105,9 +111,9 @@ zx_status_t VmObjectDispatcher::RangeOp(uint32_t op, uint64_t offset, uint64_t s
             return status;
         }
         case ZX_VMO_OP_LOCK:
+            return Lock(offset, size);
         case ZX_VMO_OP_UNLOCK:
-            // TODO: handle
-            return ZX_ERR_NOT_SUPPORTED;
+            return Unlock(offset, size);
         case ZX_VMO_OP_LOOKUP:
             // we will be using the user pointer
             if (!buffer)
@@ -130,6 +136,55 @@ zx_status_t VmObjectDispatcher::RangeOp(uint32_t op, uint64_t offset, uint64_t s
     }
 }
 
+zx_status_t VmObjectDispatcher::Lock(uint64_t offset, uint64_t size) {
+    canary_.Assert();
+
+    if (size == 0)
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<LockedRange> range(new (&ac) LockedRange());
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+    range->owner = ProcessDispatcher::GetCurrent()->get_koid();
+    range->offset = offset;
+    range->size = size;
+
+    // Pinned pages can't be decommitted, or cut off by shrinking the VMO,
+    // until they are unpinned.
+    zx_status_t status = vmo_->CommitRange(offset, size, nullptr);
+    if (status != ZX_OK)
+        return status;
+    status = vmo_->Pin(offset, size);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::AutoLock lock(&lock_);
+    locked_.push_back(fbl::move(range));
+    return ZX_OK;
+}
+
+zx_status_t VmObjectDispatcher::Unlock(uint64_t offset, uint64_t size) {
+    canary_.Assert();
+
+    zx_koid_t owner = ProcessDispatcher::GetCurrent()->get_koid();
+    fbl::unique_ptr<LockedRange> range;
+    {
+        fbl::AutoLock lock(&lock_);
+        for (auto& r : locked_) {
+            if (r.owner == owner && r.offset == offset && r.size == size) {
+                range = locked_.erase(r);
+                break;
+            }
+        }
+    }
+    if (!range)
+        return ZX_ERR_NOT_FOUND;
+
+    vmo_->Unpin(offset, size);
+    return ZX_OK;
+}
+
 zx_status_t VmObjectDispatcher::SetMappingCachePolicy(uint32_t cache_policy) {
     return vmo_->SetMappingCachePolicy(cache_policy);
 }
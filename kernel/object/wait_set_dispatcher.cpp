@@ -0,0 +1,231 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <object/wait_set_dispatcher.h>
+
+#include <assert.h>
+#include <err.h>
+
+#include <kernel/thread.h>
+#include <object/handle.h>
+#include <object/state_tracker.h>
+
+#include <zircon/rights.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/auto_lock.h>
+#include <fbl/type_support.h>
+
+using fbl::AutoLock;
+
+WaitSetDispatcher::Entry::Entry(WaitSetDispatcher* wait_set, uint64_t cookie,
+                                zx_signals_t signals, Handle* handle)
+    : wait_set_(wait_set), cookie_(cookie), watched_signals_(signals), handle_(handle),
+      dispatcher_(handle->dispatcher()) {}
+
+void WaitSetDispatcher::Entry::Detach() {
+    canary_.Assert();
+
+    bool attached;
+    {
+        AutoLock lock(&wait_set_->lock_);
+        removing_ = true;
+        attached = attached_;
+    }
+
+    // Once |removing_| is set OnCancel() leaves the entry on the tracker's
+    // list, so if it was attached above it still is.
+    if (attached) {
+        auto tracker = dispatcher_->get_state_tracker();
+        DEBUG_ASSERT(tracker);
+        tracker->RemoveObserver(this);
+    }
+
+    AutoLock lock(&wait_set_->lock_);
+    attached_ = false;
+    wait_set_->RemoveTriggeredLocked(this);
+}
+
+StateObserver::Flags WaitSetDispatcher::Entry::OnInitialize(
+        zx_signals_t initial_state, const StateObserver::CountInfo* cinfo) {
+    canary_.Assert();
+
+    AutoLock lock(&wait_set_->lock_);
+    attached_ = true;
+    observed_ = initial_state;
+    return wait_set_->UpdateTriggeredLocked(this) ? kWokeThreads : 0;
+}
+
+StateObserver::Flags WaitSetDispatcher::Entry::OnStateChange(zx_signals_t new_state) {
+    canary_.Assert();
+
+    AutoLock lock(&wait_set_->lock_);
+    observed_ = new_state;
+    return wait_set_->UpdateTriggeredLocked(this) ? kWokeThreads : 0;
+}
+
+StateObserver::Flags WaitSetDispatcher::Entry::OnCancel(const Handle* handle) {
+    canary_.Assert();
+
+    if (handle != handle_)
+        return 0;
+
+    AutoLock lock(&wait_set_->lock_);
+
+    // The entry stays in the set, permanently triggered, until it is
+    // removed, so the owner finds out that its handle went away.
+    observed_ |= ZX_SIGNAL_HANDLE_CLOSED;
+    status_ = ZX_ERR_CANCELED;
+    Flags flags = kHandled;
+    if (wait_set_->UpdateTriggeredLocked(this))
+        flags |= kWokeThreads;
+
+    // If the entry is being removed, whoever is removing it will take it
+    // off the tracker's list.
+    if (!removing_) {
+        attached_ = false;
+        flags |= kNeedRemoval;
+    }
+    return flags;
+}
+
+zx_status_t WaitSetDispatcher::Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
+                                      zx_rights_t* rights) {
+    fbl::AllocChecker ac;
+    auto disp = new (&ac) WaitSetDispatcher();
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    *rights = ZX_DEFAULT_WAIT_SET_RIGHTS;
+    *dispatcher = fbl::AdoptRef<Dispatcher>(disp);
+    return ZX_OK;
+}
+
+WaitSetDispatcher::WaitSetDispatcher() {}
+
+WaitSetDispatcher::~WaitSetDispatcher() {
+    DEBUG_ASSERT(triggered_.is_empty());
+}
+
+void WaitSetDispatcher::on_zero_handles() {
+    canary_.Assert();
+
+    AutoLock lock(&registration_lock_);
+    zero_handles_ = true;
+
+    while (!entries_.is_empty()) {
+        auto entry = entries_.pop_front();
+        entry->Detach();
+    }
+
+    // Nobody can add to the set anymore, but a thread might still be
+    // waiting on it through a handle that was just closed.
+    AutoLock state_lock(&lock_);
+    canceled_ = true;
+    if (event_.Signal() > 0)
+        thread_reschedule();
+}
+
+zx_status_t WaitSetDispatcher::AddEntry(uint64_t cookie, Handle* handle, zx_signals_t signals) {
+    canary_.Assert();
+
+    AutoLock lock(&registration_lock_);
+    if (zero_handles_)
+        return ZX_ERR_BAD_STATE;
+    if (entries_.find(cookie).IsValid())
+        return ZX_ERR_ALREADY_EXISTS;
+    if (entries_.size() >= kMaxEntries)
+        return ZX_ERR_NO_RESOURCES;
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<Entry> entry(new (&ac) Entry(this, cookie, signals, handle));
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    zx_status_t status = entry->dispatcher_->add_observer(entry.get());
+    if (status != ZX_OK)
+        return status;
+
+    entries_.insert(fbl::move(entry));
+    return ZX_OK;
+}
+
+zx_status_t WaitSetDispatcher::RemoveEntry(uint64_t cookie) {
+    canary_.Assert();
+
+    AutoLock lock(&registration_lock_);
+    auto entry = entries_.erase(cookie);
+    if (!entry)
+        return ZX_ERR_NOT_FOUND;
+
+    entry->Detach();
+    return ZX_OK;
+}
+
+zx_status_t WaitSetDispatcher::Wait(zx_time_t deadline, zx_waitset_result_t* results,
+                                    uint32_t max_results, uint32_t* num_results) {
+    canary_.Assert();
+
+    for (;;) {
+        // Returns ZX_OK if already signaled, even if the deadline has passed.
+        zx_status_t status = event_.Wait(deadline);
+        if (status != ZX_OK)
+            return status;
+
+        AutoLock lock(&lock_);
+        if (canceled_)
+            return ZX_ERR_CANCELED;
+
+        // Report the triggered entries from the front of the list, and move
+        // each one to the back so a caller with a small buffer still gets
+        // to see all of them over successive waits.
+        uint32_t count = 0u;
+        size_t triggered = triggered_.size_slow();
+        while (count < max_results && count < triggered) {
+            Entry* entry = triggered_.pop_front();
+            results[count].cookie = entry->cookie_;
+            results[count].status = entry->status_;
+            results[count].observed = entry->observed_;
+            triggered_.push_back(entry);
+            ++count;
+        }
+
+        // The entries that woke us may have been untriggered before we got
+        // the lock, in which case the event is unsignaled again and we go
+        // back to waiting.
+        if (count > 0u || max_results == 0u) {
+            *num_results = count;
+            return ZX_OK;
+        }
+    }
+}
+
+bool WaitSetDispatcher::UpdateTriggeredLocked(Entry* entry) {
+    bool triggered = (entry->status_ != ZX_OK) ||
+                     (entry->observed_ & entry->watched_signals_);
+
+    if (triggered == entry->IsTriggered())
+        return false;
+    if (entry->removing_)
+        return false;
+
+    if (!triggered) {
+        RemoveTriggeredLocked(entry);
+        return false;
+    }
+
+    bool was_empty = triggered_.is_empty();
+    triggered_.push_back(entry);
+    return was_empty && (event_.Signal() > 0);
+}
+
+void WaitSetDispatcher::RemoveTriggeredLocked(Entry* entry) {
+    if (!entry->IsTriggered())
+        return;
+
+    triggered_.erase(*entry);
+    if (triggered_.is_empty() && !canceled_)
+        event_.Unsignal();
+}
@@ -247,6 +247,32 @@ static zx_status_t msg_put_handles(ProcessDispatcher* up, MessagePacket* msg, zx
     return ZX_OK;
 }
 
+// Attaches |user_handles| to |msg| and writes it to |channel|.
+static zx_status_t channel_write_packet(ProcessDispatcher* up,
+                                       const fbl::RefPtr<ChannelDispatcher>& channel,
+                                       fbl::unique_ptr<MessagePacket> msg,
+                                       user_ptr<const zx_handle_t> user_handles,
+                                       uint32_t num_handles) {
+    zx_handle_t handles[kMaxMessageHandles];
+    if (num_handles > 0u) {
+        zx_status_t result = msg_put_handles(up, msg.get(), handles, user_handles, num_handles,
+                                             static_cast<Dispatcher*>(channel.get()));
+        if (result)
+            return result;
+    }
+
+    zx_status_t result = channel->Write(fbl::move(msg));
+    if (result != ZX_OK) {
+        // Write failed, put back the handles into this process.
+        AutoLock lock(up->handle_table_lock());
+        for (size_t ix = 0; ix != num_handles; ++ix) {
+            up->UndoRemoveHandleLocked(handles[ix]);
+        }
+        return result;
+    }
+    return ZX_OK;
+}
+
 zx_status_t sys_channel_write(zx_handle_t handle_value, uint32_t options,
                               user_ptr<const void> user_bytes, uint32_t num_bytes,
                               user_ptr<const zx_handle_t> user_handles, uint32_t num_handles) {
@@ -269,28 +295,53 @@ zx_status_t sys_channel_write(zx_handle_t handle_value, uint32_t options,
     if (result != ZX_OK)
         return result;
 
-    zx_handle_t handles[kMaxMessageHandles];
-    if (num_handles > 0u) {
-        result = msg_put_handles(up, msg.get(), handles, user_handles, num_handles,
-                                 static_cast<Dispatcher*>(channel.get()));
-        if (result)
-            return result;
-    }
-
-    result = channel->Write(fbl::move(msg));
-    if (result != ZX_OK) {
-        // Write failed, put back the handles into this process.
-        AutoLock lock(up->handle_table_lock());
-        for (size_t ix = 0; ix != num_handles; ++ix) {
-            up->UndoRemoveHandleLocked(handles[ix]);
-        }
+    result = channel_write_packet(up, channel, fbl::move(msg), user_handles, num_handles);
+    if (result != ZX_OK)
         return result;
-    }
 
     ktrace(TAG_CHANNEL_WRITE, (uint32_t)channel->get_koid(), num_bytes, num_handles, 0);
     return ZX_OK;
 }
 
+zx_status_t sys_channel_writev(zx_handle_t handle_value, uint32_t options,
+                               user_ptr<const zx_iovec_t> vec, uint32_t num_vec,
+                               user_ptr<const zx_handle_t> user_handles, uint32_t num_handles) {
+    LTRACEF("handle %x vec %p num_vec %u handles %p num_handles %u options 0x%x\n",
+            handle_value, vec.get(), num_vec, user_handles.get(), num_handles, options);
+
+    if (options)
+        return ZX_ERR_INVALID_ARGS;
+
+    iovec_t iov[kMaxUserIovecs];
+    size_t num_bytes;
+    zx_status_t result = copy_iovecs_from_user(vec, num_vec, iov, &num_bytes);
+    if (result != ZX_OK)
+        return result;
+    if (num_bytes > kMaxMessageSize)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<ChannelDispatcher> channel;
+    result = up->GetDispatcherWithRights(handle_value, ZX_RIGHT_WRITE, &channel);
+    if (result != ZX_OK)
+        return result;
+
+    // The bytes are gathered straight into the packet, with no staging copy.
+    fbl::unique_ptr<MessagePacket> msg;
+    result = MessagePacket::Create(iov, num_vec, static_cast<uint32_t>(num_bytes),
+                                   num_handles, &msg);
+    if (result != ZX_OK)
+        return result;
+
+    result = channel_write_packet(up, channel, fbl::move(msg), user_handles, num_handles);
+    if (result != ZX_OK)
+        return result;
+
+    ktrace(TAG_CHANNEL_WRITE, (uint32_t)channel->get_koid(), (uint32_t)num_bytes, num_handles, 0);
+    return ZX_OK;
+}
+
 zx_status_t sys_channel_call_noretry(zx_handle_t handle_value, uint32_t options,
                                      zx_time_t deadline,
                                      user_ptr<const zx_channel_call_args_t> user_args,
@@ -11,6 +11,7 @@
 #include <stdlib.h>
 #include <trace.h>
 
+#include <lib/user_copy/user_iovec.h>
 #include <lib/user_copy/user_ptr.h>
 #include <object/fifo_dispatcher.h>
 #include <object/handle_owner.h>
@@ -95,3 +96,55 @@ zx_status_t sys_fifo_read(zx_handle_t handle, user_ptr<void> entries, size_t len
 
     return ZX_OK;
 }
+
+zx_status_t sys_fifo_readv(zx_handle_t handle, user_ptr<const zx_iovec_t> vec, uint32_t num_vec,
+                           user_ptr<uint32_t> _actual) {
+    iovec_t iov[kMaxUserIovecs];
+    size_t len;
+    zx_status_t status = copy_iovecs_from_user(vec, num_vec, iov, &len);
+    if (status != ZX_OK)
+        return status;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<FifoDispatcher> fifo;
+    status = up->GetDispatcherWithRights(handle, ZX_RIGHT_READ, &fifo);
+    if (status != ZX_OK)
+        return status;
+
+    uint32_t actual;
+    status = fifo->ReadToUser(iov, num_vec, len, &actual);
+    if (status != ZX_OK)
+        return status;
+
+    if (_actual.copy_to_user(actual) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+
+    return ZX_OK;
+}
+
+zx_status_t sys_fifo_writev(zx_handle_t handle, user_ptr<const zx_iovec_t> vec, uint32_t num_vec,
+                            user_ptr<uint32_t> _actual) {
+    iovec_t iov[kMaxUserIovecs];
+    size_t len;
+    zx_status_t status = copy_iovecs_from_user(vec, num_vec, iov, &len);
+    if (status != ZX_OK)
+        return status;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<FifoDispatcher> fifo;
+    status = up->GetDispatcherWithRights(handle, ZX_RIGHT_WRITE, &fifo);
+    if (status != ZX_OK)
+        return status;
+
+    uint32_t actual;
+    status = fifo->WriteFromUser(iov, num_vec, len, &actual);
+    if (status != ZX_OK)
+        return status;
+
+    if (_actual.copy_to_user(actual) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+
+    return ZX_OK;
+}
@@ -21,6 +21,7 @@
 #include <object/process_dispatcher.h>
 #include <object/resource_dispatcher.h>
 #include <object/resources.h>
+#include <object/socket_dispatcher.h>
 #include <object/thread_dispatcher.h>
 #include <object/vm_address_region_dispatcher.h>
 
@@ -568,6 +569,17 @@ zx_status_t sys_object_get_property(zx_handle_t handle_value, uint32_t property,
             }
             return ZX_OK;
         }
+        case ZX_PROP_SOCKET_BUFFER_SIZE: {
+            if (size < sizeof(size_t))
+                return ZX_ERR_BUFFER_TOO_SMALL;
+            auto socket = DownCastDispatcher<SocketDispatcher>(&dispatcher);
+            if (!socket)
+                return ZX_ERR_WRONG_TYPE;
+            size_t value = socket->GetBufferSize();
+            if (_value.reinterpret<size_t>().copy_to_user(value) != ZX_OK)
+                return ZX_ERR_INVALID_ARGS;
+            return ZX_OK;
+        }
         default:
             return ZX_ERR_INVALID_ARGS;
     }
@@ -646,6 +658,17 @@ zx_status_t sys_object_set_property(zx_handle_t handle_value, uint32_t property,
             return job->set_importance(
                 static_cast<zx_job_importance_t>(value));
         }
+        case ZX_PROP_SOCKET_BUFFER_SIZE: {
+            if (size < sizeof(size_t))
+                return ZX_ERR_BUFFER_TOO_SMALL;
+            auto socket = DownCastDispatcher<SocketDispatcher>(&dispatcher);
+            if (!socket)
+                return ZX_ERR_WRONG_TYPE;
+            size_t value = 0;
+            if (_value.reinterpret<const size_t>().copy_from_user(&value) != ZX_OK)
+                return ZX_ERR_INVALID_ARGS;
+            return socket->SetBufferSize(value);
+        }
     }
 
     return ZX_ERR_INVALID_ARGS;
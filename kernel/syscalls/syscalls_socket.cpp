@@ -18,6 +18,7 @@
 #include <object/handles.h>
 #include <object/process_dispatcher.h>
 #include <object/socket_dispatcher.h>
+#include <object/vm_object_dispatcher.h>
 
 #include <zircon/syscalls/policy.h>
 #include <fbl/ref_ptr.h>
@@ -65,7 +66,8 @@ zx_status_t sys_socket_write(zx_handle_t handle, uint32_t options,
                              user_ptr<size_t> actual) {
     LTRACEF("handle %x\n", handle);
 
-    if ((size > 0u) && !buffer)
+    // In place writes take the data from the shared ring instead.
+    if ((options == ZX_SOCKET_IN_PLACE) ? !!buffer : ((size > 0u) && !buffer))
         return ZX_ERR_INVALID_ARGS;
 
     auto up = ProcessDispatcher::GetCurrent();
@@ -78,7 +80,8 @@ zx_status_t sys_socket_write(zx_handle_t handle, uint32_t options,
     size_t nwritten;
     switch (options) {
     case 0:
-        status = socket->Write(buffer, size, &nwritten);
+    case ZX_SOCKET_IN_PLACE:
+        status = socket->Write(buffer, size, options == ZX_SOCKET_IN_PLACE, &nwritten);
         break;
     case ZX_SOCKET_CONTROL:
         status = socket->WriteControl(buffer, size);
@@ -107,7 +110,7 @@ zx_status_t sys_socket_read(zx_handle_t handle, uint32_t options,
                             user_ptr<size_t> actual) {
     LTRACEF("handle %x\n", handle);
 
-    if (!buffer && size > 0)
+    if ((options == ZX_SOCKET_IN_PLACE) ? !!buffer : (!buffer && size > 0))
         return ZX_ERR_INVALID_ARGS;
 
     auto up = ProcessDispatcher::GetCurrent();
@@ -121,7 +124,8 @@ zx_status_t sys_socket_read(zx_handle_t handle, uint32_t options,
 
     switch (options) {
     case 0:
-        status = socket->Read(buffer, size, &nread);
+    case ZX_SOCKET_IN_PLACE:
+        status = socket->Read(buffer, size, options == ZX_SOCKET_IN_PLACE, &nread);
         break;
     case ZX_SOCKET_CONTROL:
         status = socket->ReadControl(buffer, size, &nread);
@@ -136,3 +140,47 @@ zx_status_t sys_socket_read(zx_handle_t handle, uint32_t options,
 
     return status;
 }
+
+zx_status_t sys_socket_get_ring(zx_handle_t handle, uint32_t options,
+                                user_ptr<zx_handle_t> _out) {
+    LTRACEF("handle %x options %#x\n", handle, options);
+
+    if (options != ZX_SOCKET_RING_READ && options != ZX_SOCKET_RING_WRITE)
+        return ZX_ERR_INVALID_ARGS;
+    bool write = options == ZX_SOCKET_RING_WRITE;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<SocketDispatcher> socket;
+    zx_status_t status = up->GetDispatcherWithRights(
+        handle, write ? ZX_RIGHT_WRITE : ZX_RIGHT_READ, &socket);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<VmObject> vmo;
+    status = socket->GetRing(write, &vmo);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<Dispatcher> dispatcher;
+    zx_rights_t rights;
+    status = VmObjectDispatcher::Create(fbl::move(vmo), &dispatcher, &rights);
+    if (status != ZX_OK)
+        return status;
+
+    // Only the writer may store into the ring.
+    rights = ZX_RIGHT_DUPLICATE | ZX_RIGHT_TRANSFER | ZX_RIGHT_READ | ZX_RIGHT_MAP;
+    if (write)
+        rights |= ZX_RIGHT_WRITE;
+
+    HandleOwner h(MakeHandle(fbl::move(dispatcher), rights));
+    if (!h)
+        return ZX_ERR_NO_MEMORY;
+
+    if (_out.copy_to_user(up->MapHandleToValue(h)) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+
+    up->AddHandle(fbl::move(h));
+
+    return ZX_OK;
+}
@@ -0,0 +1,124 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <err.h>
+#include <inttypes.h>
+#include <trace.h>
+
+#include <object/handle_owner.h>
+#include <object/handles.h>
+#include <object/process_dispatcher.h>
+#include <object/wait_set_dispatcher.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/auto_lock.h>
+#include <fbl/inline_array.h>
+#include <fbl/ref_ptr.h>
+
+#include "syscalls_priv.h"
+
+#define LOCAL_TRACE 0
+
+// Results up to this many are gathered on the stack.
+constexpr size_t kWaitSetInlineCount = 16u;
+
+zx_status_t sys_waitset_create(uint32_t options, user_ptr<zx_handle_t> out) {
+    LTRACEF("options %u\n", options);
+
+    // No options are supported.
+    if (options != 0u)
+        return ZX_ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<Dispatcher> dispatcher;
+    zx_rights_t rights;
+
+    zx_status_t result = WaitSetDispatcher::Create(options, &dispatcher, &rights);
+    if (result != ZX_OK)
+        return result;
+
+    HandleOwner handle(MakeHandle(fbl::move(dispatcher), rights));
+    if (!handle)
+        return ZX_ERR_NO_MEMORY;
+
+    if (out.copy_to_user(up->MapHandleToValue(handle)) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+    up->AddHandle(fbl::move(handle));
+
+    return ZX_OK;
+}
+
+zx_status_t sys_waitset_add(zx_handle_t ws_handle, uint64_t cookie,
+                            zx_handle_t handle_value, zx_signals_t signals) {
+    LTRACEF("ws %x cookie %" PRIu64 " handle %x\n", ws_handle, cookie, handle_value);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<WaitSetDispatcher> ws;
+    zx_status_t status = up->GetDispatcherWithRights(ws_handle, ZX_RIGHT_WRITE, &ws);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::AutoLock lock(up->handle_table_lock());
+    Handle* handle = up->GetHandleLocked(handle_value);
+    if (!handle)
+        return ZX_ERR_BAD_HANDLE;
+    if (!handle->HasRights(ZX_RIGHT_READ))
+        return ZX_ERR_ACCESS_DENIED;
+
+    return ws->AddEntry(cookie, handle, signals);
+}
+
+zx_status_t sys_waitset_remove(zx_handle_t ws_handle, uint64_t cookie) {
+    LTRACEF("ws %x cookie %" PRIu64 "\n", ws_handle, cookie);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<WaitSetDispatcher> ws;
+    zx_status_t status = up->GetDispatcherWithRights(ws_handle, ZX_RIGHT_WRITE, &ws);
+    if (status != ZX_OK)
+        return status;
+
+    return ws->RemoveEntry(cookie);
+}
+
+zx_status_t sys_waitset_wait(zx_handle_t ws_handle, zx_time_t deadline,
+                             user_ptr<zx_waitset_result_t> _results, uint32_t max_results,
+                             user_ptr<uint32_t> _actual) {
+    LTRACEF("ws %x max_results %u\n", ws_handle, max_results);
+
+    if (!_results && max_results != 0u)
+        return ZX_ERR_INVALID_ARGS;
+
+    // There can never be more triggered entries than this.
+    if (max_results > WaitSetDispatcher::kMaxEntries)
+        max_results = WaitSetDispatcher::kMaxEntries;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<WaitSetDispatcher> ws;
+    zx_status_t status = up->GetDispatcherWithRights(ws_handle, ZX_RIGHT_READ, &ws);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::AllocChecker ac;
+    fbl::InlineArray<zx_waitset_result_t, kWaitSetInlineCount> results(&ac, max_results);
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    uint32_t actual = 0u;
+    status = ws->Wait(deadline, results.get(), max_results, &actual);
+    if (status != ZX_OK)
+        return status;
+
+    if (actual > 0u && _results.copy_array_to_user(results.get(), actual) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+    if (_actual && _actual.copy_to_user(actual) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+
+    return ZX_OK;
+}
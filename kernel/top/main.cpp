@@ -16,6 +16,7 @@
 #include <debug.h>
 #include <kernel/mutex.h>
 #include <kernel/thread.h>
+#include <lib/dpc.h>
 #include <lib/heap.h>
 #include <lk/init.h>
 #include <platform.h>
@@ -138,6 +139,7 @@ void lk_init_secondary_cpus(uint secondary_cpu_count) {
             break;
         }
         thread_detach_and_resume(t);
+        dpc_init_for_cpu(i + 1);
     }
     secondary_idle_thread_count = secondary_cpu_count;
 }
@@ -26,6 +26,7 @@ ENABLE_NEW_FB := true
 DISABLE_UTEST ?= false
 ENABLE_ULIB_ONLY ?= false
 USE_ASAN ?= false
+ENABLE_LOCK_PROFILING ?= false
 USE_SANCOV ?= false
 USE_LTO ?= false
 USE_THINLTO ?= $(USE_LTO)
@@ -438,6 +439,12 @@ include kernel/arch/$(ARCH)/rules.mk
 include kernel/top/rules.mk
 include make/sysgen.mk
 
+# Build the kernel lock profiler, which records statistics for every mutex
+# and spinlock acquisition.
+ifeq ($(call TOBOOL,$(ENABLE_LOCK_PROFILING)),true)
+MODULES += kernel/lib/lockprof
+endif
+
 ifeq ($(call TOBOOL,$(USE_CLANG)),true)
 GLOBAL_COMPILEFLAGS += --target=$(CLANG_ARCH)-fuchsia
 endif
@@ -8,11 +8,13 @@
 # create a separate list of objects per source type
 MODULE_CSRCS := $(filter %.c,$(MODULE_SRCS))
 MODULE_CPPSRCS := $(filter %.cpp,$(MODULE_SRCS))
+MODULE_ASMSRCS := $(filter %.S,$(MODULE_SRCS))
 
 MODULE_COBJS := $(call TOMODULEDIR,$(patsubst %.c,%.c.o,$(MODULE_CSRCS)))
 MODULE_CPPOBJS := $(call TOMODULEDIR,$(patsubst %.cpp,%.cpp.o,$(MODULE_CPPSRCS)))
+MODULE_ASMOBJS := $(call TOMODULEDIR,$(patsubst %.S,%.S.o,$(MODULE_ASMSRCS)))
 
-MODULE_OBJS := $(MODULE_COBJS) $(MODULE_CPPOBJS)
+MODULE_OBJS := $(MODULE_COBJS) $(MODULE_CPPOBJS) $(MODULE_ASMOBJS)
 
 #$(info MODULE_SRCS = $(MODULE_SRCS))
 #$(info MODULE_CSRCS = $(MODULE_CSRCS))
@@ -26,6 +28,7 @@ $(MODULE_OBJS): MODULE_OPTFLAGS:=$(MODULE_OPTFLAGS)
 $(MODULE_OBJS): MODULE_COMPILEFLAGS:=$(MODULE_COMPILEFLAGS)
 $(MODULE_OBJS): MODULE_CFLAGS:=$(MODULE_CFLAGS)
 $(MODULE_OBJS): MODULE_CPPFLAGS:=$(MODULE_CPPFLAGS)
+$(MODULE_OBJS): MODULE_ASMFLAGS:=$(MODULE_ASMFLAGS)
 $(MODULE_OBJS): MODULE_SRCDEPS:=$(MODULE_SRCDEPS)
 
 $(MODULE_COBJS): $(MODULE_BUILDDIR)/%.c.o: %.c $(MODULE_SRCDEPS)
@@ -38,12 +41,19 @@ $(MODULE_CPPOBJS): $(MODULE_BUILDDIR)/%.cpp.o: %.cpp $(MODULE_SRCDEPS)
 	$(call BUILDECHO, compiling $<)
 	$(NOECHO)$(HOST_CXX) $(MODULE_OPTFLAGS) $(HOST_COMPILEFLAGS) $(MODULE_COMPILEFLAGS) $(HOST_CPPFLAGS) $(MODULE_CPPFLAGS) $(HOST_INCLUDES) -c $< -MMD -MP -MT $@ -MF $(@:%o=%d) -o $@
 
+$(MODULE_ASMOBJS): $(MODULE_BUILDDIR)/%.S.o: %.S $(MODULE_SRCDEPS)
+	@$(MKDIR)
+	$(call BUILDECHO, compiling $<)
+	$(NOECHO)$(HOST_CC) $(MODULE_OPTFLAGS) $(HOST_COMPILEFLAGS) $(MODULE_COMPILEFLAGS) $(MODULE_ASMFLAGS) $(HOST_INCLUDES) -c $< -MMD -MP -MT $@ -MF $(@:%o=%d) -o $@
+
 
 # clear some variables we set here
 MODULE_CSRCS :=
 MODULE_CPPSRCS :=
+MODULE_ASMSRCS :=
 MODULE_COBJS :=
 MODULE_CPPOBJS :=
+MODULE_ASMOBJS :=
 
 # MODULE_OBJS is passed back
 #MODULE_OBJS :=
@@ -168,9 +168,9 @@ static void setup_bootfs(void) {
             case BOOTDATA_BOOTFS_SYSTEM: {
                 const char* errmsg;
                 zx_handle_t bootfs_vmo;
-                status = decompress_bootdata(zx_vmar_root_self(), vmo,
-                                             off, bootdata.length + hdrsz,
-                                             &bootfs_vmo, &errmsg);
+                status = decompress_bootdata_parallel(zx_vmar_root_self(), vmo,
+                                                      off, bootdata.length + hdrsz,
+                                                      0, &bootfs_vmo, &errmsg);
                 if (status < 0) {
                     printf("devmgr: failed to decompress bootdata: %s\n", errmsg);
                 } else {
@@ -0,0 +1,100 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fs-management/ramdisk.h>
+#include <unittest/unittest.h>
+
+#include "netsvc.h"
+
+#define BLOCK_SIZE 512
+// Enough for a little over two staging buffers' worth of data
+#define BLOCK_COUNT (6 * 1024 * 1024 / BLOCK_SIZE)
+
+// Writes |len| bytes through netfile in packet-sized pieces.
+static bool netfile_write_all(const uint8_t* data, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        size_t n = len - done;
+        if (n > sizeof(((netfilemsg*)0)->data)) {
+            n = sizeof(((netfilemsg*)0)->data);
+        }
+        ASSERT_EQ(netfile_offset_write((const char*)data + done, done, n), (int)n, "");
+        done += n;
+    }
+    return true;
+}
+
+static bool netfile_block_write(void) {
+    BEGIN_TEST;
+
+    char ramdisk_path[PATH_MAX];
+    ASSERT_EQ(create_ramdisk(BLOCK_SIZE, BLOCK_COUNT, ramdisk_path), 0, "");
+
+    // Not a whole number of blocks, so the last one is padded out.
+    size_t len = 5 * 1024 * 1024 / 2 + 100;
+    uint8_t* data = malloc(len);
+    ASSERT_NONNULL(data, "");
+    for (size_t i = 0; i < len; i++) {
+        data[i] = (uint8_t)(i * 7 + i / 4096);
+    }
+
+    ASSERT_EQ(netfile_open(ramdisk_path, O_WRONLY), 0, "");
+    ASSERT_TRUE(netfile_write_all(data, len), "");
+    // Block devices are written in order, so seeking back fails.
+    ASSERT_EQ(netfile_offset_write((const char*)data, 0, 1), -EINVAL, "");
+    ASSERT_EQ(netfile_close(), 0, "");
+
+    int fd = open(ramdisk_path, O_RDONLY);
+    ASSERT_GE(fd, 0, "");
+    uint8_t* actual = malloc(len);
+    ASSERT_NONNULL(actual, "");
+    ASSERT_EQ(read(fd, actual, len), (ssize_t)len, "");
+    ASSERT_EQ(memcmp(actual, data, len), 0, "");
+    close(fd);
+
+    free(actual);
+    free(data);
+    ASSERT_EQ(destroy_ramdisk(ramdisk_path), 0, "");
+
+    END_TEST;
+}
+
+static bool netfile_block_write_past_end(void) {
+    BEGIN_TEST;
+
+    char ramdisk_path[PATH_MAX];
+    ASSERT_EQ(create_ramdisk(BLOCK_SIZE, 4, ramdisk_path), 0, "");
+
+    uint8_t data[1024];
+    memset(data, 0xa5, sizeof(data));
+    ASSERT_EQ(netfile_open(ramdisk_path, O_WRONLY), 0, "");
+    ASSERT_EQ(netfile_write((const char*)data, sizeof(data)), (int)sizeof(data), "");
+    ASSERT_EQ(netfile_write((const char*)data, sizeof(data)), (int)sizeof(data), "");
+    ASSERT_EQ(netfile_write((const char*)data, 1), -ENOSPC, "");
+    ASSERT_EQ(netfile_close(), 0, "");
+
+    // Opening again after a close works, so nothing was left attached.
+    ASSERT_EQ(netfile_open(ramdisk_path, O_WRONLY), 0, "");
+    ASSERT_EQ(netfile_close(), 0, "");
+
+    ASSERT_EQ(destroy_ramdisk(ramdisk_path), 0, "");
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(netfile_tests)
+RUN_TEST_MEDIUM(netfile_block_write)
+RUN_TEST(netfile_block_write_past_end)
+END_TEST_CASE(netfile_tests)
+
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
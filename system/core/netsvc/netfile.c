@@ -9,12 +9,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
 #include <unistd.h>
 #include <sys/stat.h>
 
+#include <block-client/client.h>
 #include <inet6/inet6.h>
 #include <inet6/netifc.h>
 
+#include <zircon/device/block.h>
+#include <zircon/process.h>
 #include <zircon/processargs.h>
 #include <zircon/syscalls.h>
 #include <launchpad/launchpad.h>
@@ -23,11 +27,277 @@
 
 #define TMP_SUFFIX ".netsvc.tmp"
 
+// Size of each half of the staging buffer for writes to block devices.
+#define BLOCK_STREAM_BUFSZ (1024 * 1024)
+
 netfile_state netfile = {
     .fd = -1,
     .needs_rename = false,
 };
 
+// Writes to a block device skip the file write path and go straight to the
+// device's block fifo. Incoming data fills one half of a staging vmo while a
+// worker thread writes the other half out, so the network never waits on a
+// device write unless the device falls a whole buffer behind.
+typedef struct {
+    fifo_client_t* client;
+    zx_handle_t vmo;
+    uint8_t* data;
+    txnid_t txnid;
+    vmoid_t vmoid;
+    // Whether txnid and vmoid were handed out by the device
+    bool has_txnid;
+    bool has_vmoid;
+    uint32_t block_size;
+    uint32_t max_transfer;
+    uint64_t dev_size;
+
+    // The half being filled, how much of it is, and where it goes on the device
+    int fill_buf;
+    size_t fill_len;
+    uint64_t fill_off;
+
+    thrd_t thread;
+    bool thread_started;
+    mtx_t lock;
+    cnd_t cond;
+    // Halves handed to the worker; a length of 0 means the half is free
+    size_t pending_len[2];
+    uint64_t pending_off[2];
+    zx_status_t status;
+    bool exiting;
+} block_stream_t;
+
+static block_stream_t blk;
+
+static zx_status_t block_stream_write(int buf, size_t len, uint64_t dev_offset) {
+    block_fifo_request_t requests[MAX_TXN_MESSAGES];
+    size_t done = 0;
+    while (done < len) {
+        size_t count = 0;
+        while (done < len && count < MAX_TXN_MESSAGES) {
+            size_t xfer = len - done;
+            if (blk.max_transfer != 0 && xfer > blk.max_transfer) {
+                xfer = blk.max_transfer;
+            }
+            requests[count].txnid = blk.txnid;
+            requests[count].vmoid = blk.vmoid;
+            requests[count].opcode = BLOCKIO_WRITE;
+            requests[count].length = xfer;
+            requests[count].vmo_offset = buf * BLOCK_STREAM_BUFSZ + done;
+            requests[count].dev_offset = dev_offset + done;
+            count++;
+            done += xfer;
+        }
+        zx_status_t status = block_fifo_txn(blk.client, requests, count);
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+    return ZX_OK;
+}
+
+static int block_stream_worker(void* arg) {
+    // Halves are handed over alternately, so they are written out in order.
+    int next = 0;
+    mtx_lock(&blk.lock);
+    for (;;) {
+        while (blk.pending_len[next] == 0 && !blk.exiting) {
+            cnd_wait(&blk.cond, &blk.lock);
+        }
+        if (blk.pending_len[next] == 0) {
+            break;
+        }
+        size_t len = blk.pending_len[next];
+        uint64_t dev_offset = blk.pending_off[next];
+        mtx_unlock(&blk.lock);
+
+        zx_status_t status = ZX_OK;
+        if (blk.status == ZX_OK) {
+            status = block_stream_write(next, len, dev_offset);
+        }
+
+        mtx_lock(&blk.lock);
+        if (status != ZX_OK) {
+            printf("netsvc: error writing %s at offset %lu: %d\n",
+                   netfile.filename, dev_offset, status);
+            blk.status = status;
+        }
+        blk.pending_len[next] = 0;
+        cnd_broadcast(&blk.cond);
+        next ^= 1;
+    }
+    mtx_unlock(&blk.lock);
+    return 0;
+}
+
+// Hands the half being filled to the worker, padding it out to a whole number
+// of blocks, and waits for the other half to be free.
+static zx_status_t block_stream_submit(void) {
+    size_t len = (blk.fill_len + blk.block_size - 1) / blk.block_size * blk.block_size;
+    memset(blk.data + blk.fill_buf * BLOCK_STREAM_BUFSZ + blk.fill_len, 0, len - blk.fill_len);
+
+    mtx_lock(&blk.lock);
+    blk.pending_len[blk.fill_buf] = len;
+    blk.pending_off[blk.fill_buf] = blk.fill_off;
+    cnd_broadcast(&blk.cond);
+    blk.fill_buf ^= 1;
+    while (blk.pending_len[blk.fill_buf] != 0) {
+        cnd_wait(&blk.cond, &blk.lock);
+    }
+    zx_status_t status = blk.status;
+    mtx_unlock(&blk.lock);
+
+    blk.fill_off += blk.fill_len;
+    blk.fill_len = 0;
+    return status;
+}
+
+// Waits for queued writes to finish and releases everything attached to the
+// device open at |fd|. Returns the first error any write hit.
+static zx_status_t block_stream_release(int fd) {
+    if (blk.thread_started) {
+        mtx_lock(&blk.lock);
+        blk.exiting = true;
+        cnd_broadcast(&blk.cond);
+        mtx_unlock(&blk.lock);
+        thrd_join(blk.thread, NULL);
+    }
+    zx_status_t status = blk.status;
+    if (blk.client != NULL) {
+        if (blk.has_txnid && blk.has_vmoid) {
+            block_fifo_request_t request = {
+                .txnid = blk.txnid,
+                .vmoid = blk.vmoid,
+                .opcode = BLOCKIO_CLOSE_VMO,
+            };
+            block_fifo_txn(blk.client, &request, 1);
+        }
+        if (blk.has_txnid) {
+            ioctl_block_free_txn(fd, &blk.txnid);
+        }
+        block_fifo_release_client(blk.client);
+        ioctl_block_fifo_close(fd);
+    }
+    if (blk.data != NULL) {
+        zx_vmar_unmap(zx_vmar_root_self(), (uintptr_t)blk.data, 2 * BLOCK_STREAM_BUFSZ);
+    }
+    if (blk.vmo != ZX_HANDLE_INVALID) {
+        zx_handle_close(blk.vmo);
+    }
+    memset(&blk, 0, sizeof(blk));
+    return status;
+}
+
+// Sets up streaming to the block device open at |fd|.
+static zx_status_t block_stream_init(int fd, const block_info_t* info) {
+    memset(&blk, 0, sizeof(blk));
+    blk.vmo = ZX_HANDLE_INVALID;
+    if (info->block_size == 0 || BLOCK_STREAM_BUFSZ % info->block_size != 0) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    blk.block_size = info->block_size;
+    blk.max_transfer = info->max_transfer_size / info->block_size * info->block_size;
+    blk.dev_size = info->block_count * info->block_size;
+
+    zx_status_t status;
+    if ((status = zx_vmo_create(2 * BLOCK_STREAM_BUFSZ, 0, &blk.vmo)) != ZX_OK) {
+        goto fail;
+    }
+    uintptr_t buffer;
+    if ((status = zx_vmar_map(zx_vmar_root_self(), 0, blk.vmo, 0, 2 * BLOCK_STREAM_BUFSZ,
+                              ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, &buffer)) != ZX_OK) {
+        goto fail;
+    }
+    blk.data = (uint8_t*)buffer;
+
+    zx_handle_t fifo;
+    if (ioctl_block_get_fifos(fd, &fifo) != sizeof(fifo)) {
+        status = ZX_ERR_BAD_STATE;
+        goto fail;
+    }
+    if ((status = block_fifo_create_client(fifo, &blk.client)) != ZX_OK) {
+        zx_handle_close(fifo);
+        ioctl_block_fifo_close(fd);
+        goto fail;
+    }
+    zx_handle_t dup;
+    if ((status = zx_handle_duplicate(blk.vmo, ZX_RIGHT_SAME_RIGHTS, &dup)) != ZX_OK) {
+        goto fail;
+    }
+    if (ioctl_block_alloc_txn(fd, &blk.txnid) != sizeof(blk.txnid)) {
+        zx_handle_close(dup);
+        status = ZX_ERR_IO;
+        goto fail;
+    }
+    blk.has_txnid = true;
+    // The ioctl takes dup whether or not it succeeds
+    if (ioctl_block_attach_vmo(fd, &dup, &blk.vmoid) != sizeof(blk.vmoid)) {
+        status = ZX_ERR_IO;
+        goto fail;
+    }
+    blk.has_vmoid = true;
+
+    mtx_init(&blk.lock, mtx_plain);
+    cnd_init(&blk.cond);
+    if (thrd_create_with_name(&blk.thread, block_stream_worker, NULL,
+                              "netsvc-blockwrite") != thrd_success) {
+        status = ZX_ERR_NO_RESOURCES;
+        goto fail;
+    }
+    blk.thread_started = true;
+    return ZX_OK;
+
+fail:
+    block_stream_release(fd);
+    return status;
+}
+
+static int block_stream_append(const char* data, size_t len) {
+    if (netfile.offset + len > blk.dev_size) {
+        printf("netsvc: write past the end of %s\n", netfile.filename);
+        return -ENOSPC;
+    }
+    size_t done = 0;
+    while (done < len) {
+        size_t n = BLOCK_STREAM_BUFSZ - blk.fill_len;
+        if (n > len - done) {
+            n = len - done;
+        }
+        memcpy(blk.data + blk.fill_buf * BLOCK_STREAM_BUFSZ + blk.fill_len, data + done, n);
+        blk.fill_len += n;
+        done += n;
+        if (blk.fill_len == BLOCK_STREAM_BUFSZ && block_stream_submit() != ZX_OK) {
+            return -EIO;
+        }
+    }
+    netfile.offset += len;
+    return len;
+}
+
+// Opens |filename| for streaming writes if it is a block device. Returns 0 on
+// success, 1 if it is not a block device, and a negative errno otherwise.
+static int netfile_open_block(const char* filename) {
+    int fd = open(filename, O_RDWR);
+    if (fd < 0) {
+        return 1;
+    }
+    block_info_t info;
+    if (ioctl_block_get_info(fd, &info) != sizeof(info)) {
+        close(fd);
+        return 1;
+    }
+    zx_status_t status = block_stream_init(fd, &info);
+    if (status != ZX_OK) {
+        printf("netsvc: cannot stream to block device %s: %d\n", filename, status);
+        close(fd);
+        return -EIO;
+    }
+    netfile.fd = fd;
+    netfile.needs_rename = false;
+    return 0;
+}
+
 static int netfile_mkdir(const char* filename) {
     const char* ptr = filename[0] == '/' ? filename + 1 : filename;
     struct stat st;
@@ -55,6 +325,9 @@ static int netfile_mkdir(const char* filename) {
 int netfile_open(const char *filename, uint32_t arg) {
     if (netfile.fd >= 0) {
         printf("netsvc: closing still-open '%s', replacing with '%s'\n", netfile.filename, filename);
+        if (blk.client != NULL) {
+            block_stream_release(netfile.fd);
+        }
         close(netfile.fd);
         netfile.fd = -1;
     }
@@ -74,6 +347,15 @@ again: // label here to catch filename=/path/to/new/directory/
         netfile.fd = open(filename, O_RDONLY);
         break;
     case O_WRONLY: {
+        if (!strncmp(filename, "/dev/", 5)) {
+            int r = netfile_open_block(filename);
+            if (r < 0) {
+                errno = -r;
+                goto err;
+            } else if (r == 0) {
+                break;
+            }
+        }
         // If we're writing a file, actually write to "filename + TMP_SUFFIX",
         // and rename to the final destination when we would close. This makes
         // written files appear to atomically update.
@@ -146,6 +428,10 @@ int netfile_offset_write(const char* data, off_t offset, size_t length) {
         return -EBADF;
     }
     if (offset != netfile.offset) {
+        if (blk.client != NULL) {
+            // Block device writes are streamed, and can't go back
+            return -EINVAL;
+        }
         if (lseek(netfile.fd, offset, SEEK_SET) != offset) {
             return -errno;
         }
@@ -159,6 +445,9 @@ int netfile_write(const char* data, size_t len) {
         printf("netsvc: write, but no open file\n");
         return -EBADF;
     }
+    if (blk.client != NULL) {
+        return block_stream_append(data, len);
+    }
     ssize_t n = write(netfile.fd, data, len);
     if (n != (ssize_t)len) {
         printf("netsvc: error writing %s: %d\n", netfile.filename, errno);
@@ -176,6 +465,15 @@ int netfile_close(void) {
     if (netfile.fd < 0) {
         printf("netsvc: close, but no open file\n");
     } else {
+        if (blk.client != NULL) {
+            zx_status_t status = ZX_OK;
+            if (blk.fill_len > 0) {
+                status = block_stream_submit();
+            }
+            if (block_stream_release(netfile.fd) != ZX_OK || status != ZX_OK) {
+                result = -EIO;
+            }
+        }
         if (netfile.needs_rename) {
             char src[PATH_MAX];
             strlcpy(src, netfile.filename, sizeof(src));
@@ -184,7 +482,7 @@ int netfile_close(void) {
                 printf("netsvc: failed to rename temporary file: %s\n", strerror(errno));
             }
         }
-        if (close(netfile.fd)) {
+        if (close(netfile.fd) && result == 0) {
             result = (errno == 0) ? -EIO : -errno;
         }
         netfile.fd = -1;
@@ -198,6 +496,13 @@ void netfile_abort_write(void) {
     if (netfile.fd < 0) {
         return;
     }
+    if (blk.client != NULL) {
+        // Whatever reached the device stays there; there's no file to unlink.
+        block_stream_release(netfile.fd);
+        close(netfile.fd);
+        netfile.fd = -1;
+        return;
+    }
     close(netfile.fd);
     netfile.fd = -1;
     char tmp[PATH_MAX];
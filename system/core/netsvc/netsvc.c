@@ -21,6 +21,7 @@
 #include <fdio/io.h>
 
 #include <zircon/boot/netboot.h>
+#include <zircon/device/ethernet.h>
 
 #include "device_id.h"
 
@@ -82,8 +83,12 @@ void udp6_recv(void* data, size_t len,
     }
 }
 
-void netifc_recv(void* data, size_t len) {
-    eth_recv(data, len);
+void netifc_recv(void* data, size_t len, uint32_t flags) {
+    if (flags & ETH_FIFO_RX_CSUM_OK) {
+        eth_recv_csum_ok(data, len);
+    } else {
+        eth_recv(data, len);
+    }
 }
 
 static const char* zedboot_banner =
@@ -19,8 +19,40 @@ MODULE_SRCS += \
     $(LOCAL_DIR)/tftp.c \
     $(LOCAL_DIR)/debuglog.c
 
-MODULE_STATIC_LIBS := system/ulib/inet6 system/ulib/tftp
+MODULE_STATIC_LIBS := \
+    system/ulib/inet6 \
+    system/ulib/inet-checksum \
+    system/ulib/tftp \
+    system/ulib/block-client \
+    system/ulib/sync
 
 MODULE_LIBS := system/ulib/fdio system/ulib/launchpad system/ulib/zircon system/ulib/c
 
 include make/module.mk
+
+
+# netsvc-test
+
+MODULE := $(LOCAL_DIR).test
+
+MODULE_TYPE := usertest
+
+MODULE_SRCS := \
+    $(LOCAL_DIR)/netfile.c \
+    $(LOCAL_DIR)/netfile-test.c
+
+MODULE_STATIC_LIBS := \
+    system/ulib/inet6 \
+    system/ulib/block-client \
+    system/ulib/sync
+
+MODULE_LIBS := \
+    system/ulib/fs-management \
+    system/ulib/unittest \
+    system/ulib/fdio \
+    system/ulib/zircon \
+    system/ulib/c
+
+MODULE_NAME := netsvc-test
+
+include make/module.mk
@@ -18,6 +18,10 @@
 
 #define SCRATCHSZ 2048
 
+// Largest block that fits in a single frame; larger ones would need IPv6
+// fragmentation, which inet6 doesn't do.
+#define TFTP_MAX_BLOCK_SIZE (ETH_MTU - ETH_HDR_LEN - IP6_HDR_LEN - UDP_HDR_LEN - 4)
+
 typedef struct {
     bool is_write;
     char filename[PATH_MAX + 1];
@@ -151,6 +155,7 @@ static void initialize_connection(const ip6_addr_t* saddr, uint16_t sport) {
     transport_info.timeout_ms = 1000;  // Reasonable default for now
     tftp_transport_interface transport_ifc = {transport_send, NULL, transport_timeout_set};
     tftp_session_set_transport_interface(session, &transport_ifc);
+    tftp_session_set_max_block_size(session, TFTP_MAX_BLOCK_SIZE);
 }
 
 static void end_connection(void) {
@@ -37,6 +37,42 @@ void bootfs_unmount(zx_handle_t vmar, zx_handle_t log, struct bootfs *fs) {
     check(log, status, "zx_handle_close failed\n");
 }
 
+// Binary search the sorted directory index.  The index lists duplicate
+// names in directory order, so this finds the first one just like the
+// linear scan does.
+static const bootfs_entry_t* bootfs_search_index(zx_handle_t log,
+                                                 const bootfs_header_t* hdr,
+                                                 const char* filename,
+                                                 size_t filename_len) {
+    const void* dir = hdr + 1;
+    const uint32_t* index = dir + hdr->dirsize;
+    const bootfs_entry_t* found = NULL;
+    size_t lo = 0;
+    size_t hi = hdr->index_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        uint32_t off = index[mid];
+        if ((off > hdr->dirsize) ||
+            (hdr->dirsize - off <= sizeof(bootfs_entry_t)))
+            fail(log, "bootfs has bogus index entry");
+        const bootfs_entry_t* e = dir + off;
+        if ((e->name_len < 1) ||
+            (BOOTFS_RECSIZE(e) > hdr->dirsize - off) ||
+            (e->name[e->name_len - 1] != '\0'))
+            fail(log, "bootfs has bogus namelen in header");
+
+        int r = strncmp(e->name, filename, filename_len);
+        if (r < 0) {
+            lo = mid + 1;
+        } else {
+            if (r == 0)
+                found = e;
+            hi = mid;
+        }
+    }
+    return found;
+}
+
 static const bootfs_entry_t* bootfs_search(zx_handle_t log,
                                            struct bootfs *fs,
                                            const char* filename) {
@@ -51,6 +87,15 @@ static const bootfs_entry_t* bootfs_search(zx_handle_t log,
 
     size_t filename_len = strlen(filename) + 1;
 
+    if (hdr->index_count > 0) {
+        if ((hdr->dirsize % sizeof(uint32_t)) ||
+            (hdr->dirsize > fs->len - sizeof(bootfs_header_t)) ||
+            (hdr->index_count > (fs->len - sizeof(bootfs_header_t) -
+                                 hdr->dirsize) / sizeof(uint32_t)))
+            fail(log, "bootfs index is too big");
+        return bootfs_search_index(log, hdr, filename, filename_len);
+    }
+
     p += sizeof(bootfs_header_t);
     size_t avail = hdr->dirsize;
 
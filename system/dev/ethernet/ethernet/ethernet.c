@@ -23,6 +23,10 @@
 #define FIFO_ESIZE sizeof(eth_fifo_entry_t)
 #define DEVICE_NAME_LEN 16
 
+// Received frames are written back to the client once this many have
+// accumulated, even if the MAC says more are coming.
+#define RX_BATCH (FIFO_DEPTH / 4)
+
 // This is used for signaling that eth_tx_thread() should exit.
 static const zx_signals_t kSignalFifoTerminate = ZX_USER_SIGNAL_0;
 
@@ -45,6 +49,14 @@ typedef struct ethdev0 {
     ethmac_info_t info;
     uint32_t status;
     zx_device_t* zxdev;
+
+    // the one client running on a FEATURE_RX_QUEUE device. Set before
+    // the MAC is started and cleared after it is stopped, so complete_rx()
+    // can use it without the lock.
+    struct ethdev* rxq_client;
+
+    // transmit queue for the next instance opened
+    uint32_t next_tx_queue;
 } ethdev0_t;
 
 // transmit thread has been created
@@ -86,9 +98,28 @@ typedef struct ethdev {
     zx_handle_t io_vmo;
     void* io_buf;
     size_t io_size;
+    // physical address of each page of it, for FEATURE_RX_QUEUE. The
+    // buffer is locked into memory while we hold it, so these stay valid.
+    zx_paddr_t* io_phys;
+
+    // rx_lock guards the rx state below, and is taken after edev0->lock
+    mtx_t rx_lock;
+    // Free rx buffers read from rx_fifo ahead of need, as a ring. For a
+    // FEATURE_RX_QUEUE device, these are the ones queued to the MAC. They
+    // are given back to the client when it stops.
+    eth_fifo_entry_t rx_free[FIFO_DEPTH];
+    uint32_t rx_free_head;
+    uint32_t rx_free_count;
+    // received frames not yet written back to rx_fifo
+    eth_fifo_entry_t rx_done[FIFO_DEPTH];
+    uint32_t rx_done_count;
+    // MAC is started and may be handed buffers with queue_rx()
+    bool rx_queue_running;
 
     // fifo thread
     thrd_t tx_thr;
+    // the MAC transmit queue it sends on
+    uint32_t tx_queue;
 
     zx_device_t* zxdev;
 
@@ -99,24 +130,87 @@ typedef struct ethdev {
 
 #define FAIL_REPORT_RATE 50
 
-static void eth_handle_rx(ethdev_t* edev, const void* data, size_t len, uint32_t extra) {
-    eth_fifo_entry_t e;
+static void eth_rx_read_failed_locked(ethdev_t* edev, zx_status_t status) {
+    if (status == ZX_ERR_SHOULD_WAIT) {
+        if ((edev->fail_rx_read++ % FAIL_REPORT_RATE) == 0) {
+            dprintf(ERROR, "eth [%s]: no rx buffers available (%u times)\n",
+                   edev->name, edev->fail_rx_read);
+        }
+    } else {
+        // Fatal, should force teardown
+        dprintf(ERROR, "eth [%s]: rx fifo read failed %d\n", edev->name, status);
+    }
+}
+
+// Writes received frames back to the client in one go. Any that the
+// fifo has no room for are kept for the next flush.
+static void eth_rx_flush_locked(ethdev_t* edev) {
     zx_status_t status;
     uint32_t count;
 
-    // TODO: read multiple and cache locally to reduce syscalls
-    if ((status = zx_fifo_read(edev->rx_fifo, &e, sizeof(e), &count)) < 0) {
+    if (edev->rx_done_count == 0) {
+        return;
+    }
+    if ((status = zx_fifo_write(edev->rx_fifo, edev->rx_done,
+                                sizeof(eth_fifo_entry_t) * edev->rx_done_count, &count)) < 0) {
         if (status == ZX_ERR_SHOULD_WAIT) {
-            if ((edev->fail_rx_read++ % FAIL_REPORT_RATE) == 0) {
-                dprintf(ERROR, "eth [%s]: no rx buffers available (%u times)\n",
-                       edev->name, edev->fail_rx_read);
+            if ((edev->fail_rx_write++ % FAIL_REPORT_RATE) == 0) {
+                dprintf(ERROR, "eth [%s]: no rx_fifo space available (%u times)\n",
+                       edev->name, edev->fail_rx_write);
             }
         } else {
             // Fatal, should force teardown
-            dprintf(ERROR, "eth [%s]: rx fifo read failed %d\n", edev->name, status);
+            dprintf(ERROR, "eth [%s]: rx_fifo write failed %d\n", edev->name, status);
+            edev->rx_done_count = 0;
         }
         return;
     }
+    edev->rx_done_count -= count;
+    memmove(edev->rx_done, edev->rx_done + count, sizeof(eth_fifo_entry_t) * edev->rx_done_count);
+}
+
+// Queues a finished rx entry to be written back to the client, flushing
+// unless the MAC has said another frame follows this one.
+static void eth_rx_done_locked(ethdev_t* edev, const eth_fifo_entry_t* e, bool more) {
+    if (edev->rx_done_count == FIFO_DEPTH) {
+        eth_rx_flush_locked(edev);
+    }
+    if (edev->rx_done_count == FIFO_DEPTH) {
+        // the client isn't reading; the buffer is lost to it
+        return;
+    }
+    edev->rx_done[edev->rx_done_count++] = *e;
+    if (!more || (edev->rx_done_count >= RX_BATCH)) {
+        eth_rx_flush_locked(edev);
+    }
+}
+
+static void eth_handle_rx(ethdev_t* edev, const void* data, size_t len, uint32_t extra,
+                          bool more) {
+    zx_status_t status;
+
+    mtx_lock(&edev->rx_lock);
+
+    // Take as many free buffers as the client has queued, so most frames
+    // need no fifo read of their own.
+    if (edev->rx_free_count == 0) {
+        uint32_t count;
+        if ((status = zx_fifo_read(edev->rx_fifo, edev->rx_free,
+                                   sizeof(edev->rx_free), &count)) < 0) {
+            eth_rx_read_failed_locked(edev, status);
+            if (!more) {
+                eth_rx_flush_locked(edev);
+            }
+            mtx_unlock(&edev->rx_lock);
+            return;
+        }
+        edev->rx_free_head = 0;
+        edev->rx_free_count = count;
+    }
+
+    eth_fifo_entry_t e = edev->rx_free[edev->rx_free_head];
+    edev->rx_free_head = (edev->rx_free_head + 1) % FIFO_DEPTH;
+    edev->rx_free_count--;
 
     if ((e.offset >= edev->io_size) || ((e.length > (edev->io_size - e.offset)))) {
         // invalid offset/length. report error. drop packet
@@ -132,18 +226,97 @@ static void eth_handle_rx(ethdev_t* edev, const void* data, size_t len, uint32_t
         e.flags = ETH_FIFO_RX_OK | extra;
     }
 
-    if ((status = zx_fifo_write(edev->rx_fifo, &e, sizeof(e), &count)) < 0) {
-        if (status == ZX_ERR_SHOULD_WAIT) {
-            if ((edev->fail_rx_write++ % FAIL_REPORT_RATE) == 0) {
-                dprintf(ERROR, "eth [%s]: no rx_fifo space available (%u times)\n",
-                       edev->name, edev->fail_rx_write);
-            }
-        } else {
-            // Fatal, should force teardown
-            dprintf(ERROR, "eth [%s]: rx_fifo write failed %d\n", edev->name, status);
+    eth_rx_done_locked(edev, &e, more);
+    mtx_unlock(&edev->rx_lock);
+}
+
+// Finds where a client rx buffer is in physical memory.
+static zx_status_t eth_rx_phys(ethdev_t* edev, const eth_fifo_entry_t* e,
+                               uintptr_t* pa0, uintptr_t* pa1) {
+    if ((e->length == 0) || (e->offset >= edev->io_size) ||
+        (e->length > (edev->io_size - e->offset))) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    size_t first = e->offset / PAGE_SIZE;
+    size_t last = (e->offset + e->length - 1) / PAGE_SIZE;
+    if (last - first > 1) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    *pa0 = edev->io_phys[first] + (e->offset % PAGE_SIZE);
+    *pa1 = (last != first) ? edev->io_phys[last] : 0;
+    return ZX_OK;
+}
+
+// Hands a FEATURE_RX_QUEUE MAC the free buffers the client has queued
+// since the last call, as many as the ring has room for.
+static void eth_rx_queue_fill_locked(ethdev_t* edev) {
+    ethdev0_t* edev0 = edev->edev0;
+    eth_fifo_entry_t entries[FIFO_DEPTH];
+    zx_status_t status;
+    uint32_t count;
+
+    uint32_t space = FIFO_DEPTH - edev->rx_free_count;
+    if (!edev->rx_queue_running || (space == 0)) {
+        return;
+    }
+    if ((status = zx_fifo_read(edev->rx_fifo, entries,
+                               sizeof(eth_fifo_entry_t) * space, &count)) < 0) {
+        if (status != ZX_ERR_SHOULD_WAIT) {
+            eth_rx_read_failed_locked(edev, status);
         }
         return;
     }
+
+    bool invalid = false;
+    for (uint32_t n = 0; n < count; n++) {
+        eth_fifo_entry_t* e = &entries[n];
+        uintptr_t pa0, pa1;
+        if (eth_rx_phys(edev, e, &pa0, &pa1) != ZX_OK) {
+            e->length = 0;
+            e->flags = ETH_FIFO_INVALID;
+            eth_rx_done_locked(edev, e, true);
+            invalid = true;
+            continue;
+        }
+        uint32_t tail = (edev->rx_free_head + edev->rx_free_count) % FIFO_DEPTH;
+        edev->rx_free[tail] = *e;
+        edev->rx_free_count++;
+        edev0->mac.ops->queue_rx(edev0->mac.ctx, 0, pa0, pa1, e->length);
+    }
+    if (invalid) {
+        eth_rx_flush_locked(edev);
+    }
+}
+
+// Starts handing buffers to a FEATURE_RX_QUEUE MAC that has just been
+// started. Any it had before were given back when it was stopped.
+static void eth_rx_queue_start(ethdev_t* edev) {
+    mtx_lock(&edev->rx_lock);
+    edev->rx_queue_running = true;
+    eth_rx_queue_fill_locked(edev);
+    mtx_unlock(&edev->rx_lock);
+}
+
+static void eth_rx_queue_stop(ethdev_t* edev) {
+    mtx_lock(&edev->rx_lock);
+    edev->rx_queue_running = false;
+    mtx_unlock(&edev->rx_lock);
+}
+
+// Hands the client back, unused, the free rx buffers read ahead of need,
+// along with any received frames not yet written back. Only called once
+// the instance is off the active list, so no more frames arrive for it.
+static void eth_rx_return_free(ethdev_t* edev) {
+    mtx_lock(&edev->rx_lock);
+    for (; edev->rx_free_count > 0; edev->rx_free_count--) {
+        eth_fifo_entry_t e = edev->rx_free[edev->rx_free_head];
+        edev->rx_free_head = (edev->rx_free_head + 1) % FIFO_DEPTH;
+        e.length = 0;
+        e.flags = 0;
+        eth_rx_done_locked(edev, &e, true);
+    }
+    eth_rx_flush_locked(edev);
+    mtx_unlock(&edev->rx_lock);
 }
 
 static void eth0_status(void* cookie, uint32_t status) {
@@ -164,18 +337,57 @@ static void eth0_status(void* cookie, uint32_t status) {
 // can deadlock with the ethermac device
 static void eth0_recv(void* cookie, void* data, size_t len, uint32_t flags) {
     ethdev0_t* edev0 = cookie;
+    bool more = flags & ETHMAC_RX_OPT_MORE;
+    uint32_t extra = (flags & ETHMAC_RX_CSUM_OK) ? ETH_FIFO_RX_CSUM_OK : 0;
 
     ethdev_t* edev;
     mtx_lock(&edev0->lock);
     list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
-        eth_handle_rx(edev, data, len, 0);
+        eth_handle_rx(edev, data, len, extra, more);
     }
     mtx_unlock(&edev0->lock);
 }
 
+// The MAC has received a frame into the oldest buffer it was given.
+static void eth0_complete_rx(void* cookie, uint32_t length, uint32_t flags) {
+    ethdev0_t* edev0 = cookie;
+    ethdev_t* edev = edev0->rxq_client;
+    if (edev == NULL) {
+        return;
+    }
+
+    mtx_lock(&edev->rx_lock);
+    if (edev->rx_free_count == 0) {
+        dprintf(ERROR, "eth [%s]: complete_rx without a queued buffer\n", edev->name);
+        mtx_unlock(&edev->rx_lock);
+        return;
+    }
+    eth_fifo_entry_t e = edev->rx_free[edev->rx_free_head];
+    edev->rx_free_head = (edev->rx_free_head + 1) % FIFO_DEPTH;
+    edev->rx_free_count--;
+
+    if (length > e.length) {
+        e.length = 0;
+        e.flags = ETH_FIFO_INVALID;
+    } else {
+        e.length = length;
+        e.flags = ETH_FIFO_RX_OK;
+        if (flags & ETHMAC_RX_CSUM_OK) {
+            e.flags |= ETH_FIFO_RX_CSUM_OK;
+        }
+    }
+    eth_rx_done_locked(edev, &e, flags & ETHMAC_RX_OPT_MORE);
+
+    // Replace the buffer right away while frames are arriving; the tx
+    // thread picks up ones the client returns when the link is quiet.
+    eth_rx_queue_fill_locked(edev);
+    mtx_unlock(&edev->rx_lock);
+}
+
 static ethmac_ifc_t ethmac_ifc = {
     .status = eth0_status,
     .recv = eth0_recv,
+    .complete_rx = eth0_complete_rx,
 };
 
 static void eth_tx_echo(ethdev0_t* edev0, const void* data, size_t len) {
@@ -183,7 +395,7 @@ static void eth_tx_echo(ethdev0_t* edev0, const void* data, size_t len) {
     mtx_lock(&edev0->lock);
     list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
         if (edev->state & ETHDEV_TX_LISTEN) {
-            eth_handle_rx(edev, data, len, ETH_FIFO_RX_TX);
+            eth_handle_rx(edev, data, len, ETH_FIFO_RX_TX, false);
         }
     }
     mtx_unlock(&edev0->lock);
@@ -192,6 +404,11 @@ static void eth_tx_echo(ethdev0_t* edev0, const void* data, size_t len) {
 static zx_status_t eth_tx_listen_locked(ethdev_t* edev, bool yes) {
     ethdev0_t* edev0 = edev->edev0;
 
+    // all of a FEATURE_RX_QUEUE client's buffers belong to the MAC
+    if (yes && (edev0->info.features & ETHMAC_FEATURE_RX_QUEUE)) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     // update our state
     if (yes) {
         edev->state |= ETHDEV_TX_LISTEN;
@@ -219,27 +436,39 @@ static zx_status_t eth_tx_listen_locked(ethdev_t* edev, bool yes) {
     return ZX_OK;
 }
 
+// Besides transmitting, this thread hands a FEATURE_RX_QUEUE MAC the rx
+// buffers the client returns while no frames are arriving.
 static int eth_tx_thread(void* arg) {
     ethdev_t* edev = (ethdev_t*)arg;
     ethdev0_t* edev0 = edev->edev0;
+    bool rx_queue = edev0->info.features & ETHMAC_FEATURE_RX_QUEUE;
     eth_fifo_entry_t entries[FIFO_DEPTH / 2];
     zx_status_t status;
     uint32_t count;
 
     for (;;) {
+        bool rx_wait = false;
+        if (rx_queue) {
+            mtx_lock(&edev->rx_lock);
+            eth_rx_queue_fill_locked(edev);
+            // only wait for buffers there is room to queue
+            rx_wait = edev->rx_queue_running && (edev->rx_free_count < FIFO_DEPTH);
+            mtx_unlock(&edev->rx_lock);
+        }
+
         if ((status = zx_fifo_read(edev->tx_fifo, entries, sizeof(entries), &count)) < 0) {
             if (status == ZX_ERR_SHOULD_WAIT) {
-                zx_signals_t observed;
-                if ((status = zx_object_wait_one(edev->tx_fifo,
-                                                 ZX_FIFO_READABLE |
-                                                 ZX_FIFO_PEER_CLOSED |
-                                                 kSignalFifoTerminate,
-                                                 ZX_TIME_INFINITE,
-                                                 &observed)) < 0) {
+                zx_wait_item_t items[2] = {
+                    { .handle = edev->tx_fifo,
+                      .waitfor = ZX_FIFO_READABLE | ZX_FIFO_PEER_CLOSED | kSignalFifoTerminate },
+                    { .handle = edev->rx_fifo, .waitfor = ZX_FIFO_READABLE },
+                };
+                if ((status = zx_object_wait_many(items, rx_wait ? 2 : 1,
+                                                  ZX_TIME_INFINITE)) < 0) {
                     dprintf(ERROR, "eth [%s]: tx_fifo: error waiting: %d\n", edev->name, status);
                     break;
                 }
-                if (observed & kSignalFifoTerminate)
+                if (items[0].pending & kSignalFifoTerminate)
                     break;
                 continue;
             } else {
@@ -248,24 +477,47 @@ static int eth_tx_thread(void* arg) {
             }
         }
 
-        uint32_t n = count;
-        for (eth_fifo_entry_t* e = entries; count > 0; e++) {
-            if ((e->offset > edev->io_size) || ((e->length > (edev->io_size - e->offset)))) {
+        // Check the entries, and send the good ones as one batch.
+        ethmac_tx_buf_t bufs[FIFO_DEPTH / 2];
+        size_t nbufs = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            eth_fifo_entry_t* e = &entries[i];
+            uint32_t opt = 0;
+            if (e->flags & ETH_FIFO_TX_CSUM) {
+                opt |= ETHMAC_TX_OPT_CSUM;
+            }
+            if ((e->offset > edev->io_size) || ((e->length > (edev->io_size - e->offset))) ||
+                ((opt & ETHMAC_TX_OPT_CSUM) && !(edev0->info.features & ETHMAC_FEATURE_TX_CSUM))) {
                 e->flags = ETH_FIFO_INVALID;
             } else {
-                uint32_t opt = count > 1 ? ETHMAC_TX_OPT_MORE : 0u;
-                if (opt) {
-                    dprintf(SPEW, "setting OPT_MORE (%u packets to go)\n", count);
-                }
-                edev0->mac.ops->send(edev0->mac.ctx, opt, edev->io_buf + e->offset, e->length);
+                bufs[nbufs].data = edev->io_buf + e->offset;
+                bufs[nbufs].length = e->length;
+                bufs[nbufs].options = opt;
+                nbufs++;
                 e->flags = ETH_FIFO_TX_OK;
-                if (edev->state & ETHDEV_TX_LOOPBACK) {
-                    eth_tx_echo(edev0, edev->io_buf + e->offset, e->length);
+            }
+        }
+        if (edev0->mac.ops->send_batch != NULL) {
+            if (nbufs > 0) {
+                edev0->mac.ops->send_batch(edev0->mac.ctx, edev->tx_queue, bufs, nbufs);
+            }
+        } else {
+            for (size_t i = 0; i < nbufs; i++) {
+                uint32_t opt = bufs[i].options;
+                if (i + 1 < nbufs) {
+                    dprintf(SPEW, "setting OPT_MORE (%zu packets to go)\n", nbufs - i);
+                    opt |= ETHMAC_TX_OPT_MORE;
                 }
+                edev0->mac.ops->send(edev0->mac.ctx, opt, bufs[i].data, bufs[i].length);
+            }
+        }
+        if (edev->state & ETHDEV_TX_LOOPBACK) {
+            for (size_t i = 0; i < nbufs; i++) {
+                eth_tx_echo(edev0, bufs[i].data, bufs[i].length);
             }
-            count--;
         }
 
+        uint32_t n = count;
         if ((status = zx_fifo_write(edev->tx_fifo, entries, sizeof(eth_fifo_entry_t) * n, &count)) < 0) {
             if (status == ZX_ERR_SHOULD_WAIT) {
                 if ((edev->fail_tx_write++ % FAIL_REPORT_RATE) == 0) {
@@ -344,11 +596,37 @@ static ssize_t eth_set_iobuf_locked(ethdev_t* edev, const void* in_buf, size_t i
         goto fail;
     }
 
+    if (edev->edev0->info.features & ETHMAC_FEATURE_RX_QUEUE) {
+        // The MAC receives straight into the buffer, so it has to stay in
+        // memory, where it is, until we let go of it in eth_kill_locked().
+        size_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+        if ((edev->io_phys = malloc(pages * sizeof(zx_paddr_t))) == NULL) {
+            status = ZX_ERR_NO_MEMORY;
+            goto fail_unmap;
+        }
+        if ((status = zx_vmo_op_range(vmo, ZX_VMO_OP_LOCK, 0, size, NULL, 0)) < 0) {
+            dprintf(ERROR, "eth [%s]: could not lock io_buf: %d\n", edev->name, status);
+            goto fail_free;
+        }
+        if ((status = zx_vmo_op_range(vmo, ZX_VMO_OP_LOOKUP, 0, size, edev->io_phys,
+                                      pages * sizeof(zx_paddr_t))) < 0) {
+            dprintf(ERROR, "eth [%s]: could not look up io_buf: %d\n", edev->name, status);
+            zx_vmo_op_range(vmo, ZX_VMO_OP_UNLOCK, 0, size, NULL, 0);
+            goto fail_free;
+        }
+    }
+
     edev->io_vmo = vmo;
     edev->io_size = size;
 
     return ZX_OK;
 
+fail_free:
+    free(edev->io_phys);
+    edev->io_phys = NULL;
+fail_unmap:
+    zx_vmar_unmap(zx_vmar_root_self(), (uintptr_t)edev->io_buf, 0);
+    edev->io_buf = NULL;
 fail:
     zx_handle_close(vmo);
     return status;
@@ -368,6 +646,12 @@ static zx_status_t eth_start_locked(ethdev_t* edev) {
         return ZX_OK;
     }
 
+    bool rx_queue = edev0->info.features & ETHMAC_FEATURE_RX_QUEUE;
+    if (rx_queue && !list_is_empty(&edev0->list_active)) {
+        // the MAC can only receive into one client's buffers
+        return ZX_ERR_ALREADY_BOUND;
+    }
+
     if (!(edev->state & ETHDEV_TX_THREAD)) {
         int r = thrd_create_with_name(&edev->tx_thr, eth_tx_thread,
                                       edev, "eth-tx-thread");
@@ -383,6 +667,9 @@ static zx_status_t eth_start_locked(ethdev_t* edev) {
         // Release the lock to allow other device operations in callback routine.
         // Re-acquire lock afterwards. Set busy to prevent problems with other ioctls.
         edev0->state |= ETHDEV0_BUSY;
+        if (rx_queue) {
+            edev0->rxq_client = edev;
+        }
         mtx_unlock(&edev0->lock);
         status = edev0->mac.ops->start(edev0->mac.ctx, &ethmac_ifc, edev0);
         mtx_lock(&edev0->lock);
@@ -395,7 +682,11 @@ static zx_status_t eth_start_locked(ethdev_t* edev) {
         edev->state |= ETHDEV_RUNNING;
         list_delete(&edev->node);
         list_add_tail(&edev0->list_active, &edev->node);
+        if (rx_queue) {
+            eth_rx_queue_start(edev);
+        }
     } else {
+        edev0->rxq_client = NULL;
         dprintf(ERROR, "eth [%s]: failed to start mac: %d\n", edev->name, status);
     }
 
@@ -411,6 +702,9 @@ static zx_status_t eth_stop_locked(ethdev_t* edev) {
         list_add_tail(&edev0->list_idle, &edev->node);
         if (list_is_empty(&edev0->list_active)) {
             if (!(edev->state & ETHDEV_DEAD)) {
+                if (edev0->info.features & ETHMAC_FEATURE_RX_QUEUE) {
+                    eth_rx_queue_stop(edev);
+                }
                 // Release the lock to allow other device operations in callback routine.
                 // Re-acquire lock afterwards. Set busy to prevent problems with other ioctls.
                 edev0->state |= ETHDEV0_BUSY;
@@ -418,8 +712,10 @@ static zx_status_t eth_stop_locked(ethdev_t* edev) {
                 edev0->mac.ops->stop(edev0->mac.ctx);
                 mtx_lock(&edev0->lock);
                 edev0->state &= ~ETHDEV0_BUSY;
+                edev0->rxq_client = NULL;
             }
         }
+        eth_rx_return_free(edev);
     }
 
     return ZX_OK;
@@ -485,6 +781,9 @@ static zx_status_t eth_ioctl(void* ctx, uint32_t op,
             if (edev->edev0->info.features & ETHMAC_FEATURE_SYNTH) {
                 info->features |= ETH_FEATURE_SYNTH;
             }
+            if (edev->edev0->info.features & ETHMAC_FEATURE_TX_CSUM) {
+                info->features |= ETH_FEATURE_TX_CSUM;
+            }
             info->mtu = edev->edev0->info.mtu;
             *out_actual = sizeof(*info);
             status = ZX_OK;
@@ -540,16 +839,26 @@ static void eth_kill_locked(ethdev_t* edev) {
     // make sure any future ioctls or other ops will fail
     edev->state |= ETHDEV_DEAD;
 
+    if (edev->tx_fifo) {
+        // Ask the TX thread to exit.
+        zx_object_signal(edev->tx_fifo, 0, kSignalFifoTerminate);
+    }
     // try to convince clients to close us
     if (edev->rx_fifo) {
+        mtx_lock(&edev->rx_lock);
         zx_handle_close(edev->rx_fifo);
         edev->rx_fifo = ZX_HANDLE_INVALID;
-    }
-    if (edev->tx_fifo) {
-        // Ask the TX thread to exit.
-        zx_object_signal(edev->tx_fifo, 0, kSignalFifoTerminate);
+        // the client can't have these back now
+        edev->rx_free_count = 0;
+        edev->rx_done_count = 0;
+        edev->rx_queue_running = false;
+        mtx_unlock(&edev->rx_lock);
     }
     if (edev->io_vmo) {
+        if (edev->io_phys != NULL) {
+            // The MAC was stopped before we got here.
+            zx_vmo_op_range(edev->io_vmo, ZX_VMO_OP_UNLOCK, 0, edev->io_size, NULL, 0);
+        }
         zx_handle_close(edev->io_vmo);
         edev->io_vmo = ZX_HANDLE_INVALID;
     }
@@ -570,6 +879,8 @@ static void eth_kill_locked(ethdev_t* edev) {
         zx_vmar_unmap(zx_vmar_root_self(), (uintptr_t)edev->io_buf, 0);
         edev->io_buf = NULL;
     }
+    free(edev->io_phys);
+    edev->io_phys = NULL;
     dprintf(TRACE, "eth [%s]: all resources released\n", edev->name);
 }
 
@@ -605,6 +916,7 @@ static zx_status_t eth0_open(void* ctx, zx_device_t** out, uint32_t flags) {
         return ZX_ERR_NO_MEMORY;
     }
     edev->edev0 = edev0;
+    mtx_init(&edev->rx_lock, mtx_plain);
 
     device_add_args_t args = {
         .version = DEVICE_ADD_ARGS_VERSION,
@@ -622,6 +934,8 @@ static zx_status_t eth0_open(void* ctx, zx_device_t** out, uint32_t flags) {
     }
 
     mtx_lock(&edev0->lock);
+    // spread clients over the MAC's transmit queues
+    edev->tx_queue = edev0->next_tx_queue++ % edev0->info.tx_queues;
     list_add_tail(&edev0->list_idle, &edev->node);
     mtx_unlock(&edev0->lock);
 
@@ -634,12 +948,15 @@ static void eth0_unbind(void* ctx) {
 
     mtx_lock(&edev0->lock);
 
-    // tear down shared memory, fifos, and threads
-    // to encourage any open instances to close
+    // Stop the MAC before the buffers it receives into go away. This
+    // moves every instance to the idle list.
     ethdev_t* edev;
-    list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
-        eth_kill_locked(edev);
+    while ((edev = list_peek_head_type(&edev0->list_active, ethdev_t, node)) != NULL) {
+        eth_stop_locked(edev);
     }
+
+    // tear down shared memory, fifos, and threads
+    // to encourage any open instances to close
     list_for_every_entry(&edev0->list_idle, edev, ethdev_t, node) {
         eth_kill_locked(edev);
     }
@@ -661,7 +978,7 @@ static zx_protocol_device_t ethdev0_ops = {
     .release = eth0_release,
 };
 
-#define BAD_FEATURES (ETHMAC_FEATURE_RX_QUEUE | ETHMAC_FEATURE_TX_QUEUE)
+#define BAD_FEATURES (ETHMAC_FEATURE_TX_QUEUE)
 
 static zx_status_t eth_bind(void* ctx, zx_device_t* dev, void** cookie) {
     ethdev0_t* edev0;
@@ -687,6 +1004,9 @@ static zx_status_t eth_bind(void* ctx, zx_device_t* dev, void** cookie) {
         status = ZX_ERR_NOT_SUPPORTED;
         goto fail;
     }
+    if (edev0->info.tx_queues == 0 || edev0->mac.ops->send_batch == NULL) {
+        edev0->info.tx_queues = 1;
+    }
 
     mtx_init(&edev0->lock, mtx_plain);
     list_initialize(&edev0->list_active);
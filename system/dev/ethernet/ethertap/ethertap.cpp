@@ -8,6 +8,7 @@
 #include <zircon/compiler.h>
 #include <fbl/auto_lock.h>
 #include <fbl/type_support.h>
+#include <inet-checksum/checksum.h>
 #include <pretty/hexdump.h>
 
 #include <stdio.h>
@@ -20,6 +21,10 @@
 
 namespace eth {
 
+// Most frames passed up in a row with ETHMAC_RX_OPT_MORE before checking
+// for link changes and shutdown.
+constexpr uint32_t kMaxRecvBatch = 64;
+
 TapCtl::TapCtl(zx_device_t* device) : ddk::Device<TapCtl, ddk::Ioctlable>(device) {}
 
 void TapCtl::DdkRelease() {
@@ -77,7 +82,7 @@ int tap_device_thread(void* arg) {
 TapDevice::TapDevice(zx_device_t* device, const ethertap_ioctl_config* config, zx::socket data)
   : ddk::Device<TapDevice, ddk::Unbindable>(device),
     options_(config->options),
-    features_(config->features | ETHMAC_FEATURE_SYNTH),
+    features_(config->features | ETHMAC_FEATURE_SYNTH | ETHMAC_FEATURE_TX_CSUM),
     mtu_(config->mtu),
     data_(fbl::move(data)) {
     ZX_DEBUG_ASSERT(data_.is_valid());
@@ -107,6 +112,7 @@ zx_status_t TapDevice::EthmacQuery(uint32_t options, ethmac_info_t* info) {
     info->features = features_;
     info->mtu = mtu_;
     memcpy(info->mac, mac_, 6);
+    info->tx_queues = kTxQueues;
     return ZX_OK;
 }
 
@@ -129,10 +135,50 @@ zx_status_t TapDevice::EthmacStart(fbl::unique_ptr<ddk::EthmacIfcProxy> proxy) {
 }
 
 void TapDevice::EthmacSend(uint32_t options, void* data, size_t length) {
+    TxQueue* queue = &tx_queues_[0];
+    fbl::AutoLock lock(&queue->lock);
+    Send(queue, options, data, length);
+}
+
+void TapDevice::EthmacSendBatch(uint32_t queue_index, ethmac_tx_buf_t* bufs, size_t count) {
+    ZX_DEBUG_ASSERT(queue_index < kTxQueues);
+    TxQueue* queue = &tx_queues_[queue_index];
+    fbl::AutoLock lock(&queue->lock);
+    for (size_t i = 0; i < count; i++) {
+        Send(queue, bufs[i].options, bufs[i].data, bufs[i].length);
+    }
+}
+
+// Fills in the checksum that ETHMAC_TX_OPT_CSUM asks for, as hardware would: the ones' complement
+// sum from the start of the transport header, whose checksum field holds the pseudo-header sum.
+static void FillChecksum(uint8_t* frame, size_t length) {
+    size_t start, field;
+    if (ethmac_csum_offsets(frame, length, &start, &field) != ZX_OK) {
+        return;
+    }
+    // The client left the pseudo-header sum in the checksum field.
+    uint16_t csum = inet_checksum(frame + start, length - start, 0);
+    if (csum == 0 && field - start == 6) {
+        // a zero UDP checksum means there is none
+        csum = 0xffff;
+    }
+    memcpy(frame + field, &csum, sizeof(csum));
+}
+
+void TapDevice::Send(TxQueue* queue, uint32_t options, void* data, size_t length) {
     ZX_DEBUG_ASSERT(length <= mtu_);
+    if (options & ETHMAC_TX_OPT_CSUM) {
+        // The frame belongs to the client, so fill the checksum in on a copy.
+        if (queue->buf == nullptr) {
+            queue->buf.reset(new uint8_t[mtu_]);
+        }
+        memcpy(queue->buf.get(), data, length);
+        data = queue->buf.get();
+        FillChecksum(queue->buf.get(), length);
+    }
     if (unlikely(options_ & ETHERTAP_OPT_TRACE_PACKETS)) {
         fbl::AutoLock lock(&lock_);
-        ethertap_trace("sending %zu bytes\n", length);
+        ethertap_trace("sending %zu bytes on queue %td\n", length, queue - tx_queues_);
         hexdump8_ex(data, length, 0);
     }
     zx_status_t status = data_.write(0u, data, length, nullptr);
@@ -144,7 +190,8 @@ void TapDevice::EthmacSend(uint32_t options, void* data, size_t length) {
 int TapDevice::Thread() {
     ethertap_trace("starting main thread\n");
     zx_signals_t pending;
-    fbl::unique_ptr<uint8_t[]> buf(new uint8_t[mtu_]);
+    // room for two frames; see Recv()
+    fbl::unique_ptr<uint8_t[]> buf(new uint8_t[2 * mtu_]);
 
     zx_status_t status = ZX_OK;
     const zx_signals_t wait = ZX_SOCKET_READABLE | ZX_SOCKET_PEER_CLOSED | ETHERTAP_SIGNAL_ONLINE
@@ -232,22 +279,47 @@ zx_status_t TapDevice::UpdateLinkStatus(zx_signals_t observed) {
 }
 
 zx_status_t TapDevice::Recv(uint8_t* buffer, uint32_t capacity) {
-    size_t actual = 0;
-    zx_status_t status = data_.read(0u, buffer, capacity, &actual);
+    // Each frame is passed up only once the next has been read into the
+    // other half of |buffer|, so the ethernet core can be told whether
+    // more follow and hand them to its clients together.
+    uint8_t* frames[2] = { buffer, buffer + capacity };
+    size_t actual[2] = {};
+    zx_status_t status = data_.read(0u, frames[0], capacity, &actual[0]);
     if (status != ZX_OK) {
         dprintf(ERROR, "ethertap: error reading data: %d\n", status);
         return status;
     }
 
+    for (uint32_t n = 0; ; n++) {
+        uint32_t cur = n % 2;
+        uint32_t next = (n + 1) % 2;
+        bool more = false;
+        if (n + 1 < kMaxRecvBatch) {
+            status = data_.read(0u, frames[next], capacity, &actual[next]);
+            if (status == ZX_OK) {
+                more = true;
+            } else if (status != ZX_ERR_SHOULD_WAIT) {
+                dprintf(ERROR, "ethertap: error reading data: %d\n", status);
+                Deliver(frames[cur], actual[cur], false);
+                return status;
+            }
+        }
+        Deliver(frames[cur], actual[cur], more);
+        if (!more) {
+            return ZX_OK;
+        }
+    }
+}
+
+void TapDevice::Deliver(uint8_t* frame, size_t length, bool more) {
     fbl::AutoLock lock(&lock_);
     if (unlikely(options_ & ETHERTAP_OPT_TRACE_PACKETS)) {
-        ethertap_trace("received %zu bytes\n", actual);
-        hexdump8_ex(buffer, actual, 0);
+        ethertap_trace("received %zu bytes\n", length);
+        hexdump8_ex(frame, length, 0);
     }
     if (ethmac_proxy_ != nullptr) {
-        ethmac_proxy_->Recv(buffer, actual, 0u);
+        ethmac_proxy_->Recv(frame, length, more ? ETHMAC_RX_OPT_MORE : 0u);
     }
-    return ZX_OK;
 }
 
 }  // namespace eth
@@ -40,12 +40,25 @@ class TapDevice : public ddk::Device<TapDevice, ddk::Unbindable>,
     void EthmacStop();
     zx_status_t EthmacStart(fbl::unique_ptr<ddk::EthmacIfcProxy> proxy);
     void EthmacSend(uint32_t options, void* data, size_t length);
+    void EthmacSendBatch(uint32_t queue, ethmac_tx_buf_t* bufs, size_t count);
 
     int Thread();
 
+    // Transmit queues reported to the ethernet core.
+    static constexpr uint32_t kTxQueues = 4;
+
   private:
     zx_status_t UpdateLinkStatus(zx_signals_t observed);
     zx_status_t Recv(uint8_t* buffer, uint32_t capacity);
+    void Deliver(uint8_t* frame, size_t length, bool more);
+
+    // Each transmit queue has its own scratch buffer for checksum offload,
+    // so clients on different queues don't contend.
+    struct TxQueue {
+        fbl::Mutex lock;
+        fbl::unique_ptr<uint8_t[]> buf __TA_GUARDED(lock);
+    };
+    void Send(TxQueue* queue, uint32_t options, void* data, size_t length) __TA_REQUIRES(queue->lock);
 
     // ethertap options
     uint32_t options_ = 0;
@@ -58,6 +71,8 @@ class TapDevice : public ddk::Device<TapDevice, ddk::Unbindable>,
     fbl::Mutex lock_;
     fbl::unique_ptr<ddk::EthmacIfcProxy> ethmac_proxy_ __TA_GUARDED(lock_);
 
+    TxQueue tx_queues_[kTxQueues];
+
     // Only accessed from Thread, so not locked.
     bool online_ = false;
     zx::socket data_;
@@ -18,6 +18,7 @@ MODULE_STATIC_LIBS := \
     system/ulib/zx \
     system/ulib/zxcpp \
     system/ulib/fbl \
+    system/ulib/inet-checksum \
     system/ulib/pretty \
 
 MODULE_LIBS := \
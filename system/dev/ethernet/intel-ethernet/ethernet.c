@@ -59,7 +59,11 @@ static int irq_thread(void* arg) {
 
             while (eth_rx(&edev->eth, &data, &len) == ZX_OK) {
                 if (edev->ifc) {
-                    edev->ifc->recv(edev->cookie, data, len, 0);
+                    uint32_t flags = eth_rx_more(&edev->eth) ? ETHMAC_RX_OPT_MORE : 0u;
+                    if (eth_rx_csum_ok(&edev->eth)) {
+                        flags |= ETHMAC_RX_CSUM_OK;
+                    }
+                    edev->ifc->recv(edev->cookie, data, len, flags);
                 }
                 eth_rx_ack(&edev->eth);
             }
@@ -91,7 +95,9 @@ static zx_status_t eth_query(void* ctx, uint32_t options, ethmac_info_t* info) {
     }
 
     memset(info, 0, sizeof(*info));
+    info->features = ETHMAC_FEATURE_TX_CSUM;
     info->mtu = ETH_RXBUF_SIZE; //TODO: not actually the mtu!
+    info->tx_queues = 1;
     memcpy(info->mac, edev->eth.mac, sizeof(edev->eth.mac));
 
     return ZX_OK;
@@ -123,7 +129,23 @@ static zx_status_t eth_start(void* ctx, ethmac_ifc_t* ifc, void* cookie) {
 
 static void eth_send(void* ctx, uint32_t options, void* data, size_t length) {
     ethernet_device_t* edev = ctx;
-    eth_tx(&edev->eth, data, length);
+    size_t start = 0, field = 0;
+    if ((options & ETHMAC_TX_OPT_CSUM) &&
+        (ethmac_csum_offsets(data, length, &start, &field) != ZX_OK)) {
+        // leave the checksum to the receiver
+        field = 0;
+    }
+    eth_tx(&edev->eth, data, length, start, field, options & ETHMAC_TX_OPT_MORE);
+}
+
+static void eth_send_batch(void* ctx, uint32_t queue, ethmac_tx_buf_t* bufs, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t options = bufs[i].options;
+        if (i + 1 < count) {
+            options |= ETHMAC_TX_OPT_MORE;
+        }
+        eth_send(ctx, options, bufs[i].data, bufs[i].length);
+    }
 }
 
 static ethmac_protocol_ops_t ethmac_ops = {
@@ -131,6 +153,7 @@ static ethmac_protocol_ops_t ethmac_ops = {
     .stop = eth_stop,
     .start = eth_start,
     .send = eth_send,
+    .send_batch = eth_send_batch,
 };
 
 static void eth_release(void* ctx) {
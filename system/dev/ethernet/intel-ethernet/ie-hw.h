@@ -103,6 +103,9 @@
 #define IE_RCTL_BSEX      (1 << 25) // Buffer Size Extension (x16)
 #define IE_RCTL_SECRC     (1 << 26) // Strip CRC Field
 
+#define IE_RXCSUM_IPOFL   (1 << 8) // IP Checksum Offload Enable
+#define IE_RXCSUM_TUOFL   (1 << 9) // TCP/UDP Checksum Offload Enable
+
 #define IE_TCTL_RST       (1 << 0) // TX Reset?
 #define IE_TCTL_EN        (1 << 1) // TX Enable
 #define IE_TCTL_PSP       (1 << 3) // Pad Short Packets (to 64b)
@@ -66,6 +66,16 @@ status_t eth_rx(ethdev_t* eth, void** data, size_t* len) {
     return ZX_OK;
 }
 
+bool eth_rx_more(ethdev_t* eth) {
+    uint32_t n = (eth->rx_rd_ptr + 1) & (ETH_RXBUF_COUNT - 1);
+    return eth->rxd[n].info & IE_RXD_DONE;
+}
+
+bool eth_rx_csum_ok(ethdev_t* eth) {
+    uint64_t info = eth->rxd[eth->rx_rd_ptr].info;
+    return (info & (IE_RXD_IXSM | IE_RXD_TCPCS | IE_RXD_TCPE)) == IE_RXD_TCPCS;
+}
+
 void eth_rx_ack(ethdev_t* eth) {
     uint32_t n = eth->rx_rd_ptr;
 
@@ -76,15 +86,17 @@ void eth_rx_ack(ethdev_t* eth) {
     eth->rx_rd_ptr = n;
 }
 
-status_t eth_tx(ethdev_t* eth, const void* data, size_t len) {
-    if ((len < 60) || (len > ETH_TXBUF_DSIZE)) {
-        return ZX_ERR_INVALID_ARGS;
-    }
-
+status_t eth_tx(ethdev_t* eth, const void* data, size_t len,
+               size_t csum_start, size_t csum_field, bool more) {
     zx_status_t status = ZX_OK;
 
     mtx_lock(&eth->send_lock);
 
+    if ((len < 60) || (len > ETH_TXBUF_DSIZE) || (csum_field > 0xff) || (csum_start > 0xff)) {
+        status = ZX_ERR_INVALID_ARGS;
+        goto out;
+    }
+
     // reclaim completed buffers from hw
     uint32_t n = eth->tx_rd_ptr;
     for (;;) {
@@ -113,15 +125,21 @@ status_t eth_tx(ethdev_t* eth, const void* data, size_t len) {
     n = eth->tx_wr_ptr;
     memcpy(frame->data, data, len);
     eth->txd[n].addr = frame->phys;
-    eth->txd[n].info = IE_TXD_LEN(len) | IE_TXD_EOP | IE_TXD_IFCS | IE_TXD_RS;
+    uint64_t info = IE_TXD_LEN(len) | IE_TXD_EOP | IE_TXD_IFCS | IE_TXD_RS;
+    if (csum_field) {
+        info |= IE_TXD_IC | IE_TXD_CSS(csum_start) | IE_TXD_CSO(csum_field);
+    }
+    eth->txd[n].info = info;
     list_add_tail(&eth->busy_frames, &frame->node);
-
-    // inform hw of buffer availability
-    n = (n + 1) & (ETH_TXBUF_COUNT - 1);
-    eth->tx_wr_ptr = n;
-    writel(n, IE_TDT);
+    eth->tx_wr_ptr = (n + 1) & (ETH_TXBUF_COUNT - 1);
 
 out:
+    // inform hw of buffer availability, once for a run of frames unless
+    // it has to free some up for the rest of the run
+    if ((!more || list_is_empty(&eth->free_frames)) && (eth->tx_wr_ptr != eth->tx_tail)) {
+        eth->tx_tail = eth->tx_wr_ptr;
+        writel(eth->tx_tail, IE_TDT);
+    }
     mtx_unlock(&eth->send_lock);
     return status;
 }
@@ -157,7 +175,7 @@ void eth_init_hw(ethdev_t* eth) {
 
     // setup rx ring
     eth->rx_rd_ptr = 0;
-    writel(0, IE_RXCSUM);
+    writel(IE_RXCSUM_IPOFL | IE_RXCSUM_TUOFL, IE_RXCSUM);
     writel((4 << 0) | (1 << 8) | (1 << 16) | (1 << 24), IE_RXDCTL);
     writel(eth->rxd_phys, IE_RDBAL);
     writel(eth->rxd_phys >> 32, IE_RDBAH);
@@ -168,6 +186,7 @@ void eth_init_hw(ethdev_t* eth) {
     // setup tx ring
     eth->tx_wr_ptr = 0;
     eth->tx_rd_ptr = 0;
+    eth->tx_tail = 0;
     writel((4 << 0) | (1 << 8) | (1 << 16) | (1 << 24), IE_TXDCTL);
     writel(eth->txd_phys, IE_TDBAL);
     writel(eth->txd_phys >> 32, IE_TDBAH);
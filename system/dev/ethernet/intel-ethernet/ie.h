@@ -27,6 +27,8 @@ struct ethdev {
 
     uint32_t tx_wr_ptr;
     uint32_t tx_rd_ptr;
+    // tx_wr_ptr as last written to the hardware
+    uint32_t tx_tail;
     uint32_t rx_rd_ptr;
 
     list_node_t free_frames;
@@ -66,9 +68,17 @@ void eth_init_hw(ethdev_t* eth);
 void eth_dump_regs(ethdev_t* eth);
 
 status_t eth_rx(ethdev_t* eth, void** data, size_t* len);
+// true if the packet after the one eth_rx() returned has also arrived
+bool eth_rx_more(ethdev_t* eth);
+// true if the hardware verified the TCP/UDP checksum of the packet eth_rx() returned
+bool eth_rx_csum_ok(ethdev_t* eth);
 void eth_rx_ack(ethdev_t* eth);
 
-status_t eth_tx(ethdev_t* eth, const void* data, size_t len);
+// If csum_field is nonzero, the hardware fills in the ones' complement sum of
+// the frame from csum_start on at that offset. The hardware only learns of the
+// frame once eth_tx() is called with more false.
+status_t eth_tx(ethdev_t* eth, const void* data, size_t len,
+                size_t csum_start, size_t csum_field, bool more);
 
 bool eth_status_online(ethdev_t* eth);
 
@@ -200,7 +200,8 @@ err:
 }
 
 #define INITIAL_CONNECTION_TIMEOUT 250
-#define TFTP_BUF_SZ 2048
+// Room for the largest block a receiver can negotiate (65464 bytes) plus its header
+#define TFTP_BUF_SZ 65536
 
 int tftp_xfer(struct sockaddr_in6* addr, const char* fn, const char* name) {
     int result = -1;
@@ -9,16 +9,20 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 
 #include <lz4frame.h>
+#include <lz4hc.h>
 #include <lib/cksum.h>
 
 #include <zircon/boot/bootdata.h>
@@ -27,6 +31,9 @@
 
 int verbose = 0;
 
+// Number of threads used to compress bootfs images; 0 means one per CPU.
+unsigned jobs = 0;
+
 typedef struct fsentry fsentry_t;
 
 struct fsentry {
@@ -55,9 +62,10 @@ struct item {
     fsentry_t* first;
     fsentry_t* last;
 
-    // size of header and total output size
+    // size of header, number of entries, and total output size
     // used by bootfs items
     size_t hdrsize;
+    size_t count;
     size_t outsize;
 };
 
@@ -181,6 +189,7 @@ void add_entry(item_t* fs, fsentry_t* e) {
     }
     fs->last = e;
     fs->hdrsize += sizeof(bootfs_entry_t) + BOOTFS_ALIGN(e->namelen);
+    fs->count++;
 }
 
 int import_manifest(FILE* fp, const char* fn, item_t* fs) {
@@ -462,6 +471,150 @@ static bool check_and_log_lz4_error(LZ4F_errorCode_t code, const char* msg) {
     return false;
 }
 
+// The bootfs image is compressed as a single LZ4 frame made of independent
+// 64kB blocks, so every block can be compressed on its own.  Rather than
+// streaming the image through LZ4F, the compressed io_ops collect the whole
+// uncompressed image in memory and compress all of its blocks at once on
+// several threads.  The output is exactly what LZ4F would have produced
+// for the same preferences: the frame header, the blocks in order (each
+// stored uncompressed if compression doesn't shrink it), and the end mark.
+
+#define LZ4_BLOCK_SIZE (64 * 1024)
+// Each block is stored with a 4-byte size prefix, and is never larger than
+// its uncompressed size.
+#define LZ4_BLOCK_MAX (4 + LZ4_BLOCK_SIZE)
+
+typedef struct {
+    uint8_t* data;
+    size_t len;
+    size_t cap;
+} compress_state_t;
+
+typedef struct {
+    const uint8_t* src;
+    size_t srclen;
+    uint8_t* dst;
+    uint32_t* dstlen;
+    size_t nblocks;
+    atomic_size_t next;
+    bool failed;
+} compress_work_t;
+
+static void* compress_worker(void* arg) {
+    compress_work_t* work = arg;
+    void* state = malloc(LZ4_sizeofStateHC());
+    if (state == NULL) {
+        work->failed = true;
+        return NULL;
+    }
+    size_t n;
+    while ((n = atomic_fetch_add(&work->next, 1)) < work->nblocks) {
+        const uint8_t* src = work->src + n * LZ4_BLOCK_SIZE;
+        size_t srclen = work->srclen - n * LZ4_BLOCK_SIZE;
+        if (srclen > LZ4_BLOCK_SIZE) {
+            srclen = LZ4_BLOCK_SIZE;
+        }
+        uint8_t* dst = work->dst + n * LZ4_BLOCK_MAX;
+        // Same as LZ4F_compressBlock: if it doesn't fit in one byte less
+        // than the input, store the block uncompressed.
+        uint32_t r = LZ4_compress_HC_extStateHC(state, (const char*)src,
+                                                (char*)dst + 4, srclen,
+                                                srclen - 1,
+                                                lz4_prefs.compressionLevel);
+        uint32_t hdr = r;
+        if (r == 0) {
+            r = srclen;
+            hdr = r | 0x80000000u;
+            memcpy(dst + 4, src, srclen);
+        }
+        dst[0] = hdr;
+        dst[1] = hdr >> 8;
+        dst[2] = hdr >> 16;
+        dst[3] = hdr >> 24;
+        work->dstlen[n] = 4 + r;
+    }
+    free(state);
+    return NULL;
+}
+
+static unsigned compress_jobs(size_t nblocks) {
+    unsigned n = jobs;
+    if (n == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        n = (cpus > 0) ? cpus : 1;
+    }
+    return (n > nblocks) ? ((nblocks > 0) ? nblocks : 1) : n;
+}
+
+// Compress src as a sequence of LZ4 blocks and write them to fd.
+static ssize_t compress_blocks(int fd, const uint8_t* src, size_t len,
+                               uint32_t* crc) {
+    compress_work_t work = {
+        .src = src,
+        .srclen = len,
+        .nblocks = (len + LZ4_BLOCK_SIZE - 1) / LZ4_BLOCK_SIZE,
+    };
+    atomic_init(&work.next, 0);
+    if (work.nblocks == 0) {
+        return 0;
+    }
+    work.dst = malloc(work.nblocks * LZ4_BLOCK_MAX);
+    work.dstlen = calloc(work.nblocks, sizeof(uint32_t));
+    if (work.dst == NULL || work.dstlen == NULL) {
+        fprintf(stderr, "error: cannot allocate compression buffer\n");
+        free(work.dst);
+        free(work.dstlen);
+        return -1;
+    }
+
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    unsigned nthreads = compress_jobs(work.nblocks);
+    pthread_t threads[nthreads];
+    unsigned started = 0;
+    // This thread does its share of the work too.
+    while (started + 1 < nthreads) {
+        if (pthread_create(&threads[started], NULL,
+                           compress_worker, &work) != 0) {
+            break;
+        }
+        started++;
+    }
+    compress_worker(&work);
+    for (unsigned i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    ssize_t r = 0;
+    size_t total = 0;
+    if (work.failed) {
+        fprintf(stderr, "error: cannot allocate compression state\n");
+        r = -1;
+    }
+    for (size_t n = 0; (r >= 0) && (n < work.nblocks); n++) {
+        const uint8_t* block = work.dst + n * LZ4_BLOCK_MAX;
+        if (crc) {
+            *crc = crc32(*crc, block, work.dstlen[n]);
+        }
+        r = writex(fd, block, work.dstlen[n]);
+        total += work.dstlen[n];
+    }
+
+    if (verbose && (r >= 0)) {
+        struct timespec t1;
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+        fprintf(stderr, "compressed %zu bytes to %zu in %zu blocks"
+                " on %u threads: %.3f s\n",
+                len, total, work.nblocks, started + 1, secs);
+    }
+
+    free(work.dst);
+    free(work.dstlen);
+    return (r < 0) ? -1 : (ssize_t)total;
+}
+
 ssize_t compress_setup(int fd, void** cookie, uint32_t* crc) {
     LZ4F_compressionContext_t cctx;
     LZ4F_errorCode_t errc = LZ4F_createCompressionContext(&cctx, LZ4F_VERSION);
@@ -470,13 +623,25 @@ ssize_t compress_setup(int fd, void** cookie, uint32_t* crc) {
     }
     uint8_t buf[128];
     size_t r = LZ4F_compressBegin(cctx, buf, sizeof(buf), &lz4_prefs);
+    LZ4F_freeCompressionContext(cctx);
     if (check_and_log_lz4_error(r, "could not begin compression")) {
-        return r;
+        return -1;
     }
 
-    // Note: LZ4F_compressionContext_t is a typedef to a pointer, so this is
-    // "safe".
-    *cookie = (void*)cctx;
+    // The content size was filled in by the caller, so the whole image
+    // can be gathered without reallocating.
+    compress_state_t* state = calloc(1, sizeof(*state));
+    if (state == NULL) {
+        return -1;
+    }
+    state->cap = lz4_prefs.frameInfo.contentSize;
+    if ((state->cap > 0) && ((state->data = malloc(state->cap)) == NULL)) {
+        fprintf(stderr, "error: cannot allocate %zu bytes for bootfs image\n",
+                state->cap);
+        free(state);
+        return -1;
+    }
+    *cookie = state;
 
     if (crc && (r > 0)) {
         *crc = crc32(*crc, buf, r);
@@ -484,18 +649,29 @@ ssize_t compress_setup(int fd, void** cookie, uint32_t* crc) {
     return writex(fd, buf, r);
 }
 
+static uint8_t* compress_reserve(compress_state_t* state, size_t len) {
+    if (state->cap - state->len < len) {
+        size_t cap = state->len + len;
+        uint8_t* data = realloc(state->data, cap);
+        if (data == NULL) {
+            fprintf(stderr, "error: cannot grow bootfs image buffer\n");
+            return NULL;
+        }
+        state->data = data;
+        state->cap = cap;
+    }
+    uint8_t* ptr = state->data + state->len;
+    state->len += len;
+    return ptr;
+}
+
 ssize_t compress_data(int fd, const void* src, size_t len, void* cookie, uint32_t* crc) {
-    // max will be, worst case, a bit larger than MAXBUFFER
-    size_t max = LZ4F_compressBound(len, &lz4_prefs);
-    uint8_t buf[max];
-    size_t r = LZ4F_compressUpdate((LZ4F_compressionContext_t)cookie, buf, max, src, len, NULL);
-    if (check_and_log_lz4_error(r, "could not compress data")) {
+    uint8_t* dst = compress_reserve(cookie, len);
+    if (dst == NULL) {
         return -1;
     }
-    if (crc) {
-        *crc = crc32(*crc, buf, r);
-    }
-    return writex(fd, buf, r);
+    memcpy(dst, src, len);
+    return len;
 }
 
 ssize_t compress_file(int fd, const char* fn, size_t len, void* cookie, uint32_t* crc) {
@@ -504,48 +680,30 @@ ssize_t compress_file(int fd, const char* fn, size_t len, void* cookie, uint32_t
         return 0;
     }
 
-    char buf[MAXBUFFER];
-    int r, fdi;
+    int fdi;
     if ((fdi = open(fn, O_RDONLY)) < 0) {
         fprintf(stderr, "error: cannot open '%s'\n", fn);
         return -1;
     }
-
-    r = 0;
-    size_t total = len;
-    while (len > 0) {
-        size_t xfer = (len > sizeof(buf)) ? sizeof(buf) : len;
-        if ((r = readx(fdi, buf, xfer)) < 0) {
-            break;
-        }
-        if ((r = compress_data(fd, buf, xfer, cookie, crc)) < 0) {
-            break;
-        }
-        len -= xfer;
-    }
+    uint8_t* dst = compress_reserve(cookie, len);
+    int r = (dst == NULL) ? -1 : readx(fdi, dst, len);
     close(fdi);
-    return (r < 0) ? -1 : total;
+    return (r < 0) ? -1 : (ssize_t)len;
 }
 
 ssize_t compress_finish(int fd, void* cookie, uint32_t* crc) {
-    // Max write is one block (64kB uncompressed) plus 8 bytes of footer.
-    size_t max = LZ4F_compressBound(65536, &lz4_prefs) + 8;
-    uint8_t buf[max];
-    size_t r = LZ4F_compressEnd((LZ4F_compressionContext_t)cookie, buf, max, NULL);
-    if (check_and_log_lz4_error(r, "could not finish compression")) {
-        r = -1;
-    } else {
+    compress_state_t* state = cookie;
+    ssize_t r = compress_blocks(fd, state->data, state->len, crc);
+    if (r >= 0) {
+        // End mark.  Content checksums are not enabled in lz4_prefs.
+        uint8_t end[4] = { 0, 0, 0, 0 };
         if (crc) {
-            *crc = crc32(*crc, buf, r);
+            *crc = crc32(*crc, end, sizeof(end));
         }
-        r = writex(fd, buf, r);
-    }
-
-    LZ4F_errorCode_t errc = LZ4F_freeCompressionContext((LZ4F_compressionContext_t)cookie);
-    if (check_and_log_lz4_error(errc, "could not free compression context")) {
-        r = -1;
+        r = writex(fd, end, sizeof(end));
     }
-
+    free(state->data);
+    free(state);
     return r;
 }
 
@@ -615,6 +773,50 @@ char fill[4096];
 
 #define CHECK(w) do { if ((w) < 0) goto fail; } while (0)
 
+typedef struct {
+    const fsentry_t* e;
+    uint32_t off;
+} index_entry_t;
+
+static int index_cmp(const void* a, const void* b) {
+    const index_entry_t* x = a;
+    const index_entry_t* y = b;
+    int r = strcmp(x->e->name, y->e->name);
+    if (r != 0) {
+        return r;
+    }
+    // Keep duplicates in directory order, so that a search for the first
+    // match finds the same entry a linear scan would.
+    return (x->off < y->off) ? -1 : (x->off > y->off);
+}
+
+// Build the sorted directory index for a bootfs item: the offset of each
+// entry (relative to the first entry), in name order.
+static uint32_t* build_index(item_t* item) {
+    index_entry_t* entries = calloc(item->count, sizeof(index_entry_t));
+    uint32_t* index = calloc(item->count, sizeof(uint32_t));
+    if ((item->count > 0) && ((entries == NULL) || (index == NULL))) {
+        fprintf(stderr, "error: cannot allocate bootfs index\n");
+        free(entries);
+        free(index);
+        return NULL;
+    }
+    uint32_t off = 0;
+    size_t n = 0;
+    for (const fsentry_t* e = item->first; e != NULL; e = e->next) {
+        entries[n].e = e;
+        entries[n].off = off;
+        off += sizeof(bootfs_entry_t) + BOOTFS_ALIGN(e->namelen);
+        n++;
+    }
+    qsort(entries, n, sizeof(index_entry_t), index_cmp);
+    for (size_t i = 0; i < n; i++) {
+        index[i] = entries[i].off;
+    }
+    free(entries);
+    return index;
+}
+
 int write_bootfs(int fd, const io_ops* op, item_t* item, bool compressed, bool extra) {
     uint32_t n;
     fsentry_t* e;
@@ -659,6 +861,7 @@ fail:
         bootfs_header_t hdr = {
             .magic = BOOTFS_MAGIC,
             .dirsize = item->hdrsize - sizeof(bootfs_header_t),
+            .index_count = item->count,
         };
         CHECK(op->write(fd, &hdr, sizeof(hdr), cookie, crc));
     }
@@ -679,7 +882,18 @@ fail:
     // Record length of last file
     uint32_t last_length = last_entry ? last_entry->length : 0;
 
-    if ((n = PAGEFILL(item->hdrsize))) {
+    // write the sorted directory index
+    {
+        uint32_t* index = build_index(item);
+        if (index == NULL) {
+            return -1;
+        }
+        ssize_t r = op->write(fd, index, item->count * sizeof(uint32_t), cookie, crc);
+        free(index);
+        CHECK(r);
+    }
+
+    if ((n = PAGEFILL(item->hdrsize + item->count * sizeof(uint32_t)))) {
         CHECK(op->write(fd, fill, n, cookie, crc));
     }
 
@@ -1039,6 +1253,7 @@ void usage(void) {
     "         -k <filename>    include kernel (must be first)\n"
     "         -C <filename>    include kernel command line\n"
     "         -c               compress bootfs image (default)\n"
+    "         -j <jobs>        compress on <jobs> threads (default: one per CPU)\n"
     "         -v               verbose output\n"
     "         -x               enable bootextra data (crc32)\n"
     "         -t <filename>    dump bootdata contents\n"
@@ -1127,6 +1342,20 @@ int main(int argc, char **argv) {
             }
             argc--;
             argv++;
+        } else if (!strcmp(cmd,"-j")) {
+            if (argc < 2) {
+                fprintf(stderr, "error: no job count given\n");
+                return -1;
+            }
+            char* end;
+            unsigned long n = strtoul(argv[1], &end, 10);
+            if ((*end != 0) || (n == 0) || (n > 256)) {
+                fprintf(stderr, "error: invalid job count '%s'\n", argv[1]);
+                return -1;
+            }
+            jobs = n;
+            argc--;
+            argv++;
         } else if (!strcmp(cmd,"-g")) {
             if (argc < 2) {
                 fprintf(stderr, "error: no group specified\n");
@@ -1203,7 +1432,8 @@ int main(int argc, char **argv) {
         case ITEM_BOOTFS_SYSTEM:
             // account for the bootfs header record
             item->hdrsize += sizeof(bootfs_header_t);
-            size_t off = PAGEALIGN(item->hdrsize);
+            // and for the directory index following the entries
+            size_t off = PAGEALIGN(item->hdrsize + item->count * sizeof(uint32_t));
             fsentry_t* last_entry = NULL;
             for (fsentry_t* e = item->first; e != NULL; e = e->next) {
                 e->offset = off;
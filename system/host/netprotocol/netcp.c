@@ -29,7 +29,8 @@
 #include <zircon/boot/netboot.h>
 #include <tftp/tftp.h>
 
-#define TFTP_BUF_SZ 2048
+// Room for the largest block a receiver can negotiate (65464 bytes) plus its header
+#define TFTP_BUF_SZ 65536
 
 typedef struct {
     int fd;
@@ -205,6 +205,13 @@ __END_CDECLS;
 //
 // - data offsets must be page aligned (multiple of 4096)
 // - entries start on uint32 boundaries
+//
+// If the header's index_count is nonzero, the entries are immediately
+// followed by an index: index_count uint32 offsets (relative to the first
+// bootfs_entry_t) of the entries, sorted by name in strcmp order.  Readers
+// can binary search it instead of scanning the entries.  Readers that
+// don't know about the index just see some extra bytes between the last
+// entry and the page-aligned file data.
 
 //lsw of sha256("bootfs")
 #define BOOTFS_MAGIC (0xa56d3ff9)
@@ -219,8 +226,11 @@ typedef struct bootfs_header {
     // does not include the size of the bootfs_header_t
     uint32_t dirsize;
 
-    // 0, 0
-    uint32_t reserved0;
+    // number of offsets in the sorted index following the entries,
+    // or 0 if there is no index
+    uint32_t index_count;
+
+    // 0
     uint32_t reserved1;
 } bootfs_header_t;
 
@@ -234,6 +244,7 @@ typedef struct bootfs_entry {
 #define BOOTFS_ALIGN(nlen) (((nlen) + 3) & (~3))
 #define BOOTFS_RECSIZE(entry) \
     (sizeof(bootfs_entry_t) + BOOTFS_ALIGN(entry->name_len))
+#define BOOTFS_INDEX_SIZE(hdr) ((hdr)->index_count * sizeof(uint32_t))
 
 #endif
 
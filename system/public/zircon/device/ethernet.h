@@ -33,6 +33,8 @@ typedef struct eth_info_t {
 #define ETH_FEATURE_WLAN  1
 // Device is a synthetic network device
 #define ETH_FEATURE_SYNTH 2
+// Device fills in TCP and UDP checksums of tx packets sent with ETH_FIFO_TX_CSUM
+#define ETH_FEATURE_TX_CSUM 4
 
 // Get the fifos to submit tx and rx operations
 //   in: none
@@ -104,13 +106,15 @@ typedef struct eth_fifos_t {
 // are returned along with the fifo handles in the eth_fifos_t.
 
 // flags values for request messages
-// - none -
+#define ETH_FIFO_TX_CSUM (1u)   // fill in the TCP/UDP checksum (see ETH_FEATURE_TX_CSUM);
+                                // the checksum field must hold the pseudo-header sum
 
 // flags values for response messages
 #define ETH_FIFO_RX_OK   (1u)   // packet received okay
 #define ETH_FIFO_TX_OK   (1u)   // packet transmitted okay
 #define ETH_FIFO_INVALID (2u)   // offset+length not within io_vmo bounds
 #define ETH_FIFO_RX_TX   (4u)   // received our own tx packet (when TX_LISTEN)
+#define ETH_FIFO_RX_CSUM_OK (8u) // device verified the packet's TCP/UDP checksum
 
 typedef struct eth_fifo_entry {
     // offset from start of io_vmo to packet data
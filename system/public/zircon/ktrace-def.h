@@ -51,6 +51,10 @@ KTRACE_DEF(0x143,32B,PORT_QUEUE,IPC) // id, size
 KTRACE_DEF(0x150,32B,WAIT_ONE,IPC) // id, signals, timeoutlo, timeouthi
 KTRACE_DEF(0x151,32B,WAIT_ONE_DONE,IPC) // id, status, pending
 
+KTRACE_DEF(0x160,32B,LOCK_CLASS,LOCK) // id, site_lo, site_hi, kind
+KTRACE_DEF(0x161,32B,LOCK_COUNTS,LOCK) // id, acquisitions, contended
+KTRACE_DEF(0x162,32B,LOCK_TIMES,LOCK) // id, wait_us, hold_us, max_wait_us
+
 // events from 0x200-0x2ff are for arch-specific needs
 
 #ifdef __x86_64__
@@ -48,6 +48,9 @@
 #define ZX_DEFAULT_PORT_RIGHTS \
   (ZX_RIGHT_DUPLICATE | ZX_RIGHT_TRANSFER | ZX_RIGHT_READ | ZX_RIGHT_WRITE)
 
+#define ZX_DEFAULT_WAIT_SET_RIGHTS \
+  (ZX_RIGHT_DUPLICATE | ZX_RIGHT_TRANSFER | ZX_RIGHT_READ | ZX_RIGHT_WRITE)
+
 #define ZX_DEFAULT_PROCESS_RIGHTS                                            \
   (ZX_RIGHT_READ | ZX_RIGHT_WRITE | ZX_RIGHT_DUPLICATE | ZX_RIGHT_TRANSFER | \
    ZX_RIGHT_ENUMERATE | ZX_RIGHT_DESTROY | ZX_RIGHT_GET_PROPERTY |           \
@@ -59,7 +62,7 @@
 
 #define ZX_DEFAULT_SOCKET_RIGHTS \
   (ZX_RIGHT_TRANSFER | ZX_RIGHT_DUPLICATE | ZX_RIGHT_READ | ZX_RIGHT_WRITE |\
-   ZX_RIGHT_SIGNAL | ZX_RIGHT_SIGNAL_PEER)
+   ZX_RIGHT_SIGNAL | ZX_RIGHT_SIGNAL_PEER | ZX_RIGHT_GET_PROPERTY)
 
 #define ZX_DEFAULT_THREAD_RIGHTS                                             \
   (ZX_RIGHT_READ | ZX_RIGHT_WRITE | ZX_RIGHT_DUPLICATE | ZX_RIGHT_TRANSFER | \
@@ -53,6 +53,7 @@ typedef enum {
     ZX_OBJ_TYPE_GUEST               = 20,
     ZX_OBJ_TYPE_VCPU                = 21,
     ZX_OBJ_TYPE_TIMER               = 22,
+    ZX_OBJ_TYPE_WAIT_SET            = 23,
     ZX_OBJ_TYPE_LAST
 } zx_obj_type_t;
 
@@ -369,6 +370,10 @@ typedef struct zx_info_resource {
 // Argument is an zx_job_importance_t value.
 #define ZX_PROP_JOB_IMPORTANCE             7u
 
+// Argument is a size_t, the number of bytes a socket endpoint can hold for
+// reading. Only ZX_SOCKET_BULK sockets can set it, and only while empty.
+#define ZX_PROP_SOCKET_BUFFER_SIZE          8u
+
 // Describes how important a job is.
 typedef int32_t zx_job_importance_t;
 
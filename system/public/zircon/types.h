@@ -171,6 +171,13 @@ typedef struct {
     uint32_t rd_num_handles;
 } zx_channel_call_args_t;
 
+// Buffer list for the scatter-gather calls zx_channel_writev(),
+// zx_fifo_readv() and zx_fifo_writev().
+typedef struct zx_iovec {
+    void* buffer;
+    size_t length;
+} zx_iovec_t;
+
 // Structure for zx_object_wait_many():
 typedef struct {
     zx_handle_t handle;
@@ -178,6 +185,13 @@ typedef struct {
     zx_signals_t pending;
 } zx_wait_item_t;
 
+// Structure for zx_waitset_wait():
+typedef struct zx_waitset_result {
+    uint64_t cookie;
+    zx_status_t status;
+    zx_signals_t observed;
+} zx_waitset_result_t;
+
 typedef uint32_t zx_rights_t;
 #define ZX_RIGHT_NONE             ((zx_rights_t)0u)
 #define ZX_RIGHT_DUPLICATE        ((zx_rights_t)1u << 0)
@@ -255,6 +269,9 @@ typedef int64_t zx_rel_off_t;
 #define ZX_CHANNEL_MAX_MSG_BYTES            65536u
 #define ZX_CHANNEL_MAX_MSG_HANDLES          64u
 
+// Most zx_iovec_t entries a single scatter-gather call can take.
+#define ZX_IOVEC_MAX                        32u
+
 // Socket options and limits.
 // These options can be passed to zx_socket_write()
 #define ZX_SOCKET_SHUTDOWN_WRITE            (1u << 0)
@@ -264,9 +281,27 @@ typedef int64_t zx_rel_off_t;
 #define ZX_SOCKET_STREAM                    (0u << 0)
 #define ZX_SOCKET_DATAGRAM                  (1u << 0)
 #define ZX_SOCKET_HAS_CONTROL               (1u << 1)
-#define ZX_SOCKET_CREATE_MASK               (ZX_SOCKET_DATAGRAM | ZX_SOCKET_HAS_CONTROL)
+#define ZX_SOCKET_BULK                      (1u << 2)
+#define ZX_SOCKET_CREATE_MASK               (ZX_SOCKET_DATAGRAM | ZX_SOCKET_HAS_CONTROL | \
+                                             ZX_SOCKET_BULK)
 // These can be passed to zx_socket_read() and zx_socket_write().
 #define ZX_SOCKET_CONTROL                   (1u << 2)
+#define ZX_SOCKET_IN_PLACE                  (1u << 3)
+// These can be passed to zx_socket_get_ring().
+#define ZX_SOCKET_RING_READ                 (0u << 0)
+#define ZX_SOCKET_RING_WRITE                (1u << 0)
+
+// The first page of the VMO returned by zx_socket_get_ring(). The data
+// follows it, at ZX_SOCKET_RING_DATA_OFFSET: the unread bytes start at
+// offset |read_count| % |capacity| into it, and the free space at
+// |write_count| % |capacity|. The kernel updates the counts, with release
+// semantics, as data is written and read.
+typedef struct zx_socket_ring_header {
+    uint64_t capacity;
+    uint64_t read_count;
+    uint64_t write_count;
+} zx_socket_ring_header_t;
+#define ZX_SOCKET_RING_DATA_OFFSET          (4096u)
 
 // Flags which can be used to to control cache policy for APIs which map memory.
 typedef enum {
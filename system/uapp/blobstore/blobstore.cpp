@@ -809,7 +809,17 @@ zx_status_t Blobstore::LoadBitmaps() {
     ReadTxn txn(this);
     txn.Enqueue(block_map_vmoid_, 0, BlockMapStartBlock(info_), BlockMapBlocks(info_));
     txn.Enqueue(node_map_vmoid_, 0, NodeMapStartBlock(info_), NodeMapBlocks(info_));
-    return txn.Flush();
+    zx_status_t status = txn.Flush();
+    if (status != ZX_OK) {
+        return status;
+    }
+    // The block map was loaded directly into its storage; build the summary
+    // which lets allocations skip over full regions of it.  The summary is
+    // only an optimization, so carry on without it on failure.
+    if ((status = block_map_.EnableSummary()) != ZX_OK) {
+        FS_TRACE_WARN("blobstore: no block map summary: %d\n", status);
+    }
+    return ZX_OK;
 }
 
 zx_status_t blobstore_create(fbl::RefPtr<Blobstore>* out, int blockfd) {
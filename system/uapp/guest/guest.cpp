@@ -36,6 +36,11 @@ static const uint32_t kMapFlags = ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE;
 /* Unused memory above this threshold may be reclaimed by the balloon. */
 static uint32_t balloon_threshold_pages = 1024;
 
+/* Longest a coalesced virtio-block interrupt is held back. */
+static const zx_duration_t kBlockCoalesceDelay = ZX_MSEC(1);
+/* Most virtio-block requests to coalesce: a queue never holds more. */
+static const unsigned long kMaxBlockCoalesceCount = 128;
+
 static zx_status_t usage(const char* cmd) {
     fprintf(stderr, "usage: %s [OPTIONS] kernel.bin\n", cmd);
     fprintf(stderr, "\n");
@@ -49,6 +54,8 @@ static zx_status_t usage(const char* cmd) {
     fprintf(stderr, "\t-p [pages]         Number of unused pages to allow the guest to\n"
                     "\t                   retain. Has no effect unless -m is also used\n");
     fprintf(stderr, "\t-d                 Demand-page balloon deflate requests\n");
+    fprintf(stderr, "\t-i [count]         Coalesce virtio-block interrupts, sending one per\n"
+                    "\t                   'count' completed requests or after at most 1ms\n");
     fprintf(stderr, "\n");
     return ZX_ERR_INVALID_ARGS;
 }
@@ -125,8 +132,9 @@ int main(int argc, char** argv) {
     const char* cmdline = NULL;
     zx_duration_t balloon_poll_interval = 0;
     bool balloon_deflate_on_demand = false;
+    uint32_t block_coalesce_count = 0;
     int opt;
-    while ((opt = getopt(argc, argv, "b:r:c:m:dp:")) != -1) {
+    while ((opt = getopt(argc, argv, "b:r:c:m:dp:i:")) != -1) {
         switch (opt) {
         case 'b':
             block_path = optarg;
@@ -156,6 +164,17 @@ int main(int argc, char** argv) {
                 return ZX_ERR_INVALID_ARGS;
             }
             break;
+        case 'i': {
+            char* end;
+            unsigned long count = strtoul(optarg, &end, 10);
+            if (end == optarg || *end != '\0' || count == 0 || count > kMaxBlockCoalesceCount) {
+                fprintf(stderr, "Invalid interrupt count %s. Must be an integer from 1 to %lu\n",
+                        optarg, kMaxBlockCoalesceCount);
+                return ZX_ERR_INVALID_ARGS;
+            }
+            block_coalesce_count = static_cast<uint32_t>(count);
+            break;
+        }
         default:
             return usage(cmd);
         }
@@ -302,6 +321,14 @@ int main(int argc, char** argv) {
         if (status != ZX_OK)
             return status;
 
+        status = block.SetInterruptCoalescing(block_coalesce_count, kBlockCoalesceDelay);
+        if (status != ZX_OK)
+            return status;
+
+        status = block.Start();
+        if (status != ZX_OK)
+            return status;
+
         status = bus.Connect(&virtio_block, PCI_DEVICE_VIRTIO_BLOCK);
         if (status != ZX_OK)
             return status;
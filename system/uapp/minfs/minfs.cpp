@@ -683,6 +683,13 @@ zx_status_t Minfs::Create(Minfs** out, fbl::unique_ptr<Bcache> bc, const minfs_i
     }
 #endif
 
+    // The block bitmap was just loaded directly into its storage; build the
+    // summary which lets allocations skip over full regions of it.  The
+    // summary is only an optimization, so carry on without it on failure.
+    if ((status = fs->block_map_.EnableSummary()) != ZX_OK) {
+        FS_TRACE_WARN("minfs: no block bitmap summary: %d\n", status);
+    }
+
     *out = fs.release();
     return ZX_OK;
 }
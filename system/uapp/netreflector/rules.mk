@@ -11,7 +11,7 @@ MODULE_GROUP := misc
 
 MODULE_SRCS += $(LOCAL_DIR)/netreflector.c
 
-MODULE_STATIC_LIBS := system/ulib/inet6
+MODULE_STATIC_LIBS := system/ulib/inet6 system/ulib/inet-checksum
 
 MODULE_LIBS := system/ulib/fdio system/ulib/zircon system/ulib/c
 
@@ -16,6 +16,7 @@
 #include <fbl/algorithm.h>
 #include <fbl/macros.h>
 #include <fbl/type_support.h>
+#include <fbl/unique_ptr.h>
 
 namespace bitmap {
 namespace internal {
@@ -72,11 +73,39 @@ public:
     // Clear all bits in the bitmap.
     void ClearAll() override;
 
+    // Builds a summary with one bit for every 4096 bits of this bitmap, which
+    // is set when all of those bits are set.  Scans for unset bits (such as
+    // Find(false, ...) when allocating) skip the regions which the summary
+    // reports as full.
+    //
+    // Set, Clear, Grow and Reset keep the summary up to date.  Callers which
+    // modify the underlying storage directly must call EnableSummary again
+    // afterwards to rebuild it.
+    zx_status_t EnableSummary();
+
 protected:
+    // Reallocates and rebuilds the summary, if enabled, after the bitmap has
+    // been resized.  If the allocation fails the summary is dropped and scans
+    // fall back to reading every word.
+    void ResizeSummary();
+
     // The size of this bitmap, in bits.
     size_t size_ = 0;
     // Owned by bits_, cached
     size_t* data_ = nullptr;
+
+private:
+    // Returns the index of the first word in [idx, end) which is not entirely
+    // *is_set*, or end if there is none.
+    size_t FindMismatchedWord(size_t idx, size_t end, bool is_set) const;
+    // Recomputes the summary bits covering words [first_idx, last_idx].
+    void UpdateSummary(size_t first_idx, size_t last_idx, bool is_set);
+    bool GroupFull(size_t group) const;
+
+    fbl::unique_ptr<size_t[]> summary_;
+    // The length of summary_, in words.
+    size_t summary_len_ = 0;
+    bool summary_enabled_ = false;
 };
 
 // A simple bitmap backed by generic storage.
@@ -122,6 +151,7 @@ public:
         size_t old_size = size_;
         data_ = static_cast<size_t*>(bits_.GetData());
         size_ = size;
+        ResizeSummary();
 
         // Clear the partial bits not included in the new "size_t"s.
         Clear(old_size, fbl::min(old_len * kBits, size_));
@@ -140,6 +170,7 @@ public:
         size_ = size;
         if (size_ == 0) {
             data_ = nullptr;
+            ResizeSummary();
             return ZX_OK;
         }
         size_t last_idx = LastIdx(size);
@@ -149,6 +180,7 @@ public:
         }
         data_ = static_cast<size_t*>(bits_.GetData());
         ClearAll();
+        ResizeSummary();
         return ZX_OK;
     }
 
@@ -7,13 +7,20 @@
 
 #include <limits.h>
 #include <stddef.h>
+#include <string.h>
 
 #include <zircon/types.h>
 #include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
 #include <fbl/macros.h>
 
 namespace {
 
+constexpr size_t kAllOnes = ~static_cast<size_t>(0);
+
+// The number of bitmap words covered by each bit of the summary.
+constexpr size_t kSummaryWords = 64;
+
 // Translates a bit offset into a starting index in the bitmap array.
 constexpr size_t FirstIdx(size_t bitoff) {
     return bitoff / bitmap::kBits;
@@ -76,24 +83,62 @@ size_t RawBitmapBase::Scan(size_t bitoff, size_t bitmax, bool is_set) const {
     }
     size_t first_idx = FirstIdx(bitoff);
     size_t last_idx = LastIdx(bitmax);
+
+    // XOR-ing a word with |flip| turns the bits which don't match *is_set*
+    // into ones, so we are looking for the first non-zero word.
+    size_t flip = is_set ? kAllOnes : 0;
     size_t i = first_idx;
-    size_t value = 0;
-    for (i = first_idx; i <= last_idx; ++i) {
-        value = GetMask(i == first_idx, i == last_idx, bitoff, bitmax);
-        if (is_set) {
-            // If is_set=true, invert the mask, OR it with the value, and invert
-            // it again to hopefully get all zeros.
-            value = ~(~value | data_[i]);
-        } else {
-            // If is_set=false, just AND the mask with the value to hopefully
-            // get all zeros.
-            value &= data_[i];
+    size_t value = (data_[i] ^ flip) & GetMask(true, i == last_idx, bitoff, bitmax);
+    if (value == 0 && i < last_idx) {
+        // Only the last word may be partial; everything between can be
+        // compared a block at a time.
+        i = FindMismatchedWord(first_idx + 1, last_idx, is_set);
+        value = (data_[i] ^ flip) & GetMask(false, i == last_idx, bitoff, bitmax);
+    }
+    return fbl::min(bitmax, CountZeros(i, value));
+}
+
+size_t RawBitmapBase::FindMismatchedWord(size_t idx, size_t end, bool is_set) const {
+    const size_t match = is_set ? kAllOnes : 0;
+    const bool use_summary = is_set && summary_ != nullptr;
+
+    while (idx < end) {
+        size_t stop = end;
+        if (use_summary) {
+            // At the start of a group, skip ahead to the first group which the
+            // summary does not report as full.
+            if (idx % kSummaryWords == 0) {
+                size_t group = idx / kSummaryWords;
+                size_t w = group / kBits;
+                size_t free_groups = ~summary_[w] & (kAllOnes << (group % kBits));
+                while (free_groups == 0 && ++w < summary_len_) {
+                    free_groups = ~summary_[w];
+                }
+                if (free_groups == 0) {
+                    return end;
+                }
+                idx = fbl::max(idx, CountZeros(w, free_groups) * kSummaryWords);
+                if (idx >= end) {
+                    return end;
+                }
+            }
+            stop = fbl::min(end, fbl::roundup(idx + 1, kSummaryWords));
         }
-        if (value != 0) {
-            break;
+
+        // Check four words (32 bytes on 64-bit targets) per branch.  The
+        // compiler turns this into vector compares where it can.
+        while (idx + 4 <= stop &&
+               ((data_[idx] ^ match) | (data_[idx + 1] ^ match) |
+                (data_[idx + 2] ^ match) | (data_[idx + 3] ^ match)) == 0) {
+            idx += 4;
+        }
+        for (; idx < stop; ++idx) {
+            if (data_[idx] != match) {
+                return idx;
+            }
         }
     }
-    return fbl::min(bitmax, CountZeros(i, value));
+    return end;
 }
 
 zx_status_t RawBitmapBase::Find(bool is_set, size_t bitoff, size_t bitmax,
@@ -132,10 +177,14 @@ zx_status_t RawBitmapBase::Set(size_t bitoff, size_t bitmax) {
     }
     size_t first_idx = FirstIdx(bitoff);
     size_t last_idx = LastIdx(bitmax);
-    for (size_t i = first_idx; i <= last_idx; ++i) {
-        data_[i] |=
-                GetMask(i == first_idx, i == last_idx, bitoff, bitmax);
+    if (first_idx == last_idx) {
+        data_[first_idx] |= GetMask(true, true, bitoff, bitmax);
+    } else {
+        data_[first_idx] |= GetMask(true, false, bitoff, bitmax);
+        memset(&data_[first_idx + 1], 0xff, (last_idx - first_idx - 1) * sizeof(size_t));
+        data_[last_idx] |= GetMask(false, true, bitoff, bitmax);
     }
+    UpdateSummary(first_idx, last_idx, true);
     return ZX_OK;
 }
 
@@ -148,10 +197,14 @@ zx_status_t RawBitmapBase::Clear(size_t bitoff, size_t bitmax) {
     }
     size_t first_idx = FirstIdx(bitoff);
     size_t last_idx = LastIdx(bitmax);
-    for (size_t i = first_idx; i <= last_idx; ++i) {
-        data_[i] &=
-                ~(GetMask(i == first_idx, i == last_idx, bitoff, bitmax));
+    if (first_idx == last_idx) {
+        data_[first_idx] &= ~GetMask(true, true, bitoff, bitmax);
+    } else {
+        data_[first_idx] &= ~GetMask(true, false, bitoff, bitmax);
+        memset(&data_[first_idx + 1], 0, (last_idx - first_idx - 1) * sizeof(size_t));
+        data_[last_idx] &= ~GetMask(false, true, bitoff, bitmax);
     }
+    UpdateSummary(first_idx, last_idx, false);
     return ZX_OK;
 }
 
@@ -159,10 +212,73 @@ void RawBitmapBase::ClearAll() {
     if (size_ == 0) {
         return;
     }
-    size_t last_idx = LastIdx(size_);
-    for (size_t i = 0; i <= last_idx; ++i) {
-        data_[i] = 0;
+    memset(data_, 0, (LastIdx(size_) + 1) * sizeof(size_t));
+    if (summary_ != nullptr) {
+        memset(summary_.get(), 0, summary_len_ * sizeof(size_t));
+    }
+}
+
+zx_status_t RawBitmapBase::EnableSummary() {
+    summary_enabled_ = true;
+    ResizeSummary();
+    return summary_enabled_ ? ZX_OK : ZX_ERR_NO_MEMORY;
+}
+
+void RawBitmapBase::ResizeSummary() {
+    if (!summary_enabled_) {
+        return;
+    }
+    summary_.reset();
+    summary_len_ = 0;
+    if (size_ == 0) {
+        return;
+    }
+
+    size_t groups = LastIdx(size_) / kSummaryWords + 1;
+    size_t len = (groups + kBits - 1) / kBits;
+    fbl::AllocChecker ac;
+    summary_.reset(new (&ac) size_t[len]);
+    if (!ac.check()) {
+        summary_enabled_ = false;
+        return;
+    }
+    summary_len_ = len;
+    memset(summary_.get(), 0, len * sizeof(size_t));
+    for (size_t group = 0; group < groups; ++group) {
+        if (GroupFull(group)) {
+            summary_[group / kBits] |= static_cast<size_t>(1) << (group % kBits);
+        }
+    }
+}
+
+void RawBitmapBase::UpdateSummary(size_t first_idx, size_t last_idx, bool is_set) {
+    if (summary_ == nullptr) {
+        return;
+    }
+    size_t first_group = first_idx / kSummaryWords;
+    size_t last_group = last_idx / kSummaryWords;
+    for (size_t group = first_group; group <= last_group; ++group) {
+        // A Set fills every group strictly inside its range, but groups at
+        // either end need to be checked.  A Clear leaves no group full.
+        bool full = is_set &&
+                    ((group != first_group && group != last_group) || GroupFull(group));
+        size_t bit = static_cast<size_t>(1) << (group % kBits);
+        if (full) {
+            summary_[group / kBits] |= bit;
+        } else {
+            summary_[group / kBits] &= ~bit;
+        }
+    }
+}
+
+bool RawBitmapBase::GroupFull(size_t group) const {
+    size_t end = fbl::min((group + 1) * kSummaryWords, LastIdx(size_) + 1);
+    for (size_t i = group * kSummaryWords; i < end; ++i) {
+        if (data_[i] != kAllOnes) {
+            return false;
+        }
     }
+    return true;
 }
 
 } // namespace bitmap
@@ -0,0 +1,38 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#pragma GCC visibility push(hidden)
+
+#include <stdint.h>
+#include <zircon/types.h>
+
+// Decompress the sequence of LZ4 blocks starting at data (and ending with
+// a zero block size) into dst, which holds outsize bytes.
+//
+// If stride is greater than one, only every stride'th block, starting with
+// block number phase, is decompressed.  This lets several threads share the
+// work on one frame.  It requires every block but the last to decompress to
+// exactly 64kB, so that each block's position in the output is known without
+// decompressing the ones before it; if that does not hold this returns
+// ZX_ERR_NOT_SUPPORTED, and the caller should fall back to stride 1.
+zx_status_t decompress_lz4_blocks(const uint8_t* data, uint8_t* dst,
+                                  size_t outsize, unsigned stride,
+                                  unsigned phase, const char** err);
+
+// Decompresses all of the LZ4 blocks at data into dst, by whatever means.
+typedef zx_status_t (*decompress_blocks_fn_t)(void* ctx, const uint8_t* data,
+                                              uint8_t* dst, size_t outsize,
+                                              const char** err);
+
+// decompress_bootdata, with the block decompression step supplied by the
+// caller.
+zx_status_t decompress_bootdata_etc(zx_handle_t vmar, zx_handle_t vmo,
+                                    size_t offset, size_t length,
+                                    decompress_blocks_fn_t decompress,
+                                    void* ctx, zx_handle_t* out,
+                                    const char** err);
+
+#pragma GCC visibility pop
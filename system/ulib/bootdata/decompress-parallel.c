@@ -0,0 +1,98 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <bootdata/decompress.h>
+
+#include "decompress-internal.h"
+
+#include <stdbool.h>
+#include <threads.h>
+
+#include <zircon/syscalls.h>
+
+// This is kept separate from decompress.c, which userboot builds directly
+// and which therefore cannot depend on anything from libc.
+
+#define MAX_THREADS 16
+
+typedef struct {
+    const uint8_t* data;
+    uint8_t* dst;
+    size_t outsize;
+    unsigned stride;
+    unsigned phase;
+    zx_status_t status;
+    const char* err;
+} decompress_job_t;
+
+static int decompress_job(void* arg) {
+    decompress_job_t* job = arg;
+    job->status = decompress_lz4_blocks(job->data, job->dst, job->outsize,
+                                        job->stride, job->phase, &job->err);
+    return 0;
+}
+
+static zx_status_t decompress_blocks_parallel(void* ctx, const uint8_t* data,
+                                             uint8_t* dst, size_t outsize,
+                                             const char** err) {
+    unsigned nthreads = *(const unsigned*)ctx;
+
+    decompress_job_t jobs[MAX_THREADS];
+    thrd_t threads[MAX_THREADS];
+    bool started[MAX_THREADS];
+    for (unsigned i = 0; i < nthreads; ++i) {
+        jobs[i] = (decompress_job_t){
+            .data = data,
+            .dst = dst,
+            .outsize = outsize,
+            .stride = nthreads,
+            .phase = i,
+        };
+        // This thread does phase 0 itself.
+        started[i] = (i > 0 &&
+                      thrd_create(&threads[i], decompress_job, &jobs[i]) ==
+                      thrd_success);
+    }
+    // Also do any phase whose thread couldn't be created.
+    for (unsigned i = 0; i < nthreads; ++i) {
+        if (!started[i])
+            decompress_job(&jobs[i]);
+    }
+
+    zx_status_t status = ZX_OK;
+    bool unsupported = false;
+    for (unsigned i = 0; i < nthreads; ++i) {
+        if (started[i])
+            thrd_join(threads[i], NULL);
+        if (status == ZX_OK && jobs[i].status != ZX_OK) {
+            status = jobs[i].status;
+            *err = jobs[i].err;
+        }
+        // The phases after a short block put their blocks in the wrong
+        // place, and may fail for that reason first.
+        if (jobs[i].status == ZX_ERR_NOT_SUPPORTED)
+            unsupported = true;
+    }
+
+    if (unsupported) {
+        // Not laid out for random access; do it the slow way.
+        status = decompress_lz4_blocks(data, dst, outsize, 1, 0, err);
+    }
+    return status;
+}
+
+zx_status_t decompress_bootdata_parallel(zx_handle_t vmar, zx_handle_t vmo,
+                                         size_t offset, size_t length,
+                                         unsigned threads,
+                                         zx_handle_t* out, const char** err) {
+    if (threads == 0)
+        threads = zx_system_get_num_cpus();
+    if (threads > MAX_THREADS)
+        threads = MAX_THREADS;
+    if (threads < 1)
+        threads = 1;
+    return decompress_bootdata_etc(vmar, vmo, offset, length,
+                                   decompress_blocks_parallel, &threads,
+                                   out, err);
+}
@@ -4,6 +4,8 @@
 
 #include <bootdata/decompress.h>
 
+#include "decompress-internal.h"
+
 #include <limits.h>
 #include <string.h>
 
@@ -46,6 +48,8 @@ typedef struct {
 #define ZX_LZ4_BLOCK_1MB          (6 << 4)
 #define ZX_LZ4_BLOCK_4MB          (7 << 4)
 
+#define ZX_LZ4_BLOCK_SIZE         (64 * 1024)
+
 static zx_status_t check_lz4_frame(const lz4_frame_desc* fd,
                                    size_t expected, const char** err) {
     if ((fd->flag & ZX_LZ4_FLAG_VERSION) != ZX_LZ4_VERSION) {
@@ -85,8 +89,90 @@ static zx_status_t check_lz4_frame(const lz4_frame_desc* fd,
     return ZX_OK;
 }
 
+zx_status_t decompress_lz4_blocks(const uint8_t* data, uint8_t* dst,
+                                  size_t outsize, unsigned stride,
+                                  unsigned phase, const char** err) {
+    // Output offset of the current block.
+    size_t off = 0;
+    size_t n = 0;
+
+    // Read each LZ4 block and decompress it. Block sizes are 32 bits.
+    uint32_t blocksize = *(const uint32_t*)data;
+    data += sizeof(uint32_t);
+    while (blocksize) {
+        // If the data is uncompressed, the high bit is 1.
+        uint32_t actual = blocksize & 0x7fffffff;
+        uint32_t next = *(const uint32_t*)(data + actual);
+
+        if (n % stride != phase) {
+            // Someone else's block; just step over it.
+            off += ZX_LZ4_BLOCK_SIZE;
+        } else {
+            if (off > outsize) {
+                *err = "bootdata outsize too small for lz4 decompression";
+                return ZX_ERR_INVALID_ARGS;
+            }
+            // No block holds more than 64kB.  Don't let the decompressor
+            // use any more room than that either, since it may scribble
+            // past the end of what it decompresses, into other blocks.
+            size_t remaining = outsize - off;
+            if (remaining > ZX_LZ4_BLOCK_SIZE)
+                remaining = ZX_LZ4_BLOCK_SIZE;
+            size_t len;
+            if (blocksize >> 31) {
+                if (actual > remaining) {
+                    *err = "bootdata outsize too small for lz4 decompression";
+                    return ZX_ERR_INVALID_ARGS;
+                }
+                memcpy(dst + off, data, actual);
+                len = actual;
+            } else {
+                int dcmp = LZ4_decompress_safe((const char*)data, (char*)dst + off,
+                                               actual, remaining);
+                if (dcmp < 0) {
+                    *err = "lz4 decompression failed";
+                    return ZX_ERR_BAD_STATE;
+                }
+                len = dcmp;
+            }
+            if (stride > 1 && next != 0 && len != ZX_LZ4_BLOCK_SIZE) {
+                // This block's successors can't be placed without
+                // decompressing everything before them.
+                *err = "lz4 blocks are not all full-sized";
+                return ZX_ERR_NOT_SUPPORTED;
+            }
+            off += len;
+        }
+
+        data += actual;
+        blocksize = next;
+        data += sizeof(uint32_t);
+        ++n;
+    }
+
+    // Sanity check: verify that we didn't have more than one page leftover.
+    // The bootdata header should have specified the exact outsize needed, which
+    // we rounded up to the next full page.  Only whoever decompressed the last
+    // block knows the exact total.
+    size_t last_phase = (n == 0) ? 0 : (n - 1) % stride;
+    if (last_phase == phase && (off > outsize || outsize - off > 4095)) {
+        *err = "bootdata size error; outsize does not match decompressed size";
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    return ZX_OK;
+}
+
+static zx_status_t decompress_blocks_serial(void* ctx, const uint8_t* data,
+                                           uint8_t* dst, size_t outsize,
+                                           const char** err) {
+    return decompress_lz4_blocks(data, dst, outsize, 1, 0, err);
+}
+
 static zx_status_t decompress_bootfs_vmo(zx_handle_t vmar, const uint8_t* data,
-                                         size_t _outsize, zx_handle_t* out,
+                                         size_t _outsize,
+                                         decompress_blocks_fn_t decompress,
+                                         void* ctx, zx_handle_t* out,
                                          const char** err) {
     if (*(const uint32_t*)data != ZX_LZ4_MAGIC) {
         *err = "bad magic number for compressed bootfs";
@@ -119,51 +205,9 @@ static zx_status_t decompress_bootfs_vmo(zx_handle_t vmar, const uint8_t* data,
         return status;
     }
 
-    size_t remaining = outsize;
-    uint8_t* dst = (uint8_t*)dst_addr;
-
-    // Read each LZ4 block and decompress it. Block sizes are 32 bits.
-    uint32_t blocksize = *(const uint32_t*)data;
-    data += sizeof(uint32_t);
-    while (blocksize) {
-        // If the data is uncompressed, the high bit is 1.
-        if (blocksize >> 31) {
-            uint32_t actual = blocksize & 0x7fffffff;
-            memcpy(dst, data, actual);
-            dst += actual;
-            data += actual;
-            if (remaining - actual > remaining) {
-                // Remaining wrapped around (would be negative if signed)
-                *err = "bootdata outsize too small for lz4 decompression";
-                return ZX_ERR_INVALID_ARGS;
-            }
-            remaining -= actual;
-        } else {
-            int dcmp = LZ4_decompress_safe((const char*)data, (char*)dst, blocksize, remaining);
-            if (dcmp < 0) {
-                *err = "lz4 decompression failed";
-                return ZX_ERR_BAD_STATE;
-            }
-            dst += dcmp;
-            data += blocksize;
-            if (remaining - dcmp > remaining) {
-                // Remaining wrapped around (would be negative if signed)
-                *err = "bootdata outsize too small for lz4 decompression";
-                return ZX_ERR_INVALID_ARGS;
-            }
-            remaining -= dcmp;
-        }
-
-        blocksize = *(uint32_t*)data;
-        data += sizeof(uint32_t);
-    }
-
-    // Sanity check: verify that we didn't have more than one page leftover.
-    // The bootdata header should have specified the exact outsize needed, which
-    // we rounded up to the next full page.
-    if (remaining > 4095) {
-        *err = "bootdata size error; outsize does not match decompressed size";
-        return ZX_ERR_INVALID_ARGS;
+    status = decompress(ctx, data, (uint8_t*)dst_addr, outsize, err);
+    if (status < 0) {
+        return status;
     }
 
     status = zx_vmar_unmap(vmar, dst_addr, outsize);
@@ -175,9 +219,11 @@ static zx_status_t decompress_bootfs_vmo(zx_handle_t vmar, const uint8_t* data,
     return ZX_OK;
 }
 
-zx_status_t decompress_bootdata(zx_handle_t vmar, zx_handle_t vmo,
-                                size_t offset, size_t length,
-                                zx_handle_t* out, const char** err) {
+zx_status_t decompress_bootdata_etc(zx_handle_t vmar, zx_handle_t vmo,
+                                    size_t offset, size_t length,
+                                    decompress_blocks_fn_t decompress,
+                                    void* ctx, zx_handle_t* out,
+                                    const char** err) {
     *err = "none";
 
     if (length > SIZE_MAX) {
@@ -205,7 +251,8 @@ zx_status_t decompress_bootdata(zx_handle_t vmar, zx_handle_t vmo,
     case BOOTDATA_BOOTFS_BOOT:
     case BOOTDATA_BOOTFS_SYSTEM:
         if (hdr->flags & BOOTDATA_BOOTFS_FLAG_COMPRESSED) {
-            status = decompress_bootfs_vmo(vmar, (const uint8_t*)bootdata_addr, hdr->extra, out, err);
+            status = decompress_bootfs_vmo(vmar, (const uint8_t*)bootdata_addr,
+                                           hdr->extra, decompress, ctx, out, err);
         }
         break;
     default:
@@ -222,3 +269,10 @@ zx_status_t decompress_bootdata(zx_handle_t vmar, zx_handle_t vmo,
 
     return status;
 }
+
+zx_status_t decompress_bootdata(zx_handle_t vmar, zx_handle_t vmo,
+                                size_t offset, size_t length,
+                                zx_handle_t* out, const char** err) {
+    return decompress_bootdata_etc(vmar, vmo, offset, length,
+                                   decompress_blocks_serial, NULL, out, err);
+}
@@ -16,4 +16,12 @@ zx_status_t decompress_bootdata(zx_handle_t vmar, zx_handle_t vmo,
                                 size_t offset, size_t length,
                                 zx_handle_t* out, const char** errmsg);
 
+// Same as decompress_bootdata, but shares the decompression across
+// threads threads (or one per CPU, if threads is 0).  This is not
+// available in userboot, which uses decompress.c on its own.
+zx_status_t decompress_bootdata_parallel(zx_handle_t vmar, zx_handle_t vmo,
+                                         size_t offset, size_t length,
+                                         unsigned threads,
+                                         zx_handle_t* out, const char** errmsg);
+
 #pragma GCC visibility pop
@@ -20,25 +20,42 @@ __BEGIN_CDECLS;
 // interface (which is selectable independently for transmit and
 // receive)
 //
-// TODO: Implement zero-copy interface in the ethernet common
+// With FEATURE_RX_QUEUE the ethernet middle layer hands the MAC the
+// physical addresses of free buffers in the client's io buffer with
+// queue_rx(), and the MAC reports each frame it has received into them,
+// in the order they were queued, with complete_rx(). The io buffer is
+// locked into memory while the MAC may be using it. Only one client can
+// be running on such a device at a time, and the MAC forgets the buffers
+// it was given when it is stopped. The middle layer may call
+// queue_rx() from within complete_rx(), to replace the buffer that was
+// just filled, so the MAC must not call complete_rx() while holding a
+// lock that queue_rx() takes.
+//
+// TODO: Implement zero-copy transmit in the ethernet common
 // middle layer driver.  Currently ethermac drivers that request
-// these will not be loaded.
+// FEATURE_TX_QUEUE will not be loaded.
 //
 // The FEATURE_WLAN flag indicates a device that supports wlan operations.
 //
 // The FEATURE_SYNTH flag indicates a device that is not backed by hardware.
+//
+// The FEATURE_TX_CSUM flag indicates a device that fills in the TCP or UDP
+// checksum of frames sent with ETHMAC_TX_OPT_CSUM.
 
 #define ETHMAC_FEATURE_RX_QUEUE (1u)
 #define ETHMAC_FEATURE_TX_QUEUE (2u)
 #define ETHMAC_FEATURE_WLAN     (4u)
 #define ETHMAC_FEATURE_SYNTH    (8u)
+#define ETHMAC_FEATURE_TX_CSUM  (16u)
 
 typedef struct ethmac_info {
     uint32_t features;
     uint32_t mtu;
     uint8_t mac[ETH_MAC_SIZE];
     uint8_t reserved0[2];
-    uint32_t reserved1[4];
+    // number of transmit queues send_batch() takes, 0 meaning 1
+    uint32_t tx_queues;
+    uint32_t reserved1[3];
 } ethmac_info_t;
 
 typedef struct ethmac_ifc_virt {
@@ -56,6 +73,75 @@ typedef struct ethmac_ifc_virt {
 // driver to batch tx to hardware if possible.
 #define ETHMAC_TX_OPT_MORE (1u)
 
+// Asks a FEATURE_TX_CSUM driver to fill in the TCP or UDP checksum of an IPv4 or IPv6 frame. The
+// checksum field must hold the sum of the pseudo-header, as for hardware that sums from the start
+// of the transport header.
+#define ETHMAC_TX_OPT_CSUM (2u)
+
+// Passed in the flags of recv() or complete_rx() to indicate that another received frame will be
+// reported right after this one. Lets the ethernet middle layer hand frames to its clients in
+// batches. A driver that sets it must follow up with another recv() or complete_rx().
+#define ETHMAC_RX_OPT_MORE (1u)
+
+// Passed in the flags of recv() or complete_rx() when the MAC has verified the frame's TCP or UDP
+// checksum. Frames that failed or were not checked are passed up without it.
+#define ETHMAC_RX_CSUM_OK (2u)
+
+typedef struct ethmac_tx_buf {
+    void* data;
+    size_t length;
+    // ETHMAC_TX_OPT_CSUM; ETHMAC_TX_OPT_MORE is implied for all but the last of a batch
+    uint32_t options;
+} ethmac_tx_buf_t;
+
+// Finds the TCP or UDP checksum of an ethernet frame for ETHMAC_TX_OPT_CSUM. On success, *start
+// is the offset of the transport header and *field that of its checksum. IPv4 options are
+// allowed; IPv6 extension headers are not.
+static inline zx_status_t ethmac_csum_offsets(const void* data, size_t length,
+                                              size_t* start, size_t* field) {
+    const uint8_t* frame = (const uint8_t*)data;
+    size_t l3 = 14;
+    if (length < l3) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    uint16_t ethertype = (uint16_t)((frame[12] << 8) | frame[13]);
+    if (ethertype == 0x8100) {
+        // 802.1Q
+        l3 += 4;
+        if (length < l3) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        ethertype = (uint16_t)((frame[16] << 8) | frame[17]);
+    }
+
+    uint8_t proto;
+    size_t l4;
+    if (ethertype == 0x0800 && length >= l3 + 20) {
+        proto = frame[l3 + 9];
+        l4 = l3 + (frame[l3] & 0xf) * 4u;
+    } else if (ethertype == 0x86dd && length >= l3 + 40) {
+        proto = frame[l3 + 6];
+        l4 = l3 + 40;
+    } else {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    size_t offset;
+    if (proto == 6) {
+        offset = 16;
+    } else if (proto == 17) {
+        offset = 6;
+    } else {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    if (l4 + offset + 2 > length) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    *start = l4;
+    *field = l4 + offset;
+    return ZX_OK;
+}
+
 // The ethernet midlayer will never call ethermac_protocol
 // methods from multiple threads simultaneously, but it
 // can call send() methods at the same time as non-send
@@ -79,10 +165,19 @@ typedef struct ethmac_protocol_ops {
     void (*send)(void* ctx, uint32_t options, void* data, size_t length);
 
     // queue_?x() is valid if FEATURE_?X_QUEUE is present, otherwise they are no-op
+    // A buffer never spans more than two pages: pa0 is the physical address of its
+    // start and pa1 that of the page it runs on into, or 0 if it fits in the first.
     void (*queue_tx)(void* ctx, uint32_t options,
                      uintptr_t pa0, uintptr_t pa1, size_t length);
     void (*queue_rx)(void* ctx, uint32_t options,
                      uintptr_t pa0, uintptr_t pa1, size_t length);
+
+    // send_batch() is optional, and used instead of send() if present.
+    // It sends |count| frames on transmit queue |queue|, which is less than
+    // the tx_queues reported by query(). Like send(), it can be called from
+    // multiple threads simultaneously; each client of the midlayer sends
+    // on one queue, so drivers need only serialize calls for the same queue.
+    void (*send_batch)(void* ctx, uint32_t queue, ethmac_tx_buf_t* bufs, size_t count);
 } ethmac_protocol_ops_t;
 
 typedef struct ethmac_protocol {
@@ -43,6 +43,7 @@ DECLARE_HAS_MEMBER_FN(has_ethmac_query, EthmacQuery);
 DECLARE_HAS_MEMBER_FN(has_ethmac_stop, EthmacStop);
 DECLARE_HAS_MEMBER_FN(has_ethmac_start, EthmacStart);
 DECLARE_HAS_MEMBER_FN(has_ethmac_send, EthmacSend);
+DECLARE_HAS_MEMBER_FN(has_ethmac_send_batch, EthmacSendBatch);
 
 template <typename D>
 constexpr void CheckEthmacProtocolSubclass() {
@@ -79,5 +80,29 @@ constexpr void CheckEthmacProtocolSubclass() {
                   "friendship).");
 }
 
+// EthmacSendBatch is optional; ops->send_batch is left null without it.
+template <typename D, bool = has_ethmac_send_batch<D>::value>
+struct EthmacSendBatchOp {
+    static void Init(ethmac_protocol_ops_t* ops) {}
+};
+
+template <typename D>
+struct EthmacSendBatchOp<D, true> {
+    static void Init(ethmac_protocol_ops_t* ops) {
+        static_assert(fbl::is_same<decltype(&D::EthmacSendBatch),
+                                    void (D::*)(uint32_t, ethmac_tx_buf_t*, size_t)>::value,
+                      "EthmacSendBatch must be a non-static member function with signature "
+                      "'void EthmacSendBatch(uint32_t, ethmac_tx_buf_t*, size_t)', and be "
+                      "visible to ddk::EthmacProtocol<D> (either because they are public, or "
+                      "because of friendship).");
+        ops->send_batch = SendBatch;
+    }
+
+  private:
+    static void SendBatch(void* ctx, uint32_t queue, ethmac_tx_buf_t* bufs, size_t count) {
+        static_cast<D*>(ctx)->EthmacSendBatch(queue, bufs, count);
+    }
+};
+
 }  // namespace internal
 }  // namespace ddk
@@ -107,6 +107,11 @@
 //         // Send the data
 //     }
 //
+//     // Optional
+//     void EthmacSendBatch(uint32_t queue, ethmac_tx_buf_t* bufs, size_t count) {
+//         // Send several buffers on one transmit queue
+//     }
+//
 //   private:
 //     zx_device_t* parent_;
 //     fbl::unique_ptr<ddk::EthmacIfcProxy> proxy_;
@@ -150,6 +155,10 @@ class EthmacIfcProxy {
         ifc_->recv(cookie_, data, length, flags);
     }
 
+    void CompleteRx(uint32_t length, uint32_t flags) {
+        ifc_->complete_rx(cookie_, length, flags);
+    }
+
   private:
     ethmac_ifc_t* ifc_;
     void* cookie_;
@@ -164,6 +173,7 @@ class EthmacProtocol : public internal::base_protocol {
         ops_.stop = Stop;
         ops_.start = Start;
         ops_.send = Send;
+        internal::EthmacSendBatchOp<D>::Init(&ops_);
 
         // Can only inherit from one base_protocol implemenation
         ZX_ASSERT(ddk_proto_ops_ == nullptr);
@@ -216,6 +226,10 @@ class EthmacProtocolProxy {
         ops_->send(ctx_, options, data, length);
     }
 
+    void SendBatch(uint32_t queue, ethmac_tx_buf_t* bufs, size_t count) {
+        ops_->send_batch(ctx_, queue, bufs, count);
+    }
+
   private:
     ethmac_protocol_ops_t* ops_;
     void* ctx_;
@@ -0,0 +1,702 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <zircon/assert.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/intrusive_container_utils.h>
+#include <fbl/intrusive_pointer_traits.h>
+#include <fbl/intrusive_single_list.h>
+#include <fbl/macros.h>
+
+namespace fbl {
+
+// Fwd decl of sanity checker class used by tests.
+namespace tests {
+namespace intrusive_containers {
+class ResizingHashTableChecker;
+}  // namespace tests
+}  // namespace intrusive_containers
+
+// DefaultResizingHashTraits defines the default implementation of the traits
+// used to hash keys for a ResizingHashTable.
+//
+// Unlike the traits of a fixed size HashTable, the GetHash method of a
+// ResizingHashTable's hash traits returns a hash over the full range of its
+// HashType; the table maps it onto its buckets itself.  The default
+// implementation simply calls a static method of ObjType named GetHash which
+// takes a const reference to a KeyType and returns a HashType.
+template <typename KeyType,
+          typename ObjType,
+          typename HashType>
+struct DefaultResizingHashTraits {
+    static_assert(is_unsigned_integer<HashType>::value, "HashTypes must be unsigned integers");
+    static HashType GetHash(const KeyType& key) {
+        return static_cast<HashType>(ObjType::GetHash(key));
+    }
+};
+
+// ResizingHashTable
+//
+// An intrusive hash table which grows and shrinks its bucket array with the
+// number of elements it holds, keeping chains short for big tables without
+// wasting memory on small ones.  Its interface and node traits are the same
+// as HashTable's.
+//
+// The bucket count is always a power of two, starting at (and never going
+// below) kMinBuckets, which are stored inline so that small tables never
+// allocate.  Hashes are spread over the buckets with a multiplicative
+// (Fibonacci) hash, so poor hash functions such as the identity on integer
+// keys are fine.
+//
+// When the table outgrows its buckets, a new array twice the size is
+// allocated, and the elements are moved over a few buckets at a time by each
+// subsequent insert, so no single insert pays for rehashing the whole table.
+// If a bigger bucket array cannot be allocated, the table simply stays at its
+// current size and its chains get longer.
+//
+// Shrinking is also driven by inserts only: an insert into a table which has
+// become mostly empty starts moving it to a bucket array half the size.  A
+// table which is only ever erased from keeps its buckets until it is cleared
+// or destroyed, and a table drained in one burst shrinks a step at a time as
+// it fills again.
+//
+// Inserting may move elements between buckets, which invalidates all
+// iterators into the table.  Erasing and lookups never move elements, which
+// is why erasing does not shrink the table, so erasing while iterating works
+// just as it does for HashTable.
+template <typename  _KeyType,
+          typename  _PtrType,
+          typename  _BucketType = SinglyLinkedList<_PtrType>,
+          typename  _HashType   = size_t,
+          typename  _KeyTraits  = DefaultKeyedObjectTraits<
+                                    _KeyType,
+                                    typename internal::ContainerPtrTraits<_PtrType>::ValueType>,
+          typename  _HashTraits = DefaultResizingHashTraits<
+                                    _KeyType,
+                                    typename internal::ContainerPtrTraits<_PtrType>::ValueType,
+                                    _HashType>>
+class ResizingHashTable {
+private:
+    // Private fwd decls of the iterator implementation.
+    template <typename IterTraits> class iterator_impl;
+    struct iterator_traits;
+    struct const_iterator_traits;
+
+public:
+    // Pointer types/traits
+    using PtrType      = _PtrType;
+    using PtrTraits    = internal::ContainerPtrTraits<PtrType>;
+    using ValueType    = typename PtrTraits::ValueType;
+
+    // Key types/traits
+    using KeyType      = _KeyType;
+    using KeyTraits    = _KeyTraits;
+
+    // Hash types/traits
+    using HashType     = _HashType;
+    using HashTraits   = _HashTraits;
+
+    // Bucket types/traits
+    using BucketType   = _BucketType;
+    using NodeTraits   = typename BucketType::NodeTraits;
+
+    // Declarations of the standard iterator types.
+    using iterator       = iterator_impl<iterator_traits>;
+    using const_iterator = iterator_impl<const_iterator_traits>;
+
+    // An alias for the type of this specific ResizingHashTable<...> and its test sanity checker.
+    using ContainerType = ResizingHashTable<_KeyType, _PtrType, _BucketType, _HashType,
+                                            _KeyTraits, _HashTraits>;
+    using CheckerType   = ::fbl::tests::intrusive_containers::ResizingHashTableChecker;
+
+    // The smallest number of buckets, which are stored inline.
+    static constexpr size_t kMinBuckets = 8;
+
+    // The table grows when it holds more than kMaxLoad elements per bucket, and
+    // shrinks when an insert finds it holding fewer than one element per
+    // kMinLoadInverse buckets.
+    static constexpr size_t kMaxLoad = 1;
+    static constexpr size_t kMinLoadInverse = 8;
+
+    // The number of non-empty old buckets moved to the new bucket array by each
+    // insert while the table is being resized, and the most buckets each insert
+    // looks at to find them.  This finishes a resize well before the table
+    // could need another one.
+    static constexpr size_t kRehashStep = 4;
+    static constexpr size_t kRehashMaxVisits = 64;
+
+    // Hash tables only support constant order erase if their underlying bucket
+    // type does.
+    static constexpr bool SupportsConstantOrderErase = BucketType::SupportsConstantOrderErase;
+    static constexpr bool SupportsConstantOrderSize = true;
+    static constexpr bool IsAssociative = true;
+    static constexpr bool IsSequenced = false;
+
+    static_assert(is_unsigned_integer<HashType>::value, "HashTypes must be unsigned integers");
+    static_assert((kMinBuckets & (kMinBuckets - 1)) == 0, "kMinBuckets must be a power of two");
+
+    constexpr ResizingHashTable() {}
+    ~ResizingHashTable() {
+        ZX_DEBUG_ASSERT(PtrTraits::IsManaged || is_empty());
+        FreeBuckets(old_);
+        FreeBuckets(cur_);
+    }
+
+    // Standard begin/end, cbegin/cend iterator accessors.
+    iterator begin()              { return       iterator(this,       iterator::BEGIN); }
+    const_iterator begin()  const { return const_iterator(this, const_iterator::BEGIN); }
+    const_iterator cbegin() const { return const_iterator(this, const_iterator::BEGIN); }
+
+    iterator end()              { return       iterator(this,       iterator::END); }
+    const_iterator end()  const { return const_iterator(this, const_iterator::END); }
+    const_iterator cend() const { return const_iterator(this, const_iterator::END); }
+
+    // make_iterator : construct an iterator out of a reference to an object.
+    iterator make_iterator(ValueType& obj) {
+        size_t ndx = BucketIndex(KeyTraits::GetKey(obj));
+        return iterator(this, ndx, GetBucket(ndx).make_iterator(obj));
+    }
+
+    void insert(const PtrType& ptr) { insert(PtrType(ptr)); }
+    void insert(PtrType&& ptr) {
+        ZX_DEBUG_ASSERT(ptr != nullptr);
+        PrepareInsert();
+
+        KeyType key = KeyTraits::GetKey(*ptr);
+        BucketType& bucket = GetBucket(BucketIndex(key));
+
+        // Duplicate keys are disallowed.  Debug assert if someone tries to to
+        // insert an element with a duplicate key.  If the user thought that
+        // there might be a duplicate key in the HashTable already, he/she
+        // should have used insert_or_find() instead.
+        ZX_DEBUG_ASSERT(FindInBucket(bucket, key).IsValid() == false);
+
+        bucket.push_front(fbl::move(ptr));
+        ++count_;
+    }
+
+    // insert_or_find
+    //
+    // Insert the element pointed to by ptr if it is not already in the
+    // HashTable, or find the element that the ptr collided with instead.
+    //
+    // 'iter' is an optional out parameter pointer to an iterator which
+    // will reference either the newly inserted item, or the item whose key
+    // collided with ptr.
+    //
+    // insert_or_find returns true if there was no collision and the item was
+    // successfully inserted, otherwise it returns false.
+    //
+    bool insert_or_find(const PtrType& ptr, iterator* iter = nullptr) {
+        return insert_or_find(PtrType(ptr), iter);
+    }
+
+    bool insert_or_find(PtrType&& ptr, iterator* iter = nullptr) {
+        ZX_DEBUG_ASSERT(ptr != nullptr);
+        PrepareInsert();
+
+        KeyType  key         = KeyTraits::GetKey(*ptr);
+        size_t   ndx         = BucketIndex(key);
+        auto&    bucket      = GetBucket(ndx);
+        auto     bucket_iter = FindInBucket(bucket, key);
+
+        if (bucket_iter.IsValid()) {
+            if (iter) *iter = iterator(this, ndx, bucket_iter);
+            return false;
+        }
+
+        bucket.push_front(fbl::move(ptr));
+        ++count_;
+        if (iter) *iter = iterator(this, ndx, bucket.begin());
+        return true;
+    }
+
+    // insert_or_replace
+    //
+    // Find the element in the hashtable with the same key as *ptr and replace
+    // it with ptr, then return the pointer to the element which was replaced.
+    // If no element in the hashtable shares a key with *ptr, simply add ptr to
+    // the hashtable and return nullptr.
+    //
+    PtrType insert_or_replace(const PtrType& ptr) {
+        return insert_or_replace(PtrType(ptr));
+    }
+
+    PtrType insert_or_replace(PtrType&& ptr) {
+        ZX_DEBUG_ASSERT(ptr != nullptr);
+        PrepareInsert();
+
+        KeyType  key    = KeyTraits::GetKey(*ptr);
+        auto&    bucket = GetBucket(BucketIndex(key));
+        auto     orig   = PtrTraits::GetRaw(ptr);
+
+        PtrType replaced = bucket.replace_if(
+            [key](const ValueType& other) -> bool {
+                return KeyTraits::EqualTo(key, KeyTraits::GetKey(other));
+            },
+            fbl::move(ptr));
+
+        if (orig == PtrTraits::GetRaw(replaced)) {
+            bucket.push_front(PtrTraits::Take(replaced));
+            count_++;
+        }
+
+        return fbl::move(replaced);
+    }
+
+    iterator find(const KeyType& key) {
+        size_t ndx         = BucketIndex(key);
+        auto&  bucket      = GetBucket(ndx);
+        auto   bucket_iter = FindInBucket(bucket, key);
+
+        return bucket_iter.IsValid() ? iterator(this, ndx, bucket_iter)
+                                     : iterator(this, iterator::END);
+    }
+
+    const_iterator find(const KeyType& key) const {
+        size_t      ndx         = BucketIndex(key);
+        const auto& bucket      = GetBucket(ndx);
+        auto        bucket_iter = FindInBucket(bucket, key);
+
+        return bucket_iter.IsValid() ? const_iterator(this, ndx, bucket_iter)
+                                     : const_iterator(this, const_iterator::END);
+    }
+
+    PtrType erase(const KeyType& key) {
+        BucketType& bucket = GetBucket(BucketIndex(key));
+
+        PtrType ret = internal::KeyEraseUtils<BucketType, KeyTraits>::erase(bucket, key);
+        if (ret != nullptr)
+            --count_;
+
+        return ret;
+    }
+
+    PtrType erase(const iterator& iter) {
+        if (!iter.IsValid())
+            return PtrType(nullptr);
+
+        return direct_erase(GetBucket(iter.bucket_ndx_), *iter);
+    }
+
+    PtrType erase(ValueType& obj) {
+        return direct_erase(GetBucket(BucketIndex(KeyTraits::GetKey(obj))), obj);
+    }
+
+    // clear
+    //
+    // Clear out the all of the hashtable buckets and return to the minimum
+    // size.  For managed pointer types, this will release all references held
+    // by the hashtable to the objects which were in it.
+    void clear() {
+        for (size_t i = 0; i < bucket_count(); ++i)
+            GetBucket(i).clear();
+        count_ = 0;
+        Reset();
+    }
+
+    // clear_unsafe
+    //
+    // Perform a clear_unsafe on all buckets, reset the internal count to zero
+    // and return to the minimum size.  See comments in
+    // fbl/intrusive_single_list.h
+    // Think carefully before calling this!
+    void clear_unsafe() {
+        static_assert(PtrTraits::IsManaged == false,
+                     "clear_unsafe is not allowed for containers of managed pointers");
+
+        for (size_t i = 0; i < bucket_count(); ++i)
+            GetBucket(i).clear_unsafe();
+        count_ = 0;
+        Reset();
+    }
+
+    size_t size()      const { return count_; }
+    bool   is_empty()  const { return count_ == 0; }
+
+    // The number of buckets currently in use, including those of the old
+    // bucket array while a resize is in progress.
+    size_t bucket_count() const { return old_.count + cur_.count; }
+
+    // Whether a resize has started and not yet moved every element over.
+    bool is_rehashing() const { return old_.count != 0; }
+
+    // erase_if
+    //
+    // Find the first member of the hash table which satisfies the predicate
+    // given by 'fn' and erase it from the list, returning a referenced pointer
+    // to the removed element.  Return nullptr if no member satisfies the
+    // predicate.
+    template <typename UnaryFn>
+    PtrType erase_if(UnaryFn fn) {
+        if (is_empty())
+            return PtrType(nullptr);
+
+        for (size_t i = 0; i < bucket_count(); ++i) {
+            auto& bucket = GetBucket(i);
+            if (!bucket.is_empty()) {
+                PtrType ret = bucket.erase_if(fn);
+                if (ret != nullptr) {
+                    --count_;
+                    return ret;
+                }
+            }
+        }
+
+        return PtrType(nullptr);
+    }
+
+    // find_if
+    //
+    // Find the first member of the hash table which satisfies the predicate
+    // given by 'fn' and return an iterator to it.  Return end() if no member
+    // satisfies the predicate.
+    template <typename UnaryFn>
+    const_iterator find_if(UnaryFn fn) const {
+        for (auto iter = begin(); iter.IsValid(); ++iter)
+            if (fn(*iter))
+                return iter;
+
+        return end();
+    }
+
+    template <typename UnaryFn>
+    iterator find_if(UnaryFn fn) {
+        for (auto iter = begin(); iter.IsValid(); ++iter)
+            if (fn(*iter))
+                return iter;
+
+        return end();
+    }
+
+private:
+    // The traits of a non-const iterator
+    struct iterator_traits {
+        using RefType    = typename PtrTraits::RefType;
+        using RawPtrType = typename PtrTraits::RawPtrType;
+        using IterType   = typename BucketType::iterator;
+
+        static IterType BucketBegin(BucketType& bucket) { return bucket.begin(); }
+        static IterType BucketEnd  (BucketType& bucket) { return bucket.end(); }
+    };
+
+    // The traits of a const iterator
+    struct const_iterator_traits {
+        using RefType    = typename PtrTraits::ConstRefType;
+        using RawPtrType = typename PtrTraits::ConstRawPtrType;
+        using IterType   = typename BucketType::const_iterator;
+
+        static IterType BucketBegin(const BucketType& bucket) { return bucket.cbegin(); }
+        static IterType BucketEnd  (const BucketType& bucket) { return bucket.cend(); }
+    };
+
+    // The shared implementation of the iterator.  Iterators walk the buckets
+    // of the old bucket array (if a resize is in progress) followed by those
+    // of the current one; see GetBucket.
+    template <class IterTraits>
+    class iterator_impl {
+    public:
+        iterator_impl() { }
+        iterator_impl(const iterator_impl& other) {
+            hash_table_ = other.hash_table_;
+            bucket_ndx_ = other.bucket_ndx_;
+            iter_       = other.iter_;
+        }
+
+        iterator_impl& operator=(const iterator_impl& other) {
+            hash_table_ = other.hash_table_;
+            bucket_ndx_ = other.bucket_ndx_;
+            iter_       = other.iter_;
+            return *this;
+        }
+
+        bool IsValid() const { return iter_.IsValid(); }
+        bool operator==(const iterator_impl& other) const { return iter_ == other.iter_; }
+        bool operator!=(const iterator_impl& other) const { return iter_ != other.iter_; }
+
+        // Prefix
+        iterator_impl& operator++() {
+            if (!IsValid()) return *this;
+            ZX_DEBUG_ASSERT(hash_table_);
+
+            // Bump the bucket iterator and go looking for a new bucket if the
+            // iterator has become invalid.
+            ++iter_;
+            advance_if_invalid_iter();
+
+            return *this;
+        }
+
+        iterator_impl& operator--() {
+            // If we have never been bound to a HashTable instance, the we had
+            // better be invalid.
+            if (!hash_table_) {
+                ZX_DEBUG_ASSERT(!IsValid());
+                return *this;
+            }
+
+            // Back up the bucket iterator.  If it is still valid, then we are done.
+            --iter_;
+            if (iter_.IsValid())
+                return *this;
+
+            // If the iterator is invalid after backing up, check previous
+            // buckets to see if they contain any nodes.
+            while (bucket_ndx_) {
+                --bucket_ndx_;
+                auto& bucket = GetBucket(bucket_ndx_);
+                if (!bucket.is_empty()) {
+                    iter_ = --IterTraits::BucketEnd(bucket);
+                    ZX_DEBUG_ASSERT(iter_.IsValid());
+                    return *this;
+                }
+            }
+
+            // Looks like we have backed up past the beginning.  Update the
+            // bookkeeping to point at the end of the last bucket.
+            bucket_ndx_ = hash_table_->bucket_count() - 1;
+            iter_ = IterTraits::BucketEnd(GetBucket(bucket_ndx_));
+
+            return *this;
+        }
+
+        // Postfix
+        iterator_impl operator++(int) {
+            iterator_impl ret(*this);
+            ++(*this);
+            return ret;
+        }
+
+        iterator_impl operator--(int) {
+            iterator_impl ret(*this);
+            --(*this);
+            return ret;
+        }
+
+        typename PtrTraits::PtrType CopyPointer()          { return iter_.CopyPointer(); }
+        typename IterTraits::RefType operator*()     const { return iter_.operator*(); }
+        typename IterTraits::RawPtrType operator->() const { return iter_.operator->(); }
+
+    private:
+        friend ContainerType;
+        using IterType = typename IterTraits::IterType;
+
+        enum BeginTag { BEGIN };
+        enum EndTag { END };
+
+        iterator_impl(const ContainerType* hash_table, BeginTag)
+            : hash_table_(hash_table),
+              bucket_ndx_(0),
+              iter_(IterTraits::BucketBegin(GetBucket(0))) {
+            advance_if_invalid_iter();
+        }
+
+        iterator_impl(const ContainerType* hash_table, EndTag)
+            : hash_table_(hash_table),
+              bucket_ndx_(hash_table->bucket_count() - 1),
+              iter_(IterTraits::BucketEnd(GetBucket(bucket_ndx_))) { }
+
+        iterator_impl(const ContainerType* hash_table, size_t bucket_ndx, const IterType& iter)
+            : hash_table_(hash_table),
+              bucket_ndx_(bucket_ndx),
+              iter_(iter) { }
+
+        BucketType& GetBucket(size_t ndx) {
+            return hash_table_->GetBucket(ndx);
+        }
+
+        void advance_if_invalid_iter() {
+            // If the iterator has run off the end of it's current bucket, then
+            // check to see if there are nodes in any of the remaining buckets.
+            if (!iter_.IsValid()) {
+                const size_t last = hash_table_->bucket_count() - 1;
+                while (bucket_ndx_ < last) {
+                    ++bucket_ndx_;
+                    auto& bucket = GetBucket(bucket_ndx_);
+
+                    if (!bucket.is_empty()) {
+                        iter_ = IterTraits::BucketBegin(bucket);
+                        ZX_DEBUG_ASSERT(iter_.IsValid());
+                        break;
+                    } else if (bucket_ndx_ == last) {
+                        iter_ = IterTraits::BucketEnd(bucket);
+                    }
+                }
+            }
+        }
+
+        const ContainerType* hash_table_ = nullptr;
+        size_t bucket_ndx_ = 0;
+        IterType iter_;
+    };
+
+    // A bucket array.  A null |heap| means the inline buckets.
+    struct BucketArray {
+        BucketType* heap;
+        size_t count;
+        uint32_t shift;
+    };
+
+    static constexpr uint32_t Shift(size_t count) {
+        return count > 1 ? Shift(count >> 1) - 1 : 64;
+    }
+
+    PtrType direct_erase(BucketType& bucket, ValueType& obj) {
+        PtrType ret = internal::DirectEraseUtils<BucketType>::erase(bucket, obj);
+
+        if (ret != nullptr)
+            --count_;
+
+        return ret;
+    }
+
+    static typename BucketType::iterator FindInBucket(BucketType& bucket,
+                                                      const KeyType& key) {
+        return bucket.find_if(
+            [key](const ValueType& other) -> bool {
+                return KeyTraits::EqualTo(key, KeyTraits::GetKey(other));
+            });
+    }
+
+    static typename BucketType::const_iterator FindInBucket(const BucketType& bucket,
+                                                            const KeyType& key) {
+        return bucket.find_if(
+            [key](const ValueType& other) -> bool {
+                return KeyTraits::EqualTo(key, KeyTraits::GetKey(other));
+            });
+    }
+
+    // The test framework's 'checker' class is our friend.
+    friend CheckerType;
+
+    // Iterators need to access our bucket arrays in order to iterate.
+    friend iterator;
+    friend const_iterator;
+
+    // Hash tables may not currently be copied, assigned or moved.
+    DISALLOW_COPY_ASSIGN_AND_MOVE(ResizingHashTable);
+
+    // Maps a hash onto one of |array|'s buckets using its top bits after
+    // multiplying by 2^64 / phi.
+    static size_t HashToBucket(HashType hash, const BucketArray& array) {
+        return static_cast<size_t>((static_cast<uint64_t>(hash) * 0x9e3779b97f4a7c15ull) >>
+                                   array.shift);
+    }
+
+    BucketType* Buckets(const BucketArray& array) const {
+        return array.heap ? array.heap : const_cast<BucketType*>(inline_buckets_);
+    }
+
+    // Buckets are numbered across both bucket arrays: the old array's come
+    // first, then the current array's.  Old buckets before rehash_pos_ have
+    // already been moved and are empty.
+    BucketType& GetBucket(size_t ndx) const {
+        ZX_DEBUG_ASSERT(ndx < bucket_count());
+        return ndx < old_.count ? Buckets(old_)[ndx] : Buckets(cur_)[ndx - old_.count];
+    }
+
+    // Returns the number of the one bucket which may hold |key|.
+    size_t BucketIndex(const KeyType& key) const {
+        HashType hash = HashTraits::GetHash(key);
+        if (old_.count) {
+            size_t ndx = HashToBucket(hash, old_);
+            if (ndx >= rehash_pos_)
+                return ndx;
+        }
+        return old_.count + HashToBucket(hash, cur_);
+    }
+
+    // Called before each insert to make progress on any resize in progress,
+    // or to start one if the table is about to be too full or is too empty.
+    // This is the only place a shrink starts; see the comment at the top.
+    void PrepareInsert() {
+        if (is_rehashing()) {
+            RehashStep();
+        } else if (count_ + 1 > cur_.count * kMaxLoad) {
+            Resize(cur_.count * 2);
+        } else if (cur_.count > kMinBuckets && (count_ + 1) * kMinLoadInverse < cur_.count) {
+            Resize(cur_.count / 2);
+        }
+    }
+
+    void Resize(size_t count) {
+        BucketType* heap = nullptr;
+        if (count > kMinBuckets) {
+            AllocChecker ac;
+            heap = new (&ac) BucketType[count];
+            if (!ac.check())
+                return;
+        }
+        // Shrinking back to the inline buckets only happens from a bigger heap
+        // array, so they are already empty.
+        old_ = cur_;
+        cur_ = { heap, count, Shift(count) };
+        rehash_pos_ = 0;
+        RehashStep();
+    }
+
+    void RehashStep() {
+        BucketType* old_buckets = Buckets(old_);
+        BucketType* new_buckets = Buckets(cur_);
+        size_t moved = 0;
+        for (size_t i = 0; i < kRehashMaxVisits && moved < kRehashStep && rehash_pos_ < old_.count;
+             ++i, ++rehash_pos_) {
+            BucketType& bucket = old_buckets[rehash_pos_];
+            moved += !bucket.is_empty();
+            while (!bucket.is_empty()) {
+                PtrType ptr = bucket.pop_front();
+                HashType hash = HashTraits::GetHash(KeyTraits::GetKey(*ptr));
+                new_buckets[HashToBucket(hash, cur_)].push_front(fbl::move(ptr));
+            }
+        }
+        if (rehash_pos_ == old_.count) {
+            FreeBuckets(old_);
+            old_ = { nullptr, 0, 0 };
+            rehash_pos_ = 0;
+        }
+    }
+
+    void Reset() {
+        FreeBuckets(old_);
+        FreeBuckets(cur_);
+        old_ = { nullptr, 0, 0 };
+        cur_ = { nullptr, kMinBuckets, Shift(kMinBuckets) };
+        rehash_pos_ = 0;
+    }
+
+    static void FreeBuckets(const BucketArray& array) {
+        delete[] array.heap;
+    }
+
+    size_t count_ = 0UL;
+    BucketArray cur_ = { nullptr, kMinBuckets, Shift(kMinBuckets) };
+    BucketArray old_ = { nullptr, 0, 0 };
+    size_t rehash_pos_ = 0;
+    BucketType inline_buckets_[kMinBuckets];
+};
+
+// Explicit declaration of constexpr storage.
+#define RESIZING_HASH_TABLE_PROP(_type, _name) \
+template <typename KeyType, typename PtrType, typename BucketType, typename HashType, \
+          typename KeyTraits, typename HashTraits> \
+constexpr _type ResizingHashTable<KeyType, PtrType, BucketType, HashType, \
+                                  KeyTraits, HashTraits>::_name
+
+RESIZING_HASH_TABLE_PROP(size_t, kMinBuckets);
+RESIZING_HASH_TABLE_PROP(size_t, kMaxLoad);
+RESIZING_HASH_TABLE_PROP(size_t, kMinLoadInverse);
+RESIZING_HASH_TABLE_PROP(size_t, kRehashStep);
+RESIZING_HASH_TABLE_PROP(size_t, kRehashMaxVisits);
+RESIZING_HASH_TABLE_PROP(bool, SupportsConstantOrderErase);
+RESIZING_HASH_TABLE_PROP(bool, SupportsConstantOrderSize);
+RESIZING_HASH_TABLE_PROP(bool, IsAssociative);
+RESIZING_HASH_TABLE_PROP(bool, IsSequenced);
+
+#undef RESIZING_HASH_TABLE_PROP
+
+}  // namespace fbl
@@ -6,6 +6,7 @@
 
 #include <zircon/compiler.h>
 #include <fbl/algorithm.h>
+#include <fbl/atomic.h>
 #include <fbl/auto_lock.h>
 #include <fbl/deleter.h>
 #include <fbl/intrusive_single_list.h>
@@ -17,6 +18,10 @@
 #include <fbl/type_support.h>
 #include <fbl/unique_ptr.h>
 
+#ifdef _KERNEL
+#include <arch/ops.h>
+#endif
+
 // Usage Notes:
 //
 // fbl::SlabAllocator<> is a utility class which implements a slab-style
@@ -36,6 +41,7 @@
 // ++ The size of the slabs of memory which get allocated.
 // ++ The synchronization primitive used to achieve thread safety.
 // ++ The static/instanced/manual-delete nature of the allocator.
+// ++ The size of the optional per-thread magazines.
 //
 // Details on each of these items are included in the sections below.
 //
@@ -95,6 +101,31 @@
 //
 // fbl::SlabAllocator<UnlockedStaticSlabAllocator<fbl::unique_ptr<MyObject>> allocator;
 //
+// :: Per-thread Magazines ::
+//
+// An allocator shared by many threads serializes every New and delete on its
+// single lock.  Setting the MAGAZINE_SIZE parameter of the
+// SlabAllocatorTraits<> struct to something other than 0 puts a layer of
+// small caches ("magazines") in front of the shared free list.  The allocator
+// keeps SlabMagazineCount magazines, each with its own LockType and room for
+// MAGAZINE_SIZE free objects.  Threads are spread across the magazines (in the
+// kernel, CPUs are), so each magazine lock is rarely contended and the shared
+// lock is only taken to move half a magazine's worth of objects at a time.
+//
+// Magazines do not change the slab quota.  When the shared free list and the
+// slab quota are both exhausted, an allocation will take a free object from
+// another thread's magazine before giving up, so New only fails when every
+// object the allocator is permitted to create is actually in use.
+//
+// CachedInstancedSlabAllocatorTraits or CachedStaticSlabAllocatorTraits may be
+// used as a shorthand for enabling magazines.
+//
+// ** Example **
+//
+// using MyAllocatorTraits =
+//     fbl::CachedInstancedSlabAllocatorTraits<fbl::unique_ptr<MyObject>>;
+// fbl::SlabAllocator<MyAllocatorTraits> allocator(64);
+//
 // :: Object Requirements ::
 //
 // Objects must be small enough that at least 1 can be allocated from a slab
@@ -283,11 +314,16 @@ enum class SlabAllocatorFlavor {
 template <typename T,
           size_t   SLAB_SIZE,
           typename LockType,
-          SlabAllocatorFlavor AllocatorFlavor> struct SlabAllocatorTraits;
+          SlabAllocatorFlavor AllocatorFlavor,
+          size_t   MAGAZINE_SIZE> struct SlabAllocatorTraits;
 template <typename SATraits, typename = void> class SlabAllocator;
 template <typename SATraits, typename = void> class SlabAllocated;
 
 constexpr size_t DEFAULT_SLAB_ALLOCATOR_SLAB_SIZE = (16 << 10u);
+constexpr size_t DEFAULT_SLAB_ALLOCATOR_MAGAZINE_SIZE = 32;
+
+// The number of magazines kept by allocators which have them enabled.
+constexpr size_t SlabMagazineCount = 16;
 
 namespace internal {
 
@@ -348,6 +384,42 @@ struct SlabOriginSetter<SATraits,
                                  internal::SlabAllocator<SATraits>* origin) { }
 };
 
+// Selects the magazine which the calling thread should use.  In the kernel,
+// this is the current CPU.  In user mode, threads are assigned magazines
+// round-robin the first time they use any magazine-enabled allocator.
+inline size_t SlabMagazineIndex() {
+#ifdef _KERNEL
+    return arch_curr_cpu_num() % SlabMagazineCount;
+#else
+    static atomic<size_t> next_index(0);
+    static thread_local size_t thread_index = 0;
+
+    // thread_index holds the assigned magazine plus one so that zero can mean
+    // "not yet assigned".
+    if (thread_index == 0)
+        thread_index = (next_index.fetch_add(1, memory_order_relaxed) % SlabMagazineCount) + 1;
+    return thread_index - 1;
+#endif
+}
+
+// A small, separately locked cache of free objects.  Allocators with
+// magazines disabled carry an empty array of these.
+template <typename LockType, size_t MAGAZINE_SIZE>
+struct SlabMagazine {
+    LockType lock;
+    size_t   count = 0;
+    void*    objs[MAGAZINE_SIZE];
+};
+
+template <typename LockType, size_t MAGAZINE_SIZE>
+struct SlabMagazineArray {
+    SlabMagazine<LockType, MAGAZINE_SIZE>& current() { return magazines[SlabMagazineIndex()]; }
+    SlabMagazine<LockType, MAGAZINE_SIZE> magazines[SlabMagazineCount];
+};
+
+template <typename LockType>
+struct SlabMagazineArray<LockType, 0> { };
+
 // Non-templated SlabAllocatorBase.  Any code which does not strictly depend on
 // trait/type awareness lives here in order to minimize code size explosion due
 // to template expansion.
@@ -514,6 +586,10 @@ public:
 
     static_assert(AllocsPerSlab > 0, "SLAB_SIZE too small to hold even 1 allocation");
 
+    static constexpr size_t MagazineSize = SATraits::MAGAZINE_SIZE;
+    static_assert((MagazineSize == 0) || (MagazineSize >= 2),
+                  "MAGAZINE_SIZE must be 0 (disabled) or at least 2");
+
     // Slab allocated objects must derive from SlabAllocated<SATraits>.
     static_assert(is_base_of<SlabAllocated<SATraits>, ObjType>::value,
                   "Objects which are slab allocated from an allocator of type "
@@ -529,7 +605,7 @@ public:
                             max_slabs,
                             alloc_initial) { }
 
-    ~SlabAllocator() { }
+    ~SlabAllocator() { DrainMagazines(integral_constant<bool, (MagazineSize > 0)>()); }
 
     template <typename... ConstructorSignature>
     PtrType New(ConstructorSignature&&... args) {
@@ -563,12 +639,23 @@ protected:
     friend class ::fbl::SlabAllocator<SATraits>;
     friend class ::fbl::SlabAllocated<SATraits>;
 
+    using LockType      = typename SATraits::LockType;
+    using MagazineType  = SlabMagazine<LockType, MagazineSize>;
+
     void* Allocate() {
+        return Allocate(integral_constant<bool, (MagazineSize > 0)>());
+    }
+
+    void ReturnToFreeList(void* ptr) {
+        ReturnToFreeList(ptr, integral_constant<bool, (MagazineSize > 0)>());
+    }
+
+    void* Allocate(false_type) {
         AutoLock alloc_lock(&this->alloc_lock_);
         return AllocateLocked();
     }
 
-    void ReturnToFreeList(void* ptr) {
+    void ReturnToFreeList(void* ptr, false_type) {
         FreeListEntry* free_obj = new (ptr) FreeListEntry;
         {
             AutoLock alloc_lock(&alloc_lock_);
@@ -576,7 +663,69 @@ protected:
         }
     }
 
-    typename SATraits::LockType alloc_lock_;
+    void* Allocate(true_type) {
+        {
+            MagazineType& mag = magazines_.current();
+            AutoLock mag_lock(&mag.lock);
+
+            // If our magazine is empty, refill half of it from the shared pool
+            // so that the next several allocations and frees both stay local.
+            if (mag.count == 0) {
+                AutoLock alloc_lock(&alloc_lock_);
+                while (mag.count < (MagazineSize / 2)) {
+                    void* mem = AllocateLocked();
+                    if (mem == nullptr)
+                        break;
+                    mag.objs[mag.count++] = mem;
+                }
+            }
+
+            if (mag.count > 0)
+                return mag.objs[--mag.count];
+        }
+
+        // The shared pool is out of objects and slab quota.  Before failing,
+        // take an object which is sitting idle in some other magazine.  Only
+        // one magazine lock is ever held at a time.
+        for (auto& mag : magazines_.magazines) {
+            AutoLock mag_lock(&mag.lock);
+            if (mag.count > 0)
+                return mag.objs[--mag.count];
+        }
+
+        return nullptr;
+    }
+
+    void ReturnToFreeList(void* ptr, true_type) {
+        MagazineType& mag = magazines_.current();
+        AutoLock mag_lock(&mag.lock);
+
+        // If our magazine is full, return the older half of it to the shared
+        // pool to make room.
+        if (mag.count == MagazineSize) {
+            AutoLock alloc_lock(&alloc_lock_);
+            for (size_t i = 0; i < (MagazineSize / 2); ++i)
+                ReturnToFreeListLocked(mag.objs[i]);
+            mag.count -= MagazineSize / 2;
+            for (size_t i = 0; i < mag.count; ++i)
+                mag.objs[i] = mag.objs[i + (MagazineSize / 2)];
+        }
+
+        mag.objs[mag.count++] = ptr;
+    }
+
+    // Everything cached in a magazine must be back on the shared free list
+    // before SlabAllocatorBase checks that all allocations were returned.
+    void DrainMagazines(false_type) { }
+    void DrainMagazines(true_type) {
+        for (auto& mag : magazines_.magazines) {
+            while (mag.count > 0)
+                ReturnToFreeListLocked(mag.objs[--mag.count]);
+        }
+    }
+
+    LockType alloc_lock_;
+    SlabMagazineArray<LockType, MagazineSize> magazines_;
 };
 }  // namespace internal
 
@@ -598,7 +747,7 @@ protected:
 // ++ LockType
 //  The fbl::AutoLock compatible class which will handle synchronization.
 //
-// ++ AllocatorType
+// ++ AllocatorFlavor
 //  Selects between a the three flavors of allocator.
 //  ++ INSTANCED - Allocations come from an instance of an allocator.
 //     Allocation objects carry the overhead of an "origin pointer" which will
@@ -618,11 +767,16 @@ protected:
 //     the object to the allocator it came from.  MANUAL_DELETE allocators are
 //     only permitted for unmanaged pointer types.
 //
+// ++ MAGAZINE_SIZE
+//  The number of free objects each per-thread magazine may hold, or 0 (the
+//  default) to disable magazines.  See "Per-thread Magazines" above.
+//
 ////////////////////////////////////////////////////////////////////////////////
 template <typename T,
           size_t   _SLAB_SIZE = DEFAULT_SLAB_ALLOCATOR_SLAB_SIZE,
           typename _LockType  = ::fbl::Mutex,
-          SlabAllocatorFlavor _AllocatorFlavor = SlabAllocatorFlavor::INSTANCED>
+          SlabAllocatorFlavor _AllocatorFlavor = SlabAllocatorFlavor::INSTANCED,
+          size_t   _MAGAZINE_SIZE = 0>
 struct SlabAllocatorTraits {
     using PtrTraits     = internal::SlabAllocatorPtrTraits<T>;
     using PtrType       = typename PtrTraits::PtrType;
@@ -631,6 +785,7 @@ struct SlabAllocatorTraits {
 
     static constexpr size_t SLAB_SIZE = _SLAB_SIZE;
     static constexpr SlabAllocatorFlavor AllocatorFlavor = _AllocatorFlavor;
+    static constexpr size_t MAGAZINE_SIZE = _MAGAZINE_SIZE;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -751,6 +906,15 @@ template <typename T,
 using UnlockedSlabAllocatorTraits =
     SlabAllocatorTraits<T, SLAB_SIZE, ::fbl::NullLock>;
 
+// Shorthand for declaring the properties of an instanced allocator with
+// per-thread magazines.
+template <typename T,
+          size_t   MAGAZINE_SIZE = DEFAULT_SLAB_ALLOCATOR_MAGAZINE_SIZE,
+          size_t   SLAB_SIZE = DEFAULT_SLAB_ALLOCATOR_SLAB_SIZE,
+          typename LockType  = ::fbl::Mutex>
+using CachedInstancedSlabAllocatorTraits =
+    SlabAllocatorTraits<T, SLAB_SIZE, LockType, SlabAllocatorFlavor::INSTANCED, MAGAZINE_SIZE>;
+
 // Shorthand for declaring the properties of a MANUAL_DELETE slab allocator.
 template <typename T,
           size_t   SLAB_SIZE = DEFAULT_SLAB_ALLOCATOR_SLAB_SIZE,
@@ -834,6 +998,15 @@ template <typename T,
 using UnlockedStaticSlabAllocatorTraits =
     SlabAllocatorTraits<T, SLAB_SIZE, ::fbl::NullLock, SlabAllocatorFlavor::STATIC>;
 
+// Shorthand for declaring the properties of a static allocator with per-thread
+// magazines.
+template <typename T,
+          size_t   MAGAZINE_SIZE = DEFAULT_SLAB_ALLOCATOR_MAGAZINE_SIZE,
+          size_t   SLAB_SIZE = DEFAULT_SLAB_ALLOCATOR_SLAB_SIZE,
+          typename LockType  = ::fbl::Mutex>
+using CachedStaticSlabAllocatorTraits =
+    SlabAllocatorTraits<T, SLAB_SIZE, LockType, SlabAllocatorFlavor::STATIC, MAGAZINE_SIZE>;
+
 // Shorthand for declaring the global storage required for a static allocator
 #define DECLARE_STATIC_SLAB_ALLOCATOR_STORAGE(ALLOC_TRAITS, ...) \
 template<> ::fbl::SlabAllocator<ALLOC_TRAITS>::InternalAllocatorType \
@@ -26,12 +26,18 @@ zx_status_t bootfs_create(bootfs_t* bfs, zx_handle_t vmo) {
         printf("bootfs_create: incorrect bootdata header: %x\n", hdr.magic);
         return ZX_ERR_IO;
     }
+    if ((hdr.dirsize % sizeof(uint32_t)) ||
+        (hdr.index_count > (UINT32_MAX - sizeof(hdr) - hdr.dirsize) /
+                           sizeof(uint32_t))) {
+        printf("bootfs_create: bogus directory size\n");
+        return ZX_ERR_IO;
+    }
     if ((r = zx_handle_duplicate(vmo, ZX_RIGHT_SAME_RIGHTS, &bfs->vmo)) < 0) {
         return r;
     }
     uintptr_t addr;
     if ((r = zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0,
-                         sizeof(hdr) + hdr.dirsize,
+                         sizeof(hdr) + hdr.dirsize + BOOTFS_INDEX_SIZE(&hdr),
                          ZX_VM_FLAG_PERM_READ, &addr)) < 0) {
         printf("boofts_create: couldn't map directory: %d\n", r);
         zx_handle_close(bfs->vmo);
@@ -39,6 +45,8 @@ zx_status_t bootfs_create(bootfs_t* bfs, zx_handle_t vmo) {
     }
     bfs->dirsize = hdr.dirsize;
     bfs->dir = (void*)addr + sizeof(hdr);
+    bfs->index_count = hdr.index_count;
+    bfs->index = (const uint32_t*)(bfs->dir + hdr.dirsize);
     return ZX_OK;
 }
 
@@ -46,7 +54,54 @@ void bootfs_destroy(bootfs_t* bfs) {
     zx_handle_close(bfs->vmo);
     zx_vmar_unmap(zx_vmar_root_self(),
                   (uintptr_t)bfs->dir - sizeof(bootfs_header_t),
-                  bfs->dirsize);
+                  sizeof(bootfs_header_t) + bfs->dirsize +
+                  bfs->index_count * sizeof(uint32_t));
+}
+
+// Returns the entry at offset off in the directory, or NULL if it's bogus.
+static bootfs_entry_t* bootfs_entry_at(bootfs_t* bfs, size_t off) {
+    if ((off > bfs->dirsize) || (bfs->dirsize - off <= sizeof(bootfs_entry_t))) {
+        return NULL;
+    }
+    bootfs_entry_t* e = bfs->dir + off;
+    size_t sz = BOOTFS_RECSIZE(e);
+    if ((e->name_len < 1) || (e->name_len > BOOTFS_MAX_NAME_LEN) ||
+        (e->name[e->name_len - 1] != 0) || (sz > bfs->dirsize - off)) {
+        return NULL;
+    }
+    return e;
+}
+
+// Binary search the sorted index for name.
+// Duplicate names are indexed in directory order, so this finds the same
+// entry as a linear scan would.
+static zx_status_t bootfs_lookup_index(bootfs_t* bfs, const char* name,
+                                       bootfs_entry_t** out) {
+    size_t lo = 0;
+    size_t hi = bfs->index_count;
+    bootfs_entry_t* found = NULL;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        bootfs_entry_t* e = bootfs_entry_at(bfs, bfs->index[mid]);
+        if (e == NULL) {
+            printf("bootfs: bogus index entry!\n");
+            return ZX_ERR_IO;
+        }
+        int r = strcmp(e->name, name);
+        if (r < 0) {
+            lo = mid + 1;
+        } else {
+            if (r == 0) {
+                found = e;
+            }
+            hi = mid;
+        }
+    }
+    if (found == NULL) {
+        return ZX_ERR_NOT_FOUND;
+    }
+    *out = found;
+    return ZX_OK;
 }
 
 zx_status_t bootfs_parse(bootfs_t* bfs,
@@ -77,6 +132,16 @@ zx_status_t bootfs_open(bootfs_t* bfs, const char* name, zx_handle_t* vmo_out) {
     size_t avail = bfs->dirsize;
     void* p = bfs->dir;
     bootfs_entry_t* e;
+    if (bfs->index_count > 0) {
+        zx_status_t r = bootfs_lookup_index(bfs, name, &e);
+        if (r == ZX_OK) {
+            goto found;
+        }
+        if (r == ZX_ERR_NOT_FOUND) {
+            printf("bootfs_open: '%s' not found\n", name);
+        }
+        return r;
+    }
     while (avail > sizeof(bootfs_entry_t)) {
         e = p;
         size_t sz = BOOTFS_RECSIZE(e);
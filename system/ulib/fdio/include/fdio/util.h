@@ -42,6 +42,9 @@ typedef struct bootfs {
     zx_handle_t vmo;
     uint32_t dirsize;
     void* dir;
+    // Sorted directory index, if the image has one (see bootdata.h).
+    uint32_t index_count;
+    const uint32_t* index;
 } bootfs_t;
 
 zx_status_t bootfs_create(bootfs_t* bfs, zx_handle_t vmo);
@@ -9,6 +9,7 @@
 #include <limits.h>
 #include <poll.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
@@ -41,6 +42,8 @@
 
 static_assert(FDIO_FLAG_CLOEXEC == FD_CLOEXEC, "Unexpected fdio flags value");
 
+static void fdio_waitset_forget(void);
+
 // non-thread-safe emulation of unistd io functions
 // using the fdio transports
 
@@ -102,6 +105,7 @@ free_fd_found:
     if (io_to_close) {
         io_to_close->ops->close(io_to_close);
         fdio_release(io_to_close);
+        fdio_waitset_forget();
     }
     return fd;
 }
@@ -172,7 +176,9 @@ zx_status_t fdio_close(fdio_t* io) {
     if (io->dupcount > 0) {
         printf("fdio_close(%p): dupcount nonzero!\n", io);
     }
-    return io->ops->close(io);
+    zx_status_t r = io->ops->close(io);
+    fdio_waitset_forget();
+    return r;
 }
 
 // Possibly return an owned fdio_t corresponding to either the root,
@@ -1028,6 +1034,7 @@ int close(int fd) {
         mtx_unlock(&fdio_lock);
         int r = io->ops->close(io);
         fdio_release(io);
+        fdio_waitset_forget();
         return STATUS(r);
     }
 }
@@ -1796,6 +1803,177 @@ void __fdio_release(fdio_t* io) {
 // TODO: getrlimit(RLIMIT_NOFILE, ...)
 #define MAX_POLL_NFDS 1024
 
+// Smaller sets are cheap enough to hand to zx_object_wait_many().
+#define WAITSET_MIN_ITEMS 4
+
+// poll() and select() tend to be called over and over on the same fds, and
+// zx_object_wait_many() has to register with every handle on every call.
+// Instead, the last set of (handle, signals) pairs waited on stays
+// registered in a wait set, with each item's index as its cookie, and only
+// the entries that changed are updated on the next call. The cached set
+// serves one caller at a time; callers that find it busy fall back to
+// zx_object_wait_many().
+//
+// Entries keep their objects alive, so the set is dropped whenever an fd is
+// closed, and rebuilt by the next caller. The item and result arrays grow
+// to the largest set waited on.
+static struct {
+    mtx_t lock;
+    zx_handle_t handle;
+    uint32_t count;
+    uint32_t capacity;
+    zx_wait_item_t* items;
+    zx_waitset_result_t* results;
+    // set by closes that found the set busy
+    atomic_bool stale;
+} fdio_waitset = {
+    .lock = MTX_INIT,
+    .handle = ZX_HANDLE_INVALID,
+};
+
+static void fdio_waitset_reset_locked(void) {
+    // closing the wait set drops all of its entries
+    zx_handle_close(fdio_waitset.handle);
+    fdio_waitset.handle = ZX_HANDLE_INVALID;
+    fdio_waitset.count = 0;
+}
+
+static void fdio_waitset_forget(void) {
+    if (mtx_trylock(&fdio_waitset.lock) == thrd_success) {
+        fdio_waitset_reset_locked();
+        atomic_store(&fdio_waitset.stale, false);
+        mtx_unlock(&fdio_waitset.lock);
+    } else {
+        // the waiter drops the set once it is done with it
+        atomic_store(&fdio_waitset.stale, true);
+    }
+}
+
+static zx_status_t fdio_waitset_reserve_locked(uint32_t count) {
+    if (count <= fdio_waitset.capacity) {
+        return ZX_OK;
+    }
+    zx_wait_item_t* items = realloc(fdio_waitset.items, count * sizeof(*items));
+    if (items == NULL) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    fdio_waitset.items = items;
+    zx_waitset_result_t* results = realloc(fdio_waitset.results, count * sizeof(*results));
+    if (results == NULL) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    fdio_waitset.results = results;
+    fdio_waitset.capacity = count;
+    return ZX_OK;
+}
+
+static zx_status_t fdio_waitset_update_locked(zx_wait_item_t* items, uint32_t count) {
+    zx_status_t r;
+    if (atomic_exchange(&fdio_waitset.stale, false)) {
+        fdio_waitset_reset_locked();
+    }
+    if ((r = fdio_waitset_reserve_locked(count)) < 0) {
+        return r;
+    }
+    if (fdio_waitset.handle == ZX_HANDLE_INVALID) {
+        if ((r = zx_waitset_create(0, &fdio_waitset.handle)) < 0) {
+            return r;
+        }
+    }
+
+    zx_handle_t ws = fdio_waitset.handle;
+    for (uint32_t i = 0; i < count; i++) {
+        zx_wait_item_t* cached = &fdio_waitset.items[i];
+        if (i < fdio_waitset.count) {
+            if ((cached->handle == items[i].handle) && (cached->waitfor == items[i].waitfor)) {
+                continue;
+            }
+            zx_waitset_remove(ws, i);
+        }
+        if ((r = zx_waitset_add(ws, i, items[i].handle, items[i].waitfor)) < 0) {
+            fdio_waitset_reset_locked();
+            return r;
+        }
+        cached->handle = items[i].handle;
+        cached->waitfor = items[i].waitfor;
+    }
+    for (uint32_t i = count; i < fdio_waitset.count; i++) {
+        zx_waitset_remove(ws, i);
+    }
+    fdio_waitset.count = count;
+    return ZX_OK;
+}
+
+static zx_status_t fdio_waitset_wait_locked(zx_wait_item_t* items, uint32_t count,
+                                            zx_time_t deadline) {
+    for (;;) {
+        // Only triggered entries are reported, and an untriggered entry has
+        // none of the signals it waits for asserted, so every item starts
+        // out clear, including on timeout.
+        for (uint32_t i = 0; i < count; i++) {
+            items[i].pending = 0;
+        }
+
+        uint32_t actual;
+        zx_status_t r = zx_waitset_wait(fdio_waitset.handle, deadline,
+                                        fdio_waitset.results, count, &actual);
+        if (r != ZX_OK) {
+            if (r != ZX_ERR_TIMED_OUT) {
+                fdio_waitset_reset_locked();
+            }
+            return r;
+        }
+
+        // An entry whose handle was closed stays in the set. If the handle
+        // value has been reused since then, the entry is just stale and is
+        // added again; if not, adding it fails the same way handing the
+        // closed handle to zx_object_wait_many() would.
+        bool stale = false;
+        for (uint32_t i = 0; i < actual; i++) {
+            zx_waitset_result_t* result = &fdio_waitset.results[i];
+            uint32_t j = (uint32_t)result->cookie;
+            if (result->status == ZX_OK) {
+                items[j].pending = result->observed;
+                continue;
+            }
+            stale = true;
+            zx_waitset_remove(fdio_waitset.handle, j);
+            if ((r = zx_waitset_add(fdio_waitset.handle, j, items[j].handle,
+                                    items[j].waitfor)) < 0) {
+                fdio_waitset_reset_locked();
+                return r;
+            }
+        }
+        if (!stale) {
+            return ZX_OK;
+        }
+    }
+}
+
+// Same contract as zx_object_wait_many().
+static zx_status_t fdio_wait_many(zx_wait_item_t* items, uint32_t count, zx_time_t deadline) {
+    if ((count < WAITSET_MIN_ITEMS) || (mtx_trylock(&fdio_waitset.lock) != thrd_success)) {
+        return zx_object_wait_many(items, count, deadline);
+    }
+
+    zx_status_t r = fdio_waitset_update_locked(items, count);
+    if (r == ZX_OK) {
+        r = fdio_waitset_wait_locked(items, count, deadline);
+    }
+    if (atomic_exchange(&fdio_waitset.stale, false)) {
+        // an fd was closed while waiting
+        fdio_waitset_reset_locked();
+    }
+    mtx_unlock(&fdio_waitset.lock);
+
+    if (r != ZX_OK && r != ZX_ERR_TIMED_OUT) {
+        // let zx_object_wait_many() report the error, or succeed where the
+        // wait set could not
+        return zx_object_wait_many(items, count, deadline);
+    }
+    return r;
+}
+
 int poll(struct pollfd* fds, nfds_t n, int timeout) {
     if (n > MAX_POLL_NFDS) {
         return ERRNO(EINVAL);
@@ -1844,7 +2022,7 @@ int poll(struct pollfd* fds, nfds_t n, int timeout) {
     int nfds = 0;
     if (r == ZX_OK && nvalid > 0) {
         zx_time_t tmo = (timeout >= 0) ? zx_deadline_after(ZX_MSEC(timeout)) : ZX_TIME_INFINITE;
-        r = zx_object_wait_many(items, nvalid, tmo);
+        r = fdio_wait_many(items, nvalid, tmo);
         // pending signals could be reported on ZX_ERR_TIMED_OUT case as well
         if (r == ZX_OK || r == ZX_ERR_TIMED_OUT) {
             nfds_t j = 0; // j counts up on a valid entry
@@ -1933,7 +2111,7 @@ int select(int n, fd_set* restrict rfds, fd_set* restrict wfds, fd_set* restrict
     if (r == ZX_OK && nvalid > 0) {
         zx_time_t tmo = (tv == NULL) ? ZX_TIME_INFINITE :
             zx_deadline_after(ZX_SEC(tv->tv_sec) + ZX_USEC(tv->tv_usec));
-        r = zx_object_wait_many(items, nvalid, tmo);
+        r = fdio_wait_many(items, nvalid, tmo);
         // pending signals could be reported on ZX_ERR_TIMED_OUT case as well
         if (r == ZX_OK || r == ZX_ERR_TIMED_OUT) {
             int j = 0; // j counts up on a valid entry
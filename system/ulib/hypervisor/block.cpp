@@ -8,6 +8,7 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
 #include <hypervisor/block.h>
 #include <hypervisor/io_apic.h>
@@ -19,20 +20,63 @@
 #include <zircon/syscalls.h>
 #include <zircon/syscalls/hypervisor.h>
 
+// A request taken off a queue by the batched path. The data segments point
+// directly into guest memory.
+typedef struct block_request {
+    uint16_t head;
+    uint32_t type;
+    // Byte offset of the data on disk, and its total length.
+    off_t off;
+    size_t len;
+    struct {
+        uint8_t* addr;
+        uint32_t len;
+    } segs[VirtioBlock::kMaxSegments];
+    uint32_t num_segs;
+    uint8_t* status;
+    uint8_t result;
+} block_request_t;
+
+// Per-queue state for the batched path. A batch's request buffers come to
+// about 18 KB, so they live here rather than on the stack of whichever
+// thread is servicing the queue.
+typedef struct block_queue {
+    VirtioBlock* block;
+    virtio_queue_t* queue;
+    thrd_t thread;
+    uint16_t heads[VirtioBlock::kMaxBatch];
+    block_request_t reqs[VirtioBlock::kMaxBatch];
+    block_request_t* pending[VirtioBlock::kMaxBatch];
+    vring_used_elem used[VirtioBlock::kMaxBatch];
+} block_queue_t;
+
 zx_status_t VirtioBlock::HandleQueueNotify(uint16_t queue_sel) {
-    if (queue_sel != 0)
+    if (queue_sel >= kNumQueues)
         return ZX_ERR_INVALID_ARGS;
-    return FileBlockDevice();
+
+    // Once the workers are running, they are woken by the notify itself.
+    if (started_)
+        return ZX_OK;
+    return FileBlockDevice(queue_sel);
 }
 
 VirtioBlock::VirtioBlock(uintptr_t guest_physmem_addr, size_t guest_physmem_size)
-    : VirtioDevice(VIRTIO_ID_BLOCK, &config_, sizeof(config_), &queue_, 1,
+    : VirtioDevice(VIRTIO_ID_BLOCK, &config_, sizeof(config_), request_queues_, kNumQueues,
                    guest_physmem_addr, guest_physmem_size) {
     config_.blk_size = kSectorSize;
+    config_.seg_max = kMaxSegments;
+    config_.num_queues = kNumQueues;
     // Virtio 1.0: 5.2.5.2: Devices SHOULD always offer VIRTIO_BLK_F_FLUSH
     add_device_features(VIRTIO_BLK_F_FLUSH
                         // Required by zircon guests.
-                        | VIRTIO_BLK_F_BLK_SIZE);
+                        | VIRTIO_BLK_F_BLK_SIZE
+                        | VIRTIO_BLK_F_SEG_MAX
+                        | VIRTIO_BLK_F_MQ);
+    cnd_init(&start_cnd_);
+}
+
+VirtioBlock::~VirtioBlock() {
+    cnd_destroy(&start_cnd_);
 }
 
 zx_status_t VirtioBlock::Init(const char* path) {
@@ -65,6 +109,15 @@ zx_status_t VirtioBlock::Init(const char* path) {
 
     config_.capacity = size_ / kSectorSize;
 
+    fbl::AllocChecker ac;
+    block_queues_.reset(new (&ac) block_queue_t[kNumQueues]);
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+    for (uint16_t i = 0; i < kNumQueues; ++i) {
+        block_queues_[i].block = this;
+        block_queues_[i].queue = &request_queues_[i];
+    }
+
     return ZX_OK;
 }
 
@@ -94,23 +147,16 @@ zx_status_t VirtioBlock::FileRequest(file_state_t* state, void* addr, uint32_t l
     if (blk_req->type == VIRTIO_BLK_T_FLUSH && blk_req->sector != 0)
         return ZX_ERR_IO_DATA_INTEGRITY;
 
-    fbl::AutoLock lock(&file_mutex_);
-    off_t ret;
-    if (blk_req->type != VIRTIO_BLK_T_FLUSH) {
-        off_t off = blk_req->sector * kSectorSize + state->off;
-        state->off += len;
-        ret = lseek(fd_, off, SEEK_SET);
-        if (ret < 0) {
-            return ZX_ERR_IO;
-        }
-    }
-
+    ssize_t ret;
+    off_t off = blk_req->sector * kSectorSize + state->off;
     switch (blk_req->type) {
     case VIRTIO_BLK_T_IN:
-        ret = read(fd_, addr, len);
+        state->off += len;
+        ret = pread(fd_, addr, len, off);
         break;
     case VIRTIO_BLK_T_OUT:
-        ret = write(fd_, addr, len);
+        state->off += len;
+        ret = pwrite(fd_, addr, len, off);
         break;
     case VIRTIO_BLK_T_FLUSH:
         len = 0;
@@ -174,7 +220,10 @@ zx_status_t VirtioBlock::QueueHandler(void* addr, uint32_t len, uint16_t flags,
     return ZX_OK;
 }
 
-zx_status_t VirtioBlock::FileBlockDevice() {
+zx_status_t VirtioBlock::FileBlockDevice(uint16_t queue_sel) {
+    if (queue_sel >= kNumQueues)
+        return ZX_ERR_INVALID_ARGS;
+
     zx_status_t status;
     do {
         file_state_t state = {
@@ -184,7 +233,260 @@ zx_status_t VirtioBlock::FileBlockDevice() {
             .blk_req = NULL,
             .status = VIRTIO_BLK_S_OK,
         };
-        status = virtio_queue_handler(&queue_, &VirtioBlock::QueueHandler, &state);
+        status = virtio_queue_handler(&request_queues_[queue_sel], &VirtioBlock::QueueHandler,
+                                      &state);
     } while (status == ZX_ERR_NEXT);
     return status;
 }
+
+zx_status_t VirtioBlock::ParseRequest(virtio_queue_t* queue, uint16_t head,
+                                      block_request_t* req) {
+    virtio_desc_t desc;
+    zx_status_t status = virtio_queue_read_desc(queue, head, &desc);
+    if (status != ZX_OK)
+        return status;
+    if (desc.len != sizeof(virtio_blk_req_t) || !desc.has_next)
+        return ZX_ERR_INVALID_ARGS;
+
+    const virtio_blk_req_t* blk_req = static_cast<const virtio_blk_req_t*>(desc.addr);
+    req->head = head;
+    req->type = blk_req->type;
+    req->off = blk_req->sector * kSectorSize;
+    req->len = 0;
+    req->num_segs = 0;
+    req->status = nullptr;
+    req->result = VIRTIO_BLK_S_OK;
+
+    // Bound the walk so a looping chain can't hold the worker forever.
+    for (uint32_t i = 0; i < queue->size; ++i) {
+        status = virtio_queue_read_desc(queue, desc.next, &desc);
+        if (status != ZX_OK)
+            return status;
+
+        // Status.
+        if (!desc.has_next) {
+            if (desc.len != sizeof(uint8_t))
+                return ZX_ERR_INVALID_ARGS;
+            req->status = static_cast<uint8_t*>(desc.addr);
+            return ZX_OK;
+        }
+
+        // Payload.
+        if (req->num_segs == kMaxSegments)
+            return ZX_ERR_OUT_OF_RANGE;
+        req->segs[req->num_segs].addr = static_cast<uint8_t*>(desc.addr);
+        req->segs[req->num_segs].len = desc.len;
+        req->num_segs++;
+        req->len += desc.len;
+    }
+    return ZX_ERR_OUT_OF_RANGE;
+}
+
+// Reads or writes |len| bytes at |addr| to or from |off|.
+static bool file_io(int fd, uint32_t type, uint8_t* addr, size_t len, off_t off) {
+    ssize_t ret = type == VIRTIO_BLK_T_IN ? pread(fd, addr, len, off)
+                                          : pwrite(fd, addr, len, off);
+    return ret >= 0 && static_cast<size_t>(ret) == len;
+}
+
+void VirtioBlock::HandleReadWrites(block_request_t** reqs, size_t count) {
+    // Order the requests by type and position, so that reads and writes of
+    // adjacent sectors end up next to each other. Batches are small, so an
+    // insertion sort will do.
+    for (size_t i = 1; i < count; ++i) {
+        block_request_t* req = reqs[i];
+        size_t j = i;
+        for (; j > 0; --j) {
+            block_request_t* prev = reqs[j - 1];
+            if (prev->type < req->type || (prev->type == req->type && prev->off <= req->off))
+                break;
+            reqs[j] = prev;
+        }
+        reqs[j] = req;
+    }
+
+    size_t first = 0;
+    while (first < count) {
+        // Extend the run for as long as each request starts where the
+        // previous one ended.
+        size_t last = first;
+        while (last + 1 < count && reqs[last + 1]->type == reqs[first]->type &&
+               reqs[last + 1]->off == reqs[last]->off + static_cast<off_t>(reqs[last]->len)) {
+            last++;
+        }
+
+        // Then do the run's I/O, coalescing the segments that are also
+        // contiguous in guest memory.
+        uint32_t type = reqs[first]->type;
+        off_t off = reqs[first]->off;
+        uint8_t* addr = nullptr;
+        size_t len = 0;
+        bool ok = true;
+        for (size_t i = first; ok && i <= last; ++i) {
+            block_request_t* req = reqs[i];
+            for (uint32_t j = 0; ok && j < req->num_segs; ++j) {
+                if (len > 0 && addr + len == req->segs[j].addr) {
+                    len += req->segs[j].len;
+                    continue;
+                }
+                if (len > 0)
+                    ok = file_io(fd_, type, addr, len, off);
+                off += len;
+                addr = req->segs[j].addr;
+                len = req->segs[j].len;
+            }
+        }
+        if (ok && len > 0)
+            ok = file_io(fd_, type, addr, len, off);
+
+        if (!ok) {
+            for (size_t i = first; i <= last; ++i)
+                reqs[i]->result = VIRTIO_BLK_S_IOERR;
+        }
+        first = last + 1;
+    }
+}
+
+void VirtioBlock::HandleRequests(block_queue_t* bq, size_t count) {
+    virtio_queue_t* queue = bq->queue;
+    const uint16_t* heads = bq->heads;
+    block_request_t* reqs = bq->reqs;
+    block_request_t** pending = bq->pending;
+    vring_used_elem* used = bq->used;
+    size_t num_reqs = 0;
+    size_t num_pending = 0;
+    size_t num_used = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        block_request_t* req = &reqs[num_reqs];
+        zx_status_t status = ParseRequest(queue, heads[i], req);
+        if (status != ZX_OK) {
+            // There's nowhere to report the error, but the chain still has
+            // to go back to the guest.
+            fprintf(stderr, "Invalid block request %u: %d\n", heads[i], status);
+            used[num_used++] = {heads[i], 0};
+            continue;
+        }
+        num_reqs++;
+
+        switch (req->type) {
+        case VIRTIO_BLK_T_IN:
+            break;
+        case VIRTIO_BLK_T_OUT:
+            // From VIRTIO Version 1.0: If the VIRTIO_BLK_F_RO feature is set
+            // by the device, any write requests will fail.
+            if (is_read_only())
+                req->result = VIRTIO_BLK_S_UNSUPP;
+            break;
+        case VIRTIO_BLK_T_FLUSH:
+            // A flush covers the writes that completed before it, so finish
+            // the ones taken off the queue ahead of it first.
+            HandleReadWrites(pending, num_pending);
+            num_pending = 0;
+            if (req->off != 0 || fsync(fd_) != 0)
+                req->result = VIRTIO_BLK_S_IOERR;
+            continue;
+        default:
+            req->result = VIRTIO_BLK_S_IOERR;
+            break;
+        }
+        if (req->result == VIRTIO_BLK_S_OK)
+            pending[num_pending++] = req;
+    }
+    HandleReadWrites(pending, num_pending);
+
+    for (size_t i = 0; i < num_reqs; ++i) {
+        block_request_t* req = &reqs[i];
+        *req->status = req->result;
+        uint32_t len = req->result == VIRTIO_BLK_S_OK ? static_cast<uint32_t>(req->len) : 0;
+        used[num_used++] = {req->head, len};
+    }
+
+    // Hand the whole batch back with a single update of the used ring.
+    virtio_queue_return_many(queue, used, num_used);
+}
+
+zx_status_t VirtioBlock::FileBlockDeviceBatched(uint16_t queue_sel) {
+    if (queue_sel >= kNumQueues)
+        return ZX_ERR_INVALID_ARGS;
+    if (!block_queues_)
+        return ZX_ERR_BAD_STATE;
+
+    block_queue_t* bq = &block_queues_[queue_sel];
+    size_t count;
+    do {
+        count = 0;
+        while (count < kMaxBatch && virtio_queue_next_avail(bq->queue, &bq->heads[count]) == ZX_OK)
+            count++;
+        HandleRequests(bq, count);
+    } while (count == kMaxBatch);
+    return ZX_OK;
+}
+
+bool VirtioBlock::WaitForStart() {
+    fbl::AutoLock lock(&start_mutex_);
+    while (start_state_ == StartState::kStarting)
+        cnd_wait(&start_cnd_, start_mutex_.GetInternal());
+    return start_state_ == StartState::kRunning;
+}
+
+int VirtioBlock::QueueWorker(void* arg) {
+    block_queue_t* bq = static_cast<block_queue_t*>(arg);
+    VirtioBlock* block = bq->block;
+    if (!block->WaitForStart())
+        return ZX_ERR_CANCELED;
+
+    while (true) {
+        // Block for one request, then take whatever else the guest has
+        // queued up behind it.
+        size_t count = 1;
+        virtio_queue_wait(bq->queue, &bq->heads[0]);
+        while (count < kMaxBatch && virtio_queue_next_avail(bq->queue, &bq->heads[count]) == ZX_OK)
+            count++;
+
+        block->HandleRequests(bq, count);
+
+        zx_status_t status = block->NotifyGuest();
+        if (status != ZX_OK) {
+            fprintf(stderr, "Block queue %td worker exiting, failed to notify guest: %d\n",
+                    bq - block->block_queues_.get(), status);
+            return status;
+        }
+    }
+    return ZX_OK;
+}
+
+zx_status_t VirtioBlock::Start() {
+    if (started_ || !block_queues_)
+        return ZX_ERR_BAD_STATE;
+
+    // The workers wait for the go-ahead before touching their queues, so
+    // that if one can't be created the others can be stopped and joined.
+    // They are never detached; they run for the life of the guest.
+    uint16_t num_workers = 0;
+    for (; num_workers < kNumQueues; ++num_workers) {
+        block_queue_t* bq = &block_queues_[num_workers];
+        int ret = thrd_create(&bq->thread, &VirtioBlock::QueueWorker, bq);
+        if (ret != thrd_success) {
+            fprintf(stderr, "Failed to create block queue worker %d\n", ret);
+            break;
+        }
+    }
+
+    bool ok = num_workers == kNumQueues;
+    {
+        fbl::AutoLock lock(&start_mutex_);
+        start_state_ = ok ? StartState::kRunning : StartState::kFailed;
+        cnd_broadcast(&start_cnd_);
+    }
+    if (!ok) {
+        for (uint16_t i = 0; i < num_workers; ++i)
+            thrd_join(block_queues_[i].thread, nullptr);
+        // Start may be tried again.
+        fbl::AutoLock lock(&start_mutex_);
+        start_state_ = StartState::kStarting;
+        return ZX_ERR_INTERNAL;
+    }
+    started_ = true;
+    return ZX_OK;
+}
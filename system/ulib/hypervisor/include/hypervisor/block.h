@@ -7,18 +7,27 @@
 #include <threads.h>
 
 #include <fbl/mutex.h>
+#include <fbl/unique_ptr.h>
 #include <hypervisor/virtio.h>
 #include <virtio/block.h>
 
 typedef struct file_state file_state_t;
+typedef struct block_request block_request_t;
+typedef struct block_queue block_queue_t;
 
 /* Stores the state of a block device. */
 class VirtioBlock : public VirtioDevice {
 public:
     static const size_t kSectorSize = 512;
+    // Number of request queues offered to the guest.
+    static const uint16_t kNumQueues = 4;
+    // Most data segments the guest may place in a single request.
+    static const uint32_t kMaxSegments = 32;
+    // Most requests a queue worker takes off the avail ring at once.
+    static const size_t kMaxBatch = 32;
 
     VirtioBlock(uintptr_t guest_physmem_addr, size_t guest_physmem_size);
-    ~VirtioBlock() override = default;
+    ~VirtioBlock() override;
 
     // Opens a file to use as backing for the block device.
     //
@@ -26,6 +35,12 @@ public:
     // if that is not possible.
     zx_status_t Init(const char* path);
 
+    // Starts a worker thread for each queue that services requests off the
+    // vCPU thread. Until this is called, requests are handled synchronously
+    // when the guest notifies a queue. If any worker fails to start, the
+    // ones already created are stopped and joined before returning.
+    zx_status_t Start();
+
     // Our config space is read-only.
     zx_status_t WriteConfig(uint16_t port, const zx_vcpu_io_t* io) override {
         return ZX_ERR_NOT_SUPPORTED;
@@ -33,32 +48,63 @@ public:
 
     zx_status_t HandleQueueNotify(uint16_t queue_sel) override;
 
-    // Block device that returns reads and writes to a file.
-    zx_status_t FileBlockDevice();
+    // Block device that returns reads and writes to a file, handling one
+    // request at a time.
+    zx_status_t FileBlockDevice(uint16_t queue_sel = 0);
+
+    // Block device that returns reads and writes to a file, taking requests
+    // off the queue in batches and merging adjacent reads and writes.
+    zx_status_t FileBlockDeviceBatched(uint16_t queue_sel = 0);
 
     // The 'read-only' feature flag.
     bool is_read_only() { return has_device_features(VIRTIO_BLK_F_RO); }
     void set_read_only() { add_device_features(VIRTIO_BLK_F_RO); }
 
-    // The queue used for handling block reauests.
-    virtio_queue_t& queue() { return queue_; }
+    // The queues used for handling block requests.
+    virtio_queue_t& queue(uint16_t queue_sel = 0) { return request_queues_[queue_sel]; }
 
 private:
     static zx_status_t QueueHandler(void* addr, uint32_t len, uint16_t flags, uint32_t* used,
                                     void* context);
+    static int QueueWorker(void* arg);
+
+    // Blocks a newly created worker until Start has created all of them.
+    // Returns false if Start failed and the worker should exit.
+    bool WaitForStart();
 
     zx_status_t FileRequest(file_state_t* state, void* addr, uint32_t len);
 
-    // File descriptor backing the block device.
+    // Reads the descriptor chain at |head| into |req|.
+    zx_status_t ParseRequest(virtio_queue_t* queue, uint16_t head, block_request_t* req);
+
+    // Handles the first |count| descriptor chains in |bq->heads| and returns
+    // them all to the used ring.
+    void HandleRequests(block_queue_t* bq, size_t count);
+
+    // Performs the reads and writes in |reqs|, merging those that are
+    // adjacent on disk.
+    void HandleReadWrites(block_request_t** reqs, size_t count);
+
+    // File descriptor backing the block device. Only positional reads and
+    // writes are used on it, so the queues can share it without locking.
     int fd_ = 0;
     // Size of file backing the block device.
     uint64_t size_ = 0;
-    // Guards access to |fd_|, such as ensuring no other threads modify the
-    // file pointer while it is in use by another thread.
-    fbl::Mutex file_mutex_;
+    // Whether the queue workers are running. Only set before the guest is.
+    bool started_ = false;
+
+    // Held by the queue workers from their creation until Start has
+    // created all of them, or decided to stop them.
+    enum class StartState { kStarting, kRunning, kFailed };
+    fbl::Mutex start_mutex_;
+    cnd_t start_cnd_;
+    StartState start_state_ TA_GUARDED(start_mutex_) = StartState::kStarting;
+
+    // Per-queue request buffers and worker state, allocated by Init.
+    fbl::unique_ptr<block_queue_t[]> block_queues_;
 
-    // Queue for handling block requests.
-    virtio_queue_t queue_;
+    // Queues for handling block requests.
+    virtio_queue_t request_queues_[kNumQueues];
     // Device configuration fields.
     virtio_blk_config_t config_ = {};
 };
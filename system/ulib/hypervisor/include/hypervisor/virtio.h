@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <threads.h>
+
 #include <fbl/auto_lock.h>
 #include <fbl/mutex.h>
 #include <hypervisor/pci.h>
@@ -19,6 +21,7 @@
 struct vring_desc;
 struct vring_avail;
 struct vring_used;
+struct vring_used_elem;
 
 class VirtioDevice;
 
@@ -63,7 +66,7 @@ private:
 /* Base class for all virtio devices. */
 class VirtioDevice {
 public:
-    virtual ~VirtioDevice() = default;
+    virtual ~VirtioDevice();
 
     // Read a device-specific configuration field.
     virtual zx_status_t ReadConfig(uint16_t port, uint8_t access_size, zx_vcpu_io_t* vcpu_io);
@@ -79,10 +82,21 @@ public:
     // Send a notification back to the guest that there are new descriptors in
     // then used ring.
     //
+    // Nothing is sent if the driver has not asked to hear about any of the
+    // descriptors returned since the last notification, and queue
+    // notifications may be held back according to SetInterruptCoalescing().
+    //
     // The method for how this notification is delievered is transport
     // specific.
     zx_status_t NotifyGuest();
 
+    // Hold back queue interrupts until either |max_count| buffers have been
+    // returned that the driver wants to hear about, or |max_delay| has passed
+    // since the first of them was returned. Config change interrupts are never
+    // held back. A |max_count| of 0 or 1 turns coalescing off, which is the
+    // default.
+    zx_status_t SetInterruptCoalescing(uint32_t max_count, zx_duration_t max_delay);
+
     uintptr_t guest_physmem_addr() { return guest_physmem_addr_; }
     size_t guest_physmem_size() { return guest_physmem_size_; }
 
@@ -94,10 +108,22 @@ public:
         VIRTIO_ISR_DEVICE = 0x2,
     };
 
-    // Sets the given flags in the ISR register.
+    // Sets the given flags in the ISR register, and asks for an interrupt on
+    // the next NotifyGuest.
     void add_isr_flags(uint8_t flags) {
         fbl::AutoLock lock(&mutex_);
         isr_status_ |= flags;
+        notify_pending_ = true;
+    }
+
+    // Sets the queue flag in the ISR register and counts |count| returned
+    // buffers towards interrupt coalescing. Only called for buffers the
+    // driver asked to hear about.
+    void add_used_buffers(uint32_t count) {
+        fbl::AutoLock lock(&mutex_);
+        isr_status_ |= VIRTIO_ISR_QUEUE;
+        notify_pending_ = true;
+        pending_used_ += count;
     }
 
     // Device features.
@@ -114,12 +140,23 @@ public:
         return (features_ & features) == features;
     }
 
+    // Driver features.
+    //
+    // These are the feature bits the driver has accepted.
+    bool has_driver_features(uint32_t features) {
+        fbl::AutoLock lock(&mutex_);
+        return (driver_features_ & features) == features;
+    }
+
     PciDevice& pci_device() { return pci_; }
 
 protected:
     VirtioDevice(uint8_t device_id, void* config, size_t config_size, virtio_queue_t* queues,
                  uint16_t num_queues, uintptr_t guest_physmem_addr, size_t guest_physmem_size);
 
+    // Raises the device's interrupt in the guest.
+    virtual zx_status_t Interrupt() { return pci_.Interrupt(); }
+
     // Mutex for accessing device configuration fields.
     fbl::Mutex config_mutex_;
 
@@ -133,6 +170,11 @@ private:
     // Handle kicks from the driver that a queue needs attention.
     zx_status_t Kick(uint16_t queue_sel);
 
+    zx_status_t NotifyGuestLocked() TA_REQ(mutex_);
+    // Sends the pending interrupt and resets the coalescing state.
+    zx_status_t InterruptLocked() TA_REQ(mutex_);
+    static int CoalesceThread(void* arg);
+
     // Device feature bits.
     //
     // Defined in Virtio 1.0 Section 2.2.
@@ -151,6 +193,26 @@ private:
 
     // Interrupt status register.
     uint8_t isr_status_ TA_GUARDED(mutex_) = 0;
+    // Whether something the driver asked to hear about has happened since
+    // the last interrupt. Unlike |isr_status_|, which stays set until the
+    // driver reads it, this is cleared by sending the interrupt, so that
+    // buffers returned in the meantime that the driver did not ask about
+    // don't interrupt it again.
+    bool notify_pending_ TA_GUARDED(mutex_) = false;
+
+    // Interrupt coalescing thresholds.
+    uint32_t coalesce_count_ TA_GUARDED(mutex_) = 0;
+    zx_duration_t coalesce_delay_ TA_GUARDED(mutex_) = 0;
+    // Thread that sends held back interrupts once they are due.
+    thrd_t coalesce_thread_;
+    bool coalesce_started_ TA_GUARDED(mutex_) = false;
+    bool coalesce_stop_ TA_GUARDED(mutex_) = false;
+    // Signalled when |pending_deadline_| is set, or the thread is to stop.
+    cnd_t coalesce_cnd_;
+    // Buffers returned since the last interrupt, and when the interrupt for
+    // them is due. A deadline of 0 means no interrupt is being held back.
+    uint32_t pending_used_ TA_GUARDED(mutex_) = 0;
+    zx_time_t pending_deadline_ TA_GUARDED(mutex_) = 0;
 
     // Index of the queue currently selected by the driver.
     uint16_t queue_sel_ TA_GUARDED(mutex_) = 0;
@@ -205,6 +267,7 @@ typedef struct virtio_queue {
 
     // Number of entries in the descriptor table.
     uint16_t size;
+    // Index of the next entry to take from the avail ring.
     uint16_t index;
 
     // Pointer to the owning device.
@@ -318,3 +381,11 @@ zx_status_t virtio_queue_read_desc(virtio_queue_t* queue, uint16_t index, virtio
  * after calling virtio_queue_return.
  */
 void virtio_queue_return(virtio_queue_t* queue, uint16_t index, uint32_t len);
+
+/* Return |count| descriptors to the used ring at once.
+ *
+ * The driver sees all of them appear together, and the device's ISR is
+ * updated once for the whole batch.
+ */
+void virtio_queue_return_many(virtio_queue_t* queue, const struct vring_used_elem* elems,
+                              size_t count);
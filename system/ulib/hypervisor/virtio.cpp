@@ -6,11 +6,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+#include <fbl/atomic.h>
 #include <fbl/auto_lock.h>
 #include <fbl/unique_ptr.h>
 #include <hypervisor/vcpu.h>
 #include <hypervisor/virtio.h>
+#include <zircon/syscalls.h>
 #include <zircon/syscalls/port.h>
 
 #include <virtio/virtio.h>
@@ -28,6 +31,9 @@ VirtioDevice::VirtioDevice(uint8_t device_id, void* config, size_t config_size,
     : device_id_(device_id), device_config_(config), device_config_size_(config_size),
       num_queues_(num_queues), queues_(queues), guest_physmem_addr_(guest_physmem_addr),
       guest_physmem_size_(guest_physmem_size), pci_(this) {
+    cnd_init(&coalesce_cnd_);
+    add_device_features(1u << VIRTIO_RING_F_EVENT_IDX);
+
     // Virt queue initialization.
     for (int i = 0; i < num_queues_; ++i) {
         virtio_queue_t* queue = &queues_[i];
@@ -37,6 +43,19 @@ VirtioDevice::VirtioDevice(uint8_t device_id, void* config, size_t config_size,
     }
 }
 
+VirtioDevice::~VirtioDevice() {
+    bool started;
+    {
+        fbl::AutoLock lock(&mutex_);
+        coalesce_stop_ = true;
+        started = coalesce_started_;
+        cnd_signal(&coalesce_cnd_);
+    }
+    if (started)
+        thrd_join(coalesce_thread_, nullptr);
+    cnd_destroy(&coalesce_cnd_);
+}
+
 // Returns a circular index into a Virtio ring.
 static uint32_t ring_index(virtio_queue_t* queue, uint32_t index) {
     return index % queue->size;
@@ -102,7 +121,97 @@ void virtio_queue_signal(virtio_queue_t* queue) {
 }
 
 zx_status_t VirtioDevice::NotifyGuest() {
-    return pci_.Interrupt();
+    fbl::AutoLock lock(&mutex_);
+    return NotifyGuestLocked();
+}
+
+zx_status_t VirtioDevice::NotifyGuestLocked() {
+    // Nothing the driver asked to hear about has happened since the last
+    // interrupt.
+    if (!notify_pending_)
+        return ZX_OK;
+
+    // Hold back queue interrupts until enough buffers have been returned,
+    // leaving the coalescing thread to send the interrupt if the rest don't
+    // arrive in time.
+    bool coalesce = coalesce_count_ > 1 && !(isr_status_ & VIRTIO_ISR_DEVICE);
+    if (coalesce && pending_used_ < coalesce_count_) {
+        if (pending_deadline_ == 0) {
+            pending_deadline_ = zx_deadline_after(coalesce_delay_);
+            cnd_signal(&coalesce_cnd_);
+        }
+        return ZX_OK;
+    }
+
+    return InterruptLocked();
+}
+
+zx_status_t VirtioDevice::InterruptLocked() {
+    notify_pending_ = false;
+    pending_used_ = 0;
+    pending_deadline_ = 0;
+    return Interrupt();
+}
+
+int VirtioDevice::CoalesceThread(void* arg) {
+    VirtioDevice* device = static_cast<VirtioDevice*>(arg);
+    device->mutex_.Acquire();
+    while (!device->coalesce_stop_) {
+        if (device->pending_deadline_ == 0) {
+            cnd_wait(&device->coalesce_cnd_, device->mutex_.GetInternal());
+            continue;
+        }
+
+        // Wait for the deadline without the lock, so that buffers returned in
+        // the meantime can still cross the count threshold and send the
+        // interrupt early. Condition variables wait on the realtime clock.
+        zx_time_t now = zx_time_get(ZX_CLOCK_MONOTONIC);
+        if (now < device->pending_deadline_) {
+            zx_duration_t remaining = device->pending_deadline_ - now;
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += remaining / ZX_SEC(1);
+            ts.tv_nsec += remaining % ZX_SEC(1);
+            if (ts.tv_nsec >= ZX_SEC(1)) {
+                ts.tv_sec++;
+                ts.tv_nsec -= ZX_SEC(1);
+            }
+            cnd_timedwait(&device->coalesce_cnd_, device->mutex_.GetInternal(), &ts);
+            continue;
+        }
+
+        if (!device->notify_pending_) {
+            device->pending_used_ = 0;
+            device->pending_deadline_ = 0;
+            continue;
+        }
+        zx_status_t status = device->InterruptLocked();
+        if (status != ZX_OK)
+            fprintf(stderr, "Failed to send coalesced interrupt %d\n", status);
+    }
+    device->mutex_.Release();
+    return ZX_OK;
+}
+
+zx_status_t VirtioDevice::SetInterruptCoalescing(uint32_t max_count, zx_duration_t max_delay) {
+    // Interrupts are only ever held back for a bounded time.
+    if (max_count > 1 && max_delay == 0)
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::AutoLock lock(&mutex_);
+    if (max_count > 1 && !coalesce_started_) {
+        int ret = thrd_create(&coalesce_thread_, &VirtioDevice::CoalesceThread, this);
+        if (ret != thrd_success) {
+            fprintf(stderr, "Failed to create interrupt coalescing thread %d\n", ret);
+            return ZX_ERR_INTERNAL;
+        }
+        coalesce_started_ = true;
+    }
+    coalesce_count_ = max_count;
+    coalesce_delay_ = max_delay;
+
+    // Don't leave anything held back under the old thresholds.
+    return NotifyGuestLocked();
 }
 
 zx_status_t VirtioDevice::Kick(uint16_t kicked_queue) {
@@ -115,22 +224,39 @@ zx_status_t VirtioDevice::Kick(uint16_t kicked_queue) {
         return status;
     }
 
+    // Notify threads waiting on a descriptor. This has to happen even if we
+    // interrupt the guest below, as the ISR may have been set by one of those
+    // threads rather than by HandleQueueNotify.
+    virtio_queue_signal(&queues_[kicked_queue]);
+
     // Send an interrupt back to the guest if we've generated one while
     // processing the queue.
-    fbl::AutoLock lock(&mutex_);
-    if (isr_status_ > 0) {
-        return NotifyGuest();
-    }
+    return NotifyGuest();
+}
 
-    // Notify threads waiting on a descriptor.
-    virtio_queue_signal(&queues_[kicked_queue]);
-    return ZX_OK;
+// Whether the driver negotiated VIRTIO_RING_F_EVENT_IDX and the queue has
+// the event fields mapped.
+static bool queue_has_event_idx(virtio_queue_t* queue) {
+    return queue->avail_event != NULL && queue->used_event != NULL &&
+           queue->virtio_device->has_driver_features(1u << VIRTIO_RING_F_EVENT_IDX);
 }
 
 // This must not return any errors besides ZX_ERR_NOT_FOUND.
 static zx_status_t virtio_queue_next_avail_locked(virtio_queue_t* queue, uint16_t* index) {
-    if (ring_avail_count(queue) < 1)
-        return ZX_ERR_NOT_FOUND;
+    if (ring_avail_count(queue) < 1) {
+        if (!queue_has_event_idx(queue))
+            return ZX_ERR_NOT_FOUND;
+
+        // We have caught up with the driver, so ask to be notified of the
+        // next buffer. While there are buffers left the driver can skip
+        // notifying us, as we'll find the new ones on our own. The driver
+        // may have added a buffer before seeing the new event index, so
+        // check again.
+        *queue->avail_event = queue->index;
+        fbl::atomic_thread_fence(fbl::memory_order_seq_cst);
+        if (ring_avail_count(queue) < 1)
+            return ZX_ERR_NOT_FOUND;
+    }
 
     *index = queue->avail->ring[ring_index(queue, queue->index++)];
     return ZX_OK;
@@ -205,6 +331,9 @@ zx_status_t virtio_queue_poll(virtio_queue_t* queue, virtio_queue_poll_fn_t hand
 
 zx_status_t virtio_queue_read_desc(virtio_queue_t* queue, uint16_t desc_index,
                                    virtio_desc_t* out) {
+    if (desc_index >= queue->size)
+        return ZX_ERR_OUT_OF_RANGE;
+
     VirtioDevice* device = queue->virtio_device;
     volatile struct vring_desc& desc = queue->desc[desc_index];
     size_t mem_size = device->guest_physmem_size();
@@ -222,20 +351,47 @@ zx_status_t virtio_queue_read_desc(virtio_queue_t* queue, uint16_t desc_index,
 }
 
 void virtio_queue_return(virtio_queue_t* queue, uint16_t index, uint32_t len) {
+    struct vring_used_elem elem = {index, len};
+    virtio_queue_return_many(queue, &elem, 1);
+}
+
+void virtio_queue_return_many(virtio_queue_t* queue, const struct vring_used_elem* elems,
+                              size_t count) {
+    if (count == 0)
+        return;
+
+    bool event_idx = queue_has_event_idx(queue);
     mtx_lock(&queue->mutex);
 
-    volatile struct vring_used_elem* used =
-        &queue->used->ring[ring_index(queue, queue->used->idx)];
+    uint16_t old_idx = queue->used->idx;
+    uint16_t new_idx = old_idx;
+    for (size_t i = 0; i < count; ++i) {
+        volatile struct vring_used_elem* used = &queue->used->ring[ring_index(queue, new_idx++)];
+        used->id = elems[i].id;
+        used->len = elems[i].len;
+    }
 
-    used->id = index;
-    used->len = len;
-    queue->used->idx++;
+    // Publish the whole batch at once, after its entries.
+    fbl::atomic_thread_fence(fbl::memory_order_release);
+    queue->used->idx = new_idx;
+
+    // Virtio 1.0 Section 2.4.7.2: with VIRTIO_F_EVENT_IDX the driver tells us
+    // which used index it next wants an interrupt for; otherwise it can ask
+    // for no interrupts at all.
+    bool interrupt;
+    if (event_idx) {
+        fbl::atomic_thread_fence(fbl::memory_order_seq_cst);
+        interrupt = vring_need_event(*queue->used_event, new_idx, old_idx);
+    } else {
+        interrupt = !(queue->avail->flags & VRING_AVAIL_F_NO_INTERRUPT);
+    }
 
     mtx_unlock(&queue->mutex);
 
     // Set the queue bit in the device ISR so that the driver knows to check
     // the queues on the next interrupt.
-    queue->virtio_device->add_isr_flags(VirtioDevice::VIRTIO_ISR_QUEUE);
+    if (interrupt)
+        queue->virtio_device->add_used_buffers(static_cast<uint32_t>(count));
 }
 
 zx_status_t virtio_queue_handler(virtio_queue_t* queue, virtio_queue_fn_t handler, void* context) {
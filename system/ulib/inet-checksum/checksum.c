@@ -0,0 +1,130 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <inet-checksum/checksum.h>
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// Since 2^16 = 1 modulo 0xffff, the sum of 16-bit words can be taken over
+// wider words and folded down at the end. The bulk of the data is added up
+// 64 bytes at a time as 32-bit words into 64-bit accumulators, which can't
+// overflow for any buffer that fits in memory; the rest as 64-bit words
+// with the carries added back in.
+
+// Ones' complement 64-bit add.
+static inline uint64_t add64(uint64_t a, uint64_t b) {
+    a += b;
+    return a + (a < b);
+}
+
+static inline uint16_t fold(uint64_t sum) {
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t)sum;
+}
+
+#if defined(__x86_64__)
+
+// SSE2 is always there on x86-64.
+static uint64_t sum_blocks(const uint8_t* p, size_t blocks) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc0 = zero;
+    __m128i acc1 = zero;
+    for (; blocks > 0; blocks--, p += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i*)p);
+        __m128i b = _mm_loadu_si128((const __m128i*)(p + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(p + 32));
+        __m128i d = _mm_loadu_si128((const __m128i*)(p + 48));
+        acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(a, zero));
+        acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(a, zero));
+        acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(b, zero));
+        acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(b, zero));
+        acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(c, zero));
+        acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(c, zero));
+        acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(d, zero));
+        acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(d, zero));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, _mm_add_epi64(acc0, acc1));
+    return add64(lanes[0], lanes[1]);
+}
+
+#elif defined(__aarch64__)
+
+static uint64_t sum_blocks(const uint8_t* p, size_t blocks) {
+    uint64x2_t acc0 = vdupq_n_u64(0);
+    uint64x2_t acc1 = vdupq_n_u64(0);
+    for (; blocks > 0; blocks--, p += 64) {
+        // pairwise add each pair of 32-bit words into a 64-bit lane
+        acc0 = vpadalq_u32(acc0, vreinterpretq_u32_u8(vld1q_u8(p)));
+        acc1 = vpadalq_u32(acc1, vreinterpretq_u32_u8(vld1q_u8(p + 16)));
+        acc0 = vpadalq_u32(acc0, vreinterpretq_u32_u8(vld1q_u8(p + 32)));
+        acc1 = vpadalq_u32(acc1, vreinterpretq_u32_u8(vld1q_u8(p + 48)));
+    }
+    uint64x2_t acc = vaddq_u64(acc0, acc1);
+    return add64(vgetq_lane_u64(acc, 0), vgetq_lane_u64(acc, 1));
+}
+
+#else
+
+static uint64_t sum_blocks(const uint8_t* p, size_t blocks) {
+    uint64_t sum = 0;
+    for (; blocks > 0; blocks--, p += 64) {
+        for (size_t i = 0; i < 64; i += 8) {
+            uint64_t w;
+            memcpy(&w, p + i, sizeof(w));
+            sum = add64(sum, w);
+        }
+    }
+    return sum;
+}
+
+#endif
+
+uint16_t inet_checksum_partial(const void* data, size_t len, uint16_t initial) {
+    const uint8_t* p = data;
+    uint64_t sum = initial;
+
+    sum = add64(sum, sum_blocks(p, len / 64));
+    p += len & ~(size_t)63;
+    len &= 63;
+
+    for (; len >= 8; len -= 8, p += 8) {
+        uint64_t w;
+        memcpy(&w, p, sizeof(w));
+        sum = add64(sum, w);
+    }
+    if (len >= 4) {
+        uint32_t w;
+        memcpy(&w, p, sizeof(w));
+        sum = add64(sum, w);
+        p += 4;
+        len -= 4;
+    }
+    if (len >= 2) {
+        uint16_t w;
+        memcpy(&w, p, sizeof(w));
+        sum = add64(sum, w);
+        p += 2;
+        len -= 2;
+    }
+    if (len) {
+        // the high byte of a big-endian word, padded with zero
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        sum = add64(sum, *p);
+#else
+        sum = add64(sum, (uint64_t)*p << 8);
+#endif
+    }
+    return fold(sum);
+}
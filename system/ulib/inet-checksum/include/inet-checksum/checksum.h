@@ -0,0 +1,29 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// The Internet checksum (RFC 1071) used by IP, UDP, TCP and ICMP.
+
+#pragma once
+
+#include <zircon/compiler.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+__BEGIN_CDECLS
+
+// Returns the ones' complement sum of the 16-bit words in the |len| bytes
+// at |data|, added to |sum|, without complementing it. Words are added in
+// host byte order, which gives the right result in network byte order
+// once it is stored back as a uint16_t. A sum can be built up over several
+// calls, but all but the last must cover an even number of bytes.
+uint16_t inet_checksum_partial(const void* data, size_t len, uint16_t sum);
+
+// Returns the checksum to store for the |len| bytes at |data|, given the
+// partial sum of any pseudo-header.
+static inline uint16_t inet_checksum(const void* data, size_t len, uint16_t sum) {
+    return (uint16_t)~inet_checksum_partial(data, len, sum);
+}
+
+__END_CDECLS
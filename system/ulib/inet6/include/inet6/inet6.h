@@ -132,6 +132,8 @@ char* ip6toa(char* _out, void* ip6addr);
 // provided by inet6.c
 void ip6_init(void* macaddr);
 void eth_recv(void* data, size_t len);
+// for frames whose UDP checksum the interface has already verified
+void eth_recv_csum_ok(void* data, size_t len);
 
 typedef struct eth_buffer eth_buffer_t;
 
@@ -26,6 +26,7 @@ int netifc_timer_expired(void);
 // packet is discarded if too large, too small, network offline, etc
 void netifc_send(const void* data, size_t len);
 
-void netifc_recv(void* data, size_t len);
+// flags are the ETH_FIFO_* flags the frame was received with
+void netifc_recv(void* data, size_t len, uint32_t flags);
 
 void netifc_get_info(uint8_t* addr, uint16_t* mtu);
\ No newline at end of file
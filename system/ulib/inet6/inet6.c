@@ -2,10 +2,12 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
+#include <inet-checksum/checksum.h>
 #include <inet6/inet6.h>
 
 #if 1
@@ -142,22 +144,6 @@ static int resolve_ip6(mac_addr_t* _mac, const ip6_addr_t* _ip) {
     return -1;
 }
 
-static uint16_t checksum(const void* _data, size_t len, uint16_t _sum) {
-    uint32_t sum = _sum;
-    const uint16_t* data = _data;
-    while (len > 1) {
-        sum += *data++;
-        len -= 2;
-    }
-    if (len) {
-        sum += (*data & 0xFF);
-    }
-    while (sum > 0xFFFF) {
-        sum = (sum & 0xFFFF) + (sum >> 16);
-    }
-    return sum;
-}
-
 typedef struct {
     uint8_t eth[16];
     ip6_hdr_t ip6;
@@ -175,9 +161,9 @@ unsigned ip6_checksum(ip6_hdr_t* ip, unsigned type, size_t length) {
     uint16_t sum;
 
     // length and protocol field for pseudo-header
-    sum = checksum(&ip->length, 2, htons(type));
+    sum = inet_checksum_partial(&ip->length, 2, htons(type));
     // src/dst for pseudo-header + payload
-    sum = checksum(&ip->src, 32 + length, sum);
+    sum = inet_checksum_partial(&ip->src, 32 + length, sum);
 
     // 0 is illegal, so 0xffff remains 0xffff
     if (sum != 0xffff) {
@@ -262,7 +248,8 @@ fail:
     return -1;
 }
 
-void _udp6_recv(ip6_hdr_t* ip, void* _data, size_t len) {
+// csum_ok is set when the interface has already verified the checksum.
+static void _udp6_recv(ip6_hdr_t* ip, void* _data, size_t len, bool csum_ok) {
     udp_hdr_t* udp = _data;
     uint16_t sum, n;
 
@@ -270,13 +257,16 @@ void _udp6_recv(ip6_hdr_t* ip, void* _data, size_t len) {
         BAD("Bogus Header Len");
     if (udp->checksum == 0)
         BAD("Checksum Invalid");
-    if (udp->checksum == 0xFFFF)
-        udp->checksum = 0;
 
-    sum = checksum(&ip->length, 2, htons(HDR_UDP));
-    sum = checksum(&ip->src, 32 + len, sum);
-    if (sum != 0xFFFF)
-        BAD("Checksum Incorrect");
+    if (!csum_ok) {
+        if (udp->checksum == 0xFFFF)
+            udp->checksum = 0;
+
+        sum = inet_checksum_partial(&ip->length, 2, htons(HDR_UDP));
+        sum = inet_checksum_partial(&ip->src, 32 + len, sum);
+        if (sum != 0xFFFF)
+            BAD("Checksum Incorrect");
+    }
 
     n = ntohs(udp->length);
     if (n < UDP_HDR_LEN)
@@ -299,8 +289,8 @@ void icmp6_recv(ip6_hdr_t* ip, void* _data, size_t len) {
     if (icmp->checksum == 0xFFFF)
         icmp->checksum = 0;
 
-    sum = checksum(&ip->length, 2, htons(HDR_ICMP6));
-    sum = checksum(&ip->src, 32 + len, sum);
+    sum = inet_checksum_partial(&ip->length, 2, htons(HDR_ICMP6));
+    sum = inet_checksum_partial(&ip->src, 32 + len, sum);
     if (sum != 0xFFFF)
         BAD("Checksum Incorrect");
 
@@ -341,7 +331,7 @@ void icmp6_recv(ip6_hdr_t* ip, void* _data, size_t len) {
     }
 }
 
-void eth_recv(void* _data, size_t len) {
+static void ip6_recv(void* _data, size_t len, bool csum_ok) {
     uint8_t* data = _data;
     ip6_hdr_t* ip;
     uint32_t n;
@@ -385,7 +375,7 @@ void eth_recv(void* _data, size_t len) {
         icmp6_recv(ip, data, len);
         break;
     case HDR_UDP:
-        _udp6_recv(ip, data, len);
+        _udp6_recv(ip, data, len, csum_ok);
         break;
     default:
         // do nothing
@@ -393,6 +383,14 @@ void eth_recv(void* _data, size_t len) {
     }
 }
 
+void eth_recv(void* data, size_t len) {
+    ip6_recv(data, len, false);
+}
+
+void eth_recv_csum_ok(void* data, size_t len) {
+    ip6_recv(data, len, true);
+}
+
 char* ip6toa(char* _out, void* ip6addr) {
     const uint8_t* x = ip6addr;
     const uint8_t* end = x + 16;
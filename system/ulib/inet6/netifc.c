@@ -390,7 +390,7 @@ void netifc_close(void) {
 static void rx_complete(void* ctx, void* cookie, size_t len, uint32_t flags) {
     eth_buffer_t* ethbuf = cookie;
     check_ethbuf(ethbuf, ETH_BUFFER_RX);
-    netifc_recv(ethbuf->data, len);
+    netifc_recv(ethbuf->data, len, flags);
     eth_queue_rx(eth, ethbuf, ethbuf->data, NET_BUFFERSZ, 0);
 }
 
@@ -13,6 +13,8 @@ MODULE_SRCS += \
     $(LOCAL_DIR)/netifc.c \
     $(LOCAL_DIR)/eth-client.c \
 
+MODULE_STATIC_LIBS := system/ulib/inet-checksum
+
 MODULE_LIBS += system/ulib/fdio system/ulib/zircon system/ulib/c
 
 include make/module.mk
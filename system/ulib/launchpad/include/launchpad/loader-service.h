@@ -47,7 +47,10 @@ zx_status_t loader_service_simple(loader_service_fn_t loader,
 typedef struct loader_service loader_service_t;
 
 // Create a new file-system backed loader service capable of handling
-// any number of clients.
+// any number of clients.  Clients are serviced by a small pool of
+// threads.  Library VMOs are cached process-wide and handed out as
+// copy-on-write clones, so repeated loads of the same library do not
+// re-read it from the filesystem.
 zx_status_t loader_service_create_fs(const char* name, loader_service_t** out);
 
 // Returns a new dl_set_loader_service-compatible loader service channel.
@@ -25,6 +25,7 @@
 #include <zircon/dlfcn.h>
 #include <zircon/device/dmctl.h>
 #include <zircon/device/vfs.h>
+#include <zircon/listnode.h>
 #include <zircon/processargs.h>
 #include <zircon/status.h>
 #include <zircon/syscalls.h>
@@ -50,15 +51,24 @@ static void __PRINTFLIKE(2, 3) log_printf(zx_handle_t log,
 
 #define PREFIX_MAX 32
 
+// Number of dispatcher threads servicing a multi-client loader service.
+// Channels are spread across them round-robin as they are attached.
+#define DISPATCHER_COUNT 4
+
 struct loader_service {
     char name[ZX_MAX_NAME_LEN];
     mtx_t dispatcher_lock;
-    fdio_dispatcher_t* dispatcher;
+    fdio_dispatcher_t* dispatcher[DISPATCHER_COUNT];
+    unsigned dispatcher_count;
+    unsigned dispatcher_next;
     zx_handle_t dispatcher_log;
 
     const loader_service_ops_t* ops;
     void* ctx;
 
+    // Guards the config fields, which are shared by every client
+    // and may be touched by several dispatcher threads at once.
+    mtx_t config_lock;
     char config_prefix[PREFIX_MAX];
     bool config_exclusive;
 };
@@ -133,15 +143,186 @@ zx_status_t loader_service_publish_data_sink_fs(const char* sink_name, zx_handle
 }
 
 
-// When loading a library object, search in the hard-coded locations.
-static int open_from_libpath(const char* fn) {
-    int fd = -1;
-    for (size_t n = 0; fd < 0 && n < countof(libpaths); ++n) {
-        char path[PATH_MAX];
-        snprintf(path, sizeof(path), "%s/%s", libpaths[n], fn);
-        fd = open(path, O_RDONLY);
+// The filesystem-backed loader ops keep a process-wide cache of the
+// library VMOs they have handed out.  Nearly every process asks for
+// the same handful of DSOs (libc, libfdio, libc++, ...), and without
+// the cache each request re-reads the file into a fresh VMO.
+//
+// Positive entries are keyed by the resolved path together with the
+// identity of the file behind it (inode, size and modification time),
+// so a library that is replaced on disk is simply a different key.
+// The cached VMO itself is never handed out: clients always receive a
+// copy-on-write clone of it.
+//
+// Negative entries remember paths that did not exist, so the probe of
+// /system/lib for libraries that live only in /boot/lib (or vice versa)
+// does not go back to the filesystem every time.  Because filesystems
+// such as /system can be mounted after the loader service starts,
+// negative entries expire after a short time.
+
+#define CACHE_BUCKETS 64
+#define CACHE_MAX_ENTRIES 256
+#define CACHE_NEGATIVE_TTL ZX_SEC(1)
+
+typedef struct cache_entry {
+    list_node_t bucket_node;
+    list_node_t lru_node;
+    // ZX_HANDLE_INVALID for a negative entry.
+    zx_handle_t vmo;
+    uint64_t size;
+    ino_t ino;
+    off_t st_size;
+    time_t mtime;
+    // Only meaningful for negative entries.
+    zx_time_t expires;
+    uint32_t hash;
+    char path[];
+} cache_entry_t;
+
+static struct {
+    mtx_t lock;
+    bool initialized;
+    list_node_t buckets[CACHE_BUCKETS];
+    // Most recently used at the head.
+    list_node_t lru;
+    size_t count;
+} cache;
+
+static uint32_t cache_hash(const char* path) {
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)path; *p; ++p) {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Must be called with cache.lock held.
+static void cache_init_locked(void) {
+    if (!cache.initialized) {
+        for (size_t i = 0; i < countof(cache.buckets); ++i)
+            list_initialize(&cache.buckets[i]);
+        list_initialize(&cache.lru);
+        cache.initialized = true;
+    }
+}
+
+// Must be called with cache.lock held.
+static void cache_remove_locked(cache_entry_t* entry) {
+    list_delete(&entry->bucket_node);
+    list_delete(&entry->lru_node);
+    --cache.count;
+    if (entry->vmo != ZX_HANDLE_INVALID)
+        zx_handle_close(entry->vmo);
+    free(entry);
+}
+
+// Must be called with cache.lock held.
+static cache_entry_t* cache_find_locked(const char* path, uint32_t hash) {
+    cache_init_locked();
+    cache_entry_t* entry;
+    list_for_every_entry (&cache.buckets[hash % CACHE_BUCKETS], entry,
+                          cache_entry_t, bucket_node) {
+        if (entry->hash == hash && !strcmp(entry->path, path)) {
+            list_delete(&entry->lru_node);
+            list_add_head(&cache.lru, &entry->lru_node);
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Takes ownership of vmo (which may be ZX_HANDLE_INVALID).
+static void cache_insert(const char* path, const struct stat* st,
+                         zx_handle_t vmo, uint64_t size) {
+    size_t len = strlen(path);
+    cache_entry_t* entry = malloc(sizeof(*entry) + len + 1);
+    if (entry == NULL) {
+        if (vmo != ZX_HANDLE_INVALID)
+            zx_handle_close(vmo);
+        return;
+    }
+    memcpy(entry->path, path, len + 1);
+    entry->hash = cache_hash(path);
+    entry->vmo = vmo;
+    entry->size = size;
+    entry->ino = st ? st->st_ino : 0;
+    entry->st_size = st ? st->st_size : 0;
+    entry->mtime = st ? st->st_mtime : 0;
+    entry->expires = (vmo == ZX_HANDLE_INVALID) ?
+        zx_time_get(ZX_CLOCK_MONOTONIC) + CACHE_NEGATIVE_TTL : 0;
+
+    mtx_lock(&cache.lock);
+    cache_entry_t* old = cache_find_locked(path, entry->hash);
+    if (old != NULL)
+        cache_remove_locked(old);
+    while (cache.count >= CACHE_MAX_ENTRIES) {
+        cache_entry_t* victim = containerof(list_peek_tail(&cache.lru),
+                                            cache_entry_t, lru_node);
+        cache_remove_locked(victim);
+    }
+    list_add_head(&cache.buckets[entry->hash % CACHE_BUCKETS],
+                  &entry->bucket_node);
+    list_add_head(&cache.lru, &entry->lru_node);
+    ++cache.count;
+    mtx_unlock(&cache.lock);
+}
+
+// Returns true if path is known (recently) not to exist.
+static bool cache_lookup_negative(const char* path) {
+    uint32_t hash = cache_hash(path);
+    bool result = false;
+    mtx_lock(&cache.lock);
+    cache_entry_t* entry = cache_find_locked(path, hash);
+    if (entry != NULL && entry->vmo == ZX_HANDLE_INVALID) {
+        if (zx_time_get(ZX_CLOCK_MONOTONIC) < entry->expires) {
+            result = true;
+        } else {
+            cache_remove_locked(entry);
+        }
+    }
+    mtx_unlock(&cache.lock);
+    return result;
+}
+
+// On a hit, returns a copy-on-write clone of the cached VMO for the
+// file currently found at path.
+static zx_status_t cache_lookup_clone(const char* path, const struct stat* st,
+                                      zx_handle_t* out) {
+    uint32_t hash = cache_hash(path);
+    zx_status_t status = ZX_ERR_NOT_FOUND;
+    mtx_lock(&cache.lock);
+    cache_entry_t* entry = cache_find_locked(path, hash);
+    if (entry != NULL && entry->vmo != ZX_HANDLE_INVALID) {
+        if (entry->ino == st->st_ino && entry->st_size == st->st_size &&
+            entry->mtime == st->st_mtime) {
+            status = zx_vmo_clone(entry->vmo, ZX_VMO_CLONE_COPY_ON_WRITE,
+                                  0, entry->size, out);
+        } else {
+            // The file changed underneath us.
+            cache_remove_locked(entry);
+        }
+    }
+    mtx_unlock(&cache.lock);
+    return status;
+}
+
+// Open fn from the first of the hard-coded library locations that has it,
+// skipping locations where it was recently found to be missing.  On
+// success, the full path is left in path.
+static int open_from_libpath(const char* fn, char* path, size_t len) {
+    for (size_t n = 0; n < countof(libpaths); ++n) {
+        snprintf(path, len, "%s/%s", libpaths[n], fn);
+        if (cache_lookup_negative(path))
+            continue;
+        int fd = open(path, O_RDONLY);
+        if (fd >= 0)
+            return fd;
+        if (errno == ENOENT)
+            cache_insert(path, NULL, ZX_HANDLE_INVALID, 0);
     }
-    return fd;
+    return -1;
 }
 
 // Always consumes the fd.
@@ -153,10 +334,45 @@ static zx_handle_t load_object_fd(int fd, const char* fn, zx_handle_t* out) {
     return status;
 }
 
+// Always consumes the fd.  Serves the object from the cache if the same
+// file was loaded before, and populates the cache otherwise.
+static zx_status_t load_object_fd_cached(int fd, const char* path,
+                                         const char* fn, zx_handle_t* out) {
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        return load_object_fd(fd, fn, out);
+
+    zx_handle_t vmo;
+    if (cache_lookup_clone(path, &st, &vmo) != ZX_OK) {
+        zx_status_t status = fdio_get_vmo(fd, &vmo);
+        if (status != ZX_OK) {
+            close(fd);
+            return status;
+        }
+        uint64_t size;
+        zx_handle_t clone;
+        if (zx_vmo_get_size(vmo, &size) != ZX_OK ||
+            zx_vmo_clone(vmo, ZX_VMO_CLONE_COPY_ON_WRITE,
+                         0, size, &clone) != ZX_OK) {
+            // Can't share this one; hand out the original uncached.
+            clone = vmo;
+        } else {
+            zx_object_set_property(vmo, ZX_PROP_NAME, fn, strlen(fn));
+            cache_insert(path, &st, vmo, size);
+        }
+        vmo = clone;
+    }
+    close(fd);
+    zx_object_set_property(vmo, ZX_PROP_NAME, fn, strlen(fn));
+    *out = vmo;
+    return ZX_OK;
+}
+
 static zx_status_t fs_load_object(void *ctx, const char* name, zx_handle_t* out) {
-    int fd = open_from_libpath(name);
+    char path[PATH_MAX];
+    int fd = open_from_libpath(name, path, sizeof(path));
     if (fd >= 0)
-        return load_object_fd(fd, name, out);
+        return load_object_fd_cached(fd, path, name, out);
     return ZX_ERR_NOT_FOUND;
 }
 
@@ -193,6 +409,7 @@ static zx_status_t default_load_fn(void* cookie, uint32_t load_op,
             status = ZX_ERR_INVALID_ARGS;
             break;
         }
+        mtx_lock(&svc->config_lock);
         strncpy(svc->config_prefix, fn, len + 1);
         svc->config_exclusive = false;
         if (svc->config_prefix[len - 1] == '!') {
@@ -201,17 +418,23 @@ static zx_status_t default_load_fn(void* cookie, uint32_t load_op,
         }
         svc->config_prefix[len] = '/';
         svc->config_prefix[len + 1] = '\0';
+        mtx_unlock(&svc->config_lock);
         status = ZX_OK;
         break;
     }
-    case LOADER_SVC_OP_LOAD_OBJECT:
+    case LOADER_SVC_OP_LOAD_OBJECT: {
+        char prefix[PREFIX_MAX];
+        mtx_lock(&svc->config_lock);
+        memcpy(prefix, svc->config_prefix, sizeof(prefix));
+        bool exclusive = svc->config_exclusive;
+        mtx_unlock(&svc->config_lock);
         // If a prefix is configured, try loading with that prefix first
-        if (svc->config_prefix[0] != '\0') {
+        if (prefix[0] != '\0') {
             size_t maxlen = PREFIX_MAX + strlen(fn) + 1;
             char pfn[maxlen];
-            snprintf(pfn, maxlen, "%s%s", svc->config_prefix, fn);
+            snprintf(pfn, maxlen, "%s%s", prefix, fn);
             if (((status = svc->ops->load_object(svc->ctx, pfn, out)) == ZX_OK) ||
-                svc->config_exclusive) {
+                exclusive) {
                 // if loading with prefix succeeds, or loading
                 // with prefix is configured to be exclusive of
                 // non-prefix loading, stop here
@@ -221,6 +444,7 @@ static zx_status_t default_load_fn(void* cookie, uint32_t load_op,
         }
         status = svc->ops->load_object(svc->ctx, fn, out);
         break;
+    }
     case LOADER_SVC_OP_LOAD_SCRIPT_INTERP:
     case LOADER_SVC_OP_LOAD_DEBUG_CONFIG:
         // When loading a script interpreter or debug configuration file,
@@ -410,23 +634,34 @@ zx_status_t loader_service_attach(loader_service_t* svc, zx_handle_t h) {
 
     mtx_lock(&svc->dispatcher_lock);
     zx_status_t r;
-    if (svc->dispatcher == NULL) {
-        if ((r = fdio_dispatcher_create(&svc->dispatcher,
-                                        multiloader_cb)) < 0) {
-            goto done;
-        }
-        if ((r = fdio_dispatcher_start(svc->dispatcher, svc->name)) < 0) {
-            //TODO: destroy dispatcher once support exists
-            svc->dispatcher = NULL;
-            goto done;
-        }
+    if (svc->dispatcher_count == 0) {
         if (zx_log_create(0, &svc->dispatcher_log) < 0) {
             // unlikely to fail, but we'll keep going without it if so
             svc->dispatcher_log = ZX_HANDLE_INVALID;
         }
     }
+    // Start dispatcher threads lazily, one per new client, until all
+    // DISPATCHER_COUNT exist, so that a service with a single client
+    // never pays for more than one thread.
+    unsigned n = svc->dispatcher_next;
+    if (n >= svc->dispatcher_count) {
+        fdio_dispatcher_t* dispatcher;
+        if ((r = fdio_dispatcher_create(&dispatcher, multiloader_cb)) < 0 ||
+            (r = fdio_dispatcher_start(dispatcher, svc->name)) < 0) {
+            //TODO: destroy dispatcher once support exists
+            if (svc->dispatcher_count == 0) {
+                goto done;
+            }
+            // Make do with the threads we already have.
+            n = 0;
+        } else {
+            n = svc->dispatcher_count++;
+            svc->dispatcher[n] = dispatcher;
+        }
+    }
+    svc->dispatcher_next = (n + 1) % DISPATCHER_COUNT;
 
-    r = fdio_dispatcher_add(svc->dispatcher, h, NULL, svc);
+    r = fdio_dispatcher_add(svc->dispatcher[n], h, NULL, svc);
 
 done:
     mtx_unlock(&svc->dispatcher_lock);
@@ -215,6 +215,20 @@ void tftp_session_set_opcode_prefix_use(tftp_session* session,
 void tftp_session_set_block_host_endianness(tftp_session* session,
                                             bool enable);
 
+// Specify the largest block size we will agree to when acting as a server.
+// A client asking for more is offered this instead, or refused if it insists
+// on its value. 0 (the default) means no limit beyond the protocol's own.
+void tftp_session_set_max_block_size(tftp_session* session,
+                                     uint16_t max_block_size);
+
+// Specify how many of the receiver's windows may be in flight at once when
+// sending. A sender starts with one window, as in RFC 7440, and sends one
+// more ahead each time a window is acknowledged without loss, up to this
+// limit, going back to one as soon as anything has to be resent. 1 disables
+// pipelining.
+void tftp_session_set_max_send_windows(tftp_session* session,
+                                       uint16_t max_windows);
+
 // When acting as a server, the options that will be overridden when a
 // value is requested by the client. Note that if the client does not
 // specify a setting, the default will be used regardless of server
@@ -44,6 +44,7 @@ typedef struct tftp_data_msg_t {
 #define DEFAULT_MAX_TIMEOUTS 5
 #define DEFAULT_USE_OPCODE_PREFIX true
 #define DEFAULT_USE_HOST_BLOCK_ENDIANNESS false
+#define DEFAULT_MAX_SEND_WINDOWS 4
 
 typedef struct tftp_options_t {
     // A bitmask of the options that have been set
@@ -132,6 +133,20 @@ struct tftp_session_t {
     uint16_t block_size;
     uint8_t timeout;
 
+    // For a server, the largest block size we will agree to (0 for no limit).
+    uint16_t max_block_size;
+
+    // When sending, how many of the receiver's windows we may have in flight at once. It
+    // grows by one for each window that is acknowledged without loss, up to
+    // max_send_windows, and drops back to one whenever we have to resend.
+    uint16_t send_windows;
+    uint16_t max_send_windows;
+
+    // Set once we have gone back to resend from block_number, so that the duplicate ACKs
+    // the receiver sends for every block that arrives after a lost one only cause one
+    // resend.
+    bool resent;
+
     // Callbacks
     tftp_file_interface file_interface;
     tftp_transport_interface transport_interface;
@@ -662,6 +662,55 @@ static bool test_tftp_receive_force_wrq_have_overrides(void) {
     END_TEST;
 }
 
+static bool test_tftp_receive_wrq_max_blocksize(void) {
+    BEGIN_TEST;
+
+    test_state ts;
+    ts.reset(1024, 1024, 1500);
+    tftp_file_interface ifc = {NULL, dummy_open_write, NULL, NULL, NULL};
+    tftp_session_set_file_interface(ts.session, &ifc);
+    tftp_session_set_max_block_size(ts.session, 1428);
+
+    uint8_t buf[] = {
+        0x00, 0x02,                                   // Opcode (WRQ)
+        'f', 'i', 'l', 'e', 'n', 'a', 'm', 'e', 0x00, // Filename
+        'O', 'C', 'T', 'E', 'T', 0x00,                // Mode
+        'T', 'S', 'I', 'Z', 'E', 0x00,                // Option
+        '1', '0', '2', '4', 0x00,                     // TSIZE value
+        'B', 'L', 'K', 'S', 'I', 'Z', 'E', 0x00,      // Option
+        '8', '1', '9', '2', 0x00,                     // BLKSIZE value
+    };
+    auto status = tftp_process_msg(ts.session, buf, sizeof(buf), ts.out, &ts.outlen, &ts.timeout,
+                                   nullptr);
+    EXPECT_EQ(TFTP_NO_ERROR, status, "receive write request failed");
+    EXPECT_EQ(1428, ts.session->block_size, "block size should be capped");
+    EXPECT_TRUE(verify_response_opcode(ts, OPCODE_OACK), "bad response");
+    const char block_sz_str[] = { 'B', 'L', 'K', 'S', 'I', 'Z', 'E', '\0', '1', '4', '2', '8', '\0' };
+    EXPECT_TRUE(find_str_in_mem(block_sz_str, sizeof(block_sz_str),
+                                static_cast<const char*>(ts.out), ts.outlen),
+                "capped block size not offered");
+
+    // A client that insists on a larger block size is refused
+    ts.reset(1024, 1024, 1500);
+    tftp_session_set_file_interface(ts.session, &ifc);
+    tftp_session_set_max_block_size(ts.session, 1428);
+    uint8_t force_buf[] = {
+        0x00, 0x02,                                   // Opcode (WRQ)
+        'f', 'i', 'l', 'e', 'n', 'a', 'm', 'e', 0x00, // Filename
+        'O', 'C', 'T', 'E', 'T', 0x00,                // Mode
+        'T', 'S', 'I', 'Z', 'E', 0x00,                // Option
+        '1', '0', '2', '4', 0x00,                     // TSIZE value
+        'B', 'L', 'K', 'S', 'I', 'Z', 'E', '!', 0x00, // Option
+        '8', '1', '9', '2', 0x00,                     // BLKSIZE value
+    };
+    status = tftp_process_msg(ts.session, force_buf, sizeof(force_buf), ts.out, &ts.outlen,
+                              &ts.timeout, nullptr);
+    EXPECT_NE(TFTP_NO_ERROR, status, "forced block size over the maximum should fail");
+    EXPECT_TRUE(verify_response_opcode(ts, OPCODE_OERROR), "bad response");
+
+    END_TEST;
+}
+
 struct tx_test_data {
     struct {
         uint16_t block;
@@ -1732,6 +1781,323 @@ static bool test_tftp_send_data_receive_ack_skip_block_wrap(void) {
     END_TEST;
 }
 
+// Whole transfers over a simulated link. The sender is driven by tftp_push_file() and the
+// receiver by tftp_handle_msg() as each packet is delivered to it. Packets in either
+// direction are dropped at random, and time is simulated rather than measured: a packet
+// takes its serialization time to send, and the reply to it arrives one round trip later.
+struct sim_link {
+    static constexpr size_t kMaxReplies = 4096;
+    static constexpr size_t kBufSize = 65536;
+    // Ethernet, IPv6 and UDP headers, plus the ethernet preamble and inter-frame gap
+    static constexpr size_t kPacketOverhead = 14 + 40 + 8 + 20;
+
+    // Link parameters
+    uint64_t bits_per_sec = 1000000000;
+    uint64_t rtt_ns = 200000;
+    uint32_t loss_ppm = 0;
+    uint32_t seed = 1;
+
+    // The file
+    fbl::unique_ptr<uint8_t[]> src;
+    fbl::unique_ptr<uint8_t[]> dst;
+    size_t size = 0;
+    bool received = false;
+
+    // The receiver
+    fbl::unique_ptr<uint8_t[]> rx_sess_buf;
+    tftp_session* rx = nullptr;
+    fbl::unique_ptr<uint8_t[]> rx_out;
+    size_t rx_out_len = 0;
+    bool rx_started = false;
+
+    // Replies on their way to the sender
+    struct reply {
+        uint64_t arrival;
+        size_t len;
+        uint8_t data[128];
+    } replies[kMaxReplies];
+    size_t reply_head = 0;
+    size_t reply_count = 0;
+
+    // Simulated time, and the sender's current timeout
+    uint64_t now = 0;
+    uint64_t timeout_ns = 0;
+
+    // Statistics
+    size_t packets = 0;
+    size_t dropped = 0;
+    size_t timeouts = 0;
+
+    bool drop() {
+        seed = seed * 1664525 + 1013904223;
+        return (seed >> 8) % 1000000 < loss_ppm;
+    }
+};
+
+static int sim_rx_send(void* data, size_t len, void* cookie) {
+    auto link = static_cast<sim_link*>(cookie);
+    if (link->drop() || link->reply_count == sim_link::kMaxReplies ||
+        len > sizeof(link->replies[0].data)) {
+        return static_cast<int>(len);
+    }
+    size_t tail = (link->reply_head + link->reply_count) % sim_link::kMaxReplies;
+    sim_link::reply* r = &link->replies[tail];
+    r->arrival = link->now + link->rtt_ns;
+    r->len = len;
+    memcpy(r->data, data, len);
+    link->reply_count++;
+    return static_cast<int>(len);
+}
+
+static int sim_tx_send(void* data, size_t len, void* cookie) {
+    auto link = static_cast<sim_link*>(cookie);
+    link->now += (len + sim_link::kPacketOverhead) * 8 * 1000000000ull / link->bits_per_sec;
+    link->packets++;
+    if (link->drop()) {
+        link->dropped++;
+        return static_cast<int>(len);
+    }
+    link->rx_started = true;
+    size_t out_sz = sim_link::kBufSize;
+    char err_msg[128];
+    tftp_handler_opts opts = {};
+    opts.inbuf = static_cast<char*>(data);
+    opts.inbuf_sz = len;
+    opts.outbuf = reinterpret_cast<char*>(link->rx_out.get());
+    opts.outbuf_sz = &out_sz;
+    opts.err_msg = err_msg;
+    opts.err_msg_sz = sizeof(err_msg);
+    tftp_handle_msg(link->rx, link, link, &opts);
+    link->rx_out_len = out_sz;
+    return static_cast<int>(len);
+}
+
+static int sim_tx_recv(void* data, size_t len, bool block, void* cookie) {
+    auto link = static_cast<sim_link*>(cookie);
+    if (link->reply_count > 0) {
+        sim_link::reply* r = &link->replies[link->reply_head];
+        if (r->arrival > link->now && block && r->arrival <= link->now + link->timeout_ns) {
+            link->now = r->arrival;
+        }
+        if (r->arrival <= link->now) {
+            size_t n = r->len < len ? r->len : len;
+            memcpy(data, r->data, n);
+            link->reply_head = (link->reply_head + 1) % sim_link::kMaxReplies;
+            link->reply_count--;
+            return static_cast<int>(n);
+        }
+    }
+    if (block) {
+        link->now += link->timeout_ns;
+        link->timeouts++;
+        // The receiver has been waiting just as long, and sends its last message again
+        if (link->rx_started) {
+            uint32_t timeout_ms;
+            tftp_timeout(link->rx, false, link->rx_out.get(), &link->rx_out_len,
+                         sim_link::kBufSize, &timeout_ms, link);
+            if (link->rx_out_len) {
+                sim_rx_send(link->rx_out.get(), link->rx_out_len, link);
+            }
+        }
+    }
+    return TFTP_ERR_TIMED_OUT;
+}
+
+static int sim_tx_timeout_set(uint32_t timeout_ms, void* cookie) {
+    static_cast<sim_link*>(cookie)->timeout_ns = timeout_ms * 1000000ull;
+    return 0;
+}
+
+static int sim_rx_timeout_set(uint32_t timeout_ms, void* cookie) {
+    return 0;
+}
+
+static ssize_t sim_open_read(const char* filename, void* cookie) {
+    return static_cast<ssize_t>(static_cast<sim_link*>(cookie)->size);
+}
+
+static tftp_status sim_open_write(const char* filename, size_t size, void* cookie) {
+    auto link = static_cast<sim_link*>(cookie);
+    return size == link->size ? TFTP_NO_ERROR : TFTP_ERR_INVALID_ARGS;
+}
+
+static tftp_status sim_read(void* data, size_t* length, off_t offset, void* cookie) {
+    auto link = static_cast<sim_link*>(cookie);
+    if (static_cast<size_t>(offset) + *length > link->size) {
+        return TFTP_ERR_INVALID_ARGS;
+    }
+    memcpy(data, link->src.get() + offset, *length);
+    return TFTP_NO_ERROR;
+}
+
+static tftp_status sim_write(const void* data, size_t* length, off_t offset, void* cookie) {
+    auto link = static_cast<sim_link*>(cookie);
+    if (static_cast<size_t>(offset) + *length > link->size) {
+        return TFTP_ERR_INVALID_ARGS;
+    }
+    memcpy(link->dst.get() + offset, data, *length);
+    return TFTP_NO_ERROR;
+}
+
+static void sim_close(void* cookie) {
+    static_cast<sim_link*>(cookie)->received = true;
+}
+
+struct sim_result {
+    double mbit_per_sec;
+    size_t packets;
+    size_t dropped;
+    size_t timeouts;
+};
+
+// Sends |size| bytes across |link| asking for |block_size| and |window_size|, with at most
+// |max_windows| windows in flight, and checks that they all arrived.
+static bool sim_transfer(sim_link* link, size_t size, uint16_t block_size, uint16_t window_size,
+                         uint16_t max_windows, sim_result* result) {
+    BEGIN_HELPER;
+
+    link->size = size;
+    link->src.reset(new uint8_t[size]);
+    link->dst.reset(new uint8_t[size]);
+    for (size_t i = 0; i < size; i++) {
+        link->src[i] = static_cast<uint8_t>(i * 7 + (i >> 11));
+    }
+    memset(link->dst.get(), 0, size);
+
+    tftp_file_interface file_ifc = {sim_open_read, sim_open_write, sim_read, sim_write,
+                                    sim_close};
+
+    link->rx_sess_buf.reset(new uint8_t[tftp_sizeof_session()]);
+    link->rx_out.reset(new uint8_t[sim_link::kBufSize]);
+    ASSERT_EQ(TFTP_NO_ERROR, tftp_init(&link->rx, link->rx_sess_buf.get(), tftp_sizeof_session()),
+              "could not initialize receiver");
+    tftp_transport_interface rx_ifc = {sim_rx_send, NULL, sim_rx_timeout_set};
+    tftp_session_set_file_interface(link->rx, &file_ifc);
+    tftp_session_set_transport_interface(link->rx, &rx_ifc);
+    tftp_session_set_max_timeouts(link->rx, 20);
+
+    fbl::unique_ptr<uint8_t[]> tx_sess_buf(new uint8_t[tftp_sizeof_session()]);
+    tftp_session* tx;
+    ASSERT_EQ(TFTP_NO_ERROR, tftp_init(&tx, tx_sess_buf.get(), tftp_sizeof_session()),
+              "could not initialize sender");
+    tftp_transport_interface tx_ifc = {sim_tx_send, sim_tx_recv, sim_tx_timeout_set};
+    tftp_session_set_file_interface(tx, &file_ifc);
+    tftp_session_set_transport_interface(tx, &tx_ifc);
+    tftp_session_set_max_send_windows(tx, max_windows);
+    tftp_session_set_max_timeouts(tx, 20);
+    ASSERT_EQ(TFTP_NO_ERROR, tftp_set_options(tx, &block_size, NULL, &window_size),
+              "could not set options");
+
+    fbl::unique_ptr<char[]> inbuf(new char[sim_link::kBufSize]);
+    fbl::unique_ptr<char[]> outbuf(new char[sim_link::kBufSize]);
+    char err_msg[128] = "";
+    tftp_request_opts opts = {};
+    opts.inbuf = inbuf.get();
+    opts.inbuf_sz = sim_link::kBufSize;
+    opts.outbuf = outbuf.get();
+    opts.outbuf_sz = sim_link::kBufSize;
+    opts.err_msg = err_msg;
+    opts.err_msg_sz = sizeof(err_msg);
+
+    tftp_status status = tftp_push_file(tx, link, link, "src", kFilename, &opts);
+    ASSERT_EQ(TFTP_NO_ERROR, status, err_msg);
+    ASSERT_TRUE(link->received, "receiver did not finish");
+    EXPECT_BYTES_EQ(link->src.get(), link->dst.get(), size, "received data mismatch");
+
+    result->mbit_per_sec = static_cast<double>(size) * 8 * 1000 / static_cast<double>(link->now);
+    result->packets = link->packets;
+    result->dropped = link->dropped;
+    result->timeouts = link->timeouts;
+
+    END_HELPER;
+}
+
+static bool test_tftp_transfer_lossless(void) {
+    BEGIN_TEST;
+
+    constexpr size_t kSize = 1024 * 1024 + 123;
+    sim_result lockstep, pipelined;
+    {
+        fbl::unique_ptr<sim_link> link(new sim_link);
+        ASSERT_TRUE(sim_transfer(link.get(), kSize, 1428, 64, 1, &lockstep), "");
+    }
+    {
+        fbl::unique_ptr<sim_link> link(new sim_link);
+        ASSERT_TRUE(sim_transfer(link.get(), kSize, 1428, 64, 4, &pipelined), "");
+    }
+    EXPECT_EQ(0u, lockstep.timeouts, "no timeouts expected on a lossless link");
+    EXPECT_EQ(0u, pipelined.timeouts, "no timeouts expected on a lossless link");
+    // Every block is sent exactly once, plus the request
+    size_t blocks = kSize / 1428 + 1;
+    EXPECT_EQ(blocks + 1, lockstep.packets, "unexpected retransmissions");
+    EXPECT_EQ(blocks + 1, pipelined.packets, "unexpected retransmissions");
+    // Keeping the next window in flight hides the round trip at the end of each window
+    EXPECT_GT(pipelined.mbit_per_sec, lockstep.mbit_per_sec, "pipelining should be faster");
+
+    END_TEST;
+}
+
+static bool test_tftp_transfer_jumbo(void) {
+    BEGIN_TEST;
+
+    constexpr size_t kSize = 1024 * 1024;
+    sim_result result;
+    fbl::unique_ptr<sim_link> link(new sim_link);
+    ASSERT_TRUE(sim_transfer(link.get(), kSize, 8192, 16, 4, &result), "");
+    EXPECT_EQ(kSize / 8192 + 2, result.packets, "expected 8K blocks");
+
+    END_TEST;
+}
+
+static bool test_tftp_transfer_lossy(void) {
+    BEGIN_TEST;
+
+    constexpr size_t kSize = 512 * 1024;
+    const uint32_t kLossPpm[] = { 1000, 10000, 50000 };
+    for (uint32_t loss : kLossPpm) {
+        size_t dropped = 0;
+        for (uint32_t seed = 1; seed <= 3; seed++) {
+            for (uint16_t windows = 1; windows <= 4; windows *= 4) {
+                fbl::unique_ptr<sim_link> link(new sim_link);
+                link->loss_ppm = loss;
+                link->seed = seed;
+                sim_result result;
+                ASSERT_TRUE(sim_transfer(link.get(), kSize, 1428, 32, windows, &result), "");
+                dropped += result.dropped;
+            }
+        }
+        EXPECT_GT(dropped, 0u, "expected some packets to be dropped");
+    }
+
+    END_TEST;
+}
+
+static bool test_tftp_transfer_rate(void) {
+    BEGIN_TEST;
+
+    constexpr size_t kSize = 16 * 1024 * 1024;
+    const uint32_t kLossPpm[] = { 0, 1000, 10000 };
+    const uint16_t kWindowSizes[] = { 1, 16, 64, 256 };
+    unittest_printf("\n%8s %8s %8s %12s %10s %10s\n",
+                    "loss", "window", "windows", "Mbit/s", "packets", "timeouts");
+    for (uint32_t loss : kLossPpm) {
+        for (uint16_t window_size : kWindowSizes) {
+            for (uint16_t windows = 1; windows <= 4; windows *= 4) {
+                fbl::unique_ptr<sim_link> link(new sim_link);
+                link->loss_ppm = loss;
+                sim_result result;
+                ASSERT_TRUE(sim_transfer(link.get(), kSize, 1428, window_size, windows, &result),
+                            "");
+                unittest_printf("%7.1f%% %8u %8u %12.1f %10zu %10zu\n",
+                                loss / 10000.0, window_size, windows, result.mbit_per_sec,
+                                result.packets, result.timeouts);
+            }
+        }
+    }
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(tftp_setup)
 RUN_TEST(test_tftp_init)
 RUN_TEST(test_tftp_session_options)
@@ -1756,6 +2122,7 @@ RUN_TEST(test_tftp_receive_wrq_windowsize)
 RUN_TEST(test_tftp_receive_wrq_have_overrides)
 RUN_TEST(test_tftp_receive_force_wrq_no_overrides)
 RUN_TEST(test_tftp_receive_force_wrq_have_overrides)
+RUN_TEST(test_tftp_receive_wrq_max_blocksize)
 END_TEST_CASE(tftp_receive_wrq)
 
 BEGIN_TEST_CASE(tftp_receive_oack)
@@ -1785,6 +2152,13 @@ RUN_TEST(test_tftp_send_data_receive_ack_block_wrapping)
 RUN_TEST(test_tftp_send_data_receive_ack_skip_block_wrap)
 END_TEST_CASE(tftp_send_data)
 
+BEGIN_TEST_CASE(tftp_transfer)
+RUN_TEST(test_tftp_transfer_lossless)
+RUN_TEST(test_tftp_transfer_jumbo)
+RUN_TEST(test_tftp_transfer_lossy)
+RUN_TEST_PERFORMANCE(test_tftp_transfer_rate)
+END_TEST_CASE(tftp_transfer)
+
 int main(int argc, char* argv[]) {
     return unittest_run_all_tests(argc, argv) ? 0 : -1;
 }
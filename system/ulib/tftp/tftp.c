@@ -157,6 +157,21 @@ static void set_error(tftp_session* session, uint16_t opcode, tftp_msg* resp, si
     session->state = ERROR;
 }
 
+// The number of blocks past block_number we may send before waiting for an ACK. We
+// always stop at the end of one of the receiver's windows, since that is when it ACKs.
+static uint32_t send_limit(tftp_session* session) {
+    uint32_t window_size = session->window_size ? session->window_size : 1;
+    uint32_t windows = session->send_windows;
+    // Keep the blocks in flight well within what the 16-bit block numbers can tell apart.
+    if (windows > 0x7fff / window_size) {
+        windows = 0x7fff / window_size;
+    }
+    if (windows < 1) {
+        windows = 1;
+    }
+    return windows * window_size;
+}
+
 tftp_status tx_data(tftp_session* session, tftp_data_msg* resp, size_t* outlen, void* cookie) {
     session->offset = (session->block_number + session->window_index) * session->block_size;
     *outlen = 0;
@@ -182,11 +197,11 @@ tftp_status tx_data(tftp_session* session, tftp_data_msg* resp, size_t* outlen,
         }
         *outlen = sizeof(*resp) + len;
 
-        if (session->window_index < session->window_size) {
-            xprintf(" -> TRANSMIT_MORE(%d < %d)\n", session->window_index, session->window_size);
+        if (session->window_index < send_limit(session)) {
+            xprintf(" -> TRANSMIT_MORE(%d < %d)\n", session->window_index, send_limit(session));
         } else {
             xprintf(" -> TRANSMIT_WAIT_ON_ACK(%d >= %d)\n", session->window_index,
-                    session->window_size);
+                    send_limit(session));
         }
     } else {
         xprintf(" -> TRANSMIT_WAIT_ON_ACK(completed)\n");
@@ -215,6 +230,8 @@ int tftp_init(tftp_session** session, void* buffer, size_t size) {
     s->max_timeouts = DEFAULT_MAX_TIMEOUTS;
     s->use_opcode_prefix = DEFAULT_USE_OPCODE_PREFIX;
     s->use_host_block_endianness = DEFAULT_USE_HOST_BLOCK_ENDIANNESS;
+    s->send_windows = 1;
+    s->max_send_windows = DEFAULT_MAX_SEND_WINDOWS;
 
     return TFTP_NO_ERROR;
 }
@@ -240,7 +257,7 @@ tftp_status tftp_session_set_transport_interface(tftp_session* session,
 
 bool tftp_session_has_pending(tftp_session* session) {
     return session->window_index > 0 &&
-           session->window_index < session->window_size &&
+           session->window_index < send_limit(session) &&
            ((session->block_number + session->window_index) * session->block_size) <=
             session->file_size;
 }
@@ -483,6 +500,14 @@ tftp_status tftp_handle_wrq(tftp_session* session,
             } else {
                 session->block_size = override_opts->block_size;
             }
+            if (session->max_block_size && session->block_size > session->max_block_size) {
+                if (force_block_size) {
+                    xprintf("block size too large\n");
+                    set_error(session, OPCODE_OERROR, resp, resp_len);
+                    return TFTP_ERR_INTERNAL;
+                }
+                session->block_size = session->max_block_size;
+            }
         } else if (!strncasecmp(option, kTimeout, kTimeoutLen)) { // RFC 2349
             bool force_timeout_val = (option[kTimeoutLen] == '!');
             // Valid values range between "1" and "255" seconds inclusive.
@@ -690,28 +715,47 @@ tftp_status tftp_handle_ack(tftp_session* session,
     // signed 16 bit offset to determine the adjustment to the current position.
     int16_t block_offset = ack_block - (uint16_t)session->block_number;
 
-    if (session->state != SENT_FIRST_DATA && block_offset == 0) {
+    if (session->state != SENT_FIRST_DATA && block_offset == 0 &&
+            (session->resent || session->window_index == 0)) {
         // Don't acknowledge duplicate ACKs, avoiding the "Sorcerer's Apprentice Syndrome"
         *resp_len = 0;
         return TFTP_NO_ERROR;
     }
+    session->state = SENT_DATA;
 
-    if (block_offset < session->window_size) {
+    if (block_offset > 0 && (uint32_t)block_offset <= session->window_index &&
+            block_offset % session->window_size == 0) {
+        // One or more whole windows arrived. The blocks we sent after them are still in
+        // flight, so carry on from the last of those, and allow another window ahead.
+        session->block_number += block_offset;
+        session->window_index -= block_offset;
+        session->resent = false;
+        if (session->send_windows < session->max_send_windows) {
+            session->send_windows++;
+        }
+    } else {
+        // The receiver is missing the block after |ack_block|: either it saw a gap, or
+        // gave up waiting partway through a window (or, for a duplicate, it has already
+        // told us once). Go back and resend from there, one window at a time.
         // If it looks like some of our data might have been dropped, modify the prefix
         // before resending.
         if (session->use_opcode_prefix) {
             session->opcode_prefix++;
         }
+        session->block_number += block_offset;
+        session->window_index = 0;
+        session->send_windows = 1;
+        session->resent = true;
     }
-    session->state = SENT_DATA;
-    session->block_number += block_offset;
-    session->window_index = 0;
 
-    if (((session->block_number + session->window_index) * session->block_size) >
-        session->file_size) {
+    if (session->block_number * session->block_size > session->file_size) {
         *resp_len = 0;
         return TFTP_TRANSFER_COMPLETED;
     }
+    if (session->window_index >= send_limit(session)) {
+        *resp_len = 0;
+        return TFTP_NO_ERROR;
+    }
 
     tftp_status ret = tx_data(session, resp_data, resp_len, cookie);
     if (ret < 0) {
@@ -822,6 +866,8 @@ tftp_status tftp_handle_oack(tftp_session* session,
     session->offset = 0;
     session->block_number = 0;
     session->window_index = 0;
+    session->send_windows = 1;
+    session->resent = false;
 
     tftp_status ret = tx_data(session, resp_data, resp_len, cookie);
     if (ret < 0) {
@@ -918,6 +964,16 @@ void tftp_session_set_block_host_endianness(tftp_session* session,
     session->use_host_block_endianness = enable;
 }
 
+void tftp_session_set_max_block_size(tftp_session* session,
+                                     uint16_t max_block_size) {
+    session->max_block_size = max_block_size;
+}
+
+void tftp_session_set_max_send_windows(tftp_session* session,
+                                       uint16_t max_windows) {
+    session->max_send_windows = max_windows ? max_windows : 1;
+}
+
 tftp_status tftp_timeout(tftp_session* session,
                          bool sending,
                          void* msg_buf,
@@ -942,6 +998,8 @@ tftp_status tftp_timeout(tftp_session* session,
     if (sending) {
         // Reset back to the last-acknowledged block
         session->window_index = 0;
+        session->send_windows = 1;
+        session->resent = true;
         return tftp_prepare_data(session, msg_buf, msg_len, timeout_ms, file_cookie);
     } else {
         // ACK up to the last block read
@@ -17,6 +17,7 @@
 #define VIRTIO_BLK_F_FLUSH      (1u << 9)
 #define VIRTIO_BLK_F_TOPOLOGY   (1u << 10)
 #define VIRTIO_BLK_F_CONFIG_WCE (1u << 11)
+#define VIRTIO_BLK_F_MQ         (1u << 12)
 
 #define VIRTIO_BLK_T_IN         0
 #define VIRTIO_BLK_T_OUT        1
@@ -41,6 +42,19 @@ typedef struct virtio_blk_config {
     uint32_t seg_max;
     virtio_blk_geometry_t geometry;
     uint32_t blk_size;
+
+    // VIRTIO_BLK_F_TOPOLOGY
+    uint8_t physical_block_exp;
+    uint8_t alignment_offset;
+    uint16_t min_io_size;
+    uint32_t opt_io_size;
+
+    // VIRTIO_BLK_F_CONFIG_WCE
+    uint8_t writeback;
+    uint8_t unused0;
+
+    // VIRTIO_BLK_F_MQ
+    uint16_t num_queues;
 } __PACKED virtio_blk_config_t;
 
 typedef struct virtio_blk_req {
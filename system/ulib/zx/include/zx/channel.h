@@ -42,6 +42,12 @@ public:
                                 num_handles);
     }
 
+    zx_status_t writev(uint32_t flags, const zx_iovec_t* vec, uint32_t num_vec,
+                       const zx_handle_t* handles, uint32_t num_handles) const {
+        return zx_channel_writev(get(), flags, vec, num_vec, handles,
+                                 num_handles);
+    }
+
     zx_status_t call(uint32_t flags, zx_time_t deadline,
                      const zx_channel_call_args_t* args,
                      uint32_t* actual_bytes, uint32_t* actual_handles,
@@ -36,6 +36,14 @@ public:
     zx_status_t read(void* buffer, size_t len, uint32_t* actual_entries) const {
         return zx_fifo_read(get(), buffer, len, actual_entries);
     }
+
+    zx_status_t writev(const zx_iovec_t* vec, uint32_t num_vec, uint32_t* actual_entries) const {
+        return zx_fifo_writev(get(), vec, num_vec, actual_entries);
+    }
+
+    zx_status_t readv(const zx_iovec_t* vec, uint32_t num_vec, uint32_t* actual_entries) const {
+        return zx_fifo_readv(get(), vec, num_vec, actual_entries);
+    }
 };
 
 using unowned_fifo = const unowned<fifo>;
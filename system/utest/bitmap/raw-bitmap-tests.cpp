@@ -5,10 +5,19 @@
 #include <bitmap/raw-bitmap.h>
 #include <bitmap/storage.h>
 
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+
 #include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <unittest/unittest.h>
 
+// Host builds have no VmoStorage, but a few tests size bitmaps in pages.
+#if !defined(__Fuchsia__) && !defined(PAGE_SIZE)
+#define PAGE_SIZE 4096
+#endif
+
 namespace bitmap {
 namespace tests {
 
@@ -335,6 +344,133 @@ static bool SetOutOfOrder(void) {
     END_TEST;
 }
 
+template <typename RawBitmap>
+static bool ScanAcrossWords(void) {
+    BEGIN_TEST;
+
+    const size_t kSize = 3 * 4096 + 17;
+    RawBitmap bitmap;
+    ASSERT_EQ(bitmap.Reset(kSize), ZX_OK);
+
+    // Exercise runs which start and end at every interesting alignment.
+    static const size_t kOffsets[] = { 0, 1, 63, 64, 65, 127, 200, 4095, 4096, 4097, 8191 };
+    static const size_t kLengths[] = { 1, 63, 64, 65, 300, 5000 };
+    for (size_t off : kOffsets) {
+        for (size_t len : kLengths) {
+            size_t max = fbl::min(off + len, kSize);
+            size_t out;
+
+            bitmap.ClearAll();
+            EXPECT_EQ(bitmap.Set(off, max), ZX_OK);
+            EXPECT_EQ(bitmap.Scan(0, kSize, false), off);
+            EXPECT_EQ(bitmap.Scan(off, kSize, true), max);
+            EXPECT_EQ(bitmap.Scan(max, kSize, false), kSize);
+            EXPECT_EQ(bitmap.Find(true, 0, kSize, max - off, &out), ZX_OK);
+            EXPECT_EQ(out, off);
+            EXPECT_EQ(bitmap.Find(true, 0, kSize, max - off + 1, &out), ZX_ERR_NO_RESOURCES);
+
+            EXPECT_EQ(bitmap.Set(0, kSize), ZX_OK);
+            EXPECT_EQ(bitmap.Clear(off, max), ZX_OK);
+            EXPECT_EQ(bitmap.Scan(0, kSize, true), off);
+            EXPECT_EQ(bitmap.Scan(off, kSize, false), max);
+            EXPECT_EQ(bitmap.Scan(max, kSize, true), kSize);
+            EXPECT_EQ(bitmap.Find(false, 0, kSize, max - off, &out), ZX_OK);
+            EXPECT_EQ(out, off);
+        }
+    }
+
+    END_TEST;
+}
+
+static uint32_t Rand(uint32_t* seed) {
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 8;
+}
+
+// Runs a random mix of operations against two bitmaps, one with a summary and
+// one without, and checks that they always agree.
+template <typename RawBitmap>
+static bool SummaryMatchesPlain(void) {
+    BEGIN_TEST;
+
+    const size_t kSize = 64 * 4096 + 100;
+    RawBitmap plain;
+    RawBitmap summarized;
+    ASSERT_EQ(plain.Reset(kSize), ZX_OK);
+    ASSERT_EQ(summarized.Reset(kSize), ZX_OK);
+    ASSERT_EQ(summarized.EnableSummary(), ZX_OK);
+
+    uint32_t seed = 1;
+    for (size_t i = 0; i < 2000; ++i) {
+        // Mostly large sets, so that whole summary groups fill up, with small
+        // clears punching holes back into them.
+        bool clear = (i % 4) == 3;
+        size_t off = Rand(&seed) % kSize;
+        size_t len = clear ? Rand(&seed) % 64 + 1 : Rand(&seed) % 20000;
+        size_t max = fbl::min(off + len, kSize);
+        if (clear) {
+            ASSERT_EQ(plain.Clear(off, max), ZX_OK);
+            ASSERT_EQ(summarized.Clear(off, max), ZX_OK);
+        } else {
+            ASSERT_EQ(plain.Set(off, max), ZX_OK);
+            ASSERT_EQ(summarized.Set(off, max), ZX_OK);
+        }
+
+        size_t start = Rand(&seed) % kSize;
+        EXPECT_EQ(plain.Scan(start, kSize, true), summarized.Scan(start, kSize, true));
+        EXPECT_EQ(plain.Scan(start, kSize, false), summarized.Scan(start, kSize, false));
+
+        size_t run_len = Rand(&seed) % 8 + 1;
+        size_t plain_out, summarized_out;
+        EXPECT_EQ(plain.Find(false, start, kSize, run_len, &plain_out),
+                  summarized.Find(false, start, kSize, run_len, &summarized_out));
+        EXPECT_EQ(plain_out, summarized_out);
+    }
+
+    // A completely full bitmap has nothing to find, until a bit is cleared.
+    size_t out;
+    EXPECT_EQ(summarized.Set(0, kSize), ZX_OK);
+    EXPECT_EQ(summarized.Scan(0, kSize, true), kSize);
+    EXPECT_EQ(summarized.Find(false, 0, kSize, 1, &out), ZX_ERR_NO_RESOURCES);
+    EXPECT_EQ(summarized.ClearOne(kSize - 1), ZX_OK);
+    EXPECT_EQ(summarized.Find(false, 0, kSize, 1, &out), ZX_OK);
+    EXPECT_EQ(out, kSize - 1);
+
+    // Clearing everything resets the summary too.
+    summarized.ClearAll();
+    EXPECT_EQ(summarized.Scan(0, kSize, false), kSize);
+    EXPECT_EQ(summarized.Find(false, 0, kSize, kSize, &out), ZX_OK);
+
+    END_TEST;
+}
+
+template <typename RawBitmap>
+static bool SummaryRebuild(void) {
+    BEGIN_TEST;
+
+    const size_t kSize = 16 * 4096;
+    RawBitmap bitmap;
+    ASSERT_EQ(bitmap.Reset(kSize), ZX_OK);
+    ASSERT_EQ(bitmap.EnableSummary(), ZX_OK);
+
+    // Fill the storage behind the bitmap's back, as a filesystem does when it
+    // loads its bitmaps from disk, then rebuild the summary.
+    void* data = const_cast<void*>(bitmap.StorageUnsafe()->GetData());
+    memset(data, 0xff, kSize / 8);
+    EXPECT_EQ(bitmap.EnableSummary(), ZX_OK);
+    EXPECT_EQ(bitmap.Scan(0, kSize, true), kSize);
+
+    EXPECT_EQ(bitmap.ClearOne(5 * 4096 + 7), ZX_OK);
+    EXPECT_EQ(bitmap.Scan(0, kSize, true), 5 * 4096 + 7);
+
+    // Reset returns the bitmap to empty, but keeps the summary enabled.
+    EXPECT_EQ(bitmap.Reset(2 * kSize), ZX_OK);
+    EXPECT_EQ(bitmap.Set(0, 2 * kSize - 1), ZX_OK);
+    EXPECT_EQ(bitmap.Scan(0, 2 * kSize, true), 2 * kSize - 1);
+
+    END_TEST;
+}
+
 template <typename RawBitmap>
 static bool GrowAcrossPage(void) {
     BEGIN_TEST;
@@ -426,6 +562,29 @@ static bool GrowShrink(void) {
     END_TEST;
 }
 
+template <typename RawBitmap>
+static bool SummaryGrow(void) {
+    BEGIN_TEST;
+
+    RawBitmap bitmap;
+    ASSERT_EQ(bitmap.Reset(2 * 4096), ZX_OK);
+    ASSERT_EQ(bitmap.EnableSummary(), ZX_OK);
+    EXPECT_EQ(bitmap.Set(0, 2 * 4096), ZX_OK);
+
+    // The newly grown bits are unset, including those in the summary group
+    // which straddles the old end of the bitmap.
+    size_t out;
+    EXPECT_EQ(bitmap.Shrink(2 * 4096 - 10), ZX_OK);
+    EXPECT_EQ(bitmap.Grow(16 * 4096), ZX_OK);
+    EXPECT_EQ(bitmap.Find(false, 0, 16 * 4096, 1, &out), ZX_OK);
+    EXPECT_EQ(out, 2 * 4096 - 10);
+
+    EXPECT_EQ(bitmap.Set(0, 16 * 4096), ZX_OK);
+    EXPECT_EQ(bitmap.Find(false, 0, 16 * 4096, 1, &out), ZX_ERR_NO_RESOURCES);
+
+    END_TEST;
+}
+
 template <typename RawBitmap>
 static bool GrowFailure(void) {
     BEGIN_TEST;
@@ -441,6 +600,78 @@ static bool GrowFailure(void) {
     END_TEST;
 }
 
+static uint64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+// What Scan used to do: look at one word at a time.
+static size_t WordAtATimeScan(const size_t* data, size_t words) {
+    for (size_t i = 0; i < words; ++i) {
+        if (data[i] != ~static_cast<size_t>(0)) {
+            return i;
+        }
+    }
+    return words;
+}
+
+// Times an allocation-style Find in a bitmap which is full except for its
+// last few bits, so every search crosses the whole bitmap.
+static bool FindBenchmark(void) {
+    BEGIN_TEST;
+
+    using RawBitmap = RawBitmapGeneric<DefaultStorage>;
+    static const size_t kSizes[] = { 1 << 16, 1 << 20, 1 << 24, 1 << 27 };
+    const size_t kIterations = 16;
+
+    unittest_printf("\n%10s %12s %12s %12s %12s\n",
+                    "bits", "word loop", "Find", "w/ summary", "Set");
+    for (size_t size : kSizes) {
+        RawBitmap plain;
+        RawBitmap summarized;
+        ASSERT_EQ(plain.Reset(size), ZX_OK);
+        ASSERT_EQ(summarized.Reset(size), ZX_OK);
+        ASSERT_EQ(summarized.EnableSummary(), ZX_OK);
+
+        uint64_t start = NowNs();
+        for (size_t i = 0; i < kIterations; ++i) {
+            ASSERT_EQ(plain.Set(0, size - 8), ZX_OK);
+        }
+        uint64_t set_ns = (NowNs() - start) / kIterations;
+        ASSERT_EQ(summarized.Set(0, size - 8), ZX_OK);
+
+        auto data = static_cast<const size_t*>(plain.StorageUnsafe()->GetData());
+        size_t word = 0;
+        start = NowNs();
+        for (size_t i = 0; i < kIterations; ++i) {
+            word += WordAtATimeScan(data, size / kBits);
+        }
+        uint64_t loop_ns = (NowNs() - start) / kIterations;
+        EXPECT_EQ(word, kIterations * ((size - 8) / kBits));
+
+        size_t out;
+        start = NowNs();
+        for (size_t i = 0; i < kIterations; ++i) {
+            ASSERT_EQ(plain.Find(false, 0, size, 1, &out), ZX_OK);
+        }
+        uint64_t find_ns = (NowNs() - start) / kIterations;
+        EXPECT_EQ(out, size - 8);
+
+        start = NowNs();
+        for (size_t i = 0; i < kIterations; ++i) {
+            ASSERT_EQ(summarized.Find(false, 0, size, 1, &out), ZX_OK);
+        }
+        uint64_t summary_ns = (NowNs() - start) / kIterations;
+        EXPECT_EQ(out, size - 8);
+
+        unittest_printf("%10zu %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64 "\n",
+                        size, loop_ns, find_ns, summary_ns, set_ns);
+    }
+
+    END_TEST;
+}
+
 #define RUN_TEMPLATIZED_TEST(test, specialization) RUN_TEST(test<specialization>)
 #define ALL_TESTS(specialization)                           \
     RUN_TEMPLATIZED_TEST(InitializedEmpty, specialization)  \
@@ -453,14 +684,21 @@ static bool GrowFailure(void) {
     RUN_TEMPLATIZED_TEST(ClearSubrange, specialization)     \
     RUN_TEMPLATIZED_TEST(BoundaryArguments, specialization) \
     RUN_TEMPLATIZED_TEST(ClearAll, specialization)          \
-    RUN_TEMPLATIZED_TEST(SetOutOfOrder, specialization)
+    RUN_TEMPLATIZED_TEST(SetOutOfOrder, specialization)     \
+    RUN_TEMPLATIZED_TEST(ScanAcrossWords, specialization)   \
+    RUN_TEMPLATIZED_TEST(SummaryMatchesPlain, specialization) \
+    RUN_TEMPLATIZED_TEST(SummaryRebuild, specialization)
 
 BEGIN_TEST_CASE(raw_bitmap_tests)
 ALL_TESTS(RawBitmapGeneric<DefaultStorage>)
+#ifdef __Fuchsia__
 ALL_TESTS(RawBitmapGeneric<VmoStorage>)
 RUN_TEST(GrowAcrossPage<RawBitmapGeneric<VmoStorage>>)
 RUN_TEST(GrowShrink<RawBitmapGeneric<VmoStorage>>)
+RUN_TEST(SummaryGrow<RawBitmapGeneric<VmoStorage>>)
+#endif
 RUN_TEST(GrowFailure<RawBitmapGeneric<DefaultStorage>>)
+RUN_TEST_PERFORMANCE(FindBenchmark)
 END_TEST_CASE(raw_bitmap_tests);
 
 } // namespace tests
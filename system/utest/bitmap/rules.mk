@@ -28,3 +28,31 @@ MODULE_LIBS := \
     system/ulib/unittest \
 
 include make/module.mk
+
+# Host tests.
+
+MODULE := $(LOCAL_DIR).hostapp
+
+MODULE_TYPE := hostapp
+
+MODULE_NAME := bitmap-test
+
+MODULE_SRCS += \
+    $(LOCAL_DIR)/main.c \
+    $(LOCAL_DIR)/raw-bitmap-tests.cpp \
+    $(LOCAL_DIR)/rle-bitmap-tests.cpp \
+    system/ulib/bitmap/raw-bitmap.cpp \
+    system/ulib/bitmap/rle-bitmap.cpp \
+
+MODULE_COMPILEFLAGS := \
+    -Isystem/ulib/bitmap/include \
+    -Isystem/ulib/fbl/include \
+    -Isystem/ulib/unittest/include \
+    -Isystem/ulib/zxcpp/include \
+
+MODULE_HOST_LIBS := \
+    system/ulib/fbl.hostlib \
+    system/ulib/pretty.hostlib \
+    system/ulib/unittest.hostlib \
+
+include make/module.mk
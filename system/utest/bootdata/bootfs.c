@@ -0,0 +1,171 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fdio/util.h>
+#include <zircon/boot/bootdata.h>
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+
+#include <unittest/unittest.h>
+
+// Number of files in the synthetic bootfs image; about what a full
+// /boot holds.
+static const uint32_t kFileCount = 1000;
+
+static void file_name(char* buf, size_t len, uint32_t i) {
+    snprintf(buf, len, "lib/libsynthetic-%04u.so", i);
+}
+
+static const uint8_t* sort_dir;
+
+static int cmp_entries(const void* a, const void* b) {
+    const bootfs_entry_t* ea = (const void*)(sort_dir + *(const uint32_t*)a);
+    const bootfs_entry_t* eb = (const void*)(sort_dir + *(const uint32_t*)b);
+    int r = strcmp(ea->name, eb->name);
+    if (r == 0) {
+        r = (*(const uint32_t*)a < *(const uint32_t*)b) ? -1 : 1;
+    }
+    return r;
+}
+
+// Build a bootfs image holding kFileCount files, laid out the way mkbootfs
+// would, optionally with the sorted directory index.  All the files hold
+// "a", except for a duplicate of the first one at the end of the directory,
+// which holds "b".
+static bool make_bootfs(bool with_index, zx_handle_t* vmo) {
+    BEGIN_HELPER;
+
+    char name[BOOTFS_MAX_NAME_LEN];
+    size_t dirsize = 0;
+    for (uint32_t i = 0; i <= kFileCount; ++i) {
+        file_name(name, sizeof(name), i % kFileCount);
+        dirsize += sizeof(bootfs_entry_t) + BOOTFS_ALIGN(strlen(name) + 1);
+    }
+    uint32_t count = with_index ? kFileCount + 1 : 0;
+    size_t hdrsize = sizeof(bootfs_header_t) + dirsize + count * sizeof(uint32_t);
+    size_t data_off = (hdrsize + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    size_t len = data_off + 2 * PAGE_SIZE;
+
+    uint8_t* buf = calloc(1, len);
+    ASSERT_NONNULL(buf, "");
+    bootfs_header_t* hdr = (bootfs_header_t*)buf;
+    hdr->magic = BOOTFS_MAGIC;
+    hdr->dirsize = dirsize;
+    hdr->index_count = count;
+
+    uint8_t* dir = buf + sizeof(bootfs_header_t);
+    uint32_t* index = (uint32_t*)(dir + dirsize);
+    size_t off = 0;
+    for (uint32_t i = 0; i <= kFileCount; ++i) {
+        bootfs_entry_t* e = (bootfs_entry_t*)(dir + off);
+        file_name(name, sizeof(name), i % kFileCount);
+        e->name_len = strlen(name) + 1;
+        e->data_len = 1;
+        e->data_off = (i == kFileCount) ? data_off + PAGE_SIZE : data_off;
+        memcpy(e->name, name, e->name_len);
+        if (with_index) {
+            index[i] = off;
+        }
+        off += BOOTFS_RECSIZE(e);
+    }
+    if (with_index) {
+        sort_dir = dir;
+        qsort(index, count, sizeof(uint32_t), cmp_entries);
+    }
+    buf[data_off] = 'a';
+    buf[data_off + PAGE_SIZE] = 'b';
+
+    ASSERT_EQ(zx_vmo_create(len, 0, vmo), ZX_OK, "");
+    size_t actual;
+    ASSERT_EQ(zx_vmo_write(*vmo, buf, 0, len, &actual), ZX_OK, "");
+    free(buf);
+
+    END_HELPER;
+}
+
+static bool open_all(bootfs_t* bfs) {
+    BEGIN_HELPER;
+
+    char name[BOOTFS_MAX_NAME_LEN];
+    for (uint32_t i = 0; i < kFileCount; ++i) {
+        file_name(name, sizeof(name), i);
+        zx_handle_t vmo;
+        ASSERT_EQ(bootfs_open(bfs, name, &vmo), ZX_OK, name);
+        zx_handle_close(vmo);
+    }
+
+    END_HELPER;
+}
+
+static bool bootfs_index_test(void) {
+    BEGIN_TEST;
+
+    for (int with_index = 0; with_index <= 1; ++with_index) {
+        zx_handle_t vmo;
+        ASSERT_TRUE(make_bootfs(with_index, &vmo), "");
+        bootfs_t bfs;
+        ASSERT_EQ(bootfs_create(&bfs, vmo), ZX_OK, "");
+        EXPECT_EQ(bfs.index_count, with_index ? kFileCount + 1 : 0, "");
+
+        EXPECT_TRUE(open_all(&bfs), "");
+
+        // A duplicate name resolves to the first entry, as it always has.
+        zx_handle_t file;
+        char name[BOOTFS_MAX_NAME_LEN];
+        file_name(name, sizeof(name), 0);
+        ASSERT_EQ(bootfs_open(&bfs, name, &file), ZX_OK, "");
+        char data;
+        size_t actual;
+        EXPECT_EQ(zx_vmo_read(file, &data, 0, 1, &actual), ZX_OK, "");
+        EXPECT_EQ(data, 'a', "found the duplicate entry");
+        zx_handle_close(file);
+
+        EXPECT_EQ(bootfs_open(&bfs, "lib/libsynthetic", &file),
+                  ZX_ERR_NOT_FOUND, "");
+        EXPECT_EQ(bootfs_open(&bfs, "lib/libsynthetic-9999.so", &file),
+                  ZX_ERR_NOT_FOUND, "");
+        EXPECT_EQ(bootfs_open(&bfs, "", &file), ZX_ERR_NOT_FOUND, "");
+
+        bootfs_destroy(&bfs);
+        zx_handle_close(vmo);
+    }
+
+    END_TEST;
+}
+
+static bool bootfs_lookup_benchmark(void) {
+    BEGIN_TEST;
+
+    for (int with_index = 0; with_index <= 1; ++with_index) {
+        zx_handle_t vmo;
+        ASSERT_TRUE(make_bootfs(with_index, &vmo), "");
+        bootfs_t bfs;
+        ASSERT_EQ(bootfs_create(&bfs, vmo), ZX_OK, "");
+
+        zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+        EXPECT_TRUE(open_all(&bfs), "");
+        zx_time_t elapsed = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+        unittest_printf("\n    %s: %u lookups in %" PRIu64 " us"
+                        " (%" PRIu64 " ns each)",
+                        with_index ? "indexed" : "linear", kFileCount,
+                        elapsed / 1000, elapsed / kFileCount);
+
+        bootfs_destroy(&bfs);
+        zx_handle_close(vmo);
+    }
+    unittest_printf("\n");
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(bootfs_lookup_tests)
+RUN_TEST(bootfs_index_test);
+RUN_TEST_PERFORMANCE(bootfs_lookup_benchmark);
+END_TEST_CASE(bootfs_lookup_tests)
@@ -0,0 +1,296 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <bootdata/decompress.h>
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lz4frame.h>
+#include <zircon/boot/bootdata.h>
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+
+#include <unittest/unittest.h>
+
+// Size of the synthetic bootfs images. Neither is a multiple of the 64kB
+// LZ4 block size, so the last block is short.
+static const size_t kTestSize = 4 * 1024 * 1024 - 1234;
+static const size_t kBenchmarkSize = 32 * 1024 * 1024 - 1234;
+
+// Offset of the content size in an item: it follows the bootdata header,
+// the LZ4 frame magic and the FLG and BD bytes.
+static const size_t kContentSizeOffset = sizeof(bootdata_t) + sizeof(uint32_t) + 2;
+
+// Fill buf with something that compresses about as well as a real bootfs:
+// runs of repeated text broken up by pseudo-random bytes.
+static void fill_image(uint8_t* buf, size_t len) {
+    static const char kText[] = "the quick brown fox jumps over the lazy dog ";
+    uint32_t seed = 1;
+    for (size_t i = 0; i < len; ++i) {
+        seed = seed * 1103515245 + 12345;
+        buf[i] = ((seed >> 16) % 8 == 0) ? (uint8_t)(seed >> 8)
+                                         : (uint8_t)kText[i % (sizeof(kText) - 1)];
+    }
+}
+
+// compress_frame for a non-zero flush_at: a streaming compression, flushed
+// after the first flush_at bytes.
+static bool compress_frame_flushed(const uint8_t* image, size_t len, size_t flush_at,
+                                   const LZ4F_preferences_t* prefs,
+                                   uint8_t* dst, size_t cap, size_t* clen) {
+    BEGIN_HELPER;
+
+    LZ4F_compressionContext_t ctx;
+    ASSERT_FALSE(LZ4F_isError(LZ4F_createCompressionContext(&ctx, LZ4F_VERSION)), "");
+    size_t off = LZ4F_compressBegin(ctx, dst, cap, prefs);
+    ASSERT_FALSE(LZ4F_isError(off), "LZ4F_compressBegin");
+    size_t n = LZ4F_compressUpdate(ctx, dst + off, cap - off, image, flush_at, NULL);
+    ASSERT_FALSE(LZ4F_isError(n), "LZ4F_compressUpdate");
+    off += n;
+    n = LZ4F_flush(ctx, dst + off, cap - off, NULL);
+    ASSERT_FALSE(LZ4F_isError(n), "LZ4F_flush");
+    off += n;
+    n = LZ4F_compressUpdate(ctx, dst + off, cap - off, image + flush_at, len - flush_at, NULL);
+    ASSERT_FALSE(LZ4F_isError(n), "LZ4F_compressUpdate");
+    off += n;
+    n = LZ4F_compressEnd(ctx, dst + off, cap - off, NULL);
+    ASSERT_FALSE(LZ4F_isError(n), "LZ4F_compressEnd");
+    off += n;
+    LZ4F_freeCompressionContext(ctx);
+    *clen = off;
+
+    END_HELPER;
+}
+
+// Compress image into one LZ4 frame at dst, which has room for cap bytes,
+// the way mkbootfs would. If flush_at is not zero, the block holding byte
+// flush_at - 1 is cut short there, as a streaming writer that flushed
+// would; the decompressor can't place the blocks after it up front.
+static bool compress_frame(const uint8_t* image, size_t len, size_t flush_at,
+                           uint8_t* dst, size_t cap, size_t* clen) {
+    BEGIN_HELPER;
+
+    LZ4F_preferences_t prefs = {
+        .frameInfo = {
+            .blockSizeID = LZ4F_max64KB,
+            .blockMode = LZ4F_blockIndependent,
+            .contentSize = len,
+        },
+        .compressionLevel = 1,
+    };
+    if (flush_at == 0) {
+        *clen = LZ4F_compressFrame(dst, cap, image, len, &prefs);
+        ASSERT_FALSE(LZ4F_isError(*clen), "LZ4F_compressFrame");
+    } else {
+        ASSERT_TRUE(compress_frame_flushed(image, len, flush_at, &prefs, dst, cap, clen), "");
+    }
+
+    END_HELPER;
+}
+
+// Build a VMO holding one compressed BOOTFS bootdata item for image.
+static bool make_bootdata(const uint8_t* image, size_t len, size_t flush_at,
+                          zx_handle_t* vmo, size_t* item_len) {
+    BEGIN_HELPER;
+
+    LZ4F_preferences_t prefs = {
+        .frameInfo = { .blockSizeID = LZ4F_max64KB },
+    };
+    // Leave room for the extra block a flush makes.
+    size_t bound = LZ4F_compressFrameBound(len, &prefs) + 1024;
+    uint8_t* buf = malloc(sizeof(bootdata_t) + bound);
+    ASSERT_NONNULL(buf, "");
+    size_t clen;
+    ASSERT_TRUE(compress_frame(image, len, flush_at, buf + sizeof(bootdata_t), bound, &clen),
+                "");
+
+    bootdata_t hdr = {
+        .type = BOOTDATA_BOOTFS_BOOT,
+        .length = clen,
+        .extra = len,
+        .flags = BOOTDATA_BOOTFS_FLAG_COMPRESSED,
+    };
+    memcpy(buf, &hdr, sizeof(hdr));
+    *item_len = sizeof(hdr) + clen;
+
+    ASSERT_EQ(zx_vmo_create(*item_len, 0, vmo), ZX_OK, "");
+    size_t actual;
+    ASSERT_EQ(zx_vmo_write(*vmo, buf, 0, *item_len, &actual), ZX_OK, "");
+    free(buf);
+
+    END_HELPER;
+}
+
+static bool check_contents(zx_handle_t vmo, const uint8_t* image, size_t len) {
+    BEGIN_HELPER;
+
+    uint8_t* buf = malloc(len);
+    ASSERT_NONNULL(buf, "");
+    size_t actual;
+    ASSERT_EQ(zx_vmo_read(vmo, buf, 0, len, &actual), ZX_OK, "");
+    ASSERT_EQ(actual, len, "");
+    EXPECT_EQ(memcmp(buf, image, len), 0, "decompressed contents differ");
+    free(buf);
+
+    END_HELPER;
+}
+
+static const unsigned kThreads[] = { 1, 2, 4, 0 };
+
+// Decompress the item in vmo serially (threads < 0) or on threads threads,
+// and check that it matches image. If elapsed is not NULL, it gets the time
+// the decompression took.
+static bool check_decompress(zx_handle_t vmo, size_t item_len, int threads,
+                             const uint8_t* image, size_t len,
+                             zx_time_t* elapsed) {
+    BEGIN_HELPER;
+
+    const char* err = NULL;
+    zx_handle_t out = ZX_HANDLE_INVALID;
+    zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+    zx_status_t status;
+    if (threads < 0) {
+        status = decompress_bootdata(zx_vmar_root_self(), vmo, 0, item_len, &out, &err);
+    } else {
+        status = decompress_bootdata_parallel(zx_vmar_root_self(), vmo, 0, item_len,
+                                              threads, &out, &err);
+    }
+    if (elapsed != NULL)
+        *elapsed = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+    ASSERT_EQ(status, ZX_OK, err);
+    EXPECT_TRUE(check_contents(out, image, len), "");
+    zx_handle_close(out);
+
+    END_HELPER;
+}
+
+// Parallel decompression gives the same output as serial decompression.
+static bool decompress_test(void) {
+    BEGIN_TEST;
+
+    uint8_t* image = malloc(kTestSize);
+    ASSERT_NONNULL(image, "");
+    fill_image(image, kTestSize);
+
+    zx_handle_t vmo;
+    size_t item_len;
+    ASSERT_TRUE(make_bootdata(image, kTestSize, 0, &vmo, &item_len), "");
+
+    EXPECT_TRUE(check_decompress(vmo, item_len, -1, image, kTestSize, NULL), "serial");
+    for (size_t i = 0; i < countof(kThreads); ++i) {
+        EXPECT_TRUE(check_decompress(vmo, item_len, kThreads[i], image, kTestSize, NULL),
+                    "parallel");
+    }
+
+    zx_handle_close(vmo);
+    free(image);
+
+    END_TEST;
+}
+
+// A frame whose blocks before the last aren't all 64kB can't be split up
+// front, so parallel decompression falls back to doing it serially.
+static bool decompress_fallback_test(void) {
+    BEGIN_TEST;
+
+    uint8_t* image = malloc(kTestSize);
+    ASSERT_NONNULL(image, "");
+    fill_image(image, kTestSize);
+
+    zx_handle_t vmo;
+    size_t item_len;
+    ASSERT_TRUE(make_bootdata(image, kTestSize, 1000, &vmo, &item_len), "");
+
+    EXPECT_TRUE(check_decompress(vmo, item_len, -1, image, kTestSize, NULL), "serial");
+    EXPECT_TRUE(check_decompress(vmo, item_len, 4, image, kTestSize, NULL), "parallel");
+
+    zx_handle_close(vmo);
+    free(image);
+
+    END_TEST;
+}
+
+static bool decompress_truncated_test(void) {
+    BEGIN_TEST;
+
+    static const size_t kSize = 1024 * 1024;
+    uint8_t* image = malloc(kSize);
+    ASSERT_NONNULL(image, "");
+    fill_image(image, kSize);
+
+    zx_handle_t vmo;
+    size_t item_len;
+    ASSERT_TRUE(make_bootdata(image, kSize, 0, &vmo, &item_len), "");
+
+    // Claim the content is a page smaller than it is, in both the bootdata
+    // header and the LZ4 frame, so that the headers agree and it is the
+    // output buffer running out that gets caught.
+    bootdata_t hdr;
+    size_t actual;
+    ASSERT_EQ(zx_vmo_read(vmo, &hdr, 0, sizeof(hdr), &actual), ZX_OK, "");
+    hdr.extra -= PAGE_SIZE;
+    ASSERT_EQ(zx_vmo_write(vmo, &hdr, 0, sizeof(hdr), &actual), ZX_OK, "");
+    uint64_t content_size = hdr.extra;
+    ASSERT_EQ(zx_vmo_write(vmo, &content_size, kContentSizeOffset, sizeof(content_size),
+                           &actual), ZX_OK, "");
+
+    static const char kSizeMismatch[] = "lz4 content size does not match bootdata outsize";
+    const char* err = NULL;
+    zx_handle_t out = ZX_HANDLE_INVALID;
+    EXPECT_NE(decompress_bootdata(zx_vmar_root_self(), vmo, 0, item_len,
+                                  &out, &err), ZX_OK, "");
+    EXPECT_NE(strcmp(err, kSizeMismatch), 0, err);
+    err = NULL;
+    EXPECT_NE(decompress_bootdata_parallel(zx_vmar_root_self(), vmo, 0,
+                                           item_len, 4, &out, &err),
+              ZX_OK, "");
+    EXPECT_NE(strcmp(err, kSizeMismatch), 0, err);
+
+    zx_handle_close(vmo);
+    free(image);
+
+    END_TEST;
+}
+
+static bool decompress_benchmark(void) {
+    BEGIN_TEST;
+
+    uint8_t* image = malloc(kBenchmarkSize);
+    ASSERT_NONNULL(image, "");
+    fill_image(image, kBenchmarkSize);
+
+    zx_handle_t vmo;
+    size_t item_len;
+    ASSERT_TRUE(make_bootdata(image, kBenchmarkSize, 0, &vmo, &item_len), "");
+
+    zx_time_t elapsed;
+    EXPECT_TRUE(check_decompress(vmo, item_len, -1, image, kBenchmarkSize, &elapsed), "");
+    unittest_printf("\n    serial: %" PRIu64 " us", elapsed / 1000);
+    for (size_t i = 0; i < countof(kThreads); ++i) {
+        EXPECT_TRUE(check_decompress(vmo, item_len, kThreads[i], image, kBenchmarkSize,
+                                     &elapsed), "");
+        unittest_printf("\n    %u threads: %" PRIu64 " us", kThreads[i], elapsed / 1000);
+    }
+    unittest_printf("\n");
+
+    zx_handle_close(vmo);
+    free(image);
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(bootdata_decompress_tests)
+RUN_TEST(decompress_test);
+RUN_TEST(decompress_fallback_test);
+RUN_TEST(decompress_truncated_test);
+RUN_TEST_PERFORMANCE(decompress_benchmark);
+END_TEST_CASE(bootdata_decompress_tests)
+
+int main(int argc, char** argv) {
+    bool success = unittest_run_all_tests(argc, argv);
+    return success ? 0 : -1;
+}
@@ -0,0 +1,29 @@
+# Copyright 2017 The Fuchsia Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+MODULE := $(LOCAL_DIR)
+
+MODULE_TYPE := usertest
+
+MODULE_SRCS += \
+    $(LOCAL_DIR)/bootfs.c \
+    $(LOCAL_DIR)/decompress.c
+
+MODULE_NAME := bootdata-test
+
+MODULE_STATIC_LIBS := \
+    system/ulib/bootdata \
+    third_party/ulib/lz4
+
+MODULE_LIBS := \
+    system/ulib/unittest \
+    system/ulib/fdio \
+    system/ulib/zircon \
+    system/ulib/c
+
+MODULE_COMPILEFLAGS += -Ithird_party/ulib/lz4/include/lz4
+
+include make/module.mk
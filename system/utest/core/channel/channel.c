@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include <assert.h>
+#include <inttypes.h>
 #include <zircon/compiler.h>
 #include <zircon/syscalls.h>
 #include <zircon/syscalls/object.h>
@@ -10,6 +11,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <threads.h>
 #include <unistd.h>
 
@@ -855,6 +857,130 @@ static bool channel_disallow_write_to_self(void) {
     END_TEST;
 }
 
+static bool channel_writev(void) {
+    BEGIN_TEST;
+
+    zx_handle_t channel[2];
+    ASSERT_EQ(zx_channel_create(0, &channel[0], &channel[1]), ZX_OK, "");
+    zx_handle_t event;
+    ASSERT_EQ(zx_event_create(0u, &event), ZX_OK, "");
+
+    char header[] = "head";
+    char payload[] = "payload";
+    zx_iovec_t vec[3] = {
+        {header, 4},
+        {NULL, 0},
+        {payload, 7},
+    };
+    ASSERT_EQ(zx_channel_writev(channel[0], 0u, vec, countof(vec), &event, 1u), ZX_OK, "");
+
+    char buf[16];
+    zx_handle_t handle;
+    uint32_t num_bytes, num_handles;
+    ASSERT_EQ(zx_channel_read(channel[1], 0u, buf, &handle, sizeof(buf), 1u,
+                              &num_bytes, &num_handles), ZX_OK, "");
+    EXPECT_EQ(num_bytes, 11u, "");
+    EXPECT_EQ(num_handles, 1u, "");
+    EXPECT_EQ(memcmp(buf, "headpayload", 11), 0, "");
+    EXPECT_EQ(zx_handle_close(handle), ZX_OK, "");
+
+    // an empty message
+    ASSERT_EQ(zx_channel_writev(channel[0], 0u, NULL, 0u, NULL, 0u), ZX_OK, "");
+    ASSERT_EQ(zx_channel_read(channel[1], 0u, buf, NULL, sizeof(buf), 0u,
+                              &num_bytes, NULL), ZX_OK, "");
+    EXPECT_EQ(num_bytes, 0u, "");
+
+    // too many buffers, too many bytes, or a bad buffer
+    zx_iovec_t many[ZX_IOVEC_MAX + 1];
+    for (size_t i = 0; i < countof(many); i++) {
+        many[i].buffer = buf;
+        many[i].length = 1;
+    }
+    EXPECT_EQ(zx_channel_writev(channel[0], 0u, many, countof(many), NULL, 0u),
+              ZX_ERR_OUT_OF_RANGE, "");
+    many[0].length = ZX_CHANNEL_MAX_MSG_BYTES;
+    EXPECT_EQ(zx_channel_writev(channel[0], 0u, many, 2u, NULL, 0u),
+              ZX_ERR_OUT_OF_RANGE, "");
+    many[0].length = 1;
+    many[1].buffer = (void*)1;
+    EXPECT_EQ(zx_channel_writev(channel[0], 0u, many, 2u, NULL, 0u),
+              ZX_ERR_INVALID_ARGS, "");
+    EXPECT_EQ(zx_channel_read(channel[1], 0u, buf, NULL, sizeof(buf), 0u, NULL, NULL),
+              ZX_ERR_SHOULD_WAIT, "");
+
+    EXPECT_EQ(zx_handle_close(channel[0]), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(channel[1]), ZX_OK, "");
+
+    END_TEST;
+}
+
+#define BENCH_HEADER_SIZE 16u
+#define BENCH_ROUNDS 20000u
+
+// Sends messages made of a small header and a separate payload, either
+// copied together first or gathered by the kernel, and reads them back.
+static bool run_assembly_benchmark(bool vectored, uint32_t payload_size) {
+    BEGIN_HELPER;
+
+    zx_handle_t channel[2];
+    ASSERT_EQ(zx_channel_create(0, &channel[0], &channel[1]), ZX_OK, "");
+    uint32_t msg_size = BENCH_HEADER_SIZE + payload_size;
+    char header[BENCH_HEADER_SIZE];
+    memset(header, 0xa5, sizeof(header));
+    char* payload = malloc(payload_size);
+    char* staging = malloc(msg_size);
+    char* buf = malloc(msg_size);
+    ASSERT_NONNULL(payload, "");
+    ASSERT_NONNULL(staging, "");
+    ASSERT_NONNULL(buf, "");
+    memset(payload, 0x5a, payload_size);
+    zx_iovec_t vec[2] = {
+        {header, sizeof(header)},
+        {payload, payload_size},
+    };
+
+    zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+    for (unsigned round = 0; round < BENCH_ROUNDS; round++) {
+        if (vectored) {
+            ASSERT_EQ(zx_channel_writev(channel[0], 0u, vec, countof(vec), NULL, 0u), ZX_OK, "");
+        } else {
+            memcpy(staging, header, sizeof(header));
+            memcpy(staging + sizeof(header), payload, payload_size);
+            ASSERT_EQ(zx_channel_write(channel[0], 0u, staging, msg_size, NULL, 0u), ZX_OK, "");
+        }
+        uint32_t num_bytes;
+        ASSERT_EQ(zx_channel_read(channel[1], 0u, buf, NULL, msg_size, 0u, &num_bytes, NULL),
+                  ZX_OK, "");
+        ASSERT_EQ(num_bytes, msg_size, "");
+    }
+    zx_time_t elapsed = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+
+    unittest_printf("\n    %s, %5u byte payload: %6" PRIu64 " ns per message",
+                    vectored ? "zx_channel_writev        " : "staging + zx_channel_write",
+                    payload_size, elapsed / BENCH_ROUNDS);
+
+    free(payload);
+    free(staging);
+    free(buf);
+    EXPECT_EQ(zx_handle_close(channel[0]), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(channel[1]), ZX_OK, "");
+
+    END_HELPER;
+}
+
+static bool channel_assembly_benchmark(void) {
+    BEGIN_TEST;
+
+    static const uint32_t sizes[] = {64u, 1024u, 16384u, 65536u - BENCH_HEADER_SIZE};
+    for (size_t i = 0; i < countof(sizes); ++i) {
+        EXPECT_TRUE(run_assembly_benchmark(false, sizes[i]), "");
+        EXPECT_TRUE(run_assembly_benchmark(true, sizes[i]), "");
+    }
+    unittest_printf("\n");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(channel_tests)
 RUN_TEST(channel_test)
 RUN_TEST(channel_read_error_test)
@@ -868,6 +994,8 @@ RUN_TEST(channel_call2)
 RUN_TEST(bad_channel_call_finish)
 RUN_TEST(channel_nest)
 RUN_TEST(channel_disallow_write_to_self)
+RUN_TEST(channel_writev)
+RUN_TEST_PERFORMANCE(channel_assembly_benchmark)
 END_TEST_CASE(channel_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -3,9 +3,11 @@
 // found in the LICENSE file.
 
 #include <assert.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <threads.h>
 #include <unistd.h>
 
@@ -118,8 +120,163 @@ static bool options_test(void) {
     END_TEST;
 }
 
+static bool vector_test(void) {
+    BEGIN_TEST;
+    zx_handle_t a, b;
+    uint64_t n[8] = { 1, 2, 3, 4, 5, 6, 7, 8};
+    ASSERT_EQ(zx_fifo_create(8, 8, 0, &a, &b), ZX_OK, "");
+
+    // gather entries 1-6 from three buffers, splitting entry 4 across two
+    // of them, with an empty buffer in between
+    zx_iovec_t vec[4] = {
+        {&n[0], 3 * sizeof(uint64_t) + 4},
+        {NULL, 0},
+        {(char*)&n[3] + 4, 4},
+        {&n[4], 2 * sizeof(uint64_t) + 3},
+    };
+    uint32_t actual;
+    ASSERT_EQ(zx_fifo_writev(a, vec, countof(vec), &actual), ZX_OK, "");
+    ASSERT_EQ(actual, 6u, "");
+    EXPECT_SIGNALS(b, ZX_FIFO_READABLE | ZX_FIFO_WRITABLE | ZX_SIGNAL_LAST_HANDLE);
+
+    // only the two free slots are filled
+    ASSERT_EQ(zx_fifo_writev(a, vec, countof(vec), &actual), ZX_OK, "");
+    ASSERT_EQ(actual, 2u, "");
+    EXPECT_SIGNALS(a, ZX_SIGNAL_LAST_HANDLE);
+
+    // scatter them back out, again splitting an entry
+    uint64_t x[3], y[5];
+    memset(x, 0, sizeof(x));
+    memset(y, 0, sizeof(y));
+    zx_iovec_t out[2] = {
+        {x, sizeof(x)},
+        {y, sizeof(y)},
+    };
+    ASSERT_EQ(zx_fifo_readv(b, out, countof(out), &actual), ZX_OK, "");
+    ASSERT_EQ(actual, 8u, "");
+    for (unsigned i = 0; i < 3; i++) {
+        EXPECT_EQ(x[i], i + 1u, "");
+    }
+    EXPECT_EQ(y[0], 4u, "");
+    EXPECT_EQ(y[1], 5u, "");
+    EXPECT_EQ(y[2], 6u, "");
+    EXPECT_EQ(y[3], 1u, "");
+    EXPECT_EQ(y[4], 2u, "");
+    EXPECT_SIGNALS(b, ZX_FIFO_WRITABLE | ZX_SIGNAL_LAST_HANDLE);
+
+    zx_handle_close(a);
+    zx_handle_close(b);
+
+    END_TEST;
+}
+
+static bool vector_invalid_test(void) {
+    BEGIN_TEST;
+    zx_handle_t a, b;
+    uint64_t n[2] = { 1, 2 };
+    ASSERT_EQ(zx_fifo_create(8, 8, 0, &a, &b), ZX_OK, "");
+
+    uint32_t actual;
+    zx_iovec_t vec[ZX_IOVEC_MAX + 1];
+    for (unsigned i = 0; i < countof(vec); i++) {
+        vec[i].buffer = n;
+        vec[i].length = sizeof(n);
+    }
+    EXPECT_EQ(zx_fifo_writev(a, vec, ZX_IOVEC_MAX + 1, &actual), ZX_ERR_OUT_OF_RANGE, "");
+
+    // less than one entry in total
+    vec[0].length = 4;
+    vec[1].length = 3;
+    EXPECT_EQ(zx_fifo_writev(a, vec, 2, &actual), ZX_ERR_OUT_OF_RANGE, "");
+
+    // a bad buffer writes nothing
+    vec[1].buffer = (void*)1;
+    vec[1].length = sizeof(n);
+    EXPECT_EQ(zx_fifo_writev(a, vec, 2, &actual), ZX_ERR_INVALID_ARGS, "");
+    EXPECT_EQ(zx_fifo_read(b, n, sizeof(n), &actual), ZX_ERR_SHOULD_WAIT, "");
+    EXPECT_EQ(zx_fifo_writev(a, NULL, 1, &actual), ZX_ERR_INVALID_ARGS, "");
+
+    zx_handle_close(a);
+    zx_handle_close(b);
+
+    END_TEST;
+}
+
+// Laid out like a block_fifo_request_t.
+typedef struct {
+    uint32_t opcode;
+    uint16_t txnid;
+    uint16_t vmoid;
+    uint64_t length;
+    uint64_t vmo_offset;
+    uint64_t dev_offset;
+} bench_request_t;
+
+#define BENCH_BATCH 8u
+#define BENCH_ROUNDS 100000u
+
+// Submits batches of requests that live apart from each other, the way a
+// block client's transactions do, and drains them from the other end.
+static bool run_submit_benchmark(bool vectored) {
+    BEGIN_HELPER;
+    zx_handle_t a, b;
+    ASSERT_EQ(zx_fifo_create(64, sizeof(bench_request_t), 0, &a, &b), ZX_OK, "");
+
+    bench_request_t* requests[BENCH_BATCH];
+    zx_iovec_t vec[BENCH_BATCH];
+    for (unsigned i = 0; i < BENCH_BATCH; i++) {
+        requests[i] = calloc(1, sizeof(bench_request_t));
+        ASSERT_NONNULL(requests[i], "");
+        requests[i]->txnid = (uint16_t)i;
+        vec[i].buffer = requests[i];
+        vec[i].length = sizeof(bench_request_t);
+    }
+    bench_request_t staging[BENCH_BATCH];
+    bench_request_t responses[BENCH_BATCH];
+
+    zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+    for (unsigned round = 0; round < BENCH_ROUNDS; round++) {
+        uint32_t actual;
+        if (vectored) {
+            ASSERT_EQ(zx_fifo_writev(a, vec, BENCH_BATCH, &actual), ZX_OK, "");
+        } else {
+            for (unsigned i = 0; i < BENCH_BATCH; i++) {
+                memcpy(&staging[i], requests[i], sizeof(bench_request_t));
+            }
+            ASSERT_EQ(zx_fifo_write(a, staging, sizeof(staging), &actual), ZX_OK, "");
+        }
+        ASSERT_EQ(actual, BENCH_BATCH, "");
+        ASSERT_EQ(zx_fifo_read(b, responses, sizeof(responses), &actual), ZX_OK, "");
+        ASSERT_EQ(actual, BENCH_BATCH, "");
+    }
+    zx_time_t elapsed = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+
+    unittest_printf("\n    %s: %" PRIu64 " ns per %u request batch",
+                    vectored ? "zx_fifo_writev        " : "staging + zx_fifo_write",
+                    elapsed / BENCH_ROUNDS, BENCH_BATCH);
+
+    for (unsigned i = 0; i < BENCH_BATCH; i++) {
+        free(requests[i]);
+    }
+    zx_handle_close(a);
+    zx_handle_close(b);
+
+    END_HELPER;
+}
+
+static bool submit_benchmark(void) {
+    BEGIN_TEST;
+    EXPECT_TRUE(run_submit_benchmark(false), "");
+    EXPECT_TRUE(run_submit_benchmark(true), "");
+    unittest_printf("\n");
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(fifo_tests)
 RUN_TEST(basic_test)
+RUN_TEST(vector_test)
+RUN_TEST(vector_invalid_test)
+RUN_TEST_PERFORMANCE(submit_benchmark)
 END_TEST_CASE(fifo_tests)
 
 #ifndef BUILD_COMBINED_TESTS
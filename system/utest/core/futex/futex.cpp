@@ -526,6 +526,61 @@ static bool test_event_signaling() {
     END_TEST;
 }
 
+// Each thread of the contention benchmark hammers its own futex with
+// operations that take the kernel's futex lock but never block.
+struct ContentionThread {
+    alignas(64) int futex_value;
+    uint32_t iterations;
+    bool ok;
+};
+
+static int contention_thread(void* arg) {
+    auto info = static_cast<ContentionThread*>(arg);
+    info->ok = true;
+    for (uint32_t i = 0; i < info->iterations; ++i) {
+        if (zx_futex_wake(&info->futex_value, 1) != ZX_OK ||
+            zx_futex_wait(&info->futex_value, info->futex_value + 1, 0) != ZX_ERR_BAD_STATE) {
+            info->ok = false;
+            break;
+        }
+    }
+    return 0;
+}
+
+// Many threads operating on distinct futexes should not contend with
+// each other in the kernel.
+static bool test_futex_contention_benchmark() {
+    BEGIN_TEST;
+
+    constexpr uint32_t kIterations = 20000;
+    constexpr uint32_t kMaxThreads = 16;
+    static ContentionThread infos[kMaxThreads];
+
+    for (uint32_t nthreads = 1; nthreads <= kMaxThreads; nthreads *= 2) {
+        thrd_t threads[kMaxThreads];
+        zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+        for (uint32_t i = 0; i < nthreads; ++i) {
+            infos[i].futex_value = 0;
+            infos[i].iterations = kIterations;
+            ASSERT_EQ(thrd_create_with_name(&threads[i], contention_thread, &infos[i],
+                                            "futex_contention"),
+                      thrd_success, "");
+        }
+        for (uint32_t i = 0; i < nthreads; ++i) {
+            ASSERT_EQ(thrd_join(threads[i], NULL), thrd_success, "");
+            EXPECT_TRUE(infos[i].ok, "unexpected futex status");
+        }
+        zx_time_t elapsed = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+        uint64_t ops = 2ull * kIterations * nthreads;
+        unittest_printf("\n    %2u threads: %" PRIu64 " ops in %" PRIu64 " us"
+                        " (%" PRIu64 " ns/op)",
+                        nthreads, ops, elapsed / 1000, elapsed / ops);
+    }
+    unittest_printf("\n");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(futex_tests)
 RUN_TEST(test_futex_wait_value_mismatch);
 RUN_TEST(test_futex_wait_timeout);
@@ -545,6 +600,7 @@ RUN_TEST(test_futex_thread_killed);
 RUN_TEST(test_futex_thread_suspended);
 RUN_TEST(test_futex_misaligned);
 RUN_TEST(test_event_signaling);
+RUN_TEST_PERFORMANCE(test_futex_contention_benchmark);
 END_TEST_CASE(futex_tests)
 
 #ifndef BUILD_COMBINED_TESTS
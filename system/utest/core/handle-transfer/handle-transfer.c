@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <threads.h>
 #include <time.h>
@@ -140,9 +141,91 @@ bool handle_transfer_cancel_wait_test(void) {
     END_TEST;
 }
 
+#define BENCH_ITERATIONS 20000
+#define BENCH_MAX_THREADS 8
+
+static int create_close_thread(void* arg) {
+    for (int i = 0; i < BENCH_ITERATIONS; ++i) {
+        zx_handle_t event;
+        if (zx_event_create(0u, &event) != ZX_OK)
+            return -1;
+        zx_handle_close(event);
+    }
+    return 0;
+}
+
+// Each iteration duplicates a handle, sends the duplicate through a
+// channel, reads it back and closes it.
+static int transfer_thread(void* arg) {
+    zx_handle_t event;
+    zx_handle_t channel[2];
+    if (zx_event_create(0u, &event) != ZX_OK)
+        return -1;
+    if (zx_channel_create(0u, &channel[0], &channel[1]) != ZX_OK)
+        return -1;
+    int result = 0;
+    for (int i = 0; i < BENCH_ITERATIONS; ++i) {
+        zx_handle_t dup;
+        uint32_t num_handles = 1u;
+        if (zx_handle_duplicate(event, ZX_RIGHT_SAME_RIGHTS, &dup) != ZX_OK ||
+            zx_channel_write(channel[0], 0u, NULL, 0u, &dup, 1u) != ZX_OK ||
+            zx_channel_read(channel[1], 0u, NULL, &dup, 0u, num_handles,
+                            NULL, &num_handles) != ZX_OK) {
+            result = -1;
+            break;
+        }
+        zx_handle_close(dup);
+    }
+    zx_handle_close(channel[0]);
+    zx_handle_close(channel[1]);
+    zx_handle_close(event);
+    return result;
+}
+
+// Runs |fn| on 1, 2, 4 ... BENCH_MAX_THREADS threads at once, reporting
+// the time per iteration. Use "k zx htinfo" to see the kernel's per-CPU
+// handle cache hit rates afterwards.
+static bool run_handle_benchmark(const char* name, thrd_start_t fn) {
+    BEGIN_HELPER;
+    unittest_printf("\n  %s:", name);
+    for (int nthreads = 1; nthreads <= BENCH_MAX_THREADS; nthreads *= 2) {
+        thrd_t threads[BENCH_MAX_THREADS];
+        zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+        for (int i = 0; i < nthreads; ++i) {
+            ASSERT_EQ(thrd_create_with_name(&threads[i], fn, NULL, name),
+                      thrd_success, "failed to create thread");
+        }
+        for (int i = 0; i < nthreads; ++i) {
+            int ret;
+            ASSERT_EQ(thrd_join(threads[i], &ret), thrd_success, "");
+            EXPECT_EQ(ret, 0, "benchmark thread failed");
+        }
+        zx_time_t elapsed = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+        uint64_t ops = (uint64_t)BENCH_ITERATIONS * nthreads;
+        unittest_printf("\n    %d threads: %" PRIu64 " ns/iteration",
+                        nthreads, elapsed / ops);
+    }
+    unittest_printf("\n");
+    END_HELPER;
+}
+
+bool handle_create_close_benchmark(void) {
+    BEGIN_TEST;
+    EXPECT_TRUE(run_handle_benchmark("event create/close", create_close_thread), "");
+    END_TEST;
+}
+
+bool handle_transfer_benchmark(void) {
+    BEGIN_TEST;
+    EXPECT_TRUE(run_handle_benchmark("duplicate/transfer/close", transfer_thread), "");
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(handle_transfer_tests)
 RUN_TEST(handle_transfer_test)
 RUN_TEST(handle_transfer_cancel_wait_test)
+RUN_TEST_PERFORMANCE(handle_create_close_benchmark)
+RUN_TEST_PERFORMANCE(handle_transfer_benchmark)
 END_TEST_CASE(handle_transfer_tests)
 
 #ifndef BUILD_COMBINED_TESTS
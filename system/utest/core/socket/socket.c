@@ -3,11 +3,16 @@
 // found in the LICENSE file.
 
 #include <assert.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <zircon/process.h>
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
 #include <unittest/unittest.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <threads.h>
 #include <unistd.h>
 
 static zx_signals_t get_satisfied_signals(zx_handle_t handle) {
@@ -460,8 +465,11 @@ static bool socket_short_write(void) {
     status = zx_socket_create(0, &h0, &h1);
     ASSERT_EQ(status, ZX_OK, "");
 
-    // TODO(qsr): Request socket buffer and use (socket_buffer + 1).
-    const size_t buffer_size = 256 * 1024 + 1;
+    size_t socket_buffer;
+    status = zx_object_get_property(h1, ZX_PROP_SOCKET_BUFFER_SIZE,
+                                    &socket_buffer, sizeof(socket_buffer));
+    ASSERT_EQ(status, ZX_OK, "");
+    const size_t buffer_size = socket_buffer + 1;
     char* buffer = malloc(buffer_size);
     size_t written = ~(size_t)0; // This should get overwritten by the syscall.
     status = zx_socket_write(h0, 0u, buffer, buffer_size, &written);
@@ -552,8 +560,11 @@ static bool socket_datagram_no_short_write(void) {
     status = zx_socket_create(ZX_SOCKET_DATAGRAM, &h0, &h1);
     ASSERT_EQ(status, ZX_OK, "");
 
-    // TODO(qsr): Request socket buffer and use (socket_buffer + 1).
-    const size_t buffer_size = 256 * 1024 + 1;
+    size_t socket_buffer;
+    status = zx_object_get_property(h1, ZX_PROP_SOCKET_BUFFER_SIZE,
+                                    &socket_buffer, sizeof(socket_buffer));
+    ASSERT_EQ(status, ZX_OK, "");
+    const size_t buffer_size = socket_buffer + 1;
     char* buffer = malloc(buffer_size);
     size_t written = 999;
     status = zx_socket_write(h0, 0u, buffer, buffer_size, &written);
@@ -719,6 +730,543 @@ static bool socket_control_plane_shutdown(void) {
     END_TEST;
 }
 
+static bool socket_bulk(void) {
+    BEGIN_TEST;
+
+    zx_status_t status;
+    size_t count;
+    zx_handle_t h0, h1;
+
+    status = zx_socket_create(ZX_SOCKET_BULK, &h0, &h1);
+    ASSERT_EQ(status, ZX_OK, "");
+
+    size_t size;
+    status = zx_object_get_property(h1, ZX_PROP_SOCKET_BUFFER_SIZE, &size, sizeof(size));
+    EXPECT_EQ(status, ZX_OK, "");
+    EXPECT_EQ(size, 256u * 1024u, "");
+
+    // The size is rounded up to whole pages.
+    size = PAGE_SIZE + 1;
+    status = zx_object_set_property(h1, ZX_PROP_SOCKET_BUFFER_SIZE, &size, sizeof(size));
+    EXPECT_EQ(status, ZX_OK, "");
+    status = zx_object_get_property(h1, ZX_PROP_SOCKET_BUFFER_SIZE, &size, sizeof(size));
+    EXPECT_EQ(status, ZX_OK, "");
+    EXPECT_EQ(size, 2u * PAGE_SIZE, "");
+
+    // Writes past the capacity are short.
+    static unsigned char wbuf[3 * PAGE_SIZE];
+    static unsigned char rbuf[3 * PAGE_SIZE];
+    for (size_t i = 0; i < sizeof(wbuf); ++i)
+        wbuf[i] = (unsigned char)(i * 7);
+    status = zx_socket_write(h0, 0u, wbuf, sizeof(wbuf), &count);
+    EXPECT_EQ(status, ZX_OK, "");
+    EXPECT_EQ(count, 2u * PAGE_SIZE, "");
+    EXPECT_EQ(get_satisfied_signals(h0), ZX_SIGNAL_LAST_HANDLE, "");
+    status = zx_socket_write(h0, 0u, wbuf, 1u, &count);
+    EXPECT_EQ(status, ZX_ERR_SHOULD_WAIT, "");
+
+    // Data that wraps around the end of the ring comes back in order.
+    status = zx_socket_read(h1, 0u, rbuf, 5000u, &count);
+    EXPECT_EQ(status, ZX_OK, "");
+    EXPECT_EQ(count, 5000u, "");
+    EXPECT_EQ(memcmp(rbuf, wbuf, 5000u), 0, "");
+    EXPECT_EQ(get_satisfied_signals(h0), ZX_SOCKET_WRITABLE | ZX_SIGNAL_LAST_HANDLE, "");
+
+    status = zx_socket_write(h0, 0u, wbuf + 2 * PAGE_SIZE, 4000u, &count);
+    EXPECT_EQ(status, ZX_OK, "");
+    EXPECT_EQ(count, 4000u, "");
+
+    status = zx_socket_read(h1, 0u, NULL, 0, &count);
+    EXPECT_EQ(status, ZX_OK, "");
+    EXPECT_EQ(count, 2u * PAGE_SIZE - 5000u + 4000u, "");
+
+    status = zx_socket_read(h1, 0u, rbuf, sizeof(rbuf), &count);
+    EXPECT_EQ(status, ZX_OK, "");
+    EXPECT_EQ(count, 2u * PAGE_SIZE - 5000u + 4000u, "");
+    EXPECT_EQ(memcmp(rbuf, wbuf + 5000u, count), 0, "");
+    EXPECT_EQ(get_satisfied_signals(h1), ZX_SOCKET_WRITABLE | ZX_SIGNAL_LAST_HANDLE, "");
+
+    zx_handle_close(h0);
+    zx_handle_close(h1);
+
+    END_TEST;
+}
+
+static bool socket_bulk_invalid(void) {
+    BEGIN_TEST;
+
+    zx_status_t status;
+    size_t count;
+    zx_handle_t h0, h1;
+
+    status = zx_socket_create(ZX_SOCKET_BULK | ZX_SOCKET_DATAGRAM, &h0, &h1);
+    EXPECT_EQ(status, ZX_ERR_INVALID_ARGS, "");
+
+    // Only bulk sockets can be resized, so others don't get the right to.
+    status = zx_socket_create(0, &h0, &h1);
+    ASSERT_EQ(status, ZX_OK, "");
+    size_t size = 1024u * 1024u;
+    status = zx_object_set_property(h1, ZX_PROP_SOCKET_BUFFER_SIZE, &size, sizeof(size));
+    EXPECT_EQ(status, ZX_ERR_ACCESS_DENIED, "");
+    zx_handle_close(h0);
+    zx_handle_close(h1);
+
+    status = zx_socket_create(ZX_SOCKET_BULK, &h0, &h1);
+    ASSERT_EQ(status, ZX_OK, "");
+    size = 0u;
+    status = zx_object_set_property(h1, ZX_PROP_SOCKET_BUFFER_SIZE, &size, sizeof(size));
+    EXPECT_EQ(status, ZX_ERR_OUT_OF_RANGE, "");
+    size = 1024u * 1024u * 1024u;
+    status = zx_object_set_property(h1, ZX_PROP_SOCKET_BUFFER_SIZE, &size, sizeof(size));
+    EXPECT_EQ(status, ZX_ERR_OUT_OF_RANGE, "");
+
+    // Nor while holding data.
+    status = zx_socket_write(h0, 0u, "x", 1u, &count);
+    EXPECT_EQ(status, ZX_OK, "");
+    size = 1024u * 1024u;
+    status = zx_object_set_property(h1, ZX_PROP_SOCKET_BUFFER_SIZE, &size, sizeof(size));
+    EXPECT_EQ(status, ZX_ERR_BAD_STATE, "");
+    status = zx_object_set_property(h0, ZX_PROP_SOCKET_BUFFER_SIZE, &size, sizeof(size));
+    EXPECT_EQ(status, ZX_OK, "");
+
+    zx_handle_close(h0);
+    zx_handle_close(h1);
+
+    END_TEST;
+}
+
+// Maps the ring |socket| reads from, or with ZX_SOCKET_RING_WRITE writes to.
+static bool map_ring(zx_handle_t socket, uint32_t options, zx_handle_t* vmo,
+                     zx_socket_ring_header_t** header, unsigned char** data) {
+    BEGIN_HELPER;
+
+    ASSERT_EQ(zx_socket_get_ring(socket, options, vmo), ZX_OK, "");
+    uint64_t size;
+    ASSERT_EQ(zx_vmo_get_size(*vmo, &size), ZX_OK, "");
+    uint32_t flags = ZX_VM_FLAG_PERM_READ;
+    if (options == ZX_SOCKET_RING_WRITE)
+        flags |= ZX_VM_FLAG_PERM_WRITE;
+    uintptr_t addr;
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), 0, *vmo, 0, size, flags, &addr), ZX_OK, "");
+    *header = (zx_socket_ring_header_t*)addr;
+    *data = (unsigned char*)addr + ZX_SOCKET_RING_DATA_OFFSET;
+    ASSERT_EQ(size, ZX_SOCKET_RING_DATA_OFFSET + (*header)->capacity, "");
+
+    END_HELPER;
+}
+
+static void unmap_ring(zx_handle_t vmo, zx_socket_ring_header_t* header) {
+    zx_vmar_unmap(zx_vmar_root_self(), (uintptr_t)header,
+                  ZX_SOCKET_RING_DATA_OFFSET + header->capacity);
+    zx_handle_close(vmo);
+}
+
+static uint64_t ring_load(const uint64_t* count) {
+    return __atomic_load_n(count, __ATOMIC_ACQUIRE);
+}
+
+static bool socket_bulk_in_place(void) {
+    BEGIN_TEST;
+
+    zx_status_t status;
+    size_t count;
+    zx_handle_t h0, h1;
+
+    status = zx_socket_create(ZX_SOCKET_BULK, &h0, &h1);
+    ASSERT_EQ(status, ZX_OK, "");
+    size_t size = 2u * PAGE_SIZE;
+    status = zx_object_set_property(h1, ZX_PROP_SOCKET_BUFFER_SIZE, &size, sizeof(size));
+    ASSERT_EQ(status, ZX_OK, "");
+
+    static unsigned char wbuf[3 * PAGE_SIZE];
+    static unsigned char rbuf[3 * PAGE_SIZE];
+    for (size_t i = 0; i < sizeof(wbuf); ++i)
+        wbuf[i] = (unsigned char)(i * 7);
+
+    // Data written before sharing shows up in the ring.
+    status = zx_socket_write(h0, 0u, wbuf, 100u, &count);
+    EXPECT_EQ(status, ZX_OK, "");
+
+    // h0 writes to the ring h1 reads from.
+    zx_handle_t wvmo, rvmo;
+    zx_socket_ring_header_t *wheader, *rheader;
+    unsigned char *wdata, *rdata;
+    ASSERT_TRUE(map_ring(h0, ZX_SOCKET_RING_WRITE, &wvmo, &wheader, &wdata), "");
+    ASSERT_TRUE(map_ring(h1, ZX_SOCKET_RING_READ, &rvmo, &rheader, &rdata), "");
+    EXPECT_EQ(rheader->capacity, 2u * PAGE_SIZE, "");
+    EXPECT_EQ(ring_load(&rheader->read_count), 0u, "");
+    EXPECT_EQ(ring_load(&rheader->write_count), 100u, "");
+    EXPECT_EQ(memcmp(rdata, wbuf, 100u), 0, "");
+
+    // Store 5000 bytes in place, then consume them in place.
+    memcpy(wdata + 100u, wbuf + 100u, 4900u);
+    status = zx_socket_write(h0, ZX_SOCKET_IN_PLACE, NULL, 4900u, &count);
+    EXPECT_EQ(status, ZX_OK, "");
+    EXPECT_EQ(count, 4900u, "");
+    EXPECT_EQ(get_satisfied_signals(h1), ZX_SOCKET_READABLE | ZX_SOCKET_WRITABLE |
+              ZX_SIGNAL_LAST_HANDLE, "");
+    EXPECT_EQ(ring_load(&rheader->write_count), 5000u, "");
+    EXPECT_EQ(memcmp(rdata, wbuf, 5000u), 0, "");
+    status = zx_socket_read(h1, ZX_SOCKET_IN_PLACE, NULL, 5000u, &count);
+    EXPECT_EQ(status, ZX_OK, "");
+    EXPECT_EQ(count, 5000u, "");
+    EXPECT_EQ(ring_load(&rheader->read_count), 5000u, "");
+    EXPECT_EQ(get_satisfied_signals(h1), ZX_SOCKET_WRITABLE | ZX_SIGNAL_LAST_HANDLE, "");
+
+    // An in place write that wraps around the end of the ring, read back by
+    // copying. The ring no longer starts over at the beginning once drained.
+    size_t tail = ring_load(&wheader->write_count) % wheader->capacity;
+    EXPECT_EQ(tail, 5000u, "");
+    size_t first = wheader->capacity - tail;
+    memcpy(wdata + tail, wbuf, first);
+    memcpy(wdata, wbuf + first, 4000u - first);
+    status = zx_socket_write(h0, ZX_SOCKET_IN_PLACE, NULL, 4000u, &count);
+    EXPECT_EQ(status, ZX_OK, "");
+    EXPECT_EQ(count, 4000u, "");
+    status = zx_socket_read(h1, 0u, rbuf, sizeof(rbuf), &count);
+    EXPECT_EQ(status, ZX_OK, "");
+    EXPECT_EQ(count, 4000u, "");
+    EXPECT_EQ(memcmp(rbuf, wbuf, 4000u), 0, "");
+
+    // In place writes past the capacity are short too.
+    status = zx_socket_write(h0, ZX_SOCKET_IN_PLACE, NULL, 3u * PAGE_SIZE, &count);
+    EXPECT_EQ(status, ZX_OK, "");
+    EXPECT_EQ(count, 2u * PAGE_SIZE, "");
+    EXPECT_EQ(get_satisfied_signals(h0), ZX_SIGNAL_LAST_HANDLE, "");
+    status = zx_socket_write(h0, ZX_SOCKET_IN_PLACE, NULL, 1u, &count);
+    EXPECT_EQ(status, ZX_ERR_SHOULD_WAIT, "");
+    status = zx_socket_read(h1, ZX_SOCKET_IN_PLACE, NULL, 3u * PAGE_SIZE, &count);
+    EXPECT_EQ(status, ZX_OK, "");
+    EXPECT_EQ(count, 2u * PAGE_SIZE, "");
+    EXPECT_EQ(ring_load(&rheader->read_count), ring_load(&rheader->write_count), "");
+
+    // The ring stays usable after the socket is closed.
+    zx_handle_close(h0);
+    zx_handle_close(h1);
+    EXPECT_EQ(memcmp(rdata, wdata, 2u * PAGE_SIZE), 0, "");
+    unmap_ring(wvmo, wheader);
+    unmap_ring(rvmo, rheader);
+
+    END_TEST;
+}
+
+static bool socket_bulk_in_place_invalid(void) {
+    BEGIN_TEST;
+
+    zx_status_t status;
+    size_t count;
+    zx_handle_t h0, h1, vmo;
+
+    status = zx_socket_create(0, &h0, &h1);
+    ASSERT_EQ(status, ZX_OK, "");
+    status = zx_socket_get_ring(h0, ZX_SOCKET_RING_READ, &vmo);
+    EXPECT_EQ(status, ZX_ERR_NOT_SUPPORTED, "");
+    status = zx_socket_write(h0, ZX_SOCKET_IN_PLACE, NULL, 1u, &count);
+    EXPECT_EQ(status, ZX_ERR_NOT_SUPPORTED, "");
+    status = zx_socket_read(h1, ZX_SOCKET_IN_PLACE, NULL, 1u, &count);
+    EXPECT_EQ(status, ZX_ERR_NOT_SUPPORTED, "");
+    zx_handle_close(h0);
+    zx_handle_close(h1);
+
+    status = zx_socket_create(ZX_SOCKET_BULK, &h0, &h1);
+    ASSERT_EQ(status, ZX_OK, "");
+    status = zx_socket_get_ring(h0, 2u, &vmo);
+    EXPECT_EQ(status, ZX_ERR_INVALID_ARGS, "");
+    status = zx_socket_write(h0, ZX_SOCKET_IN_PLACE, "x", 1u, &count);
+    EXPECT_EQ(status, ZX_ERR_INVALID_ARGS, "");
+
+    // Nothing is shared yet.
+    status = zx_socket_write(h0, ZX_SOCKET_IN_PLACE, NULL, 1u, &count);
+    EXPECT_EQ(status, ZX_ERR_BAD_STATE, "");
+    status = zx_socket_read(h1, ZX_SOCKET_IN_PLACE, NULL, 1u, &count);
+    EXPECT_EQ(status, ZX_ERR_BAD_STATE, "");
+
+    // Once shared, the ring can't be resized, decommitted or written by
+    // the reader.
+    zx_socket_ring_header_t* header;
+    unsigned char* data;
+    ASSERT_TRUE(map_ring(h0, ZX_SOCKET_RING_WRITE, &vmo, &header, &data), "");
+    size_t size = 1024u * 1024u;
+    status = zx_object_set_property(h1, ZX_PROP_SOCKET_BUFFER_SIZE, &size, sizeof(size));
+    EXPECT_EQ(status, ZX_ERR_BAD_STATE, "");
+    EXPECT_NE(zx_vmo_set_size(vmo, PAGE_SIZE), ZX_OK, "");
+    EXPECT_NE(zx_vmo_op_range(vmo, ZX_VMO_OP_DECOMMIT, ZX_SOCKET_RING_DATA_OFFSET, PAGE_SIZE,
+                              NULL, 0u), ZX_OK, "");
+    unmap_ring(vmo, header);
+
+    zx_handle_t rvmo;
+    ASSERT_EQ(zx_socket_get_ring(h1, ZX_SOCKET_RING_READ, &rvmo), ZX_OK, "");
+    uintptr_t addr;
+    status = zx_vmar_map(zx_vmar_root_self(), 0, rvmo, 0, PAGE_SIZE,
+                         ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, &addr);
+    EXPECT_EQ(status, ZX_ERR_ACCESS_DENIED, "");
+    zx_handle_close(rvmo);
+
+    zx_handle_close(h1);
+    status = zx_socket_get_ring(h0, ZX_SOCKET_RING_WRITE, &vmo);
+    EXPECT_EQ(status, ZX_ERR_PEER_CLOSED, "");
+    zx_handle_close(h0);
+
+    END_TEST;
+}
+
+#define STARVE_SOCKETS 8u
+#define STARVE_CHUNK (1024u * 1024u)
+
+// Enlarged bulk sockets that are never drained exhaust the memory shared
+// by all rings, but a socket of the default size can still fill its ring.
+static bool socket_bulk_starvation(void) {
+    BEGIN_TEST;
+
+    unsigned char* buf = malloc(STARVE_CHUNK);
+    ASSERT_NONNULL(buf, "");
+    memset(buf, 0x5a, STARVE_CHUNK);
+
+    zx_handle_t hogs[STARVE_SOCKETS][2];
+    bool exhausted = false;
+    for (size_t i = 0; i < STARVE_SOCKETS; ++i) {
+        ASSERT_EQ(zx_socket_create(ZX_SOCKET_BULK, &hogs[i][0], &hogs[i][1]), ZX_OK, "");
+        size_t size = 16u * 1024u * 1024u;
+        ASSERT_EQ(zx_object_set_property(hogs[i][1], ZX_PROP_SOCKET_BUFFER_SIZE,
+                                         &size, sizeof(size)),
+                  ZX_OK, "");
+        for (;;) {
+            size_t count;
+            zx_status_t status = zx_socket_write(hogs[i][0], 0u, buf, STARVE_CHUNK, &count);
+            if (status == ZX_ERR_SHOULD_WAIT)
+                break;
+            if (status == ZX_ERR_NO_MEMORY || count < STARVE_CHUNK) {
+                exhausted = true;
+                break;
+            }
+            ASSERT_EQ(status, ZX_OK, "");
+        }
+    }
+    EXPECT_TRUE(exhausted, "the hogs should have run out of memory");
+
+    zx_handle_t h0, h1;
+    ASSERT_EQ(zx_socket_create(ZX_SOCKET_BULK, &h0, &h1), ZX_OK, "");
+    size_t capacity;
+    ASSERT_EQ(zx_object_get_property(h1, ZX_PROP_SOCKET_BUFFER_SIZE, &capacity, sizeof(capacity)),
+              ZX_OK, "");
+    ASSERT_LE(capacity, (size_t)STARVE_CHUNK, "");
+    size_t count;
+    EXPECT_EQ(zx_socket_write(h0, 0u, buf, capacity, &count), ZX_OK, "");
+    EXPECT_EQ(count, capacity, "");
+    zx_handle_close(h0);
+    zx_handle_close(h1);
+
+    for (size_t i = 0; i < STARVE_SOCKETS; ++i) {
+        zx_handle_close(hogs[i][0]);
+        zx_handle_close(hogs[i][1]);
+    }
+    free(buf);
+
+    END_TEST;
+}
+
+#define BENCH_BYTES (64u * 1024u * 1024u)
+
+typedef struct bench_reader {
+    zx_handle_t socket;
+    size_t chunk;
+    bool in_place;
+} bench_reader_t;
+
+// Stands in for producing |len| bytes of data.
+static void bench_produce(unsigned char* data, size_t len) {
+    memset(data, 0x5a, len);
+}
+
+// Keeps bench_consume() from being optimized away.
+static volatile unsigned bench_sink;
+
+// Stands in for looking at |len| bytes of data.
+static unsigned bench_consume(const unsigned char* data, size_t len) {
+    unsigned sum = 0u;
+    for (size_t i = 0; i < len; i += 64u)
+        sum += data[i];
+    return sum;
+}
+
+// Maps the ring |socket| reads from, or with ZX_SOCKET_RING_WRITE writes to,
+// without the unittest macros, which the reader thread can't use.
+static zx_status_t bench_map_ring(zx_handle_t socket, uint32_t options,
+                                  zx_socket_ring_header_t** header, unsigned char** data) {
+    zx_handle_t vmo;
+    zx_status_t status = zx_socket_get_ring(socket, options, &vmo);
+    if (status != ZX_OK)
+        return status;
+    uint64_t size;
+    uintptr_t addr;
+    status = zx_vmo_get_size(vmo, &size);
+    if (status == ZX_OK) {
+        uint32_t flags = ZX_VM_FLAG_PERM_READ;
+        if (options == ZX_SOCKET_RING_WRITE)
+            flags |= ZX_VM_FLAG_PERM_WRITE;
+        status = zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, size, flags, &addr);
+    }
+    // The mapping keeps the ring alive.
+    zx_handle_close(vmo);
+    if (status != ZX_OK)
+        return status;
+    *header = (zx_socket_ring_header_t*)addr;
+    *data = (unsigned char*)addr + ZX_SOCKET_RING_DATA_OFFSET;
+    return ZX_OK;
+}
+
+// Reads BENCH_BYTES from the socket, |chunk| bytes at a time.
+static int bench_reader_thread(void* arg) {
+    bench_reader_t* reader = arg;
+    unsigned char* buf = malloc(reader->chunk);
+    if (buf == NULL)
+        return -1;
+    zx_socket_ring_header_t* header = NULL;
+    unsigned char* data = NULL;
+    if (reader->in_place &&
+        bench_map_ring(reader->socket, ZX_SOCKET_RING_READ, &header, &data) != ZX_OK) {
+        free(buf);
+        return -1;
+    }
+    size_t total = 0u;
+    unsigned sum = 0u;
+    int result = 0;
+    while (total < BENCH_BYTES) {
+        size_t count = reader->chunk;
+        zx_status_t status;
+        if (reader->in_place) {
+            uint64_t read = ring_load(&header->read_count);
+            size_t offset = read % header->capacity;
+            size_t avail = ring_load(&header->write_count) - read;
+            if (count > avail)
+                count = avail;
+            if (count > header->capacity - offset)
+                count = header->capacity - offset;
+            sum += bench_consume(data + offset, count);
+            status = count ? zx_socket_read(reader->socket, ZX_SOCKET_IN_PLACE, NULL, count,
+                                            &count)
+                           : ZX_ERR_SHOULD_WAIT;
+        } else {
+            status = zx_socket_read(reader->socket, 0u, buf, count, &count);
+            if (status == ZX_OK)
+                sum += bench_consume(buf, count);
+        }
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            zx_object_wait_one(reader->socket, ZX_SOCKET_READABLE | ZX_SOCKET_PEER_CLOSED,
+                               ZX_TIME_INFINITE, NULL);
+            continue;
+        }
+        if (status != ZX_OK) {
+            result = -1;
+            break;
+        }
+        total += count;
+    }
+    if (header != NULL) {
+        zx_vmar_unmap(zx_vmar_root_self(), (uintptr_t)header,
+                      ZX_SOCKET_RING_DATA_OFFSET + header->capacity);
+    }
+    free(buf);
+    bench_sink = sum;
+    return result;
+}
+
+// Streams BENCH_BYTES through a socket created with |options| to a reader
+// thread, |chunk| bytes per read and write, and reports the throughput.
+// With |in_place| both ends work directly in the mapped ring instead.
+static bool run_socket_benchmark(uint32_t options, size_t buffer_size, size_t chunk,
+                                 bool in_place) {
+    BEGIN_HELPER;
+
+    zx_handle_t h0, h1;
+    ASSERT_EQ(zx_socket_create(options, &h0, &h1), ZX_OK, "");
+    if (buffer_size != 0u) {
+        ASSERT_EQ(zx_object_set_property(h1, ZX_PROP_SOCKET_BUFFER_SIZE,
+                                         &buffer_size, sizeof(buffer_size)),
+                  ZX_OK, "");
+    }
+    unsigned char* buf = malloc(chunk);
+    ASSERT_NONNULL(buf, "");
+    zx_socket_ring_header_t* header = NULL;
+    unsigned char* data = NULL;
+    if (in_place)
+        ASSERT_EQ(bench_map_ring(h0, ZX_SOCKET_RING_WRITE, &header, &data), ZX_OK, "");
+
+    bench_reader_t reader = {h1, chunk, in_place};
+    thrd_t thread;
+    zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+    ASSERT_EQ(thrd_create_with_name(&thread, bench_reader_thread, &reader, "socket reader"),
+              thrd_success, "");
+
+    size_t total = 0u;
+    while (total < BENCH_BYTES) {
+        size_t count = chunk;
+        zx_status_t status;
+        if (in_place) {
+            uint64_t written = ring_load(&header->write_count);
+            size_t offset = written % header->capacity;
+            size_t space = header->capacity - (written - ring_load(&header->read_count));
+            if (count > space)
+                count = space;
+            if (count > header->capacity - offset)
+                count = header->capacity - offset;
+            bench_produce(data + offset, count);
+            status = count ? zx_socket_write(h0, ZX_SOCKET_IN_PLACE, NULL, count, &count)
+                           : ZX_ERR_SHOULD_WAIT;
+        } else {
+            bench_produce(buf, count);
+            status = zx_socket_write(h0, 0u, buf, count, &count);
+        }
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            zx_object_wait_one(h0, ZX_SOCKET_WRITABLE | ZX_SOCKET_PEER_CLOSED,
+                               ZX_TIME_INFINITE, NULL);
+            continue;
+        }
+        ASSERT_EQ(status, ZX_OK, "");
+        total += count;
+    }
+
+    int ret;
+    ASSERT_EQ(thrd_join(thread, &ret), thrd_success, "");
+    EXPECT_EQ(ret, 0, "reader failed");
+    zx_time_t elapsed = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+
+    size_t capacity;
+    ASSERT_EQ(zx_object_get_property(h1, ZX_PROP_SOCKET_BUFFER_SIZE, &capacity, sizeof(capacity)),
+              ZX_OK, "");
+    // MB/s is bytes per microsecond.
+    unittest_printf("\n    %s, %7zu byte buffer, %6zu byte chunks: %5" PRIu64 " MB/s",
+                    in_place ? "in place" : (options & ZX_SOCKET_BULK) ? "bulk    " : "stream  ",
+                    capacity, chunk, (uint64_t)BENCH_BYTES * 1000u / elapsed);
+
+    if (header != NULL) {
+        zx_vmar_unmap(zx_vmar_root_self(), (uintptr_t)header,
+                      ZX_SOCKET_RING_DATA_OFFSET + header->capacity);
+    }
+    free(buf);
+    zx_handle_close(h0);
+    zx_handle_close(h1);
+
+    END_HELPER;
+}
+
+static bool socket_throughput_benchmark(void) {
+    BEGIN_TEST;
+
+    static const size_t chunks[] = {4096u, 65536u, 262144u};
+    for (size_t i = 0; i < countof(chunks); ++i) {
+        EXPECT_TRUE(run_socket_benchmark(0u, 0u, chunks[i], false), "");
+        EXPECT_TRUE(run_socket_benchmark(ZX_SOCKET_BULK, 0u, chunks[i], false), "");
+        EXPECT_TRUE(run_socket_benchmark(ZX_SOCKET_BULK, 4u * 1024u * 1024u, chunks[i], false),
+                    "");
+        EXPECT_TRUE(run_socket_benchmark(ZX_SOCKET_BULK, 4u * 1024u * 1024u, chunks[i], true),
+                    "");
+    }
+    unittest_printf("\n");
+
+    END_TEST;
+}
+
 
 BEGIN_TEST_CASE(socket_tests)
 RUN_TEST(socket_basic)
@@ -734,6 +1282,12 @@ RUN_TEST(socket_datagram_no_short_write)
 RUN_TEST(socket_control_plane_absent)
 RUN_TEST(socket_control_plane)
 RUN_TEST(socket_control_plane_shutdown)
+RUN_TEST(socket_bulk)
+RUN_TEST(socket_bulk_invalid)
+RUN_TEST(socket_bulk_in_place)
+RUN_TEST(socket_bulk_in_place_invalid)
+RUN_TEST(socket_bulk_starvation)
+RUN_TEST_PERFORMANCE(socket_throughput_benchmark)
 END_TEST_CASE(socket_tests)
 
 #ifndef BUILD_COMBINED_TESTS
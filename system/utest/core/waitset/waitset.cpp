@@ -0,0 +1,218 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <zircon/syscalls.h>
+#include <fbl/algorithm.h>
+
+#include <unittest/unittest.h>
+
+static bool basic_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t ws;
+    ASSERT_EQ(zx_waitset_create(0u, &ws), ZX_OK, "");
+
+    zx_handle_t events[2];
+    for (auto& event : events)
+        ASSERT_EQ(zx_event_create(0u, &event), ZX_OK, "");
+
+    EXPECT_EQ(zx_waitset_add(ws, 1u, events[0], ZX_USER_SIGNAL_0), ZX_OK, "");
+    EXPECT_EQ(zx_waitset_add(ws, 2u, events[1], ZX_USER_SIGNAL_0), ZX_OK, "");
+    EXPECT_EQ(zx_waitset_add(ws, 2u, events[0], ZX_USER_SIGNAL_1), ZX_ERR_ALREADY_EXISTS, "");
+
+    zx_waitset_result_t results[4];
+    uint32_t actual = 0u;
+    EXPECT_EQ(zx_waitset_wait(ws, 0u, results, fbl::count_of(results), &actual),
+              ZX_ERR_TIMED_OUT, "nothing is triggered");
+
+    EXPECT_EQ(zx_object_signal(events[1], 0u, ZX_USER_SIGNAL_0), ZX_OK, "");
+    EXPECT_EQ(zx_waitset_wait(ws, 0u, results, fbl::count_of(results), &actual), ZX_OK, "");
+    ASSERT_EQ(actual, 1u, "");
+    EXPECT_EQ(results[0].cookie, 2u, "");
+    EXPECT_EQ(results[0].status, ZX_OK, "");
+    EXPECT_TRUE(results[0].observed & ZX_USER_SIGNAL_0, "");
+
+    // Entries are level triggered.
+    EXPECT_EQ(zx_waitset_wait(ws, 0u, results, fbl::count_of(results), &actual), ZX_OK, "");
+    EXPECT_EQ(actual, 1u, "");
+
+    EXPECT_EQ(zx_object_signal(events[1], ZX_USER_SIGNAL_0, 0u), ZX_OK, "");
+    EXPECT_EQ(zx_waitset_wait(ws, 0u, results, fbl::count_of(results), &actual),
+              ZX_ERR_TIMED_OUT, "untriggered");
+
+    EXPECT_EQ(zx_object_signal(events[0], 0u, ZX_USER_SIGNAL_0), ZX_OK, "");
+    EXPECT_EQ(zx_waitset_remove(ws, 1u), ZX_OK, "");
+    EXPECT_EQ(zx_waitset_remove(ws, 1u), ZX_ERR_NOT_FOUND, "");
+    EXPECT_EQ(zx_waitset_wait(ws, 0u, results, fbl::count_of(results), &actual),
+              ZX_ERR_TIMED_OUT, "removed entries are not reported");
+
+    // The cookie can be reused once removed.
+    EXPECT_EQ(zx_waitset_add(ws, 1u, events[0], ZX_USER_SIGNAL_0), ZX_OK, "");
+    EXPECT_EQ(zx_waitset_wait(ws, 0u, results, fbl::count_of(results), &actual), ZX_OK, "");
+    EXPECT_EQ(actual, 1u, "");
+    EXPECT_EQ(results[0].cookie, 1u, "");
+
+    for (auto& event : events)
+        EXPECT_EQ(zx_handle_close(event), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(ws), ZX_OK, "");
+
+    END_TEST;
+}
+
+static bool rotate_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t ws;
+    ASSERT_EQ(zx_waitset_create(0u, &ws), ZX_OK, "");
+
+    zx_handle_t events[3];
+    for (uint64_t i = 0; i < fbl::count_of(events); ++i) {
+        ASSERT_EQ(zx_event_create(0u, &events[i]), ZX_OK, "");
+        ASSERT_EQ(zx_object_signal(events[i], 0u, ZX_EVENT_SIGNALED), ZX_OK, "");
+        ASSERT_EQ(zx_waitset_add(ws, i, events[i], ZX_EVENT_SIGNALED), ZX_OK, "");
+    }
+
+    // A caller that asks for one result at a time sees every entry in turn.
+    bool seen[fbl::count_of(events)] = {};
+    for (size_t i = 0; i < fbl::count_of(events); ++i) {
+        zx_waitset_result_t result;
+        uint32_t actual = 0u;
+        ASSERT_EQ(zx_waitset_wait(ws, 0u, &result, 1u, &actual), ZX_OK, "");
+        ASSERT_EQ(actual, 1u, "");
+        ASSERT_LT(result.cookie, fbl::count_of(events), "");
+        EXPECT_FALSE(seen[result.cookie], "entry reported twice");
+        seen[result.cookie] = true;
+    }
+
+    for (auto& event : events)
+        EXPECT_EQ(zx_handle_close(event), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(ws), ZX_OK, "");
+
+    END_TEST;
+}
+
+static bool handle_close_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t ws;
+    ASSERT_EQ(zx_waitset_create(0u, &ws), ZX_OK, "");
+
+    zx_handle_t event;
+    ASSERT_EQ(zx_event_create(0u, &event), ZX_OK, "");
+    ASSERT_EQ(zx_waitset_add(ws, 7u, event, ZX_EVENT_SIGNALED), ZX_OK, "");
+    ASSERT_EQ(zx_handle_close(event), ZX_OK, "");
+
+    // The entry stays in the set, reporting that its handle went away.
+    zx_waitset_result_t result;
+    uint32_t actual = 0u;
+    ASSERT_EQ(zx_waitset_wait(ws, 0u, &result, 1u, &actual), ZX_OK, "");
+    ASSERT_EQ(actual, 1u, "");
+    EXPECT_EQ(result.cookie, 7u, "");
+    EXPECT_EQ(result.status, ZX_ERR_CANCELED, "");
+    EXPECT_TRUE(result.observed & ZX_SIGNAL_HANDLE_CLOSED, "");
+
+    EXPECT_EQ(zx_waitset_remove(ws, 7u), ZX_OK, "");
+    EXPECT_EQ(zx_waitset_wait(ws, 0u, &result, 1u, &actual), ZX_ERR_TIMED_OUT, "");
+
+    EXPECT_EQ(zx_handle_close(ws), ZX_OK, "");
+
+    END_TEST;
+}
+
+static bool bad_args_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t ws;
+    EXPECT_EQ(zx_waitset_create(1u, &ws), ZX_ERR_INVALID_ARGS, "");
+    ASSERT_EQ(zx_waitset_create(0u, &ws), ZX_OK, "");
+
+    EXPECT_EQ(zx_waitset_add(ws, 0u, ZX_HANDLE_INVALID, ZX_EVENT_SIGNALED),
+              ZX_ERR_BAD_HANDLE, "");
+
+    zx_handle_t event;
+    ASSERT_EQ(zx_event_create(0u, &event), ZX_OK, "");
+    EXPECT_EQ(zx_waitset_add(event, 0u, ws, ZX_EVENT_SIGNALED), ZX_ERR_WRONG_TYPE, "");
+
+    zx_handle_t ro;
+    ASSERT_EQ(zx_handle_duplicate(ws, ZX_RIGHT_READ, &ro), ZX_OK, "");
+    EXPECT_EQ(zx_waitset_add(ro, 0u, event, ZX_EVENT_SIGNALED), ZX_ERR_ACCESS_DENIED, "");
+
+    EXPECT_EQ(zx_handle_close(ro), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(event), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(ws), ZX_OK, "");
+
+    END_TEST;
+}
+
+// Wait on |count| events, only the last of which is signaled, both ways.
+static bool wait_benchmark_one(uint32_t count) {
+    BEGIN_HELPER;
+
+    constexpr uint32_t kIterations = 1000u;
+
+    zx_handle_t ws;
+    ASSERT_EQ(zx_waitset_create(0u, &ws), ZX_OK, "");
+
+    zx_wait_item_t* items =
+        static_cast<zx_wait_item_t*>(calloc(count, sizeof(zx_wait_item_t)));
+    ASSERT_NONNULL(items, "");
+    for (uint32_t i = 0; i < count; ++i) {
+        ASSERT_EQ(zx_event_create(0u, &items[i].handle), ZX_OK, "");
+        items[i].waitfor = ZX_EVENT_SIGNALED;
+        ASSERT_EQ(zx_waitset_add(ws, i, items[i].handle, ZX_EVENT_SIGNALED), ZX_OK, "");
+    }
+    ASSERT_EQ(zx_object_signal(items[count - 1].handle, 0u, ZX_EVENT_SIGNALED), ZX_OK, "");
+
+    zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+    for (uint32_t i = 0; i < kIterations; ++i)
+        ASSERT_EQ(zx_object_wait_many(items, count, 0u), ZX_OK, "");
+    zx_time_t wait_many = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+
+    start = zx_time_get(ZX_CLOCK_MONOTONIC);
+    for (uint32_t i = 0; i < kIterations; ++i) {
+        zx_waitset_result_t result;
+        uint32_t actual;
+        ASSERT_EQ(zx_waitset_wait(ws, 0u, &result, 1u, &actual), ZX_OK, "");
+    }
+    zx_time_t waitset = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+
+    unittest_printf("\n    %4u handles: object_wait_many %6" PRIu64 " ns,"
+                    " waitset_wait %6" PRIu64 " ns",
+                    count, wait_many / kIterations, waitset / kIterations);
+
+    for (uint32_t i = 0; i < count; ++i)
+        EXPECT_EQ(zx_handle_close(items[i].handle), ZX_OK, "");
+    free(items);
+    EXPECT_EQ(zx_handle_close(ws), ZX_OK, "");
+
+    END_HELPER;
+}
+
+static bool wait_benchmark(void) {
+    BEGIN_TEST;
+
+    for (uint32_t count : {10u, 100u, 1000u})
+        EXPECT_TRUE(wait_benchmark_one(count), "");
+    unittest_printf("\n");
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(waitset_tests)
+RUN_TEST(basic_test)
+RUN_TEST(rotate_test)
+RUN_TEST(handle_close_test)
+RUN_TEST(bad_args_test)
+RUN_TEST_PERFORMANCE(wait_benchmark)
+END_TEST_CASE(waitset_tests)
+
+#ifndef BUILD_COMBINED_TESTS
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
+#endif
@@ -0,0 +1,197 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <dlfcn.h>
+#include <inttypes.h>
+#include <launchpad/vmo.h>
+#include <zircon/dlfcn.h>
+#include <zircon/syscalls.h>
+
+#include <stdio.h>
+
+#include <unittest/unittest.h>
+
+#if __has_feature(address_sanitizer)
+# define LIBPREFIX "/boot/lib/asan/"
+#else
+# define LIBPREFIX "/boot/lib/"
+#endif
+
+static const int kIterations = 10000;
+
+static void report(const char* what, zx_time_t start, int count) {
+    zx_time_t elapsed = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+    unittest_printf_critical("\n    %-40s %8" PRIu64 " ns/op", what,
+                             elapsed / count);
+}
+
+// Symbols looked up by the benchmarks below, defined in objects near the
+// front and near the back of the global search list, plus one that is
+// defined nowhere (which has to consult every object).
+static const char* const kFrontSymbol = "malloc";
+static const char* const kBackSymbol = "launchpad_create";
+static const char* const kMissingSymbol = "no_such_symbol_anywhere";
+
+// Loading a DSO is dominated by do_relocs, whose symbol lookups ld.so
+// caches per DSO.  A loaded object is never unloaded and a second dlopen
+// just finds it by soname, so this can only time one fresh load per run;
+// it has to run before anything else here opens liblaunchpad.so.
+// launchpad-test's spawn latency benchmark covers the same work at
+// process startup.
+static bool dlopen_relocate_benchmark(void) {
+    BEGIN_TEST;
+
+    ASSERT_NULL(dlopen("liblaunchpad.so", RTLD_NOLOAD),
+                "liblaunchpad.so already loaded");
+
+    zx_handle_t vmo = ZX_HANDLE_INVALID;
+    ASSERT_EQ(launchpad_vmo_from_file(LIBPREFIX "liblaunchpad.so", &vmo),
+              ZX_OK, "");
+    zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+    void* lib = dlopen_vmo(vmo, RTLD_LOCAL);
+    report("dlopen_vmo(liblaunchpad.so) first load", start, 1);
+    zx_handle_close(vmo);
+    ASSERT_NONNULL(lib, "dlopen_vmo");
+
+    EXPECT_EQ(dlclose(lib), 0, "");
+
+    END_TEST;
+}
+
+static bool dlsym_default_benchmark(void) {
+    BEGIN_TEST;
+
+    // Make liblaunchpad.so global, so its symbols are at the far end of
+    // the RTLD_DEFAULT search.
+    zx_handle_t vmo = ZX_HANDLE_INVALID;
+    ASSERT_EQ(launchpad_vmo_from_file(LIBPREFIX "liblaunchpad.so", &vmo),
+              ZX_OK, "");
+    void* lib = dlopen_vmo(vmo, RTLD_GLOBAL);
+    zx_handle_close(vmo);
+    ASSERT_NONNULL(lib, "dlopen_vmo");
+
+    const char* const names[] = { kFrontSymbol, kBackSymbol };
+    for (size_t i = 0; i < countof(names); ++i) {
+        ASSERT_NONNULL(dlsym(RTLD_DEFAULT, names[i]), names[i]);
+        zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+        for (int n = 0; n < kIterations; ++n)
+            dlsym(RTLD_DEFAULT, names[i]);
+        char what[64];
+        snprintf(what, sizeof(what), "dlsym(RTLD_DEFAULT, %s)", names[i]);
+        report(what, start, kIterations);
+    }
+
+    // Failing lookups are never cached, so this measures the full walk
+    // over every loaded object's hash table (or bloom filter).
+    EXPECT_NULL(dlsym(RTLD_DEFAULT, kMissingSymbol), "");
+    zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+    for (int n = 0; n < kIterations; ++n)
+        dlsym(RTLD_DEFAULT, kMissingSymbol);
+    report("dlsym(RTLD_DEFAULT, <missing>)", start, kIterations);
+
+    EXPECT_EQ(dlclose(lib), 0, "");
+
+    END_TEST;
+}
+
+// A working set larger than the dlsym cache, with about a third of the
+// names defined nowhere, so most lookups miss the cache (or fail) and
+// take the full search.  This is closer to a plugin host resolving many
+// optional entry points once each than the single-name loops above.
+static const char* const kMixedSymbols[] = {
+    "malloc", "free", "calloc", "realloc", "memcpy", "memmove", "memset",
+    "memcmp", "strlen", "strcmp", "strncmp", "strcpy", "strncpy", "strchr",
+    "strrchr", "strstr", "strdup", "snprintf", "vsnprintf", "printf",
+    "fprintf", "fopen", "fclose", "fread", "fwrite", "fflush", "open",
+    "close", "read", "write", "lseek", "stat", "fstat", "unlink", "mkdir",
+    "opendir", "readdir", "closedir", "pthread_create", "pthread_join",
+    "pthread_mutex_lock", "pthread_mutex_unlock", "qsort", "bsearch",
+    "atoi", "strtol", "strtoul", "getenv", "setenv", "clock_gettime",
+    "nanosleep", "launchpad_create", "launchpad_go", "launchpad_load_from_file",
+    "fdio_get_vmo", "fdio_wait_fd",
+    "no_such_symbol_0", "no_such_symbol_1", "no_such_symbol_2",
+    "no_such_symbol_3", "no_such_symbol_4", "no_such_symbol_5",
+    "no_such_symbol_6", "no_such_symbol_7", "no_such_symbol_8",
+    "no_such_symbol_9", "no_such_symbol_10", "no_such_symbol_11",
+    "plugin_init", "plugin_fini", "plugin_get_info", "plugin_version",
+    "optional_feature_a", "optional_feature_b", "optional_feature_c",
+    "optional_feature_d", "optional_feature_e", "optional_feature_f",
+    "optional_feature_g", "optional_feature_h", "optional_feature_i",
+    "optional_feature_j",
+};
+
+static bool dlsym_mixed_benchmark(void) {
+    BEGIN_TEST;
+
+    zx_handle_t vmo = ZX_HANDLE_INVALID;
+    ASSERT_EQ(launchpad_vmo_from_file(LIBPREFIX "liblaunchpad.so", &vmo),
+              ZX_OK, "");
+    void* lib = dlopen_vmo(vmo, RTLD_GLOBAL);
+    zx_handle_close(vmo);
+    ASSERT_NONNULL(lib, "dlopen_vmo");
+
+    const int rounds = kIterations / (int)countof(kMixedSymbols) + 1;
+    zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+    for (int n = 0; n < rounds; ++n) {
+        for (size_t i = 0; i < countof(kMixedSymbols); ++i)
+            dlsym(RTLD_DEFAULT, kMixedSymbols[i]);
+    }
+    report("dlsym(RTLD_DEFAULT, <mixed names>)", start,
+           rounds * (int)countof(kMixedSymbols));
+
+    EXPECT_EQ(dlclose(lib), 0, "");
+
+    END_TEST;
+}
+
+static bool dlsym_handle_benchmark(void) {
+    BEGIN_TEST;
+
+    void* lib = dlopen("libfdio.so", RTLD_NOLOAD);
+    ASSERT_NONNULL(lib, "libfdio.so not loaded");
+
+    ASSERT_NONNULL(dlsym(lib, "fdio_get_vmo"), "");
+    zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+    for (int n = 0; n < kIterations; ++n)
+        dlsym(lib, "fdio_get_vmo");
+    report("dlsym(libfdio.so, fdio_get_vmo)", start, kIterations);
+
+    // Defined in a dependency (libc), so the lookup recurses.
+    ASSERT_NONNULL(dlsym(lib, kFrontSymbol), "");
+    start = zx_time_get(ZX_CLOCK_MONOTONIC);
+    for (int n = 0; n < kIterations; ++n)
+        dlsym(lib, kFrontSymbol);
+    report("dlsym(libfdio.so, malloc)", start, kIterations);
+
+    EXPECT_EQ(dlclose(lib), 0, "");
+
+    END_TEST;
+}
+
+static bool dlopen_noload_benchmark(void) {
+    BEGIN_TEST;
+
+    zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+    for (int n = 0; n < kIterations; ++n) {
+        void* lib = dlopen("libfdio.so", RTLD_NOLOAD);
+        ASSERT_NONNULL(lib, "");
+        dlclose(lib);
+    }
+    report("dlopen(libfdio.so, RTLD_NOLOAD)", start, kIterations);
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(dlfcn_bench)
+RUN_TEST_PERFORMANCE(dlopen_relocate_benchmark);
+RUN_TEST_PERFORMANCE(dlsym_default_benchmark);
+RUN_TEST_PERFORMANCE(dlsym_mixed_benchmark);
+RUN_TEST_PERFORMANCE(dlsym_handle_benchmark);
+RUN_TEST_PERFORMANCE(dlopen_noload_benchmark);
+END_TEST_CASE(dlfcn_bench)
+
+int main(int argc, char** argv) {
+    bool success = unittest_run_all_tests(argc, argv);
+    return success ? 0 : -1;
+}
@@ -0,0 +1,21 @@
+# Copyright 2017 The Fuchsia Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+MODULE := $(LOCAL_DIR)
+
+MODULE_TYPE := usertest
+
+MODULE_SRCS += \
+    $(LOCAL_DIR)/dlfcn-bench.c
+
+MODULE_NAME := dlfcn-bench-test
+
+# Like dlfcn-test, this uses liblaunchpad.so as the library to dlopen,
+# so link launchpad statically to keep it from being loaded already.
+MODULE_STATIC_LIBS := system/ulib/launchpad system/ulib/elfload
+MODULE_LIBS := system/ulib/unittest system/ulib/fdio system/ulib/zircon system/ulib/c
+
+include make/module.mk
@@ -7,6 +7,7 @@
 #include <zircon/device/ethernet.h>
 #include <zircon/device/ethertap.h>
 #include <zircon/status.h>
+#include <zircon/syscalls.h>
 #include <zircon/types.h>
 #include <zx/fifo.h>
 #include <zx/socket.h>
@@ -23,6 +24,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -219,6 +221,11 @@ class EthernetClient {
         return rc < 0 ? static_cast<zx_status_t>(rc) : ZX_OK;
     }
 
+    zx_status_t GetInfo(eth_info_t* info) {
+        ssize_t rc = ioctl_ethernet_get_info(fd_, info);
+        return rc < 0 ? static_cast<zx_status_t>(rc) : ZX_OK;
+    }
+
     zx_status_t GetStatus(uint32_t* eth_status) {
         ssize_t rc = ioctl_ethernet_get_status(fd_, eth_status);
         return rc < 0 ? static_cast<zx_status_t>(rc) : ZX_OK;
@@ -270,6 +277,21 @@ class EthernetClient {
     fbl::SinglyLinkedList<FifoEntryPtr> tx_pending_;
 };
 
+// Adds up |len| bytes as big-endian 16-bit words, for the Internet checksum.
+uint32_t OnesSum(const uint8_t* data, size_t len, uint32_t sum) {
+    size_t i = 0;
+    for (; i + 1 < len; i += 2) {
+        sum += (data[i] << 8) | data[i + 1];
+    }
+    if (i < len) {
+        sum += data[i] << 8;
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return sum;
+}
+
 }  // namespace
 
 static bool EthernetStartTest() {
@@ -440,6 +462,91 @@ static bool EthernetDataTest_Send() {
     return true;
 }
 
+static bool EthernetDataTest_SendCsum() {
+    zx::socket sock;
+    ASSERT_EQ(ZX_OK, CreateEthertap(1500, &sock));
+
+    int devfd = -1;
+    ASSERT_EQ(ZX_OK, OpenEthertapDev(&devfd));
+    ASSERT_GE(devfd, 0);
+
+    EthernetClient client(devfd);
+    ASSERT_EQ(ZX_OK, client.Register(kTapDevName, 32, 2048));
+    ASSERT_EQ(ZX_OK, client.Start());
+
+    // The tap device fills in checksums in software
+    eth_info_t info;
+    ASSERT_EQ(ZX_OK, client.GetInfo(&info));
+    ASSERT_TRUE(info.features & ETH_FEATURE_TX_CSUM);
+
+    sock.signal_peer(0, ETHERTAP_SIGNAL_ONLINE);
+
+    // Build an IPv4 UDP packet with 32 bytes of payload
+    constexpr size_t kUdpOffset = 14 + 20;
+    constexpr size_t kUdpLength = 8 + 32;
+    constexpr size_t kFrameLength = kUdpOffset + kUdpLength;
+    auto entry = client.GetTxBuffer();
+    ASSERT_TRUE(entry != nullptr);
+    uint8_t* buf = static_cast<uint8_t*>(entry->cookie);
+    memset(buf, 0, kFrameLength);
+    memcpy(buf, kTapMac, 6);
+    memcpy(buf + 6, kTapMac, 6);
+    buf[12] = 0x08;
+    uint8_t* ip = buf + 14;
+    ip[0] = 0x45;
+    ip[3] = 20 + kUdpLength;
+    ip[8] = 64;
+    ip[9] = 17;
+    const uint8_t addrs[8] = { 192, 168, 0, 1, 192, 168, 0, 2 };
+    memcpy(ip + 12, addrs, sizeof(addrs));
+    uint8_t* udp = buf + kUdpOffset;
+    udp[1] = 7;
+    udp[3] = 9;
+    udp[5] = kUdpLength;
+    for (size_t i = 8; i < kUdpLength; i++) {
+        udp[i] = static_cast<uint8_t>(i * 7);
+    }
+
+    // The checksum field starts out as the pseudo-header sum
+    const uint8_t proto_len[4] = { 0, 17, 0, kUdpLength };
+    uint32_t pseudo = OnesSum(proto_len, sizeof(proto_len), OnesSum(addrs, sizeof(addrs), 0));
+    udp[6] = static_cast<uint8_t>(pseudo >> 8);
+    udp[7] = static_cast<uint8_t>(pseudo);
+
+    entry->length = kFrameLength;
+    entry->flags = ETH_FIFO_TX_CSUM;
+    uint32_t actual = 0;
+    ASSERT_EQ(ZX_OK, client.tx_fifo()->write(entry, sizeof(eth_fifo_entry_t), &actual));
+    EXPECT_EQ(1u, actual);
+
+    zx_signals_t obs;
+    EXPECT_EQ(ZX_OK, sock.wait_one(ZX_SOCKET_READABLE, zx::deadline_after(ZX_MSEC(10)), &obs));
+    ASSERT_TRUE(obs & ZX_SOCKET_READABLE);
+
+    uint8_t read_buf[kFrameLength];
+    size_t actual_sz = 0;
+    EXPECT_EQ(ZX_OK, sock.read(0u, read_buf, sizeof(read_buf), &actual_sz));
+    ASSERT_EQ(kFrameLength, actual_sz);
+
+    // Only the checksum should have changed, and it should now verify
+    EXPECT_BYTES_EQ(buf, read_buf, kUdpOffset + 6, "");
+    EXPECT_BYTES_EQ(buf + kUdpOffset + 8, read_buf + kUdpOffset + 8, kUdpLength - 8, "");
+    uint32_t sum = OnesSum(read_buf + kUdpOffset, kUdpLength, pseudo);
+    EXPECT_EQ(0xffffu, sum);
+
+    eth_fifo_entry_t return_entry;
+    EXPECT_EQ(ZX_OK,
+            client.tx_fifo()->wait_one(ZX_FIFO_READABLE, zx::deadline_after(ZX_MSEC(10)), &obs));
+    ASSERT_EQ(ZX_OK, client.tx_fifo()->read(&return_entry, sizeof(eth_fifo_entry_t), &actual));
+    EXPECT_TRUE(return_entry.flags & ETH_FIFO_TX_OK);
+    client.ReturnTxBuffer(&return_entry);
+
+    EXPECT_EQ(ZX_OK, client.Stop());
+    sock.reset();
+
+    return true;
+}
+
 static bool EthernetDataTest_Recv() {
     // Set up the tap device and the ethernet client
     zx::socket sock;
@@ -499,6 +606,233 @@ static bool EthernetDataTest_Recv() {
     return true;
 }
 
+static bool EthernetDataTest_RecvBatch() {
+    // Set up the tap device and the ethernet client
+    zx::socket sock;
+    ASSERT_EQ(ZX_OK, CreateEthertap(1500, &sock));
+
+    int devfd = -1;
+    ASSERT_EQ(ZX_OK, OpenEthertapDev(&devfd));
+    ASSERT_GE(devfd, 0);
+
+    EthernetClient client(devfd);
+    ASSERT_EQ(ZX_OK, client.Register(kTapDevName, 32, 2048));
+    ASSERT_EQ(ZX_OK, client.Start());
+
+    sock.signal_peer(0, ETHERTAP_SIGNAL_ONLINE);
+
+    // Send as many frames as the client has buffers, back to back, so the driver hands them over
+    // in batches
+    constexpr uint32_t kFrames = 32;
+    for (uint32_t i = 0; i < kFrames; i++) {
+        uint8_t buf[64];
+        memset(buf, static_cast<int>(i), sizeof(buf));
+        size_t actual = 0;
+        ASSERT_EQ(ZX_OK, sock.write(0, static_cast<void*>(buf), sizeof(buf), &actual));
+        ASSERT_EQ(sizeof(buf), actual);
+    }
+
+    // Every frame should arrive, intact and in the order it was sent
+    uint32_t received = 0;
+    while (received < kFrames) {
+        zx_signals_t obs;
+        ASSERT_EQ(ZX_OK, client.rx_fifo()->wait_one(ZX_FIFO_READABLE,
+                                                    zx::deadline_after(ZX_MSEC(100)), &obs));
+
+        eth_fifo_entry_t entries[kFrames];
+        uint32_t actual_entries = 0;
+        ASSERT_EQ(ZX_OK, client.rx_fifo()->read(entries, sizeof(entries), &actual_entries));
+        for (uint32_t n = 0; n < actual_entries; n++, received++) {
+            EXPECT_TRUE(entries[n].flags & ETH_FIFO_RX_OK);
+            ASSERT_EQ(64u, entries[n].length);
+            uint8_t expected[64];
+            memset(expected, static_cast<int>(received), sizeof(expected));
+            EXPECT_BYTES_EQ(expected, client.GetRxBuffer(entries[n].offset), 64, "");
+        }
+    }
+
+    // Shutdown the client and cleanup the tap device
+    EXPECT_EQ(ZX_OK, client.Stop());
+    sock.reset();
+
+    return true;
+}
+
+static bool EthernetDataTest_RecvStop() {
+    // Set up the tap device and the ethernet client
+    zx::socket sock;
+    ASSERT_EQ(ZX_OK, CreateEthertap(1500, &sock));
+
+    int devfd = -1;
+    ASSERT_EQ(ZX_OK, OpenEthertapDev(&devfd));
+    ASSERT_GE(devfd, 0);
+
+    constexpr uint32_t kBufs = 32;
+    EthernetClient client(devfd);
+    ASSERT_EQ(ZX_OK, client.Register(kTapDevName, kBufs, 2048));
+    ASSERT_EQ(ZX_OK, client.Start());
+
+    sock.signal_peer(0, ETHERTAP_SIGNAL_ONLINE);
+
+    // Receiving one frame makes the driver read ahead the rest of the free buffers
+    uint8_t buf[64] = {};
+    size_t actual = 0;
+    ASSERT_EQ(ZX_OK, sock.write(0, static_cast<void*>(buf), sizeof(buf), &actual));
+
+    zx_signals_t obs;
+    ASSERT_EQ(ZX_OK, client.rx_fifo()->wait_one(ZX_FIFO_READABLE,
+                                                zx::deadline_after(ZX_MSEC(100)), &obs));
+    eth_fifo_entry_t entries[kBufs];
+    uint32_t actual_entries = 0;
+    ASSERT_EQ(ZX_OK, client.rx_fifo()->read(entries, sizeof(entries), &actual_entries));
+    ASSERT_EQ(1u, actual_entries);
+    EXPECT_TRUE(entries[0].flags & ETH_FIFO_RX_OK);
+
+    // Stopping gives every other buffer back, unused
+    EXPECT_EQ(ZX_OK, client.Stop());
+    uint32_t returned = 0;
+    while (returned < kBufs - 1) {
+        ASSERT_EQ(ZX_OK, client.rx_fifo()->wait_one(ZX_FIFO_READABLE,
+                                                    zx::deadline_after(ZX_MSEC(100)), &obs));
+        ASSERT_EQ(ZX_OK, client.rx_fifo()->read(entries, sizeof(entries), &actual_entries));
+        for (uint32_t n = 0; n < actual_entries; n++, returned++) {
+            EXPECT_FALSE(entries[n].flags & ETH_FIFO_RX_OK);
+            EXPECT_EQ(0u, entries[n].length);
+        }
+    }
+    EXPECT_EQ(kBufs - 1, returned);
+
+    sock.reset();
+
+    return true;
+}
+
+// Measures how many small frames a second make it from the tap socket to the client.
+static bool EthernetRecvRateTest() {
+    zx::socket sock;
+    ASSERT_EQ(ZX_OK, CreateEthertap(1500, &sock));
+
+    int devfd = -1;
+    ASSERT_EQ(ZX_OK, OpenEthertapDev(&devfd));
+    ASSERT_GE(devfd, 0);
+
+    EthernetClient client(devfd);
+    ASSERT_EQ(ZX_OK, client.Register(kTapDevName, 256, 2048));
+    ASSERT_EQ(ZX_OK, client.Start());
+
+    sock.signal_peer(0, ETHERTAP_SIGNAL_ONLINE);
+
+    constexpr uint32_t kFrames = 20000;
+    uint8_t frame[64] = {};
+    uint32_t sent = 0;
+    uint32_t received = 0;
+    zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+    while (received < kFrames) {
+        // Keep the socket full, and hand every buffer that comes back straight to the driver
+        while (sent < kFrames) {
+            size_t actual = 0;
+            if (sock.write(0, frame, sizeof(frame), &actual) != ZX_OK) {
+                break;
+            }
+            sent++;
+        }
+
+        zx_signals_t obs;
+        ASSERT_EQ(ZX_OK, client.rx_fifo()->wait_one(ZX_FIFO_READABLE,
+                                                    zx::deadline_after(ZX_SEC(1)), &obs));
+        eth_fifo_entry_t entries[256];
+        uint32_t actual_entries = 0;
+        ASSERT_EQ(ZX_OK, client.rx_fifo()->read(entries, sizeof(entries), &actual_entries));
+        received += actual_entries;
+        for (uint32_t n = 0; n < actual_entries; n++) {
+            entries[n].length = 2048;
+        }
+        uint32_t returned = 0;
+        ASSERT_EQ(ZX_OK, client.rx_fifo()->write(entries, sizeof(eth_fifo_entry_t) * actual_entries,
+                                                 &returned));
+        ASSERT_EQ(actual_entries, returned);
+    }
+    zx_time_t elapsed = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+
+    unittest_printf("\n%u frames in %" PRIu64 " ms: %" PRIu64 " frames/s\n", kFrames,
+                    elapsed / ZX_MSEC(1), kFrames * ZX_SEC(1) / elapsed);
+
+    EXPECT_EQ(ZX_OK, client.Stop());
+    sock.reset();
+
+    return true;
+}
+
+// Measures how fast full-size frames can be sent through the tap device.
+static bool EthernetSendRateTest() {
+    zx::socket sock;
+    ASSERT_EQ(ZX_OK, CreateEthertap(1500, &sock));
+
+    int devfd = -1;
+    ASSERT_EQ(ZX_OK, OpenEthertapDev(&devfd));
+    ASSERT_GE(devfd, 0);
+
+    // Few enough buffers in flight that the tap socket never fills
+    constexpr uint32_t kBufs = 64;
+    EthernetClient client(devfd);
+    ASSERT_EQ(ZX_OK, client.Register(kTapDevName, kBufs, 2048));
+    ASSERT_EQ(ZX_OK, client.Start());
+
+    sock.signal_peer(0, ETHERTAP_SIGNAL_ONLINE);
+
+    constexpr uint32_t kFrames = 20000;
+    constexpr uint16_t kFrameSize = 1500;
+    uint32_t sent = 0;
+    uint32_t completed = 0;
+    zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+    while (completed < kFrames) {
+        // Send on every free buffer at once
+        eth_fifo_entry_t batch[kBufs];
+        uint32_t n = 0;
+        eth_fifo_entry_t* entry;
+        while (sent + n < kFrames && (entry = client.GetTxBuffer()) != nullptr) {
+            entry->length = kFrameSize;
+            entry->flags = 0;
+            batch[n++] = *entry;
+        }
+        if (n > 0) {
+            uint32_t actual = 0;
+            ASSERT_EQ(ZX_OK, client.tx_fifo()->write(batch, sizeof(eth_fifo_entry_t) * n,
+                                                     &actual));
+            ASSERT_EQ(n, actual);
+            sent += n;
+        }
+
+        zx_signals_t obs;
+        ASSERT_EQ(ZX_OK, client.tx_fifo()->wait_one(ZX_FIFO_READABLE,
+                                                    zx::deadline_after(ZX_SEC(1)), &obs));
+        eth_fifo_entry_t done[kBufs];
+        uint32_t actual = 0;
+        ASSERT_EQ(ZX_OK, client.tx_fifo()->read(done, sizeof(done), &actual));
+        for (uint32_t i = 0; i < actual; i++) {
+            EXPECT_TRUE(done[i].flags & ETH_FIFO_TX_OK);
+            client.ReturnTxBuffer(&done[i]);
+        }
+        completed += actual;
+
+        // Play the part of the wire
+        uint8_t frame[kFrameSize];
+        size_t frame_size;
+        while (sock.read(0u, frame, sizeof(frame), &frame_size) == ZX_OK) {}
+    }
+    zx_time_t elapsed = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+
+    uint64_t bits = static_cast<uint64_t>(kFrames) * kFrameSize * 8;
+    unittest_printf("\n%u frames in %" PRIu64 " ms: %" PRIu64 " frames/s, %" PRIu64 " Mbit/s\n",
+                    kFrames, elapsed / ZX_MSEC(1), kFrames * ZX_SEC(1) / elapsed,
+                    bits * 1000 / elapsed);
+
+    EXPECT_EQ(ZX_OK, client.Stop());
+    sock.reset();
+
+    return true;
+}
+
 BEGIN_TEST_CASE(EthernetSetupTests)
 RUN_TEST_MEDIUM(EthernetStartTest)
 RUN_TEST_MEDIUM(EthernetLinkStatusTest)
@@ -506,7 +840,12 @@ END_TEST_CASE(EthernetSetupTests)
 
 BEGIN_TEST_CASE(EthernetDataTests)
 RUN_TEST_MEDIUM(EthernetDataTest_Send)
+RUN_TEST_MEDIUM(EthernetDataTest_SendCsum)
 RUN_TEST_MEDIUM(EthernetDataTest_Recv)
+RUN_TEST_MEDIUM(EthernetDataTest_RecvBatch)
+RUN_TEST_MEDIUM(EthernetDataTest_RecvStop)
+RUN_TEST_PERFORMANCE(EthernetRecvRateTest)
+RUN_TEST_PERFORMANCE(EthernetSendRateTest)
 END_TEST_CASE(EthernetDataTests)
 
 int main(int argc, char* argv[]) {
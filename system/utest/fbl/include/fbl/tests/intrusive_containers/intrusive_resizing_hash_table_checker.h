@@ -0,0 +1,67 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <unittest/unittest.h>
+#include <fbl/intrusive_resizing_hash_table.h>
+#include <fbl/tests/intrusive_containers/intrusive_doubly_linked_list_checker.h>
+#include <fbl/tests/intrusive_containers/intrusive_singly_linked_list_checker.h>
+#include <fbl/tests/intrusive_containers/test_environment_utils.h>
+
+namespace fbl {
+namespace tests {
+namespace intrusive_containers {
+
+// The resizing hash table sanity checker implementation is shared across
+// ResizingHashTables of all bucket types.
+class ResizingHashTableChecker {
+public:
+    template <typename ContainerType>
+    static bool SanityCheck(const ContainerType& container) {
+        using BucketType    = typename ContainerType::BucketType;
+        using BucketChecker = typename BucketType::CheckerType;
+        using KeyTraits     = typename ContainerType::KeyTraits;
+
+        BEGIN_TEST;
+
+        // Both bucket arrays are always powers of two, and the current one is
+        // never smaller than the minimum.
+        size_t cur_count = container.cur_.count;
+        size_t old_count = container.old_.count;
+        EXPECT_GE(cur_count, ContainerType::kMinBuckets, "");
+        EXPECT_EQ(0u, cur_count & (cur_count - 1), "");
+        EXPECT_EQ(0u, old_count & (old_count - 1), "");
+        EXPECT_EQ(container.is_rehashing(), old_count != 0, "");
+        EXPECT_LE(container.rehash_pos_, old_count, "");
+
+        // Demand that every bucket pass its sanity check.  Keep a running total
+        // of the total size of the HashTable in the process.
+        size_t total_size = 0;
+        for (size_t i = 0; i < container.bucket_count(); ++i) {
+            const BucketType& bucket = container.GetBucket(i);
+            ASSERT_TRUE(BucketChecker::SanityCheck(bucket), "");
+            total_size += SizeUtils<BucketType>::size(bucket);
+
+            // Old buckets which have been moved over must be empty.
+            if (i < container.rehash_pos_) {
+                EXPECT_TRUE(bucket.is_empty(), "");
+            }
+
+            // For every element in the bucket, make sure that it is in the
+            // bucket lookups will search for it.
+            for (const auto& obj : bucket) {
+                ASSERT_EQ(container.BucketIndex(KeyTraits::GetKey(obj)), i, "");
+            }
+        }
+
+        EXPECT_EQ(container.size(), total_size, "");
+
+        END_TEST;
+    }
+};
+
+}  // namespace intrusive_containers
+}  // namespace tests
+}  // namespace fbl
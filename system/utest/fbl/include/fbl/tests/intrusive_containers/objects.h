@@ -57,6 +57,20 @@ public:
     }
 };
 
+// The base class for objects kept in resizing hash tables, whose hash
+// functions return hashes over the full range of their HashType.  The
+// identity is about the worst hash there is, which makes it a good test of the
+// table's own mixing.
+template <typename KeyType, typename HashType>
+class ResizingHashedTestObjBase : public KeyedTestObjBase<KeyType>  {
+public:
+    explicit ResizingHashedTestObjBase(size_t val) : KeyedTestObjBase<KeyType>(val) { }
+
+    static HashType GetHash(const KeyType& key) {
+        return static_cast<HashType>(key);
+    }
+};
+
 // Container test objects are objects which...
 //
 // 1) Store a size_t value
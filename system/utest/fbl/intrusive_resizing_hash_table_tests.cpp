@@ -0,0 +1,402 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <inttypes.h>
+#include <time.h>
+
+#include <unittest/unittest.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/intrusive_double_list.h>
+#include <fbl/intrusive_hash_table.h>
+#include <fbl/intrusive_resizing_hash_table.h>
+#include <fbl/unique_ptr.h>
+#include <fbl/tests/intrusive_containers/associative_container_test_environment.h>
+#include <fbl/tests/intrusive_containers/intrusive_resizing_hash_table_checker.h>
+#include <fbl/tests/intrusive_containers/test_thunks.h>
+
+namespace fbl {
+namespace tests {
+namespace intrusive_containers {
+
+using ResizingOtherKeyType  = uint16_t;
+using ResizingOtherHashType = uint32_t;
+
+template <typename PtrType>
+struct ResizingOtherHashTraits {
+    using ObjType = typename ::fbl::internal::ContainerPtrTraits<PtrType>::ValueType;
+    using BucketStateType = DoublyLinkedListNodeState<PtrType>;
+
+    // Linked List Traits
+    static BucketStateType& node_state(ObjType& obj) {
+        return obj.other_container_state_.bucket_state_;
+    }
+
+    // Keyed Object Traits
+    static ResizingOtherKeyType GetKey(const ObjType& obj) {
+        return obj.other_container_state_.key_;
+    }
+
+    static bool LessThan(const ResizingOtherKeyType& key1, const ResizingOtherKeyType& key2) {
+        return key1 <  key2;
+    }
+
+    static bool EqualTo(const ResizingOtherKeyType& key1, const ResizingOtherKeyType& key2) {
+        return key1 == key2;
+    }
+
+    // Hash Traits
+    static ResizingOtherHashType GetHash(const ResizingOtherKeyType& key) {
+        return static_cast<ResizingOtherHashType>(key * 0xaee58187);
+    }
+
+    // Set key is a trait which is only used by the tests, not by the containers
+    // themselves.
+    static void SetKey(ObjType& obj, ResizingOtherKeyType key) {
+        obj.other_container_state_.key_ = key;
+    }
+};
+
+template <typename PtrType>
+struct ResizingOtherHashState {
+private:
+    friend struct ResizingOtherHashTraits<PtrType>;
+    ResizingOtherKeyType key_;
+    typename ResizingOtherHashTraits<PtrType>::BucketStateType bucket_state_;
+};
+
+template <typename PtrType>
+class RHTDLLTraits {
+public:
+    using ObjType = typename ::fbl::internal::ContainerPtrTraits<PtrType>::ValueType;
+
+    using ContainerType           = ResizingHashTable<size_t, PtrType, DoublyLinkedList<PtrType>>;
+    using ContainableBaseClass    = DoublyLinkedListable<PtrType>;
+    using ContainerStateType      = DoublyLinkedListNodeState<PtrType>;
+    using KeyType                 = typename ContainerType::KeyType;
+    using HashType                = typename ContainerType::HashType;
+
+    using OtherContainerTraits    = ResizingOtherHashTraits<PtrType>;
+    using OtherContainerStateType = ResizingOtherHashState<PtrType>;
+    using OtherBucketType         = DoublyLinkedList<PtrType, OtherContainerTraits>;
+    using OtherContainerType      = ResizingHashTable<ResizingOtherKeyType,
+                                                      PtrType,
+                                                      OtherBucketType,
+                                                      ResizingOtherHashType,
+                                                      OtherContainerTraits,
+                                                      OtherContainerTraits>;
+
+    using TestObjBaseType  = ResizingHashedTestObjBase<typename ContainerType::KeyType,
+                                                       typename ContainerType::HashType>;
+};
+
+DEFINE_TEST_OBJECTS(RHTDLL);
+using UMTE = DEFINE_TEST_THUNK(Associative, RHTDLL, Unmanaged);
+using UPTE = DEFINE_TEST_THUNK(Associative, RHTDLL, UniquePtr);
+using RPTE = DEFINE_TEST_THUNK(Associative, RHTDLL, RefPtr);
+
+// Tests of the resizing itself, using plain objects and enough of them to
+// grow the table many times over.
+struct ResizingHashEntry : public SinglyLinkedListable<ResizingHashEntry*> {
+    uint64_t key;
+
+    uint64_t GetKey() const { return key; }
+    static uint64_t GetHash(uint64_t key) { return key; }
+};
+
+using ResizingTable = ResizingHashTable<uint64_t, ResizingHashEntry*>;
+
+static unique_ptr<ResizingHashEntry[]> MakeEntries(size_t count) {
+    AllocChecker ac;
+    unique_ptr<ResizingHashEntry[]> entries(new (&ac) ResizingHashEntry[count]);
+    if (!ac.check())
+        return nullptr;
+    for (size_t i = 0; i < count; ++i)
+        entries[i].key = i * 3;
+    return entries;
+}
+
+static bool ResizingGrowShrinkTest() {
+    BEGIN_TEST;
+
+    constexpr size_t kCount = 10000;
+    auto entries = MakeEntries(kCount);
+    ASSERT_NONNULL(entries, "");
+
+    ResizingTable table;
+    EXPECT_EQ(ResizingTable::kMinBuckets, table.bucket_count(), "");
+
+    // Grow.  The table should keep up with the number of elements, and every
+    // element should be findable at every step.
+    for (size_t i = 0; i < kCount; ++i) {
+        table.insert(&entries[i]);
+        if ((i & (i + 1)) == 0 || i + 1 == kCount) {
+            ASSERT_TRUE(ResizingHashTableChecker::SanityCheck(table), "");
+            for (size_t j = 0; j <= i; ++j)
+                ASSERT_EQ(&entries[j], &*table.find(entries[j].key), "");
+        }
+        ASSERT_LE(table.size(), 2 * table.bucket_count() * ResizingTable::kMaxLoad, "");
+    }
+    EXPECT_FALSE(table.find(1).IsValid(), "");
+
+    // Erasing never shrinks the table by itself...
+    size_t buckets = table.bucket_count();
+    for (size_t i = 10; i < kCount; ++i)
+        ASSERT_EQ(&entries[i], table.erase(entries[i].key), "");
+    EXPECT_EQ(10u, table.size(), "");
+    EXPECT_EQ(buckets, table.bucket_count(), "");
+
+    // ...but inserting into a mostly empty table does.
+    for (size_t i = 0; i < 1000; ++i) {
+        table.insert(&entries[10]);
+        ASSERT_EQ(&entries[10], table.erase(entries[10].key), "");
+    }
+    EXPECT_FALSE(table.is_rehashing(), "");
+    EXPECT_LE(table.bucket_count(), 8 * ResizingTable::kMinLoadInverse * table.size(), "");
+    ASSERT_TRUE(ResizingHashTableChecker::SanityCheck(table), "");
+    for (size_t i = 0; i < 10; ++i)
+        EXPECT_EQ(&entries[i], &*table.find(entries[i].key), "");
+
+    table.clear();
+    EXPECT_TRUE(table.is_empty(), "");
+    EXPECT_EQ(ResizingTable::kMinBuckets, table.bucket_count(), "");
+
+    END_TEST;
+}
+
+static bool ResizingMidRehashTest() {
+    BEGIN_TEST;
+
+    constexpr size_t kCount = 1000;
+    auto entries = MakeEntries(kCount);
+    ASSERT_NONNULL(entries, "");
+
+    // Fill the table until a resize is in progress with plenty left to move.
+    ResizingTable table;
+    size_t count = 0;
+    while (count < kCount && !(table.is_rehashing() && table.size() > 100))
+        table.insert(&entries[count++]);
+    ASSERT_TRUE(table.is_rehashing(), "");
+    ASSERT_TRUE(ResizingHashTableChecker::SanityCheck(table), "");
+
+    // Everything can be found and iterated over, whichever bucket array it is in.
+    size_t visited = 0;
+    for (const auto& entry : table) {
+        EXPECT_EQ(&entry, &*table.find(entry.key), "");
+        ++visited;
+    }
+    EXPECT_EQ(count, visited, "");
+    for (size_t i = 0; i < count; ++i)
+        EXPECT_TRUE(table.find(entries[i].key).IsValid(), "");
+
+    // Erasing while iterating doesn't move anything, so it works mid-resize too.
+    for (auto iter = table.begin(); iter.IsValid();) {
+        if (iter->key % 2) {
+            table.erase(iter++);
+        } else {
+            ++iter;
+        }
+    }
+    EXPECT_TRUE(table.is_rehashing(), "");
+    ASSERT_TRUE(ResizingHashTableChecker::SanityCheck(table), "");
+    for (size_t i = 0; i < count; ++i)
+        EXPECT_EQ(entries[i].key % 2 == 0, table.find(entries[i].key).IsValid(), "");
+
+    // Inserts finish the resize.
+    size_t buckets = table.bucket_count();
+    while (table.is_rehashing())
+        table.insert(&entries[count++]);
+    EXPECT_LE(count - visited, buckets / ResizingTable::kRehashStep, "");
+    ASSERT_TRUE(ResizingHashTableChecker::SanityCheck(table), "");
+
+    table.clear();
+    END_TEST;
+}
+
+// Benchmarks of the resizing table against fixed size tables.
+using FixedSmallTable = HashTable<uint64_t, ResizingHashEntry*>;
+using FixedLargeTable = HashTable<uint64_t, ResizingHashEntry*,
+                                  SinglyLinkedList<ResizingHashEntry*>, size_t, 4099>;
+
+static uint64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+struct BenchResult {
+    uint64_t insert_ns;
+    uint64_t max_insert_ns;
+    uint64_t find_ns;
+};
+
+template <typename TableType>
+static bool RunBenchmark(ResizingHashEntry* entries, size_t count, BenchResult* result) {
+    BEGIN_HELPER;
+
+    unique_ptr<TableType> table(new TableType());
+    result->max_insert_ns = 0;
+    uint64_t start = NowNs();
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t t = NowNs();
+        table->insert(&entries[i]);
+        t = NowNs() - t;
+        if (t > result->max_insert_ns)
+            result->max_insert_ns = t;
+    }
+    result->insert_ns = (NowNs() - start) / count;
+
+    size_t found = 0;
+    start = NowNs();
+    for (size_t i = 0; i < count; ++i)
+        found += table->find(entries[(i * 7919) % count].key).IsValid();
+    result->find_ns = (NowNs() - start) / count;
+    EXPECT_EQ(count, found, "");
+
+    table->clear();
+    END_HELPER;
+}
+
+static bool ResizingBenchmark() {
+    BEGIN_TEST;
+
+    static const size_t kCounts[] = { 100, 1000, 10000, 100000 };
+    unittest_printf("\n%8s %-10s %12s %12s %12s\n",
+                    "count", "table", "insert ns", "max insert", "find ns");
+    for (size_t count : kCounts) {
+        auto entries = MakeEntries(count);
+        ASSERT_NONNULL(entries, "");
+        BenchResult result;
+
+        ASSERT_TRUE(RunBenchmark<FixedSmallTable>(entries.get(), count, &result), "");
+        unittest_printf("%8zu %-10s %12" PRIu64 " %12" PRIu64 " %12" PRIu64 "\n",
+                        count, "fixed 37", result.insert_ns, result.max_insert_ns,
+                        result.find_ns);
+        ASSERT_TRUE(RunBenchmark<FixedLargeTable>(entries.get(), count, &result), "");
+        unittest_printf("%8zu %-10s %12" PRIu64 " %12" PRIu64 " %12" PRIu64 "\n",
+                        count, "fixed 4099", result.insert_ns, result.max_insert_ns,
+                        result.find_ns);
+        ASSERT_TRUE(RunBenchmark<ResizingTable>(entries.get(), count, &result), "");
+        unittest_printf("%8zu %-10s %12" PRIu64 " %12" PRIu64 " %12" PRIu64 "\n",
+                        count, "resizing", result.insert_ns, result.max_insert_ns,
+                        result.find_ns);
+    }
+
+    END_TEST;
+}
+BEGIN_TEST_CASE(resizing_hashtable_tests)
+//////////////////////////////////////////
+// General container specific tests.
+//////////////////////////////////////////
+RUN_NAMED_TEST("Clear (unmanaged)",            UMTE::ClearTest)
+RUN_NAMED_TEST("Clear (unique)",               UPTE::ClearTest)
+RUN_NAMED_TEST("Clear (RefPtr)",               RPTE::ClearTest)
+
+RUN_NAMED_TEST("ClearUnsafe (unmanaged)",      UMTE::ClearUnsafeTest)
+#if TEST_WILL_NOT_COMPILE || 0
+RUN_NAMED_TEST("ClearUnsafe (unique)",         UPTE::ClearUnsafeTest)
+RUN_NAMED_TEST("ClearUnsafe (RefPtr)",         RPTE::ClearUnsafeTest)
+#endif
+
+RUN_NAMED_TEST("IsEmpty (unmanaged)",          UMTE::IsEmptyTest)
+RUN_NAMED_TEST("IsEmpty (unique)",             UPTE::IsEmptyTest)
+RUN_NAMED_TEST("IsEmpty (RefPtr)",             RPTE::IsEmptyTest)
+
+RUN_NAMED_TEST("Iterate (unmanaged)",          UMTE::IterateTest)
+RUN_NAMED_TEST("Iterate (unique)",             UPTE::IterateTest)
+RUN_NAMED_TEST("Iterate (RefPtr)",             RPTE::IterateTest)
+
+RUN_NAMED_TEST("IterErase (unmanaged)",        UMTE::IterEraseTest)
+RUN_NAMED_TEST("IterErase (unique)",           UPTE::IterEraseTest)
+RUN_NAMED_TEST("IterErase (RefPtr)",           RPTE::IterEraseTest)
+
+RUN_NAMED_TEST("DirectErase (unmanaged)",      UMTE::DirectEraseTest)
+#if TEST_WILL_NOT_COMPILE || 0
+RUN_NAMED_TEST("DirectErase (unique)",         UPTE::DirectEraseTest)
+#endif
+RUN_NAMED_TEST("DirectErase (RefPtr)",         RPTE::DirectEraseTest)
+
+RUN_NAMED_TEST("MakeIterator (unmanaged)",     UMTE::MakeIteratorTest)
+#if TEST_WILL_NOT_COMPILE || 0
+RUN_NAMED_TEST("MakeIterator (unique)",        UPTE::MakeIteratorTest)
+#endif
+RUN_NAMED_TEST("MakeIterator (RefPtr)",        RPTE::MakeIteratorTest)
+
+RUN_NAMED_TEST("ReverseIterErase (unmanaged)", UMTE::ReverseIterEraseTest)
+RUN_NAMED_TEST("ReverseIterErase (unique)",    UPTE::ReverseIterEraseTest)
+RUN_NAMED_TEST("ReverseIterErase (RefPtr)",    RPTE::ReverseIterEraseTest)
+
+RUN_NAMED_TEST("ReverseIterate (unmanaged)",   UMTE::ReverseIterateTest)
+RUN_NAMED_TEST("ReverseIterate (unique)",      UPTE::ReverseIterateTest)
+RUN_NAMED_TEST("ReverseIterate (RefPtr)",      RPTE::ReverseIterateTest)
+
+// Hash tables do not support swapping or Rvalue operations (Assignment or
+// construction) as doing so would be an O(n) operation (With 'n' == to the
+// number of buckets in the hashtable)
+#if TEST_WILL_NOT_COMPILE || 0
+RUN_NAMED_TEST("Swap (unmanaged)",             UMTE::SwapTest)
+RUN_NAMED_TEST("Swap (unique)",                UPTE::SwapTest)
+RUN_NAMED_TEST("Swap (RefPtr)",                RPTE::SwapTest)
+
+RUN_NAMED_TEST("Rvalue Ops (unmanaged)",       UMTE::RvalueOpsTest)
+RUN_NAMED_TEST("Rvalue Ops (unique)",          UPTE::RvalueOpsTest)
+RUN_NAMED_TEST("Rvalue Ops (RefPtr)",          RPTE::RvalueOpsTest)
+#endif
+
+RUN_NAMED_TEST("Scope (unique)",               UPTE::ScopeTest)
+RUN_NAMED_TEST("Scope (RefPtr)",               RPTE::ScopeTest)
+
+RUN_NAMED_TEST("TwoContainer (unmanaged)",     UMTE::TwoContainerTest)
+#if TEST_WILL_NOT_COMPILE || 0
+RUN_NAMED_TEST("TwoContainer (unique)",        UPTE::TwoContainerTest)
+#endif
+RUN_NAMED_TEST("TwoContainer (RefPtr)",        RPTE::TwoContainerTest)
+
+RUN_NAMED_TEST("IterCopyPointer (unmanaged)",  UMTE::IterCopyPointerTest)
+#if TEST_WILL_NOT_COMPILE || 0
+RUN_NAMED_TEST("IterCopyPointer (unique)",     UPTE::IterCopyPointerTest)
+#endif
+RUN_NAMED_TEST("IterCopyPointer (RefPtr)",     RPTE::IterCopyPointerTest)
+
+RUN_NAMED_TEST("EraseIf (unmanaged)",          UMTE::EraseIfTest)
+RUN_NAMED_TEST("EraseIf (unique)",             UPTE::EraseIfTest)
+RUN_NAMED_TEST("EraseIf (RefPtr)",             RPTE::EraseIfTest)
+
+RUN_NAMED_TEST("FindIf (unmanaged)",           UMTE::FindIfTest)
+RUN_NAMED_TEST("FindIf (unique)",              UPTE::FindIfTest)
+RUN_NAMED_TEST("FindIf (RefPtr)",              RPTE::FindIfTest)
+
+//////////////////////////////////////////
+// Associative container specific tests.
+//////////////////////////////////////////
+RUN_NAMED_TEST("InsertByKey (unmanaged)",      UMTE::InsertByKeyTest)
+RUN_NAMED_TEST("InsertByKey (unique)",         UPTE::InsertByKeyTest)
+RUN_NAMED_TEST("InsertByKey (RefPtr)",         RPTE::InsertByKeyTest)
+
+RUN_NAMED_TEST("FindByKey (unmanaged)",        UMTE::FindByKeyTest)
+RUN_NAMED_TEST("FindByKey (unique)",           UPTE::FindByKeyTest)
+RUN_NAMED_TEST("FindByKey (RefPtr)",           RPTE::FindByKeyTest)
+
+RUN_NAMED_TEST("EraseByKey (unmanaged)",       UMTE::EraseByKeyTest)
+RUN_NAMED_TEST("EraseByKey (unique)",          UPTE::EraseByKeyTest)
+RUN_NAMED_TEST("EraseByKey (RefPtr)",          RPTE::EraseByKeyTest)
+
+RUN_NAMED_TEST("InsertOrFind (unmanaged)",     UMTE::InsertOrFindTest)
+RUN_NAMED_TEST("InsertOrFind (unique)",        UPTE::InsertOrFindTest)
+RUN_NAMED_TEST("InsertOrFind (RefPtr)",        RPTE::InsertOrFindTest)
+
+RUN_NAMED_TEST("InsertOrReplace (unmanaged)",  UMTE::InsertOrReplaceTest)
+RUN_NAMED_TEST("InsertOrReplace (unique)",     UPTE::InsertOrReplaceTest)
+RUN_NAMED_TEST("InsertOrReplace (RefPtr)",     RPTE::InsertOrReplaceTest)
+
+//////////////////////////////////////////
+// Resizing specific tests.
+//////////////////////////////////////////
+RUN_NAMED_TEST("GrowShrink",                   ResizingGrowShrinkTest)
+RUN_NAMED_TEST("MidRehash",                    ResizingMidRehashTest)
+RUN_TEST_PERFORMANCE(ResizingBenchmark)
+END_TEST_CASE(resizing_hashtable_tests);
+
+}  // namespace intrusive_containers
+}  // namespace tests
+}  // namespace fbl
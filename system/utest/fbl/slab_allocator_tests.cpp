@@ -2,7 +2,13 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <inttypes.h>
+#include <threads.h>
+#include <time.h>
+
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
+#include <fbl/atomic.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/ref_counted.h>
 #include <fbl/ref_ptr.h>
@@ -118,11 +124,13 @@ struct ReleaseHelper<SATraits, typename fbl::enable_if<
 
 // Traits which define the various test flavors.
 template <typename LockType,
-          fbl::SlabAllocatorFlavor AllocatorFlavor = fbl::SlabAllocatorFlavor::INSTANCED>
+          fbl::SlabAllocatorFlavor AllocatorFlavor = fbl::SlabAllocatorFlavor::INSTANCED,
+          size_t MagazineSize = 0>
 struct UnmanagedTestTraits {
     class ObjType;
     using PtrType       = ObjType*;
-    using AllocTraits   = fbl::SlabAllocatorTraits<PtrType, 1024, LockType, AllocatorFlavor>;
+    using AllocTraits   = fbl::SlabAllocatorTraits<PtrType, 1024, LockType, AllocatorFlavor,
+                                                    MagazineSize>;
     using AllocatorType = fbl::SlabAllocator<AllocTraits>;
     using RefList       = fbl::DoublyLinkedList<PtrType>;
 
@@ -141,11 +149,13 @@ struct UnmanagedTestTraits {
     static constexpr size_t MaxAllocs(size_t slabs) { return AllocatorType::AllocsPerSlab * slabs; }
 };
 
-template <typename LockType>
+template <typename LockType, size_t MagazineSize = 0>
 struct UniquePtrTestTraits {
     class ObjType;
     using PtrType       = fbl::unique_ptr<ObjType>;
-    using AllocTraits   = fbl::SlabAllocatorTraits<PtrType, 1024, LockType>;
+    using AllocTraits   = fbl::SlabAllocatorTraits<PtrType, 1024, LockType,
+                                                    fbl::SlabAllocatorFlavor::INSTANCED,
+                                                    MagazineSize>;
     using AllocatorType = fbl::SlabAllocator<AllocTraits>;
     using RefList       = fbl::DoublyLinkedList<PtrType>;
 
@@ -165,11 +175,13 @@ struct UniquePtrTestTraits {
     static constexpr size_t MaxAllocs(size_t slabs) { return AllocatorType::AllocsPerSlab * slabs; }
 };
 
-template <typename LockType>
+template <typename LockType, size_t MagazineSize = 0>
 struct RefPtrTestTraits {
     class ObjType;
     using PtrType       = fbl::RefPtr<ObjType>;
-    using AllocTraits   = fbl::SlabAllocatorTraits<PtrType, 1024, LockType>;
+    using AllocTraits   = fbl::SlabAllocatorTraits<PtrType, 1024, LockType,
+                                                    fbl::SlabAllocatorFlavor::INSTANCED,
+                                                    MagazineSize>;
     using AllocatorType = fbl::SlabAllocator<AllocTraits>;
     using RefList       = fbl::DoublyLinkedList<PtrType>;
 
@@ -271,11 +283,13 @@ bool slab_test() {
     END_TEST;
 }
 
-template <typename LockType>
+template <typename LockType, size_t MagazineSize = 0>
 struct StaticUnmanagedTestTraits {
     class ObjType;
     using PtrType       = ObjType*;
-    using AllocTraits   = fbl::StaticSlabAllocatorTraits<PtrType, 1024, LockType>;
+    using AllocTraits   = fbl::SlabAllocatorTraits<PtrType, 1024, LockType,
+                                                    fbl::SlabAllocatorFlavor::STATIC,
+                                                    MagazineSize>;
     using AllocatorType = fbl::SlabAllocator<AllocTraits>;
     using RefList       = fbl::DoublyLinkedList<PtrType>;
 
@@ -295,11 +309,13 @@ struct StaticUnmanagedTestTraits {
     static constexpr bool   IsManaged = false;
 };
 
-template <typename LockType>
+template <typename LockType, size_t MagazineSize = 0>
 struct StaticUniquePtrTestTraits {
     class ObjType;
     using PtrType       = fbl::unique_ptr<ObjType>;
-    using AllocTraits   = fbl::StaticSlabAllocatorTraits<PtrType, 1024, LockType>;
+    using AllocTraits   = fbl::SlabAllocatorTraits<PtrType, 1024, LockType,
+                                                    fbl::SlabAllocatorFlavor::STATIC,
+                                                    MagazineSize>;
     using AllocatorType = fbl::SlabAllocator<AllocTraits>;
     using RefList       = fbl::DoublyLinkedList<PtrType>;
 
@@ -319,11 +335,13 @@ struct StaticUniquePtrTestTraits {
     static constexpr bool   IsManaged = false;
 };
 
-template <typename LockType>
+template <typename LockType, size_t MagazineSize = 0>
 struct StaticRefPtrTestTraits {
     class ObjType;
     using PtrType       = fbl::RefPtr<ObjType>;
-    using AllocTraits   = fbl::StaticSlabAllocatorTraits<PtrType, 1024, LockType>;
+    using AllocTraits   = fbl::SlabAllocatorTraits<PtrType, 1024, LockType,
+                                                    fbl::SlabAllocatorFlavor::STATIC,
+                                                    MagazineSize>;
     using AllocatorType = fbl::SlabAllocator<AllocTraits>;
     using RefList       = fbl::DoublyLinkedList<PtrType>;
 
@@ -428,6 +446,153 @@ bool static_slab_test() {
 
     END_TEST;
 }
+
+// Allocates everything the allocator will hand out, frees it all, and returns
+// the number of objects which were allocated.
+template <typename Traits>
+int fill_and_free_thread(void* ctx) {
+    auto allocator = static_cast<typename Traits::AllocatorType*>(ctx);
+    typename Traits::RefList ref_list;
+    int count = 0;
+
+    while (true) {
+        auto ptr = allocator->New();
+        if (ptr == nullptr)
+            break;
+        ref_list.push_front(fbl::move(ptr));
+        ++count;
+    }
+
+    while (!ref_list.is_empty()) {
+        auto ptr = ref_list.pop_front();
+        ReleaseHelper<typename Traits::AllocTraits>::ReleasePtr(*allocator, ptr);
+    }
+
+    return count;
+}
+
+// Objects freed by one thread are cached in that thread's magazine.  Make sure
+// that other threads can still allocate the allocator's entire quota.
+template <typename Traits>
+bool magazine_steal_test() {
+    BEGIN_TEST;
+    typename Traits::AllocatorType allocator(Traits::MaxSlabs);
+    const int max_allocs = static_cast<int>(Traits::MaxAllocs(Traits::MaxSlabs));
+
+    TestBase::Reset();
+
+    for (size_t pass = 0; pass < 4; ++pass) {
+        thrd_t thread;
+        int count = 0;
+        ASSERT_EQ(thrd_success, thrd_create(&thread, fill_and_free_thread<Traits>, &allocator),
+                  "");
+        ASSERT_EQ(thrd_success, thrd_join(thread, &count), "");
+        EXPECT_EQ(max_allocs, count, "");
+        EXPECT_EQ(0u, TestBase::allocated_obj_count(), "");
+    }
+
+    EXPECT_EQ(max_allocs, fill_and_free_thread<Traits>(&allocator), "");
+
+    END_TEST;
+}
+
+// Multithreaded allocation benchmark comparing a locked allocator against one
+// with per-thread magazines.
+template <size_t MagazineSize>
+struct BenchTraits {
+    class ObjType;
+    using AllocTraits   = fbl::SlabAllocatorTraits<ObjType*,
+                                                    fbl::DEFAULT_SLAB_ALLOCATOR_SLAB_SIZE,
+                                                    fbl::Mutex,
+                                                    fbl::SlabAllocatorFlavor::INSTANCED,
+                                                    MagazineSize>;
+    using AllocatorType = fbl::SlabAllocator<AllocTraits>;
+
+    class ObjType : public fbl::SlabAllocated<AllocTraits> {
+    public:
+        uint64_t payload_[8];
+    };
+};
+
+static constexpr size_t kBenchBatch = 8;
+static constexpr size_t kBenchIterations = 50000;
+static constexpr size_t kBenchMaxThreads = 8;
+
+static uint64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+template <typename Traits>
+struct BenchArgs {
+    typename Traits::AllocatorType* allocator;
+    fbl::atomic<int>* go;
+    fbl::atomic<size_t>* failures;
+};
+
+template <typename Traits>
+int bench_thread(void* ctx) {
+    auto args = static_cast<BenchArgs<Traits>*>(ctx);
+    typename Traits::ObjType* objs[kBenchBatch];
+
+    while (!args->go->load())
+        thrd_yield();
+
+    for (size_t i = 0; i < kBenchIterations; ++i) {
+        for (auto& obj : objs) {
+            obj = args->allocator->New();
+            if (obj == nullptr)
+                args->failures->fetch_add(1);
+        }
+        for (auto obj : objs)
+            delete obj;
+    }
+
+    return 0;
+}
+
+// Returns the aggregate number of alloc/free pairs per microsecond.
+template <typename Traits>
+static bool run_bench(size_t thread_count, uint64_t* ops_per_us) {
+    BEGIN_HELPER;
+
+    typename Traits::AllocatorType allocator(64);
+    fbl::atomic<int> go(0);
+    fbl::atomic<size_t> failures(0);
+    BenchArgs<Traits> args = { &allocator, &go, &failures };
+    thrd_t threads[kBenchMaxThreads];
+
+    for (size_t i = 0; i < thread_count; ++i)
+        ASSERT_EQ(thrd_success, thrd_create(&threads[i], bench_thread<Traits>, &args), "");
+
+    uint64_t start = NowNs();
+    go.store(1);
+    for (size_t i = 0; i < thread_count; ++i)
+        ASSERT_EQ(thrd_success, thrd_join(threads[i], nullptr), "");
+    uint64_t elapsed = fbl::max<uint64_t>(NowNs() - start, 1);
+
+    EXPECT_EQ(0u, failures.load(), "");
+    *ops_per_us = (thread_count * kBenchIterations * kBenchBatch * 1000u) / elapsed;
+
+    END_HELPER;
+}
+
+static bool magazine_benchmark() {
+    BEGIN_TEST;
+
+    static const size_t kThreadCounts[] = { 1, 2, 4, kBenchMaxThreads };
+    unittest_printf("\n%8s %14s %14s\n", "threads", "locked ops/us", "cached ops/us");
+    for (size_t thread_count : kThreadCounts) {
+        uint64_t locked, cached;
+        ASSERT_TRUE(run_bench<BenchTraits<0>>(thread_count, &locked), "");
+        ASSERT_TRUE(run_bench<BenchTraits<fbl::DEFAULT_SLAB_ALLOCATOR_MAGAZINE_SIZE>>(
+                        thread_count, &cached), "");
+        unittest_printf("%8zu %14" PRIu64 " %14" PRIu64 "\n", thread_count, locked, cached);
+    }
+
+    END_TEST;
+}
 }  // anon namespace
 
 using MutexLock = ::fbl::Mutex;
@@ -441,6 +606,20 @@ DECLARE_STATIC_SLAB_ALLOCATOR_STORAGE(StaticUnmanagedTestTraits<NullLock>::Alloc
 DECLARE_STATIC_SLAB_ALLOCATOR_STORAGE(StaticUniquePtrTestTraits<NullLock>::AllocTraits, 1);
 DECLARE_STATIC_SLAB_ALLOCATOR_STORAGE(StaticRefPtrTestTraits<NullLock>::AllocTraits, 1);
 
+using CachedUnmanagedTestTraits =
+    UnmanagedTestTraits<MutexLock, fbl::SlabAllocatorFlavor::INSTANCED, 8>;
+using CachedManualDeleteTestTraits =
+    UnmanagedTestTraits<MutexLock, fbl::SlabAllocatorFlavor::MANUAL_DELETE, 8>;
+using CachedUniquePtrTestTraits       = UniquePtrTestTraits<MutexLock, 8>;
+using CachedRefPtrTestTraits          = RefPtrTestTraits<MutexLock, 8>;
+using CachedStaticUnmanagedTestTraits = StaticUnmanagedTestTraits<MutexLock, 8>;
+using CachedStaticUniquePtrTestTraits = StaticUniquePtrTestTraits<MutexLock, 8>;
+using CachedStaticRefPtrTestTraits    = StaticRefPtrTestTraits<MutexLock, 8>;
+
+DECLARE_STATIC_SLAB_ALLOCATOR_STORAGE(CachedStaticUnmanagedTestTraits::AllocTraits, 1);
+DECLARE_STATIC_SLAB_ALLOCATOR_STORAGE(CachedStaticUniquePtrTestTraits::AllocTraits, 1);
+DECLARE_STATIC_SLAB_ALLOCATOR_STORAGE(CachedStaticRefPtrTestTraits::AllocTraits, 1);
+
 BEGIN_TEST_CASE(slab_allocator_tests)
 RUN_NAMED_TEST("Unmanaged Single Slab (mutex)", (slab_test<UnmanagedTestTraits<MutexLock>, 1>))
 RUN_NAMED_TEST("Unmanaged Multi Slab  (mutex)", (slab_test<UnmanagedTestTraits<MutexLock>>))
@@ -472,4 +651,21 @@ RUN_NAMED_TEST("Static RefPtr    (mutex)", (static_slab_test<StaticRefPtrTestTra
 RUN_NAMED_TEST("Static Unmanaged (unlock)", (static_slab_test<StaticUnmanagedTestTraits<NullLock>>))
 RUN_NAMED_TEST("Static UniquePtr (unlock)", (static_slab_test<StaticUniquePtrTestTraits<NullLock>>))
 RUN_NAMED_TEST("Static RefPtr    (unlock)", (static_slab_test<StaticRefPtrTestTraits<NullLock>>))
+
+RUN_NAMED_TEST("Unmanaged Single Slab (magazines)", (slab_test<CachedUnmanagedTestTraits, 1>))
+RUN_NAMED_TEST("Unmanaged Multi Slab  (magazines)", (slab_test<CachedUnmanagedTestTraits>))
+RUN_NAMED_TEST("UniquePtr Single Slab (magazines)", (slab_test<CachedUniquePtrTestTraits, 1>))
+RUN_NAMED_TEST("UniquePtr Multi Slab  (magazines)", (slab_test<CachedUniquePtrTestTraits>))
+RUN_NAMED_TEST("RefPtr Single Slab    (magazines)", (slab_test<CachedRefPtrTestTraits, 1>))
+RUN_NAMED_TEST("RefPtr Multi Slab     (magazines)", (slab_test<CachedRefPtrTestTraits>))
+RUN_NAMED_TEST("Manual Delete Unmanaged (magazines)", (slab_test<CachedManualDeleteTestTraits>))
+
+RUN_NAMED_TEST("Static Unmanaged (magazines)", (static_slab_test<CachedStaticUnmanagedTestTraits>))
+RUN_NAMED_TEST("Static UniquePtr (magazines)", (static_slab_test<CachedStaticUniquePtrTestTraits>))
+RUN_NAMED_TEST("Static RefPtr    (magazines)", (static_slab_test<CachedStaticRefPtrTestTraits>))
+
+RUN_NAMED_TEST("Magazine Steal Unmanaged", (magazine_steal_test<CachedUnmanagedTestTraits>))
+RUN_NAMED_TEST("Magazine Steal UniquePtr", (magazine_steal_test<CachedUniquePtrTestTraits>))
+RUN_NAMED_TEST("Magazine Steal RefPtr",    (magazine_steal_test<CachedRefPtrTestTraits>))
+RUN_TEST_PERFORMANCE(magazine_benchmark)
 END_TEST_CASE(slab_allocator_tests);
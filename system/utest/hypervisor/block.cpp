@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <inttypes.h>
 #include <limits.h>
 #include <stdlib.h>
 #include <string.h>
@@ -14,6 +15,7 @@
 #include <unittest/unittest.h>
 #include <virtio/block.h>
 #include <virtio/virtio_ring.h>
+#include <zircon/syscalls.h>
 
 #define QUEUE_SIZE 8u
 #define DATA_SIZE 128u
@@ -536,6 +538,235 @@ static bool file_block_device_read_only(void) {
     END_TEST;
 }
 
+#define BATCH_REQUESTS 5u
+#define BATCH_QUEUE_SIZE 16u
+
+typedef struct batch_mem {
+    struct vring_desc desc[BATCH_QUEUE_SIZE];
+    uint8_t avail_buf[sizeof(struct vring_avail) + sizeof(uint16_t) * BATCH_QUEUE_SIZE];
+    uint8_t used_buf[sizeof(struct vring_used) +
+                     sizeof(struct vring_used_elem) * BATCH_QUEUE_SIZE];
+    virtio_blk_req_t req[BATCH_REQUESTS];
+    uint8_t status[BATCH_REQUESTS];
+    uint8_t data[4][VirtioBlock::kSectorSize];
+} batch_mem_t;
+
+static void set_batch_desc(batch_mem_t* mem, uint16_t i, uint64_t off, uint32_t len,
+                           uint16_t flags, uint16_t next) {
+    mem->desc[i] = {off, len, flags, next};
+}
+
+/* Queue up whole-sector writes to sectors 2, 0 and 1, in that order, so the
+ * batched path has to sort them into one run, then a write to sector 4 that
+ * must not join it, and a flush. Sector 1's data comes in two descriptors.
+ */
+static bool file_block_device_batched_write(void) {
+    BEGIN_TEST;
+
+    constexpr uint32_t kHalf = VirtioBlock::kSectorSize / 2;
+
+    char path[] = "/tmp/file-block-device-batched-write.XXXXXX";
+    int fd = mkblk(path);
+    ASSERT_GE(fd, 0);
+
+    fbl::unique_ptr<batch_mem_t> mem(new batch_mem_t);
+    memset(mem.get(), 0, sizeof(batch_mem_t));
+    auto block = fbl::make_unique<VirtioBlock>((uintptr_t)mem.get(), sizeof(batch_mem_t));
+    ASSERT_EQ(block->Init(path), ZX_OK);
+
+    virtio_queue_t* queue = &block->queue();
+    queue->size = BATCH_QUEUE_SIZE;
+    queue->desc = mem->desc;
+    queue->avail = (struct vring_avail*)mem->avail_buf;
+    queue->used = (struct vring_used*)mem->used_buf;
+
+    // The data for sectors 0 to 2 is laid out in order in guest memory, so
+    // once sorted the run is contiguous on both sides.
+    memset(mem->data[0], 0xa0, VirtioBlock::kSectorSize);
+    memset(mem->data[1], 0xb1, kHalf);
+    memset(mem->data[1] + kHalf, 0xc1, kHalf);
+    memset(mem->data[2], 0xa2, VirtioBlock::kSectorSize);
+    memset(mem->data[3], 0xa4, VirtioBlock::kSectorSize);
+    memset(mem->status, UINT8_MAX, sizeof(mem->status));
+
+    // Request 0 (descriptors 0-2) writes sector 2.
+    mem->req[0] = {VIRTIO_BLK_T_OUT, 0, 2};
+    set_batch_desc(mem.get(), 0, offsetof(batch_mem_t, req[0]), sizeof(virtio_blk_req_t),
+                   VRING_DESC_F_NEXT, 1);
+    set_batch_desc(mem.get(), 1, offsetof(batch_mem_t, data[2]), VirtioBlock::kSectorSize,
+                   VRING_DESC_F_NEXT, 2);
+    set_batch_desc(mem.get(), 2, offsetof(batch_mem_t, status[0]), sizeof(uint8_t),
+                   VRING_DESC_F_WRITE, 0);
+    queue->avail->ring[0] = 0;
+
+    // Request 1 (descriptors 3-5) writes sector 0.
+    mem->req[1] = {VIRTIO_BLK_T_OUT, 0, 0};
+    set_batch_desc(mem.get(), 3, offsetof(batch_mem_t, req[1]), sizeof(virtio_blk_req_t),
+                   VRING_DESC_F_NEXT, 4);
+    set_batch_desc(mem.get(), 4, offsetof(batch_mem_t, data[0]), VirtioBlock::kSectorSize,
+                   VRING_DESC_F_NEXT, 5);
+    set_batch_desc(mem.get(), 5, offsetof(batch_mem_t, status[1]), sizeof(uint8_t),
+                   VRING_DESC_F_WRITE, 0);
+    queue->avail->ring[1] = 3;
+
+    // Request 2 (descriptors 6-9) writes sector 1 from two halves.
+    mem->req[2] = {VIRTIO_BLK_T_OUT, 0, 1};
+    set_batch_desc(mem.get(), 6, offsetof(batch_mem_t, req[2]), sizeof(virtio_blk_req_t),
+                   VRING_DESC_F_NEXT, 7);
+    set_batch_desc(mem.get(), 7, offsetof(batch_mem_t, data[1]), kHalf, VRING_DESC_F_NEXT, 8);
+    set_batch_desc(mem.get(), 8, offsetof(batch_mem_t, data[1]) + kHalf, kHalf,
+                   VRING_DESC_F_NEXT, 9);
+    set_batch_desc(mem.get(), 9, offsetof(batch_mem_t, status[2]), sizeof(uint8_t),
+                   VRING_DESC_F_WRITE, 0);
+    queue->avail->ring[2] = 6;
+
+    // Request 3 (descriptors 10-12) writes sector 4, leaving a gap at 3.
+    mem->req[3] = {VIRTIO_BLK_T_OUT, 0, 4};
+    set_batch_desc(mem.get(), 10, offsetof(batch_mem_t, req[3]), sizeof(virtio_blk_req_t),
+                   VRING_DESC_F_NEXT, 11);
+    set_batch_desc(mem.get(), 11, offsetof(batch_mem_t, data[3]), VirtioBlock::kSectorSize,
+                   VRING_DESC_F_NEXT, 12);
+    set_batch_desc(mem.get(), 12, offsetof(batch_mem_t, status[3]), sizeof(uint8_t),
+                   VRING_DESC_F_WRITE, 0);
+    queue->avail->ring[3] = 10;
+
+    // Request 4 (descriptors 13,14) flushes.
+    mem->req[4] = {VIRTIO_BLK_T_FLUSH, 0, 0};
+    set_batch_desc(mem.get(), 13, offsetof(batch_mem_t, req[4]), sizeof(virtio_blk_req_t),
+                   VRING_DESC_F_NEXT, 14);
+    set_batch_desc(mem.get(), 14, offsetof(batch_mem_t, status[4]), sizeof(uint8_t),
+                   VRING_DESC_F_WRITE, 0);
+    queue->avail->ring[4] = 13;
+
+    queue->avail->idx = BATCH_REQUESTS;
+    ASSERT_EQ(block->FileBlockDeviceBatched(), ZX_OK);
+
+    // Everything comes back in the order it was queued.
+    const uint16_t heads[BATCH_REQUESTS] = {0, 3, 6, 10, 13};
+    ASSERT_EQ(queue->used->idx, BATCH_REQUESTS);
+    for (uint32_t i = 0; i < BATCH_REQUESTS; ++i) {
+        ASSERT_EQ(queue->used->ring[i].id, heads[i]);
+        ASSERT_EQ(queue->used->ring[i].len, i < 4 ? static_cast<uint32_t>(VirtioBlock::kSectorSize) : 0u);
+        ASSERT_EQ(mem->status[i], VIRTIO_BLK_S_OK);
+    }
+
+    // Each sector holds what was written to it, and the gap is untouched.
+    uint8_t actual[VirtioBlock::kSectorSize * 5];
+    uint8_t expected[VirtioBlock::kSectorSize * 5];
+    memset(expected, 0, sizeof(expected));
+    memcpy(expected, mem->data[0], VirtioBlock::kSectorSize);
+    memcpy(expected + VirtioBlock::kSectorSize, mem->data[1], VirtioBlock::kSectorSize);
+    memcpy(expected + VirtioBlock::kSectorSize * 2, mem->data[2], VirtioBlock::kSectorSize);
+    memcpy(expected + VirtioBlock::kSectorSize * 4, mem->data[3], VirtioBlock::kSectorSize);
+    ASSERT_EQ(pread(fd, actual, sizeof(actual), 0), static_cast<ssize_t>(sizeof(actual)));
+    ASSERT_EQ(memcmp(actual, expected, sizeof(actual)), 0);
+
+    // A flush with a non-zero sector fails.
+    mem->req[4].sector = 1;
+    queue->avail->ring[5] = 13;
+    queue->avail->idx = BATCH_REQUESTS + 1;
+    ASSERT_EQ(block->FileBlockDeviceBatched(), ZX_OK);
+    ASSERT_EQ(queue->used->idx, BATCH_REQUESTS + 1);
+    ASSERT_EQ(queue->used->ring[5].id, 13u);
+    ASSERT_EQ(mem->status[4], VIRTIO_BLK_S_IOERR);
+
+    END_TEST;
+}
+
+/* Requests with a bad header are returned to the used ring unprocessed,
+ * rather than left for the guest to wait on forever.
+ */
+static bool file_block_device_batched_bad_header(void) {
+    BEGIN_TEST;
+
+    char path[] = "/tmp/file-block-device-batched-bad-header.XXXXXX";
+    ASSERT_GE(mkblk(path), 0);
+
+    virtio_mem_t mem;
+    fbl::unique_ptr<VirtioBlock> block;
+    setup_block(path, &mem, &block);
+    block->queue().avail->idx = 1;
+
+    set_desc(&mem, 0, sizeof(virtio_mem_t), 1, 0);
+    ASSERT_EQ(block->FileBlockDeviceBatched(), ZX_OK);
+    ASSERT_EQ(block->queue().used->idx, 1u);
+    ASSERT_EQ(block->queue().used->ring[0].len, 0u);
+
+    END_TEST;
+}
+
+#define BENCH_REQUESTS 32u
+#define BENCH_QUEUE_SIZE (BENCH_REQUESTS * 4)
+#define BENCH_DATA_SIZE 4096u
+
+typedef struct bench_mem {
+    struct vring_desc desc[BENCH_QUEUE_SIZE];
+    uint8_t avail_buf[sizeof(struct vring_avail) + sizeof(uint16_t) * BENCH_QUEUE_SIZE];
+    uint8_t used_buf[sizeof(struct vring_used) +
+                     sizeof(struct vring_used_elem) * BENCH_QUEUE_SIZE];
+    virtio_blk_req_t req[BENCH_REQUESTS];
+    uint8_t status[BENCH_REQUESTS];
+    uint8_t data[BENCH_REQUESTS][BENCH_DATA_SIZE];
+} bench_mem_t;
+
+/* Fill the ring with sequential reads, the way a guest reading a large file
+ * would, and time how long each way of handling them takes.
+ */
+static bool file_block_device_benchmark(void) {
+    BEGIN_TEST;
+
+    constexpr uint32_t kIterations = 100u;
+
+    char path[] = "/tmp/file-block-device-benchmark.XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(ftruncate(fd, BENCH_REQUESTS * BENCH_DATA_SIZE), 0);
+
+    fbl::unique_ptr<bench_mem_t> mem(new bench_mem_t);
+    memset(mem.get(), 0, sizeof(bench_mem_t));
+    auto block = fbl::make_unique<VirtioBlock>((uintptr_t)mem.get(), sizeof(bench_mem_t));
+    ASSERT_EQ(block->Init(path), ZX_OK);
+
+    virtio_queue_t* queue = &block->queue();
+    queue->size = BENCH_QUEUE_SIZE;
+    queue->desc = mem->desc;
+    queue->avail = (struct vring_avail*)mem->avail_buf;
+    queue->used = (struct vring_used*)mem->used_buf;
+
+    for (uint16_t i = 0; i < BENCH_REQUESTS; ++i) {
+        uint16_t d = static_cast<uint16_t>(i * 3);
+        mem->req[i].type = VIRTIO_BLK_T_IN;
+        mem->req[i].sector = i * (BENCH_DATA_SIZE / VirtioBlock::kSectorSize);
+        mem->desc[d] = {offsetof(bench_mem_t, req[i]), sizeof(virtio_blk_req_t),
+                        VRING_DESC_F_NEXT, static_cast<uint16_t>(d + 1)};
+        mem->desc[d + 1] = {offsetof(bench_mem_t, data[i]), BENCH_DATA_SIZE,
+                            VRING_DESC_F_NEXT | VRING_DESC_F_WRITE, static_cast<uint16_t>(d + 2)};
+        mem->desc[d + 2] = {offsetof(bench_mem_t, status[i]), sizeof(uint8_t),
+                            VRING_DESC_F_WRITE, 0};
+        queue->avail->ring[i] = d;
+    }
+
+    for (int batched = 0; batched <= 1; ++batched) {
+        zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+        for (uint32_t i = 0; i < kIterations; ++i) {
+            queue->index = 0;
+            queue->avail->idx = BENCH_REQUESTS;
+            queue->used->idx = 0;
+            zx_status_t status = batched ? block->FileBlockDeviceBatched()
+                                         : block->FileBlockDevice();
+            ASSERT_EQ(status, ZX_OK);
+            ASSERT_EQ(queue->used->idx, BENCH_REQUESTS);
+        }
+        zx_time_t elapsed = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+        unittest_printf("\n    %s: %u requests in %" PRIu64 " us",
+                        batched ? "batched" : "single", BENCH_REQUESTS * kIterations,
+                        elapsed / 1000);
+    }
+    unittest_printf("\n");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(block)
 RUN_TEST(file_block_device_empty_queue)
 RUN_TEST(file_block_device_bad_ring)
@@ -552,4 +783,7 @@ RUN_TEST(file_block_device_flush)
 RUN_TEST(file_block_device_flush_data)
 RUN_TEST(file_block_device_multiple_descriptors)
 RUN_TEST(file_block_device_read_only)
+RUN_TEST(file_block_device_batched_write)
+RUN_TEST(file_block_device_batched_bad_header)
+RUN_TEST_PERFORMANCE(file_block_device_benchmark)
 END_TEST_CASE(block)
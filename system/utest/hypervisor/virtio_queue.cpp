@@ -0,0 +1,271 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <inttypes.h>
+#include <string.h>
+
+#include <fbl/atomic.h>
+#include <fbl/unique_ptr.h>
+#include <hypervisor/virtio.h>
+#include <unittest/unittest.h>
+#include <virtio/virtio_ring.h>
+#include <zircon/syscalls.h>
+
+#define QUEUE_SIZE 16u
+
+typedef struct virtio_mem {
+    struct vring_desc desc[QUEUE_SIZE];
+    uint8_t avail_buf[sizeof(struct vring_avail) + sizeof(uint16_t) * QUEUE_SIZE];
+    uint16_t used_event;
+    uint8_t used_buf[sizeof(struct vring_used) + sizeof(struct vring_used_elem) * QUEUE_SIZE];
+    uint16_t avail_event;
+} virtio_mem_t;
+
+// A device with a single queue that counts the interrupts it would have sent
+// to the guest, rather than sending them.
+class TestDevice : public VirtioDevice {
+public:
+    TestDevice(virtio_mem_t* mem)
+        : VirtioDevice(0, nullptr, 0, &queue_, 1, (uintptr_t)mem, sizeof(*mem)) {
+        memset(mem, 0, sizeof(*mem));
+        queue_.desc = mem->desc;
+        queue_.avail = (struct vring_avail*)mem->avail_buf;
+        queue_.used_event = &mem->used_event;
+        queue_.used = (struct vring_used*)mem->used_buf;
+        queue_.avail_event = &mem->avail_event;
+    }
+
+    virtio_queue_t& queue() { return queue_; }
+    uint32_t interrupts() { return interrupts_.load(); }
+
+    zx_status_t SetDriverFeatures(uint32_t features) {
+        zx_vcpu_io_t io = {};
+        io.access_size = 4;
+        io.u32 = features;
+        return pci_device().WriteBar(0, VIRTIO_PCI_COMMON_CFG_DRIVER_FEATURES, &io);
+    }
+
+    // Returns |count| descriptors and notifies the guest, either all at once
+    // or one by one.
+    zx_status_t Return(uint16_t count, bool batch) {
+        if (batch) {
+            vring_used_elem elems[QUEUE_SIZE];
+            for (uint16_t i = 0; i < count; ++i)
+                elems[i] = {i, 0};
+            virtio_queue_return_many(&queue_, elems, count);
+            return NotifyGuest();
+        }
+        for (uint16_t i = 0; i < count; ++i) {
+            virtio_queue_return(&queue_, i, 0);
+            zx_status_t status = NotifyGuest();
+            if (status != ZX_OK)
+                return status;
+        }
+        return ZX_OK;
+    }
+
+    // Reads the ISR register the way the driver does on an interrupt, which
+    // clears it.
+    void AckInterrupt() {
+        zx_vcpu_io_t io;
+        pci_device().ReadBar(0, kIsrPort, 1, &io);
+    }
+
+protected:
+    zx_status_t Interrupt() override {
+        interrupts_.fetch_add(1);
+        return ZX_OK;
+    }
+
+private:
+    // Offset of the ISR register in the BAR, following the notification
+    // configuration.
+    static const uint16_t kIsrPort = 0x3a;
+
+    virtio_queue_t queue_;
+    // Incremented by the coalescing thread as well as the test.
+    fbl::atomic<uint32_t> interrupts_{0};
+};
+
+static bool queue_used_event(void) {
+    BEGIN_TEST;
+
+    virtio_mem_t mem;
+    TestDevice device(&mem);
+    ASSERT_EQ(device.SetDriverFeatures(1u << VIRTIO_RING_F_EVENT_IDX), ZX_OK);
+
+    // The driver wants to hear about the 4th used buffer, so returning the
+    // first three must not interrupt it.
+    mem.used_event = 3;
+    ASSERT_EQ(device.Return(3, false), ZX_OK);
+    EXPECT_EQ(device.interrupts(), 0u);
+    EXPECT_EQ(device.queue().used->idx, 3u);
+
+    ASSERT_EQ(device.Return(1, false), ZX_OK);
+    EXPECT_EQ(device.interrupts(), 1u);
+    device.AckInterrupt();
+
+    // A batch that crosses the event index sends a single interrupt.
+    mem.used_event = 6;
+    ASSERT_EQ(device.Return(4, true), ZX_OK);
+    EXPECT_EQ(device.interrupts(), 2u);
+    EXPECT_EQ(device.queue().used->idx, 8u);
+
+    END_TEST;
+}
+
+static bool queue_used_event_unacked(void) {
+    BEGIN_TEST;
+
+    virtio_mem_t mem;
+    TestDevice device(&mem);
+    ASSERT_EQ(device.SetDriverFeatures(1u << VIRTIO_RING_F_EVENT_IDX), ZX_OK);
+
+    mem.used_event = 0;
+    ASSERT_EQ(device.Return(1, false), ZX_OK);
+    EXPECT_EQ(device.interrupts(), 1u);
+
+    // The driver hasn't read the ISR yet, but it hasn't asked to hear about
+    // these buffers either, so they must not interrupt it again.
+    ASSERT_EQ(device.Return(3, false), ZX_OK);
+    EXPECT_EQ(device.interrupts(), 1u);
+
+    mem.used_event = 4;
+    ASSERT_EQ(device.Return(1, false), ZX_OK);
+    EXPECT_EQ(device.interrupts(), 2u);
+
+    END_TEST;
+}
+
+static bool queue_avail_event(void) {
+    BEGIN_TEST;
+
+    virtio_mem_t mem;
+    TestDevice device(&mem);
+    virtio_queue_t* queue = &device.queue();
+    ASSERT_EQ(device.SetDriverFeatures(1u << VIRTIO_RING_F_EVENT_IDX), ZX_OK);
+
+    queue->avail->idx = 2;
+    queue->avail->ring[0] = 5;
+    queue->avail->ring[1] = 6;
+    mem.avail_event = 0xffff;
+
+    // While there are buffers left the driver is not asked to notify us.
+    uint16_t head;
+    ASSERT_EQ(virtio_queue_next_avail(queue, &head), ZX_OK);
+    EXPECT_EQ(head, 5u);
+    ASSERT_EQ(virtio_queue_next_avail(queue, &head), ZX_OK);
+    EXPECT_EQ(head, 6u);
+    EXPECT_EQ(mem.avail_event, 0xffff);
+
+    // Once the ring is empty, it is asked to notify us of the next one.
+    EXPECT_EQ(virtio_queue_next_avail(queue, &head), ZX_ERR_NOT_FOUND);
+    EXPECT_EQ(mem.avail_event, 2u);
+
+    END_TEST;
+}
+
+static bool queue_no_interrupt(void) {
+    BEGIN_TEST;
+
+    virtio_mem_t mem;
+    TestDevice device(&mem);
+
+    // Without VIRTIO_F_EVENT_IDX the driver can only turn interrupts off.
+    mem.used_event = 10;
+    device.queue().avail->flags = VRING_AVAIL_F_NO_INTERRUPT;
+    ASSERT_EQ(device.Return(4, false), ZX_OK);
+    EXPECT_EQ(device.interrupts(), 0u);
+
+    device.queue().avail->flags = 0;
+    ASSERT_EQ(device.Return(1, false), ZX_OK);
+    EXPECT_EQ(device.interrupts(), 1u);
+
+    END_TEST;
+}
+
+static bool queue_coalesce_count(void) {
+    BEGIN_TEST;
+
+    virtio_mem_t mem;
+    TestDevice device(&mem);
+    ASSERT_EQ(device.SetInterruptCoalescing(4, ZX_SEC(60)), ZX_OK);
+
+    ASSERT_EQ(device.Return(3, false), ZX_OK);
+    EXPECT_EQ(device.interrupts(), 0u);
+    ASSERT_EQ(device.Return(1, false), ZX_OK);
+    EXPECT_EQ(device.interrupts(), 1u);
+    device.AckInterrupt();
+
+    // Turning coalescing off sends what is being held back.
+    ASSERT_EQ(device.Return(2, false), ZX_OK);
+    EXPECT_EQ(device.interrupts(), 1u);
+    ASSERT_EQ(device.SetInterruptCoalescing(0, 0), ZX_OK);
+    EXPECT_EQ(device.interrupts(), 2u);
+
+    EXPECT_EQ(device.SetInterruptCoalescing(2, 0), ZX_ERR_INVALID_ARGS);
+
+    END_TEST;
+}
+
+static bool queue_coalesce_delay(void) {
+    BEGIN_TEST;
+
+    virtio_mem_t mem;
+    TestDevice device(&mem);
+    ASSERT_EQ(device.SetInterruptCoalescing(QUEUE_SIZE, ZX_MSEC(1)), ZX_OK);
+
+    ASSERT_EQ(device.Return(1, false), ZX_OK);
+    EXPECT_EQ(device.interrupts(), 0u);
+
+    // The held back interrupt is sent once the delay passes.
+    zx_time_t deadline = zx_deadline_after(ZX_SEC(5));
+    while (device.interrupts() == 0 && zx_time_get(ZX_CLOCK_MONOTONIC) < deadline)
+        zx_nanosleep(zx_deadline_after(ZX_MSEC(1)));
+    EXPECT_EQ(device.interrupts(), 1u);
+
+    END_TEST;
+}
+
+static bool queue_return_benchmark(void) {
+    BEGIN_TEST;
+
+    static const uint32_t kRounds = 10000;
+    static const uint16_t kBatch = QUEUE_SIZE;
+
+    for (int batch = 0; batch <= 1; ++batch) {
+        virtio_mem_t mem;
+        TestDevice device(&mem);
+        ASSERT_EQ(device.SetDriverFeatures(1u << VIRTIO_RING_F_EVENT_IDX), ZX_OK);
+
+        zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+        for (uint32_t i = 0; i < kRounds; ++i) {
+            // Like a driver that has gone back to sleep, ask to hear about
+            // the next used buffer.
+            mem.used_event = device.queue().used->idx;
+            ASSERT_EQ(device.Return(kBatch, batch), ZX_OK);
+            device.AckInterrupt();
+        }
+        zx_time_t elapsed = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+        uint64_t buffers = static_cast<uint64_t>(kRounds) * kBatch;
+        unittest_printf("\n    %s: %" PRIu64 " buffers in %" PRIu64 " us"
+                        " (%" PRIu64 " ns each), %u interrupts",
+                        batch ? "batched" : "one at a time", buffers,
+                        elapsed / 1000, elapsed / buffers, device.interrupts());
+        EXPECT_EQ(device.interrupts(), kRounds);
+    }
+    unittest_printf("\n");
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(virtio_queue)
+RUN_TEST(queue_used_event)
+RUN_TEST(queue_used_event_unacked)
+RUN_TEST(queue_avail_event)
+RUN_TEST(queue_no_interrupt)
+RUN_TEST(queue_coalesce_count)
+RUN_TEST(queue_coalesce_delay)
+RUN_TEST_PERFORMANCE(queue_return_benchmark)
+END_TEST_CASE(virtio_queue)
@@ -0,0 +1,156 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <inet-checksum/checksum.h>
+#include <unittest/unittest.h>
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// The straightforward 16 bits at a time sum, to check against.
+static uint16_t reference_sum(const void* data, size_t len, uint16_t initial) {
+    const uint8_t* p = data;
+    uint64_t sum = initial;
+    for (; len > 1; len -= 2, p += 2) {
+        uint16_t w;
+        memcpy(&w, p, sizeof(w));
+        sum += w;
+    }
+    if (len) {
+        uint8_t last[2] = { *p, 0 };
+        uint16_t w;
+        memcpy(&w, last, sizeof(w));
+        sum += w;
+    }
+    while (sum > 0xffff) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return (uint16_t)sum;
+}
+
+// 0 and 0xffff are both zero in ones' complement.
+static bool same_sum(uint16_t a, uint16_t b) {
+    return (a == b) || ((a == 0 || a == 0xffff) && (b == 0 || b == 0xffff));
+}
+
+static uint8_t* random_buffer(size_t len) {
+    uint8_t* buf = malloc(len);
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)rand();
+    }
+    return buf;
+}
+
+static bool rfc1071_example(void) {
+    BEGIN_TEST;
+    // From section 3 of RFC 1071.
+    const uint8_t data[] = { 0x00, 0x01, 0xf2, 0x03, 0xf4, 0xf5, 0xf6, 0xf7 };
+    uint16_t sum = inet_checksum_partial(data, sizeof(data), 0);
+    uint8_t bytes[2];
+    memcpy(bytes, &sum, sizeof(bytes));
+    EXPECT_EQ(0xdd, bytes[0], "");
+    EXPECT_EQ(0xf2, bytes[1], "");
+
+    uint16_t csum = inet_checksum(data, sizeof(data), 0);
+    EXPECT_EQ((uint16_t)~sum, csum, "");
+    END_TEST;
+}
+
+static bool matches_reference(void) {
+    BEGIN_TEST;
+    const size_t kMaxLen = 1100;
+    uint8_t* buf = random_buffer(kMaxLen + 16);
+    // every length and alignment up to past the 64-byte blocks
+    for (size_t offset = 0; offset < 16; offset++) {
+        for (size_t len = 0; len <= kMaxLen; len++) {
+            uint16_t initial = (uint16_t)(len * 0x9e37);
+            uint16_t expected = reference_sum(buf + offset, len, initial);
+            uint16_t actual = inet_checksum_partial(buf + offset, len, initial);
+            if (!same_sum(expected, actual)) {
+                unittest_printf("offset %zu len %zu: expected %#x got %#x\n",
+                                offset, len, expected, actual);
+                EXPECT_TRUE(false, "sum mismatch");
+            }
+        }
+    }
+    free(buf);
+    END_TEST;
+}
+
+static bool all_ones(void) {
+    BEGIN_TEST;
+    // the most carries: every word is 0xffff
+    const size_t kLen = 1 << 20;
+    uint8_t* buf = malloc(kLen);
+    memset(buf, 0xff, kLen);
+    EXPECT_EQ(0xffff, inet_checksum_partial(buf, kLen, 0xffff), "");
+    EXPECT_TRUE(same_sum(reference_sum(buf, kLen - 1, 0),
+                         inet_checksum_partial(buf, kLen - 1, 0)), "");
+    free(buf);
+    END_TEST;
+}
+
+static bool chained(void) {
+    BEGIN_TEST;
+    const size_t kLen = 1500;
+    uint8_t* buf = random_buffer(kLen);
+    uint16_t whole = inet_checksum_partial(buf, kLen, 0);
+    // split at every even offset, as for a pseudo-header and payload
+    for (size_t split = 0; split <= kLen; split += 2) {
+        uint16_t sum = inet_checksum_partial(buf, split, 0);
+        sum = inet_checksum_partial(buf + split, kLen - split, sum);
+        EXPECT_TRUE(same_sum(whole, sum), "");
+    }
+    free(buf);
+    END_TEST;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static bool throughput(void) {
+    BEGIN_TEST;
+    static const size_t kSizes[] = { 64, 576, 1500, 9000, 65536 };
+    const size_t kBytesPerRun = 256 << 20;
+    uint8_t* buf = random_buffer(65536);
+
+    unittest_printf("\n%8s %12s %12s\n", "bytes", "MB/s", "16-bit MB/s");
+    for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); i++) {
+        size_t len = kSizes[i];
+        size_t iters = kBytesPerRun / len;
+        // keep the compiler from dropping the calls
+        volatile uint16_t sink = 0;
+
+        uint64_t start = now_ns();
+        for (size_t n = 0; n < iters; n++) {
+            sink = inet_checksum_partial(buf, len, sink);
+        }
+        uint64_t fast = now_ns() - start;
+
+        start = now_ns();
+        for (size_t n = 0; n < iters; n++) {
+            sink = reference_sum(buf, len, sink);
+        }
+        uint64_t slow = now_ns() - start;
+
+        unittest_printf("%8zu %12" PRIu64 " %12" PRIu64 "\n", len,
+                        (uint64_t)kBytesPerRun * 1000 / fast, (uint64_t)kBytesPerRun * 1000 / slow);
+    }
+    free(buf);
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(inet_checksum_tests)
+RUN_TEST(rfc1071_example)
+RUN_TEST(matches_reference)
+RUN_TEST(all_ones)
+RUN_TEST(chained)
+RUN_TEST_PERFORMANCE(throughput)
+END_TEST_CASE(inet_checksum_tests)
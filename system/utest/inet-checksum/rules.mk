@@ -0,0 +1,54 @@
+# Copyright 2017 The Fuchsia Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+checksum_tests := \
+    $(LOCAL_DIR)/main.c \
+    $(LOCAL_DIR)/checksum-tests.c
+
+# Userspace tests.
+
+MODULE := $(LOCAL_DIR)
+
+MODULE_TYPE := usertest
+
+MODULE_SRCS := $(checksum_tests)
+
+MODULE_NAME := inet-checksum-test
+
+MODULE_STATIC_LIBS := \
+    system/ulib/inet-checksum
+
+MODULE_LIBS := \
+    system/ulib/c \
+    system/ulib/fdio \
+    system/ulib/unittest
+
+include make/module.mk
+
+# Host tests.
+
+MODULE := $(LOCAL_DIR).hostapp
+
+MODULE_TYPE := hostapp
+
+MODULE_SRCS := $(checksum_tests)
+
+MODULE_NAME := inet-checksum-test
+
+MODULE_HOST_LIBS := \
+    system/ulib/inet-checksum.hostlib \
+    system/ulib/unittest.hostlib \
+    system/ulib/pretty.hostlib
+
+MODULE_COMPILEFLAGS := \
+    -Isystem/ulib/inet-checksum/include \
+    -Isystem/ulib/unittest/include \
+
+include make/module.mk
+
+# Clear out local variables.
+
+checksum_tests :=
@@ -9,12 +9,14 @@
 #include <elfload/elfload.h>
 
 #include <launchpad/launchpad.h>
+#include <launchpad/loader-service.h>
 #include <launchpad/vmo.h>
 
 #include <zircon/process.h>
 #include <zircon/processargs.h>
 #include <zircon/syscalls.h>
 #include <zircon/syscalls/object.h>
+#include <inttypes.h>
 #include <limits.h>
 
 #include <fdio/util.h>
@@ -125,9 +127,75 @@ static bool argument_size_test(void) {
     return ok;
 }
 
+static bool spawn_one(loader_service_t* svc, zx_time_t* elapsed) {
+    BEGIN_HELPER;
+
+    zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+
+    launchpad_t* lp;
+    ASSERT_EQ(launchpad_create(ZX_HANDLE_INVALID, "spawn benchmark", &lp),
+              ZX_OK, "");
+    zx_handle_t loader;
+    ASSERT_EQ(loader_service_connect(svc, &loader), ZX_OK, "");
+    zx_handle_close(launchpad_use_loader_service(lp, loader));
+
+    const char* const argv[] = { "/boot/bin/sh", "-c", ":" };
+    EXPECT_EQ(launchpad_set_args(lp, countof(argv), argv), ZX_OK, "");
+    EXPECT_EQ(launchpad_load_from_file(lp, argv[0]), ZX_OK, "");
+
+    zx_handle_t proc = ZX_HANDLE_INVALID;
+    const char* errmsg = "???";
+    ASSERT_EQ(launchpad_go(lp, &proc, &errmsg), ZX_OK, errmsg);
+    EXPECT_EQ(zx_object_wait_one(proc, ZX_PROCESS_TERMINATED,
+                                 ZX_TIME_INFINITE, NULL), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(proc), ZX_OK, "");
+
+    *elapsed = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+
+    END_HELPER;
+}
+
+// Measures process spawn latency (launch through exit) of a small
+// dynamically-linked program served by a fresh filesystem loader service.
+// The first spawn populates the loader's library cache; the rest should
+// be served from it.
+static bool spawn_latency_benchmark(void) {
+    BEGIN_TEST;
+
+    static const int kIterations = 50;
+
+    loader_service_t* svc;
+    ASSERT_EQ(loader_service_create_fs("spawn-bench-loader", &svc), ZX_OK, "");
+
+    zx_time_t first;
+    ASSERT_TRUE(spawn_one(svc, &first), "");
+
+    zx_time_t total = 0;
+    zx_time_t min = ZX_TIME_INFINITE;
+    zx_time_t max = 0;
+    for (int i = 0; i < kIterations; ++i) {
+        zx_time_t elapsed;
+        ASSERT_TRUE(spawn_one(svc, &elapsed), "");
+        total += elapsed;
+        if (elapsed < min)
+            min = elapsed;
+        if (elapsed > max)
+            max = elapsed;
+    }
+
+    unittest_printf_critical(
+        "\n    spawn latency: first %" PRIu64 " us,"
+        " then avg %" PRIu64 " us (min %" PRIu64 ", max %" PRIu64 ") over %d\n",
+        first / 1000, total / kIterations / 1000, min / 1000, max / 1000,
+        kIterations);
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(launchpad_tests)
 RUN_TEST(launchpad_test);
 RUN_TEST(argument_size_test);
+RUN_TEST_PERFORMANCE(spawn_latency_benchmark);
 END_TEST_CASE(launchpad_tests)
 
 int main(int argc, char **argv)
@@ -0,0 +1,61 @@
+# Copyright 2017 The Fuchsia Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+# Private copies of libc's x86-64 assembly string functions, so every
+# implementation can be tested, not just the one this machine picks.
+string_x86_64_srcs := $(wildcard $(LOCAL_DIR)/x86-64/*.S)
+string_x86_64_flags := -I. -Ithird_party/ulib/musl/src/internal
+
+# Userspace tests.
+
+MODULE := $(LOCAL_DIR)
+
+MODULE_TYPE := usertest
+
+MODULE_SRCS += $(LOCAL_DIR)/string.c
+
+# Like libc, skip the assembly versions under ASan.
+ifeq ($(SUBARCH):$(call TOBOOL,$(USE_ASAN)),x86-64:false)
+MODULE_SRCS += $(string_x86_64_srcs)
+MODULE_DEFINES := STRING_TEST_X86_64=1
+MODULE_COMPILEFLAGS := $(string_x86_64_flags)
+endif
+
+MODULE_NAME := string-test
+
+MODULE_LIBS := system/ulib/unittest system/ulib/fdio system/ulib/zircon system/ulib/c
+
+include make/module.mk
+
+# Host tests, which compare the same routines against the host's libc.
+# The assembly is written for ELF, so it is only built for Linux hosts.
+
+MODULE := $(LOCAL_DIR).hostapp
+
+MODULE_TYPE := hostapp
+
+MODULE_SRCS += $(LOCAL_DIR)/string.c
+
+ifeq ($(HOST_PLATFORM):$(HOST_ARCH),linux:x86_64)
+MODULE_SRCS += $(string_x86_64_srcs)
+MODULE_DEFINES := STRING_TEST_X86_64=1
+MODULE_COMPILEFLAGS := $(string_x86_64_flags)
+endif
+
+MODULE_NAME := string-test
+
+MODULE_HOST_LIBS := \
+    system/ulib/unittest.hostlib \
+    system/ulib/pretty.hostlib
+
+MODULE_COMPILEFLAGS += -Isystem/ulib/unittest/include
+
+include make/module.mk
+
+# Clear out local variables.
+
+string_x86_64_srcs :=
+string_x86_64_flags :=
@@ -0,0 +1,435 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#define _DEFAULT_SOURCE // for MAP_ANONYMOUS and clock_gettime on the host
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unittest/unittest.h>
+
+#ifdef __Fuchsia__
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+#else
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#if STRING_TEST_X86_64
+#include <cpuid.h>
+
+#include "hwcap.h"
+#endif
+
+typedef struct string_impl {
+    const char* name;
+    size_t hwcap;
+    void* (*memcpy)(void*, const void*, size_t);
+    void* (*memmove)(void*, const void*, size_t);
+    void* (*memset)(void*, int, size_t);
+    void* (*memchr)(const void*, int, size_t);
+    int (*memcmp)(const void*, const void*, size_t);
+    int (*strcmp)(const char*, const char*);
+    size_t (*strlen)(const char*);
+} string_impl_t;
+
+#if STRING_TEST_X86_64
+size_t string_test_hwcap;
+void* string_test_memcpy(void*, const void*, size_t);
+void* string_test_memmove(void*, const void*, size_t);
+void* string_test_memset(void*, int, size_t);
+void* string_test_memchr(const void*, int, size_t);
+int string_test_memcmp(const void*, const void*, size_t);
+int string_test_strcmp(const char*, const char*);
+size_t string_test_strlen(const char*);
+
+#define X86_IMPL(name, hwcap)                                           \
+    { name, hwcap, string_test_memcpy, string_test_memmove,             \
+      string_test_memset, string_test_memchr, string_test_memcmp,       \
+      string_test_strcmp, string_test_strlen }
+#endif
+
+static const string_impl_t impls[] = {
+    {"libc", 0, memcpy, memmove, memset, memchr, memcmp, strcmp, strlen},
+#if STRING_TEST_X86_64
+    X86_IMPL("sse2", 0),
+    X86_IMPL("erms", HWCAP_X86_ERMS),
+    X86_IMPL("avx2", HWCAP_X86_AVX2),
+    X86_IMPL("avx2+erms", HWCAP_X86_AVX2 | HWCAP_X86_ERMS),
+#endif
+};
+
+// Selects |impl|, returning false if this CPU can't run it.
+static bool use_impl(const string_impl_t* impl) {
+#if STRING_TEST_X86_64
+    if (impl->hwcap & HWCAP_X86_AVX2) {
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) || !(ebx & (1u << 5)))
+            return false;
+    }
+    string_test_hwcap = impl->hwcap;
+#endif
+    return true;
+}
+
+#define BUFFER_SIZE 8192u
+
+static uint64_t now_ns(void) {
+#ifdef __Fuchsia__
+    return zx_time_get(ZX_CLOCK_MONOTONIC);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
+
+// Maps two pages, the second of them inaccessible, returning the first.
+static char* map_guarded_page(size_t page_size) {
+#ifdef __Fuchsia__
+    zx_handle_t vmo;
+    if (zx_vmo_create(page_size * 2, 0, &vmo) != ZX_OK)
+        return NULL;
+    uintptr_t addr;
+    zx_status_t status = zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, page_size * 2,
+                                     ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, &addr);
+    zx_handle_close(vmo);
+    if (status != ZX_OK)
+        return NULL;
+    if (zx_vmar_protect(zx_vmar_root_self(), addr + page_size, page_size, 0) != ZX_OK) {
+        zx_vmar_unmap(zx_vmar_root_self(), addr, page_size * 2);
+        return NULL;
+    }
+    return (char*)addr;
+#else
+    void* addr = mmap(NULL, page_size * 2, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED)
+        return NULL;
+    if (mprotect((char*)addr + page_size, page_size, PROT_NONE) != 0) {
+        munmap(addr, page_size * 2);
+        return NULL;
+    }
+    return addr;
+#endif
+}
+
+static void unmap_guarded_page(char* addr, size_t page_size) {
+#ifdef __Fuchsia__
+    zx_vmar_unmap(zx_vmar_root_self(), (uintptr_t)addr, page_size * 2);
+#else
+    munmap(addr, page_size * 2);
+#endif
+}
+
+// Byte at a time versions to check against.
+static void ref_memmove(uint8_t* dst, const uint8_t* src, size_t n) {
+    if (dst < src) {
+        for (size_t i = 0; i < n; ++i)
+            dst[i] = src[i];
+    } else {
+        for (size_t i = n; i > 0; --i)
+            dst[i - 1] = src[i - 1];
+    }
+}
+
+static int sign(int x) {
+    return (x > 0) - (x < 0);
+}
+
+static void fill_random(uint8_t* buf, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+        buf[i] = (uint8_t)rand();
+}
+
+// The sizes to try: every size up to a few times the largest vector, then
+// some bigger ones on both sides of the rep movsb threshold.
+static size_t next_size(size_t n) {
+    return n < 300 ? n + 1 : n * 3 / 2;
+}
+
+static bool copy_test(void) {
+    BEGIN_TEST;
+
+    static uint8_t src[BUFFER_SIZE], dst[BUFFER_SIZE], expected[BUFFER_SIZE];
+    for (size_t i = 0; i < countof(impls); ++i) {
+        const string_impl_t* impl = &impls[i];
+        if (!use_impl(impl))
+            continue;
+        for (size_t n = 0; n < BUFFER_SIZE - 64; n = next_size(n)) {
+            for (size_t align = 0; align < 32; align += 7) {
+                fill_random(src, sizeof(src));
+                fill_random(dst, sizeof(dst));
+                memcpy(expected, dst, sizeof(dst));
+                ref_memmove(expected + align, src + 32 - align, n);
+                void* ret = impl->memcpy(dst + align, src + 32 - align, n);
+                EXPECT_EQ(ret, dst + align, impl->name);
+                ASSERT_EQ(memcmp(dst, expected, sizeof(dst)), 0, impl->name);
+            }
+        }
+    }
+
+    END_TEST;
+}
+
+static bool move_test(void) {
+    BEGIN_TEST;
+
+    static uint8_t buf[BUFFER_SIZE], expected[BUFFER_SIZE];
+    for (size_t i = 0; i < countof(impls); ++i) {
+        const string_impl_t* impl = &impls[i];
+        if (!use_impl(impl))
+            continue;
+        for (size_t n = 0; n < BUFFER_SIZE / 2; n = next_size(n)) {
+            // Overlap by a little and by a lot, in both directions.
+            static const size_t distances[] = {1, 15, 33, 200};
+            for (size_t j = 0; j < countof(distances); ++j) {
+                size_t d = distances[j];
+                fill_random(buf, sizeof(buf));
+                memcpy(expected, buf, sizeof(buf));
+                ref_memmove(expected + 64, expected + 64 + d, n);
+                impl->memmove(buf + 64, buf + 64 + d, n);
+                ASSERT_EQ(memcmp(buf, expected, sizeof(buf)), 0, impl->name);
+
+                ref_memmove(expected + 64 + d, expected + 64, n);
+                impl->memmove(buf + 64 + d, buf + 64, n);
+                ASSERT_EQ(memcmp(buf, expected, sizeof(buf)), 0, impl->name);
+            }
+        }
+    }
+
+    END_TEST;
+}
+
+static bool set_test(void) {
+    BEGIN_TEST;
+
+    static uint8_t buf[BUFFER_SIZE];
+    for (size_t i = 0; i < countof(impls); ++i) {
+        const string_impl_t* impl = &impls[i];
+        if (!use_impl(impl))
+            continue;
+        for (size_t n = 0; n < BUFFER_SIZE - 64; n = next_size(n)) {
+            for (size_t align = 0; align < 32; align += 7) {
+                memset(buf, 0x5a, sizeof(buf));
+                int c = 0x100 | (int)(n & 0xff);
+                void* ret = impl->memset(buf + align, c, n);
+                EXPECT_EQ(ret, buf + align, impl->name);
+                for (size_t k = 0; k < sizeof(buf); ++k) {
+                    uint8_t expected = (k >= align && k < align + n) ? (uint8_t)c : 0x5a;
+                    if (buf[k] != expected)
+                        ASSERT_EQ(buf[k], expected, impl->name);
+                }
+            }
+        }
+    }
+
+    END_TEST;
+}
+
+static bool compare_test(void) {
+    BEGIN_TEST;
+
+    static uint8_t a[BUFFER_SIZE], b[BUFFER_SIZE];
+    for (size_t i = 0; i < countof(impls); ++i) {
+        const string_impl_t* impl = &impls[i];
+        if (!use_impl(impl))
+            continue;
+        for (size_t n = 0; n < BUFFER_SIZE / 2; n = next_size(n)) {
+            for (size_t align = 0; align < 32; align += 7) {
+                fill_random(a, sizeof(a));
+                memcpy(b, a, sizeof(b));
+                EXPECT_EQ(impl->memcmp(a + align, b + 32 - align, 0), 0, impl->name);
+
+                // Equal, then differing in one byte, compared as unsigned.
+                memcpy(b + 32 - align, a + align, n);
+                EXPECT_EQ(impl->memcmp(a + align, b + 32 - align, n), 0, impl->name);
+                if (n == 0)
+                    continue;
+                size_t k = (size_t)rand() % n;
+                b[32 - align + k] = (uint8_t)(a[align + k] ^ 0x80);
+                int expected = a[align + k] < b[32 - align + k] ? -1 : 1;
+                EXPECT_EQ(sign(impl->memcmp(a + align, b + 32 - align, n)), expected,
+                          impl->name);
+
+                // As strings with no early terminator.
+                for (size_t m = 0; m < n; ++m) {
+                    if (a[align + m] == 0)
+                        a[align + m] = 1;
+                    b[32 - align + m] = a[align + m];
+                }
+                a[align + n] = b[32 - align + n] = 0;
+                EXPECT_EQ(impl->strlen((const char*)a + align), n, impl->name);
+                EXPECT_EQ(impl->strcmp((const char*)a + align, (const char*)b + 32 - align), 0,
+                          impl->name);
+                b[32 - align + k] = (uint8_t)(a[align + k] == 0xff ? 1 : 0xff);
+                expected = a[align + k] < b[32 - align + k] ? -1 : 1;
+                EXPECT_EQ(sign(impl->strcmp((const char*)a + align,
+                                            (const char*)b + 32 - align)),
+                          expected, impl->name);
+                b[32 - align + k] = 0;
+                EXPECT_EQ(sign(impl->strcmp((const char*)a + align,
+                                            (const char*)b + 32 - align)),
+                          1, impl->name);
+            }
+        }
+    }
+
+    END_TEST;
+}
+
+static bool chr_test(void) {
+    BEGIN_TEST;
+
+    static uint8_t buf[BUFFER_SIZE];
+    for (size_t i = 0; i < countof(impls); ++i) {
+        const string_impl_t* impl = &impls[i];
+        if (!use_impl(impl))
+            continue;
+        for (size_t n = 1; n < BUFFER_SIZE / 2; n = next_size(n)) {
+            for (size_t align = 0; align < 32; align += 7) {
+                memset(buf, 'a', sizeof(buf));
+                uint8_t* s = buf + align;
+                EXPECT_NULL(impl->memchr(s, 'b', n), impl->name);
+
+                // Matches just past the end don't count, even if the size
+                // overflows the address space.
+                s[n] = 'b';
+                EXPECT_NULL(impl->memchr(s, 'b', n), impl->name);
+                EXPECT_EQ(impl->memchr(s, 'b', SIZE_MAX), s + n, impl->name);
+                s[n - 1] = 'b';
+                EXPECT_EQ(impl->memchr(s, 'b', n), s + n - 1, impl->name);
+                // Only the low byte of the character counts.
+                s[0] = 'b';
+                EXPECT_EQ(impl->memchr(s, 'b' | 0x100, n), s, impl->name);
+            }
+        }
+    }
+
+    END_TEST;
+}
+
+// Strings that end right before an inaccessible page must not fault.
+static bool page_end_test(void) {
+    BEGIN_TEST;
+
+#ifdef __Fuchsia__
+    size_t page_size = PAGE_SIZE;
+#else
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+#endif
+    char* addr = map_guarded_page(page_size);
+    ASSERT_NONNULL(addr, "");
+    char* end = addr + page_size;
+
+    for (size_t i = 0; i < countof(impls); ++i) {
+        const string_impl_t* impl = &impls[i];
+        if (!use_impl(impl))
+            continue;
+        for (size_t len = 0; len < 40; ++len) {
+            // One string at the end of the page and a copy of it at
+            // each alignment at the start.
+            char* s = end - len - 1;
+            memset(s, 'x', len);
+            s[len] = '\0';
+            char* t = addr + len % 16;
+            memcpy(t, s, len + 1);
+            EXPECT_EQ(impl->strlen(s), len, impl->name);
+            EXPECT_EQ(impl->strcmp(s, t), 0, impl->name);
+            EXPECT_EQ(impl->strcmp(t, s), 0, impl->name);
+            EXPECT_EQ(impl->memchr(s, '\0', len + 1), s + len, impl->name);
+            EXPECT_EQ(impl->memcmp(s, t, len + 1), 0, impl->name);
+        }
+    }
+
+    unmap_guarded_page(addr, page_size);
+
+    END_TEST;
+}
+
+static bool throughput_benchmark(void) {
+    BEGIN_TEST;
+
+    static const size_t kMaxSize = 1u << 20;
+    uint8_t* src = malloc(kMaxSize);
+    uint8_t* dst = malloc(kMaxSize);
+    ASSERT_NONNULL(src, "");
+    ASSERT_NONNULL(dst, "");
+    memset(src, 'a', kMaxSize);
+    src[kMaxSize - 1] = '\0';
+    memset(dst, 'a', kMaxSize);
+    dst[kMaxSize - 1] = '\0';
+
+    for (size_t i = 0; i < countof(impls); ++i) {
+        const string_impl_t* impl = &impls[i];
+        if (!use_impl(impl))
+            continue;
+        unittest_printf("\n    %s:", impl->name);
+        for (size_t n = 1; n <= kMaxSize; n *= 4) {
+            // Touch about 256MiB, in at most a million calls.
+            size_t rounds = (256u << 20) / n;
+            if (rounds > 1000000)
+                rounds = 1000000;
+
+            uint64_t results[4];
+            uint64_t start = now_ns();
+            for (size_t r = 0; r < rounds; ++r)
+                impl->memcpy(dst, src, n);
+            results[0] = now_ns() - start;
+
+            start = now_ns();
+            for (size_t r = 0; r < rounds; ++r)
+                EXPECT_EQ(impl->memcmp(dst, src, n), 0, "");
+            results[2] = now_ns() - start;
+
+            start = now_ns();
+            for (size_t r = 0; r < rounds; ++r)
+                impl->memset(dst, 'a', n);
+            results[1] = now_ns() - start;
+
+            start = now_ns();
+            for (size_t r = 0; r < rounds; ++r)
+                EXPECT_NULL(impl->memchr(src, 'b', n), "");
+            results[3] = now_ns() - start;
+
+            // MB/s is bytes per microsecond.
+            uint64_t bytes = (uint64_t)rounds * n * 1000;
+            unittest_printf("\n      %7zu bytes: memcpy %6" PRIu64 " MB/s, memset %6" PRIu64
+                            " MB/s, memcmp %6" PRIu64 " MB/s, memchr %6" PRIu64 " MB/s",
+                            n, bytes / (results[0] + 1), bytes / (results[1] + 1),
+                            bytes / (results[2] + 1), bytes / (results[3] + 1));
+        }
+        uint64_t start = now_ns();
+        for (int r = 0; r < 256; ++r)
+            EXPECT_EQ(impl->strlen((const char*)src), kMaxSize - 1, "");
+        uint64_t elapsed = now_ns() - start;
+        unittest_printf("\n      strlen of 1MiB: %" PRIu64 " MB/s",
+                        (uint64_t)256 * kMaxSize * 1000 / (elapsed + 1));
+    }
+    unittest_printf("\n");
+
+    free(src);
+    free(dst);
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(string_tests)
+RUN_TEST(copy_test)
+RUN_TEST(move_test)
+RUN_TEST(set_test)
+RUN_TEST(compare_test)
+RUN_TEST(chr_test)
+RUN_TEST(page_end_test)
+RUN_TEST_PERFORMANCE(throughput_benchmark)
+END_TEST_CASE(string_tests)
+
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
@@ -0,0 +1,22 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+// libc's string functions are built into the test renamed, so they don't
+// replace the real ones, and read their hwcap bits from a variable the
+// tests control.
+
+#define __hwcap string_test_hwcap
+#define __memcpy_fwd string_test_memcpy_fwd
+#define __unsanitized_memcpy string_test_unsanitized_memcpy
+#define __unsanitized_memmove string_test_unsanitized_memmove
+#define __unsanitized_memset string_test_unsanitized_memset
+#define memchr string_test_memchr
+#define memcmp string_test_memcmp
+#define memcpy string_test_memcpy
+#define memmove string_test_memmove
+#define memset string_test_memset
+#define strcmp string_test_strcmp
+#define strlen string_test_strlen
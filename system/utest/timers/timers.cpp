@@ -3,12 +3,15 @@
 // found in the LICENSE file.
 
 #include <assert.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <threads.h>
 
 #include <zx/timer.h>
 
+#include <fbl/alloc_checker.h>
 #include <fbl/type_support.h>
+#include <fbl/unique_ptr.h>
 
 #include <unistd.h>
 #include <unittest/unittest.h>
@@ -170,6 +173,49 @@ static bool coalesce_test_late() {
     return coalesce_test(ZX_TIMER_SLACK_LATE);
 }
 
+// Measures arming and canceling a timer while many others are pending,
+// which is what a busy server with lots of outstanding deadlines does.
+static bool arm_cancel_benchmark() {
+    BEGIN_TEST;
+
+    constexpr size_t kMaxPending = 20000;
+    constexpr size_t kIterations = 10000;
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<zx::timer[]> timers(new (&ac) zx::timer[kMaxPending]);
+    ASSERT_TRUE(ac.check());
+
+    const zx_time_t far = zx_deadline_after(ZX_SEC(3600));
+    uint32_t seed = 1;
+    size_t pending = 0;
+    for (size_t count = 10; count <= kMaxPending; count *= 10) {
+        // Park |count| timers at scattered deadlines far in the future,
+        // half of them with slack.
+        for (; pending < count; ++pending) {
+            uint32_t mode = (pending % 2) ? ZX_TIMER_SLACK_LATE : ZX_TIMER_SLACK_CENTER;
+            ASSERT_EQ(zx::timer::create(mode, ZX_CLOCK_MONOTONIC, &timers[pending]), ZX_OK);
+            seed = seed * 1103515245 + 12345;
+            zx_duration_t slack = (pending % 2) ? ZX_USEC(seed % 1000) : 0u;
+            ASSERT_EQ(timers[pending].set(far + ZX_USEC(seed % 1000000), slack), ZX_OK);
+        }
+
+        zx::timer timer;
+        ASSERT_EQ(zx::timer::create(ZX_TIMER_SLACK_CENTER, ZX_CLOCK_MONOTONIC, &timer), ZX_OK);
+        zx_time_t start = zx_time_get(ZX_CLOCK_MONOTONIC);
+        for (size_t ix = 0; ix != kIterations; ++ix) {
+            seed = seed * 1103515245 + 12345;
+            ASSERT_EQ(timer.set(far + ZX_USEC(seed % 1000000), ZX_USEC(100)), ZX_OK);
+            ASSERT_EQ(timer.cancel(), ZX_OK);
+        }
+        zx_duration_t elapsed = zx_time_get(ZX_CLOCK_MONOTONIC) - start;
+        unittest_printf("\n    %5zu pending: %" PRIu64 " ns per arm+cancel",
+                        pending, elapsed / kIterations);
+    }
+    unittest_printf("\n");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(timers_test)
 RUN_TEST(invalid_calls)
 RUN_TEST(basic_test)
@@ -179,6 +225,7 @@ RUN_TEST(restart_test)
 RUN_TEST(edge_cases)
 RUN_TEST(restart_race)
 RUN_TEST(signals_asserted_immediately)
+RUN_TEST_PERFORMANCE(arm_cancel_benchmark)
 END_TEST_CASE(timers_test)
 
 int main(int argc, char** argv) {
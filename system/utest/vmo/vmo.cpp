@@ -1058,6 +1058,53 @@ bool vmo_cache_test() {
     END_TEST;
 }
 
+bool vmo_lock_test() {
+    BEGIN_TEST;
+
+    zx_handle_t vmo;
+    const size_t size = 4 * PAGE_SIZE;
+    ASSERT_EQ(ZX_OK, zx_vmo_create(size, 0, &vmo), "");
+
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, zx_vmo_op_range(vmo, ZX_VMO_OP_LOCK, 0, 0, NULL, 0), "");
+    EXPECT_EQ(ZX_ERR_OUT_OF_RANGE,
+              zx_vmo_op_range(vmo, ZX_VMO_OP_LOCK, 0, size + PAGE_SIZE, NULL, 0), "");
+
+    // Locking commits the pages, and then keeps them.
+    EXPECT_EQ(ZX_OK, zx_vmo_op_range(vmo, ZX_VMO_OP_LOCK, PAGE_SIZE, 2 * PAGE_SIZE, NULL, 0), "");
+    zx_paddr_t before[2], after[2];
+    EXPECT_EQ(ZX_OK, zx_vmo_op_range(vmo, ZX_VMO_OP_LOOKUP, PAGE_SIZE, 2 * PAGE_SIZE,
+                                     before, sizeof(before)), "");
+    EXPECT_EQ(ZX_ERR_BAD_STATE,
+              zx_vmo_op_range(vmo, ZX_VMO_OP_DECOMMIT, 0, size, NULL, 0), "");
+    EXPECT_NE(ZX_OK, zx_vmo_set_size(vmo, PAGE_SIZE), "");
+    EXPECT_EQ(ZX_OK, zx_vmo_op_range(vmo, ZX_VMO_OP_LOOKUP, PAGE_SIZE, 2 * PAGE_SIZE,
+                                     after, sizeof(after)), "");
+    EXPECT_EQ(0, memcmp(before, after, sizeof(before)), "");
+
+    // Only a range that was locked can be unlocked, once per lock.
+    EXPECT_EQ(ZX_ERR_NOT_FOUND,
+              zx_vmo_op_range(vmo, ZX_VMO_OP_UNLOCK, 0, PAGE_SIZE, NULL, 0), "");
+    EXPECT_EQ(ZX_OK, zx_vmo_op_range(vmo, ZX_VMO_OP_LOCK, PAGE_SIZE, PAGE_SIZE, NULL, 0), "");
+    EXPECT_EQ(ZX_OK, zx_vmo_op_range(vmo, ZX_VMO_OP_UNLOCK, PAGE_SIZE, 2 * PAGE_SIZE, NULL, 0),
+              "");
+    EXPECT_EQ(ZX_ERR_NOT_FOUND,
+              zx_vmo_op_range(vmo, ZX_VMO_OP_UNLOCK, PAGE_SIZE, 2 * PAGE_SIZE, NULL, 0), "");
+    EXPECT_EQ(ZX_ERR_BAD_STATE,
+              zx_vmo_op_range(vmo, ZX_VMO_OP_DECOMMIT, PAGE_SIZE, PAGE_SIZE, NULL, 0), "");
+    EXPECT_EQ(ZX_OK, zx_vmo_op_range(vmo, ZX_VMO_OP_DECOMMIT, 2 * PAGE_SIZE, PAGE_SIZE, NULL, 0),
+              "");
+
+    // Closing the last handle unlocks the rest.
+    zx_handle_t dup;
+    ASSERT_EQ(ZX_OK, zx_handle_duplicate(vmo, ZX_RIGHT_SAME_RIGHTS, &dup), "");
+    EXPECT_EQ(ZX_OK, zx_handle_close(vmo), "");
+    EXPECT_EQ(ZX_ERR_BAD_STATE,
+              zx_vmo_op_range(dup, ZX_VMO_OP_DECOMMIT, PAGE_SIZE, PAGE_SIZE, NULL, 0), "");
+    EXPECT_EQ(ZX_OK, zx_handle_close(dup), "");
+
+    END_TEST;
+}
+
 bool vmo_decommit_misaligned_test() {
     BEGIN_TEST;
 
@@ -1244,6 +1291,7 @@ RUN_TEST(vmo_resize_test);
 RUN_TEST(vmo_rights_test);
 RUN_TEST(vmo_lookup_test);
 RUN_TEST(vmo_commit_test);
+RUN_TEST(vmo_lock_test);
 RUN_TEST(vmo_decommit_misaligned_test);
 RUN_TEST(vmo_cache_test);
 RUN_TEST(vmo_zero_page_test);
@@ -352,9 +352,12 @@ static Sym* gnu_lookup_filtered(uint32_t h1, uint32_t* hashtab,
 #define ARCH_SYM_REJECT_UND(s) 0
 #endif
 
+// Like find_sym, but for callers that already have the name's GNU hash
+// (dlsym computes it for its cache probe).
 __NO_SAFESTACK NO_ASAN
-static struct symdef find_sym(struct dso* dso, const char* s, int need_def) {
-    uint32_t h = 0, gh, gho, *ght;
+static struct symdef find_sym_gnu_hashed(struct dso* dso, const char* s,
+                                         uint32_t gh, int need_def) {
+    uint32_t h = 0, gho, *ght;
     size_t ghm = 0;
     struct symdef def = {};
     for (; dso; dso = dso->next) {
@@ -363,7 +366,6 @@ static struct symdef find_sym(struct dso* dso, const char* s, int need_def) {
             continue;
         if ((ght = dso->ghashtab)) {
             if (!ghm) {
-                gh = gnu_hash(s);
                 int maskbits = 8 * sizeof ghm;
                 gho = gh / maskbits;
                 ghm = 1ul << gh % maskbits;
@@ -397,6 +399,44 @@ static struct symdef find_sym(struct dso* dso, const char* s, int need_def) {
     return def;
 }
 
+__NO_SAFESTACK NO_ASAN
+static struct symdef find_sym(struct dso* dso, const char* s, int need_def) {
+    return find_sym_gnu_hashed(dso, s, gnu_hash(s), need_def);
+}
+
+// Relocations within one DSO frequently refer to the same symbol: a
+// GOT slot and a PLT slot for the same function, or the many vtable and
+// typeinfo references in C++ code.  Remember recent lookups by symbol
+// index so each one only goes through find_sym once per DSO.  Entries
+// are only valid for the generation in which they were filled, and the
+// generation is bumped before relocating each DSO.  This lives in .bss
+// rather than on the stack so stage 2 need not clear it with memset.
+// Callers of reloc_all are serialized (startup, or dlopen under lock).
+// This is the only relocation work saved: replaying precomputed
+// relocations or sharing relocated RELRO pages between processes would
+// need every DSO at the same address everywhere, which ASLR rules out.
+#define SYMCACHE_SIZE 128
+static struct symcache_entry {
+    unsigned int gen;
+    unsigned int key;
+    struct symdef def;
+} symcache[SYMCACHE_SIZE];
+static unsigned int symcache_gen;
+
+__NO_SAFESTACK NO_ASAN
+static struct symdef find_sym_cached(struct dso* ctx, int sym_index,
+                                     const char* name, int need_def) {
+    unsigned int key = (unsigned int)sym_index << 1 | !!need_def;
+    struct symcache_entry* e = &symcache[key % SYMCACHE_SIZE];
+    if (e->gen == symcache_gen && e->key == key)
+        return e->def;
+    struct symdef def = find_sym(ctx, name, need_def);
+    e->gen = symcache_gen;
+    e->key = key;
+    e->def = def;
+    return def;
+}
+
 __attribute__((__visibility__("hidden"))) ptrdiff_t __tlsdesc_static(void), __tlsdesc_dynamic(void);
 
 __NO_SAFESTACK NO_ASAN static void do_relocs(struct dso* dso, size_t* rel,
@@ -435,8 +475,12 @@ __NO_SAFESTACK NO_ASAN static void do_relocs(struct dso* dso, size_t* rel,
             sym = syms + sym_index;
             name = strings + sym->st_name;
             ctx = type == REL_COPY ? head->next : head;
-            def = (sym->st_info & 0xf) == STT_SECTION ? (struct symdef){.dso = dso, .sym = sym}
-                                                      : find_sym(ctx, name, type == REL_PLT);
+            if ((sym->st_info & 0xf) == STT_SECTION)
+                def = (struct symdef){.dso = dso, .sym = sym};
+            else if (type == REL_COPY)
+                def = find_sym(ctx, name, 0);
+            else
+                def = find_sym_cached(ctx, sym_index, name, type == REL_PLT);
             if (!def.sym && (sym->st_shndx != SHN_UNDEF || sym->st_info >> 4 != STB_WEAK)) {
                 error("Error relocating %s: %s: symbol not found", dso->name, name);
                 if (runtime)
@@ -1257,6 +1301,7 @@ __NO_SAFESTACK NO_ASAN static void reloc_all(struct dso* p) {
         if (p->relocated)
             continue;
         decode_vec(p->dynv, dyn, DYN_CNT);
+        ++symcache_gen;
         do_relocs(p, laddr(p, dyn[DT_JMPREL]), dyn[DT_PLTRELSZ], 2 + (dyn[DT_PLTREL] == DT_RELA));
         do_relocs(p, laddr(p, dyn[DT_REL]), dyn[DT_RELSZ], 2);
         do_relocs(p, laddr(p, dyn[DT_RELA]), dyn[DT_RELASZ], 3);
@@ -1993,14 +2038,17 @@ void* __tls_get_addr(size_t*);
 
 static bool find_sym_for_dlsym(struct dso* p,
                                const char* name,
-                               uint32_t* name_gnu_hash,
+                               uint32_t name_gnu_hash,
                                uint32_t* name_sysv_hash,
-                               void** result) {
+                               void** result, bool* is_tls) {
     const Sym* sym;
     if (p->ghashtab != NULL) {
-        if (*name_gnu_hash == 0)
-            *name_gnu_hash = gnu_hash(name);
-        sym = gnu_lookup(*name_gnu_hash, p->ghashtab, p, name);
+        // Check the bloom filter first, as find_sym does, so that
+        // objects that cannot define the name cost only a word test.
+        uint32_t gh = name_gnu_hash;
+        int maskbits = 8 * sizeof(size_t);
+        sym = gnu_lookup_filtered(gh, p->ghashtab, p, name,
+                                  gh / maskbits, 1ul << gh % maskbits);
     } else {
         if (*name_sysv_hash == 0)
             *name_sysv_hash = sysv_hash(name);
@@ -2008,6 +2056,7 @@ static bool find_sym_for_dlsym(struct dso* p,
     }
     if (sym && (sym->st_info & 0xf) == STT_TLS) {
         *result = __tls_get_addr((size_t[]){p->tls_id, sym->st_value});
+        *is_tls = true;
         return true;
     }
     if (sym && sym->st_value && (1 << (sym->st_info & 0xf) & OK_TYPES)) {
@@ -2017,15 +2066,75 @@ static bool find_sym_for_dlsym(struct dso* p,
     if (p->deps) {
         for (struct dso** dep = p->deps; *dep != NULL; ++dep) {
             if (find_sym_for_dlsym(*dep, name, name_gnu_hash, name_sysv_hash,
-                                   result))
+                                   result, is_tls))
                 return true;
         }
     }
     return false;
 }
 
+// Cache of recent successful dlsym results, so that programs that look
+// up the same names repeatedly (plugin hosts, or code that resolves
+// optional entry points on every call) don't walk the whole DSO list
+// each time.  Results depend on the set of loaded objects, so every
+// entry is tagged with the gencnt at the time it was filled; any
+// dlopen bumps gencnt and so invalidates the whole cache.  RTLD_NEXT
+// (which depends on the caller) and TLS symbols (which depend on the
+// calling thread) are never cached, nor are names too long to store.
+// dlsym runs under the read lock, so the cache has its own lock.
+#define DLSYM_CACHE_SIZE 64
+#define DLSYM_CACHE_NAME_MAX 48
+static struct dlsym_cache_entry {
+    unsigned long long gen; // gencnt + 1; zero means empty.
+    const void* handle;
+    uint32_t hash;
+    char name[DLSYM_CACHE_NAME_MAX];
+    void* result;
+} dlsym_cache[DLSYM_CACHE_SIZE];
+static pthread_mutex_t dlsym_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct dlsym_cache_entry* dlsym_cache_slot(const void* handle,
+                                                  uint32_t hash) {
+    return &dlsym_cache[(hash ^ ((uintptr_t)handle >> 4)) % DLSYM_CACHE_SIZE];
+}
+
+static bool dlsym_cache_lookup(const void* handle, const char* s,
+                               uint32_t hash, void** result) {
+    bool found = false;
+    pthread_mutex_lock(&dlsym_cache_lock);
+    struct dlsym_cache_entry* e = dlsym_cache_slot(handle, hash);
+    if (e->gen == gencnt + 1 && e->handle == handle && e->hash == hash &&
+        !strcmp(e->name, s)) {
+        *result = e->result;
+        found = true;
+    }
+    pthread_mutex_unlock(&dlsym_cache_lock);
+    return found;
+}
+
+static void dlsym_cache_insert(const void* handle, const char* s,
+                               uint32_t hash, void* result) {
+    size_t len = strlen(s);
+    if (len >= DLSYM_CACHE_NAME_MAX)
+        return;
+    pthread_mutex_lock(&dlsym_cache_lock);
+    struct dlsym_cache_entry* e = dlsym_cache_slot(handle, hash);
+    e->gen = gencnt + 1;
+    e->handle = handle;
+    e->hash = hash;
+    memcpy(e->name, s, len + 1);
+    e->result = result;
+    pthread_mutex_unlock(&dlsym_cache_lock);
+}
+
 static void* do_dlsym(struct dso* p, const char* s, void* ra) {
+    // Hash the name once; the cache probe and every lookup below use it.
+    uint32_t gnu_hash_val = gnu_hash(s), sysv_hash_val = 0;
+    void* result;
+    if (p != RTLD_NEXT && dlsym_cache_lookup(p, s, gnu_hash_val, &result))
+        return result;
     if (p == head || p == RTLD_DEFAULT || p == RTLD_NEXT) {
+        void* handle = p;
         if (p == RTLD_DEFAULT) {
             p = head;
         } else if (p == RTLD_NEXT) {
@@ -2034,19 +2143,25 @@ static void* do_dlsym(struct dso* p, const char* s, void* ra) {
                 p = head;
             p = p->next;
         }
-        struct symdef def = find_sym(p, s, 0);
+        struct symdef def = find_sym_gnu_hashed(p, s, gnu_hash_val, 0);
         if (!def.sym)
             goto failed;
         if ((def.sym->st_info & 0xf) == STT_TLS)
             return __tls_get_addr((size_t[]){def.dso->tls_id, def.sym->st_value});
-        return laddr(def.dso, def.sym->st_value);
+        result = laddr(def.dso, def.sym->st_value);
+        if (handle != RTLD_NEXT)
+            dlsym_cache_insert(handle, s, gnu_hash_val, result);
+        return result;
     }
     if (__dl_invalid_handle(p))
         return 0;
-    uint32_t gnu_hash = 0, sysv_hash = 0;
-    void* result;
-    if (find_sym_for_dlsym(p, s, &gnu_hash, &sysv_hash, &result))
+    bool is_tls = false;
+    if (find_sym_for_dlsym(p, s, gnu_hash_val, &sysv_hash_val,
+                           &result, &is_tls)) {
+        if (!is_tls)
+            dlsym_cache_insert(p, s, gnu_hash_val, result);
         return result;
+    }
 failed:
     error("Symbol not found: %s", s);
     return 0;
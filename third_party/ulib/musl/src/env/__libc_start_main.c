@@ -81,6 +81,10 @@ __NO_SAFESTACK _Noreturn void __libc_start_main(
     // out the zeroing as dead stores.
     __asm__("# keepalive %0" :: "m"(randoms));
 
+    // Let the string functions pick their implementations before any
+    // program code runs.
+    __init_hwcap();
+
     // extract process startup information from channel in arg
     zx_handle_t bootstrap = (uintptr_t)arg;
 
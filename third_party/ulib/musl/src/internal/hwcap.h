@@ -0,0 +1,21 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+// Bits in __hwcap, which is filled in by __init_hwcap() early in process
+// startup. Until then it is zero, so code that checks these bits must
+// work without them. This file is included from assembly too.
+
+#ifdef __x86_64__
+// AVX2 instructions are supported and the OS saves the YMM registers.
+#define HWCAP_X86_AVX2 (1 << 0)
+// Enhanced REP MOVSB/STOSB: rep movsb and rep stosb are fast for
+// large sizes.
+#define HWCAP_X86_ERMS (1 << 1)
+#endif
+
+#ifdef __ASSEMBLER__
+.hidden __hwcap
+#endif
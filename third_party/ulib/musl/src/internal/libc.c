@@ -1,9 +1,37 @@
 #include "libc.h"
+#include "hwcap.h"
 #include "setjmp_impl.h"
 
+#ifdef __x86_64__
+#include <cpuid.h>
+#endif
+
 struct __libc __libc;
 
 size_t __hwcap;
+
+__NO_SAFESTACK void __init_hwcap(void) {
+#ifdef __x86_64__
+    // CPUID.1:ECX.OSXSAVE[bit 27], CPUID.7:EBX.AVX2[bit 5] and
+    // CPUID.7:EBX.ERMS[bit 9].
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0, NULL) < 7)
+        return;
+    __cpuid(1, eax, ebx, ecx, edx);
+    bool osxsave = ecx & (1u << 27);
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    if (ebx & (1u << 9))
+        __hwcap |= HWCAP_X86_ERMS;
+    if ((ebx & (1u << 5)) && osxsave) {
+        // The OS must also have enabled saving the SSE and AVX state.
+        uint32_t xcr0_lo, xcr0_hi;
+        __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+        if ((xcr0_lo & 0x6) == 0x6)
+            __hwcap |= HWCAP_X86_AVX2;
+    }
+#endif
+}
+
 char *__progname = 0, *__progname_full = 0;
 
 weak_alias(__progname, program_invocation_short_name);
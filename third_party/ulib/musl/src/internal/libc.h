@@ -44,6 +44,7 @@ extern struct __libc __libc ATTR_LIBC_VISIBILITY;
 #define libc __libc
 
 extern size_t __hwcap ATTR_LIBC_VISIBILITY;
+void __init_hwcap(void) ATTR_LIBC_VISIBILITY;
 extern char *__progname, *__progname_full;
 
 void __libc_start_init(void) ATTR_LIBC_VISIBILITY;
@@ -107,14 +107,28 @@ LOCAL_SRCS += \
 else
 
 LOCAL_SRCS += \
-    $(GET_LOCAL_DIR)/memchr.c \
-    $(GET_LOCAL_DIR)/memcmp.c \
     $(GET_LOCAL_DIR)/strchr.c \
     $(GET_LOCAL_DIR)/strchrnul.c \
-    $(GET_LOCAL_DIR)/strcmp.c \
     $(GET_LOCAL_DIR)/strcpy.c \
-    $(GET_LOCAL_DIR)/strlen.c \
     $(GET_LOCAL_DIR)/strncmp.c \
     $(GET_LOCAL_DIR)/strnlen.c \
 
+# The assembly versions read past the ends of the strings, so only use them
+# if x86-64 and not ASan.
+ifeq ($(SUBARCH):$(call TOBOOL,$(USE_ASAN)),x86-64:false)
+LOCAL_SRCS += \
+    $(GET_LOCAL_DIR)/x86_64/memchr.S \
+    $(GET_LOCAL_DIR)/x86_64/memcmp.S \
+    $(GET_LOCAL_DIR)/x86_64/strcmp.S \
+    $(GET_LOCAL_DIR)/x86_64/strlen.S \
+
+else
+LOCAL_SRCS += \
+    $(GET_LOCAL_DIR)/memchr.c \
+    $(GET_LOCAL_DIR)/memcmp.c \
+    $(GET_LOCAL_DIR)/strcmp.c \
+    $(GET_LOCAL_DIR)/strlen.c \
+
+endif
+
 endif